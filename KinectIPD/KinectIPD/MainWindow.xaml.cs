@@ -489,6 +489,7 @@ namespace KinectIPD
             _hasValidIPD = false;
             _currentAcceptableStdDev = _acceptableStdDevStart;
             _ipds = new List<double>();
+            _pupilDetect.ResetTracking();
             if (!_isDebugMode)
                 debugMessage.Text = "";
             IPDText = string.Empty;
@@ -862,11 +863,11 @@ namespace KinectIPD
 
             busy = true;
 
-            Size leftPixelSize = new Size(_kinect.LeftEyeRect.Width, _kinect.LeftEyeRect.Height);
-            byte[] leftPixelArray = _kinect.ColorBitmap.ToArray(new Int32Rect((int)_kinect.LeftEyeRect.X, (int)_kinect.LeftEyeRect.Y, (int)_kinect.LeftEyeRect.Width, (int)_kinect.LeftEyeRect.Height));
+            Int32Rect leftPixelRect = new Int32Rect((int)_kinect.LeftEyeRect.X, (int)_kinect.LeftEyeRect.Y, (int)_kinect.LeftEyeRect.Width, (int)_kinect.LeftEyeRect.Height);
+            byte[] leftPixelArray = _kinect.ColorBitmap.ToArray(leftPixelRect);
 
-            Size rightPixelSize = new Size(_kinect.RightEyeRect.Width, _kinect.RightEyeRect.Height);
-            byte[] rightPixelArray = _kinect.ColorBitmap.ToArray(new Int32Rect((int)_kinect.RightEyeRect.X, (int)_kinect.RightEyeRect.Y, (int)_kinect.RightEyeRect.Width, (int)_kinect.RightEyeRect.Height));
+            Int32Rect rightPixelRect = new Int32Rect((int)_kinect.RightEyeRect.X, (int)_kinect.RightEyeRect.Y, (int)_kinect.RightEyeRect.Width, (int)_kinect.RightEyeRect.Height);
+            byte[] rightPixelArray = _kinect.ColorBitmap.ToArray(rightPixelRect);
 
             if ((bool)AutoExposure.IsChecked && !(_recorder.IsRecording || _recorder.IsPlaying))
             {
@@ -905,16 +906,15 @@ namespace KinectIPD
                 Rect leftPupilLocalRect = Rect.Empty;
                 Point leftPupilLocalCenter = new Point();
 
-                var leftEyeTask = _pupilDetect.FindPupil(ref leftPixelArray, (int)leftPixelSize.Width, (int)leftPixelSize.Height);
-                var rightEyeTask = _pupilDetect.FindPupil(ref rightPixelArray, (int)rightPixelSize.Width, (int)rightPixelSize.Height);
-                if (leftEyeTask != null && rightEyeTask != null)
+                var eyesTask = _pupilDetect.TrackPupils(ref leftPixelArray, leftPixelRect, ref rightPixelArray, rightPixelRect);
+                if (eyesTask != null)
                 {
-                    Task.WaitAll(new Task[] { leftEyeTask, rightEyeTask });
+                    eyesTask.Wait();
 
-                    leftPupilLocalRect = leftEyeTask.Result.rectangle;
-                    leftPupilLocalCenter = leftEyeTask.Result.center;
-                    rightPupilLocalRect = rightEyeTask.Result.rectangle;
-                    rightPupilLocalCenter = rightEyeTask.Result.center;
+                    leftPupilLocalRect = eyesTask.Result[0].rectangle;
+                    leftPupilLocalCenter = eyesTask.Result[0].center;
+                    rightPupilLocalRect = eyesTask.Result[1].rectangle;
+                    rightPupilLocalCenter = eyesTask.Result[1].center;
                 }
 
                 _foundPupils =
@@ -30,6 +30,25 @@ namespace KinectIPD
         public float PostProcessThreshold { get; set; }
         public float MaxMag { get; set; }
     };
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MEyeImage
+    {
+        public IntPtr Pixels;
+        public int Width;
+        public int Height;
+        public int Left;
+        public int Top;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct MPupilTrackInfo
+    {
+        public float CenterX { get; private set; }
+        public float CenterY { get; private set; }
+        public float Confidence { get; private set; }
+        public int FullSearch { get; private set; }
+    }
     #endregion
     public class PupilDetect
     {
@@ -49,12 +68,22 @@ namespace KinectIPD
         [DllImport(@"PupilDetectDLL.dll")]
         private static extern int FindCenter(IntPtr instance, IntPtr pixels, int width, int height, out IntPtr PupilInfo, bool writeFiles, string fileNamePrefix);
 
+        [DllImport(@"PupilDetectDLL.dll")]
+        private static extern IntPtr CreatePupilTracker(IntPtr instance);
+
+        [DllImport(@"PupilDetectDLL.dll")]
+        private static extern void ResetPupilTracker(IntPtr tracker);
+
+        [DllImport(@"PupilDetectDLL.dll")]
+        private static extern int TrackCenters(IntPtr tracker, ref MEyeImage leftEye, ref MEyeImage rightEye, out IntPtr leftPupilTrackInfo, out IntPtr rightPupilTrackInfo);
+
         #endregion
 
 
         private float _ignoreBorderWidth = 5.0f;
         private MPupilDetectSettings _settings;
         private IntPtr _pupilDetectDLL = IntPtr.Zero;
+        private IntPtr _pupilTracker = IntPtr.Zero;
 
         public PupilDetect()
         {
@@ -70,6 +99,7 @@ namespace KinectIPD
             _settings.PostProcessThreshold = .95f;
             _settings.MaxMag = 50;
             UpdatePupilDetectSettings();
+            _pupilTracker = CreatePupilTracker(_pupilDetectDLL);
         }
 
         public struct PupilDetectResult
@@ -110,14 +140,9 @@ namespace KinectIPD
                 var pupilResult = new PupilDetectResult();
                 if (result == 1)
                 {
+                    // Copied on the thread that called FindCenter, before it can overwrite the PupilInfo.
                     var PupilInfo = (MPupilInfo)Marshal.PtrToStructure(pPupilInfo, typeof(MPupilInfo));
-                    // Reject the result if the pupil was found along the border - usually not valid.
-                    if (PupilInfo.CenterX > _ignoreBorderWidth && PupilInfo.CenterX < width - _ignoreBorderWidth &&
-                    PupilInfo.CenterY > _ignoreBorderWidth && PupilInfo.CenterY < height - _ignoreBorderWidth)
-                    {
-                        pupilResult.center = new Point(PupilInfo.CenterX, PupilInfo.CenterY);
-                        pupilResult.rectangle = new Rect(PupilInfo.CenterX - 2, PupilInfo.CenterY - 2, 4, 4);
-                    }
+                    pupilResult = ToPupilDetectResult(PupilInfo.CenterX, PupilInfo.CenterY, width, height);
                 }
                 return pupilResult;
             });
@@ -125,6 +150,64 @@ namespace KinectIPD
             return t;
         }
 
+        // Pupils of both eyes in the latest frame, searched near where they were in the previous frame.
+        // The eye rectangles are in the color image, so the pupils can be followed as the face moves.
+        // Call ResetTracking when someone else walks up.
+        public Task<PupilDetectResult[]> TrackPupils(ref byte[] leftArray, Int32Rect leftEyeRect, ref byte[] rightArray, Int32Rect rightEyeRect)
+        {
+            if (leftEyeRect.Width == 0 || leftEyeRect.Height == 0 || rightEyeRect.Width == 0 || rightEyeRect.Height == 0)
+            {
+                return null;
+            }
+
+            // Copy the arrays to unmanaged memory.
+            IntPtr leftPnt = Marshal.AllocHGlobal(leftArray.Length);
+            Marshal.Copy(leftArray, 0, leftPnt, leftArray.Length);
+            IntPtr rightPnt = Marshal.AllocHGlobal(rightArray.Length);
+            Marshal.Copy(rightArray, 0, rightPnt, rightArray.Length);
+
+            Task<PupilDetectResult[]> t = Task.Run(() =>
+            {
+                var leftEye = new MEyeImage { Pixels = leftPnt, Width = leftEyeRect.Width, Height = leftEyeRect.Height, Left = leftEyeRect.X, Top = leftEyeRect.Y };
+                var rightEye = new MEyeImage { Pixels = rightPnt, Width = rightEyeRect.Width, Height = rightEyeRect.Height, Left = rightEyeRect.X, Top = rightEyeRect.Y };
+                var pLeftInfo = IntPtr.Zero;
+                var pRightInfo = IntPtr.Zero;
+                var result = TrackCenters(_pupilTracker, ref leftEye, ref rightEye, out pLeftInfo, out pRightInfo);
+                Marshal.FreeHGlobal(leftPnt);
+                Marshal.FreeHGlobal(rightPnt);
+
+                var pupilResults = new PupilDetectResult[2];
+                if (result == 1)
+                {
+                    var leftInfo = (MPupilTrackInfo)Marshal.PtrToStructure(pLeftInfo, typeof(MPupilTrackInfo));
+                    var rightInfo = (MPupilTrackInfo)Marshal.PtrToStructure(pRightInfo, typeof(MPupilTrackInfo));
+                    pupilResults[0] = ToPupilDetectResult(leftInfo.CenterX, leftInfo.CenterY, leftEyeRect.Width, leftEyeRect.Height);
+                    pupilResults[1] = ToPupilDetectResult(rightInfo.CenterX, rightInfo.CenterY, rightEyeRect.Width, rightEyeRect.Height);
+                }
+                return pupilResults;
+            });
+
+            return t;
+        }
+
+        public void ResetTracking()
+        {
+            ResetPupilTracker(_pupilTracker);
+        }
+
+        private PupilDetectResult ToPupilDetectResult(float centerX, float centerY, int width, int height)
+        {
+            var pupilResult = new PupilDetectResult();
+            // Reject the result if the pupil was found along the border - usually not valid.
+            if (centerX > _ignoreBorderWidth && centerX < width - _ignoreBorderWidth &&
+            centerY > _ignoreBorderWidth && centerY < height - _ignoreBorderWidth)
+            {
+                pupilResult.center = new Point(centerX, centerY);
+                pupilResult.rectangle = new Rect(centerX - 2, centerY - 2, 4, 4);
+            }
+            return pupilResult;
+        }
+
         private void UpdatePupilDetectSettings()
         {
             var pPupilSettings = Marshal.AllocHGlobal(Marshal.SizeOf(typeof(MPupilDetectSettings)));
@@ -0,0 +1,570 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Runs IPupilDetect over a corpus of labeled eye images, and reports how far the centers it finds are from the labels,
+// and how long each stage of finding them took.  Sweeps settings in parallel to find the fastest ones that meet an accuracy target.
+//
+// Only depends on OpenCV.  Build it with CMake from this directory, see the top of CMakeLists.txt.
+//
+// The corpus is a text file with a line per eye image: file,x,y
+// where x and y are the labeled pupil center in the image's pixels, and file is relative to the text file.
+// Images are cropped to one eye, like the rectangles the kiosk passes to FindCenter.
+//
+// With --upsampled, every eye is also found the way FindCenter used to find it, by upsampling it by ScaleInput first,
+// and the latency and cv::Mat allocations of both, and the distance between their centers, are reported too.
+//
+// With --track, the corpus lines are also tracked as consecutive frames of one eye with IPupilTracker, and the latency,
+// the number of full searches and the distance from FindCenter's center on the frames the tracker followed are reported.
+
+#include "stdafx.h"
+#include "PupilDetectExports.h"
+#include "PupilDetect.h"
+#include "findEyeCenter.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using PupilDetect::PupilDetectSettings;
+using PupilDetect::PupilTimings;
+
+class Sample
+{
+public:
+	std::string file;
+	cv::Mat pixels;	// BGRA, like the kiosk's color frames
+	cv::Point2f label;
+};
+
+// One setting and the values to sweep it over.
+class Sweep
+{
+public:
+	std::string name;
+	std::vector<double> values;
+};
+
+class Result
+{
+public:
+	PupilDetectSettings settings;
+	// Pixels from the label, sorted.
+	std::vector<double> errors;
+	// Mean milliseconds per eye.
+	PupilTimings timings = {};
+	std::string failure;
+
+	// With --upsampled: mean milliseconds per eye of the upsampled pipeline, cv::Mat buffers allocated per eye
+	// on the thread that searched it, and the mean and largest distance in pixels between the centers of both.
+	bool upsampled = false;
+	double upsampledMS = 0;
+	double allocations = 0;
+	double upsampledAllocations = 0;
+	double upsampledDistance = 0;
+	double maxUpsampledDistance = 0;
+
+	// With --track: mean milliseconds per frame, frames the tracker searched in full, and the mean and largest distance
+	// in pixels from FindCenter's center on the other frames.
+	bool track = false;
+	double trackMS = 0;
+	int fullSearches = 0;
+	double trackDistance = 0;
+	double maxTrackDistance = 0;
+
+	double Percentile(double percentile) const
+	{
+		if (errors.empty())
+			return 0;
+		size_t rank = (size_t)std::ceil(percentile / 100.0 * errors.size());
+		return errors[std::min(errors.size(), std::max((size_t)1, rank)) - 1];
+	}
+};
+
+// Counts the cv::Mat buffers allocated on each thread, for --upsampled.
+#if CV_VERSION_MAJOR >= 4
+typedef cv::AccessFlag MatAccessFlags;
+#else
+typedef int MatAccessFlags;
+#endif
+class CountingAllocator : public cv::MatAllocator
+{
+public:
+	CountingAllocator(cv::MatAllocator* allocator) : m_allocator(allocator) {}
+
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, MatAccessFlags flags, cv::UMatUsageFlags usageFlags) const
+	{
+		// Mats that wrap the caller's pixels do not allocate.
+		if (data == nullptr)
+			s_allocations++;
+		return m_allocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+	}
+
+	bool allocate(cv::UMatData* data, MatAccessFlags accessFlags, cv::UMatUsageFlags usageFlags) const
+	{
+		return m_allocator->allocate(data, accessFlags, usageFlags);
+	}
+
+	void deallocate(cv::UMatData* data) const
+	{
+		m_allocator->deallocate(data);
+	}
+
+	// Before any Mats are created, so every Mat is deallocated by the allocator that allocated it.
+	static void Install()
+	{
+		cv::Mat::setDefaultAllocator(new CountingAllocator(cv::Mat::getStdAllocator()));
+	}
+
+	static int GetAllocations()
+	{
+		return s_allocations;
+	}
+
+private:
+	cv::MatAllocator* m_allocator;
+	static thread_local int s_allocations;
+};
+thread_local int CountingAllocator::s_allocations = 0;
+
+// FindCenter before the eye was resampled once at its own size: upsampled by ScaleInput, then scaled down again by findEyeCenter.
+cv::Point2f FindCenterUpsampled(const cv::Mat& eye, const PupilDetectSettings& settings)
+{
+	cv::Mat biggerImg;
+	int scale = settings.ScaleInput;
+	cv::resize(eye, biggerImg, cv::Size(eye.cols * scale, eye.rows * scale));
+
+	cv::Mat grayImg;
+	cv::cvtColor(biggerImg, grayImg, cv::COLOR_BGRA2GRAY);
+	cv::Rect eyeRegion(0, 0, eye.cols * scale, eye.rows * scale);
+	EyeCenter eyeCenter;
+	PupilDetect::ApplySettings(settings, eyeCenter);
+	cv::Point pupil = eyeCenter.findEyeCenter(grayImg, eyeRegion, "", false, "");
+	return cv::Point2f((float)pupil.x / scale, (float)pupil.y / scale);
+}
+
+// The settings PupilDetect.cs gives the DLL.
+PupilDetectSettings KioskSettings(PupilDetectSettings settings)
+{
+	settings.EnableWeight = true;
+	settings.EnablePostProcess = true;
+	settings.FastEyeWidth = 75;
+	settings.WeightBlurSize = 7;
+	settings.WeightDivisor = 1;
+	settings.GradientThreshold = 50;
+	settings.PostProcessThreshold = .95f;
+	settings.MaxMag = 50;
+	return settings;
+}
+
+bool SetSetting(PupilDetectSettings& settings, const std::string& name, double value)
+{
+	if (name == "ScaleInput")
+		settings.ScaleInput = (int)value;
+	else if (name == "FastEyeWidth")
+		settings.FastEyeWidth = (int)value;
+	else if (name == "WeightBlurSize")
+		settings.WeightBlurSize = (int)value;
+	else if (name == "EnableWeight")
+		settings.EnableWeight = value != 0;
+	else if (name == "WeightDivisor")
+		settings.WeightDivisor = (float)value;
+	else if (name == "GradientThreshold")
+		settings.GradientThreshold = value;
+	else if (name == "EnablePostProcess")
+		settings.EnablePostProcess = value != 0;
+	else if (name == "PostProcessThreshold")
+		settings.PostProcessThreshold = (float)value;
+	else if (name == "MaxMag")
+		settings.MaxMag = (float)value;
+	else
+		return false;
+	return true;
+}
+
+std::string Describe(const PupilDetectSettings& settings)
+{
+	char text[256];
+	snprintf(text, sizeof(text), "FastEyeWidth=%i WeightBlurSize=%i EnableWeight=%i WeightDivisor=%g GradientThreshold=%g EnablePostProcess=%i PostProcessThreshold=%g MaxMag=%g",
+		settings.FastEyeWidth, settings.WeightBlurSize, settings.EnableWeight ? 1 : 0, settings.WeightDivisor, settings.GradientThreshold,
+		settings.EnablePostProcess ? 1 : 0, settings.PostProcessThreshold, settings.MaxMag);
+	return text;
+}
+
+bool LoadCorpus(const std::string& path, std::vector<Sample>& samples)
+{
+	std::ifstream stream(path);
+	if (!stream)
+	{
+		printf("Could not open %s\n", path.c_str());
+		return false;
+	}
+
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(stream, line))
+	{
+		lineNumber++;
+		if (line.empty() || line[0] == '#' || line == "\r")
+			continue;
+
+		std::istringstream fields(line);
+		Sample sample;
+		std::string x, y;
+		if (!std::getline(fields, sample.file, ',') || !std::getline(fields, x, ',') || !std::getline(fields, y))
+		{
+			printf("%s:%i: expected file,x,y\n", path.c_str(), lineNumber);
+			return false;
+		}
+		sample.label = cv::Point2f((float)atof(x.c_str()), (float)atof(y.c_str()));
+
+		cv::Mat image = cv::imread(directory + sample.file, cv::IMREAD_COLOR);
+		if (image.empty())
+		{
+			printf("Could not read %s\n", (directory + sample.file).c_str());
+			return false;
+		}
+		cv::cvtColor(image, sample.pixels, cv::COLOR_BGR2BGRA);
+		samples.push_back(sample);
+	}
+	return !samples.empty();
+}
+
+// Every combination of the swept values, on top of base.
+std::vector<PupilDetectSettings> Combinations(const PupilDetectSettings& base, const std::vector<Sweep>& sweeps)
+{
+	std::vector<PupilDetectSettings> combinations(1, base);
+	for (const Sweep& sweep : sweeps)
+	{
+		std::vector<PupilDetectSettings> next;
+		for (const PupilDetectSettings& settings : combinations)
+		{
+			for (double value : sweep.values)
+			{
+				PupilDetectSettings combination = settings;
+				SetSetting(combination, sweep.name, value);
+				next.push_back(combination);
+			}
+		}
+		combinations = next;
+	}
+	return combinations;
+}
+
+// Tracks the samples as consecutive frames of the left eye, each at the top left of the camera image,
+// and compares every frame the tracker followed with FindCenter's full search.
+void TrackFrames(IPupilDetect* detect, IPupilTracker* tracker, const std::vector<Sample>& samples, int repeat, Result& result)
+{
+	int trackedFrames = 0;
+	for (int i = 0; i < repeat; ++i)
+	{
+		ResetPupilTracker(tracker);
+		for (const Sample& sample : samples)
+		{
+			PupilDetect::EyeImage image = { sample.pixels.data, sample.pixels.cols, sample.pixels.rows, 0, 0 };
+			PupilDetect::PupilTrackInfo* info;
+			int64 start = cv::getTickCount();
+			TrackCenter(tracker, 0, &image, &info);
+			result.trackMS += (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+			if (i > 0)
+				continue;
+			if (info->FullSearch)
+			{
+				result.fullSearches++;
+				continue;
+			}
+
+			cv::Point2f center(info->CenterX, info->CenterY);
+			PupilDetect::PupilInfo* fullSearch;
+			FindCenter(detect, sample.pixels.data, sample.pixels.cols, sample.pixels.rows, &fullSearch, false, "");
+			double distance = cv::norm(cv::Point2f(fullSearch->CenterX, fullSearch->CenterY) - center);
+			result.trackDistance += distance;
+			result.maxTrackDistance = std::max(result.maxTrackDistance, distance);
+			trackedFrames++;
+		}
+	}
+
+	result.trackMS /= (double)samples.size() * repeat;
+	if (trackedFrames > 0)
+		result.trackDistance /= trackedFrames;
+}
+
+Result Evaluate(const PupilDetectSettings& settings, const std::vector<Sample>& samples, int repeat, bool upsampled, bool track)
+{
+	Result result;
+	result.settings = settings;
+	result.upsampled = upsampled;
+	result.track = track;
+
+	IPupilDetect* detect = CreatePupilDetect();
+	SetSettings(detect, &result.settings);
+	IPupilTracker* tracker = track ? CreatePupilTracker(detect) : nullptr;
+	try
+	{
+		for (const Sample& sample : samples)
+		{
+			for (int i = 0; i < repeat; ++i)
+			{
+				PupilDetect::PupilInfo* info;
+				int allocations = CountingAllocator::GetAllocations();
+				FindCenter(detect, sample.pixels.data, sample.pixels.cols, sample.pixels.rows, &info, false, "");
+				result.allocations += CountingAllocator::GetAllocations() - allocations;
+				cv::Point2f center(info->CenterX, info->CenterY);
+
+				const PupilTimings* timings = GetTimings(detect);
+				result.timings.Resize += timings->Resize;
+				result.timings.Gradient += timings->Gradient;
+				result.timings.Voting += timings->Voting;
+				result.timings.PostProcess += timings->PostProcess;
+				result.timings.Total += timings->Total;
+				if (i == 0)
+					result.errors.push_back(cv::norm(center - sample.label));
+
+				if (upsampled)
+				{
+					int64 start = cv::getTickCount();
+					allocations = CountingAllocator::GetAllocations();
+					cv::Point2f upsampledCenter = FindCenterUpsampled(sample.pixels, settings);
+					result.upsampledMS += (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+					result.upsampledAllocations += CountingAllocator::GetAllocations() - allocations;
+					if (i == 0)
+					{
+						double distance = cv::norm(upsampledCenter - center);
+						result.upsampledDistance += distance / samples.size();
+						result.maxUpsampledDistance = std::max(result.maxUpsampledDistance, distance);
+					}
+				}
+			}
+		}
+
+		if (track)
+			TrackFrames(detect, tracker, samples, repeat, result);
+	}
+	catch (const cv::Exception& e)
+	{
+		// eg: an even WeightBlurSize
+		result.failure = e.what();
+		result.errors.clear();
+	}
+	DestroyPupilTracker(tracker);
+	DestroyPupilDetect(detect);
+
+	double numEyes = (double)samples.size() * repeat;
+	result.timings.Resize /= numEyes;
+	result.timings.Gradient /= numEyes;
+	result.timings.Voting /= numEyes;
+	result.timings.PostProcess /= numEyes;
+	result.timings.Total /= numEyes;
+	result.upsampledMS /= numEyes;
+	result.allocations /= numEyes;
+	result.upsampledAllocations /= numEyes;
+	std::sort(result.errors.begin(), result.errors.end());
+	return result;
+}
+
+void PrintResult(const Result& result, const char* mark)
+{
+	if (!result.failure.empty())
+	{
+		printf("   failed: %s\n      %s\n", result.failure.c_str(), Describe(result.settings).c_str());
+		return;
+	}
+	printf("%s %6.2f %6.2f %6.2f %6.2f %6.2f %8.3f %8.3f %8.3f %8.3f %8.3f\n      %s\n",
+		mark, result.Percentile(50), result.Percentile(90), result.Percentile(95), result.Percentile(99), result.errors.back(),
+		result.timings.Total, result.timings.Resize, result.timings.Gradient, result.timings.Voting, result.timings.PostProcess,
+		Describe(result.settings).c_str());
+	if (result.upsampled)
+	{
+		printf("      %.1f allocations per eye.  Upsampled by %i: %.3f ms (%.1fx), %.1f allocations, centers %.2f px apart on average, %.2f px at most\n",
+			result.allocations, result.settings.ScaleInput, result.upsampledMS, result.upsampledMS / result.timings.Total, result.upsampledAllocations,
+			result.upsampledDistance, result.maxUpsampledDistance);
+	}
+	if (result.track)
+	{
+		printf("      Tracked: %.3f ms per frame (%.2fx), %i of %i frames searched in full, centers %.2f px from FindCenter's on average, %.2f px at most\n",
+			result.trackMS, result.trackMS / result.timings.Total, result.fullSearches, (int)result.errors.size(),
+			result.trackDistance, result.maxTrackDistance);
+	}
+}
+
+void PrintUsage()
+{
+	printf("Usage: pupildetectbenchmark corpus.txt [options]\n"
+		"  corpus.txt          a line per eye image: file,x,y (labeled center in pixels, file relative to corpus.txt)\n"
+		"  --kiosk             start from the settings the kiosk uses instead of the DLL's defaults\n"
+		"  --set Name=value    change a setting\n"
+		"  --sweep Name=v,...  try each value of a setting; every combination of the swept settings is run\n"
+		"  --percentile P      percentile of the center error the target applies to (default 95)\n"
+		"  --target PX         report the fastest settings with the percentile error at most PX pixels\n"
+		"  --threads N         settings run at once, each on one core (default: all cores)\n"
+		"  --repeat N          times each eye is searched, for steadier timings (default 1)\n"
+		"  --upsampled         also find each eye the way FindCenter used to, upsampled by ScaleInput first, and compare them\n"
+		"  --track             also track the eye images as consecutive frames, and compare the tracked centers with FindCenter's\n"
+		"Settings: ScaleInput (--upsampled only) FastEyeWidth WeightBlurSize (odd) EnableWeight WeightDivisor GradientThreshold EnablePostProcess PostProcessThreshold MaxMag\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	IPupilDetect* defaults = CreatePupilDetect();
+	PupilDetectSettings base = *GetSettings(defaults);
+	DestroyPupilDetect(defaults);
+
+	std::string corpus = argv[1];
+	std::vector<Sweep> sweeps;
+	double percentile = 95;
+	double target = -1;
+	int threads = std::max(1, (int)std::thread::hardware_concurrency());
+	int repeat = 1;
+	bool upsampled = false;
+	bool track = false;
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--kiosk")
+		{
+			base = KioskSettings(base);
+		}
+		else if ((arg == "--set" || arg == "--sweep") && hasValue)
+		{
+			std::string assignment = argv[++i];
+			size_t equals = assignment.find('=');
+			Sweep sweep;
+			sweep.name = assignment.substr(0, equals);
+			std::istringstream values(equals == std::string::npos ? "" : assignment.substr(equals + 1));
+			std::string value;
+			while (std::getline(values, value, ','))
+				sweep.values.push_back(atof(value.c_str()));
+
+			PupilDetectSettings check = base;
+			if (sweep.values.empty() || !SetSetting(check, sweep.name, sweep.values[0]) || (arg == "--set" && sweep.values.size() != 1))
+			{
+				printf("Bad setting: %s\n", assignment.c_str());
+				PrintUsage();
+				return 1;
+			}
+			if (arg == "--set")
+				base = check;
+			else
+				sweeps.push_back(sweep);
+		}
+		else if (arg == "--percentile" && hasValue)
+		{
+			percentile = atof(argv[++i]);
+		}
+		else if (arg == "--target" && hasValue)
+		{
+			target = atof(argv[++i]);
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			threads = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--repeat" && hasValue)
+		{
+			repeat = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--upsampled")
+		{
+			upsampled = true;
+		}
+		else if (arg == "--track")
+		{
+			track = true;
+		}
+		else
+		{
+			printf("Unknown option: %s\n", arg.c_str());
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (upsampled)
+		CountingAllocator::Install();
+
+	std::vector<Sample> samples;
+	if (!LoadCorpus(corpus, samples))
+	{
+		printf("No eye images in %s\n", corpus.c_str());
+		return 1;
+	}
+	double eyeWidth = 0;
+	for (const Sample& sample : samples)
+		eyeWidth += sample.pixels.cols;
+	printf("%i eyes, %.1f pixels wide on average\n", (int)samples.size(), eyeWidth / samples.size());
+
+	std::vector<PupilDetectSettings> combinations = Combinations(base, sweeps);
+	threads = std::min(threads, (int)combinations.size());
+
+	// With several settings at once, each runs on one core, so the timings are comparable with each other.
+	// The center voting would otherwise spread every eye over all of them.
+	int numThreads = cv::getNumThreads();
+	if (threads > 1)
+		cv::setNumThreads(1);
+
+	std::vector<Result> results(combinations.size());
+	std::atomic<int> next(0);
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+	{
+		workers.push_back(std::thread([&]()
+		{
+			for (int i = next++; i < (int)combinations.size(); i = next++)
+				results[i] = Evaluate(combinations[i], samples, repeat, upsampled, track);
+		}));
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+	cv::setNumThreads(numThreads);
+
+	std::sort(results.begin(), results.end(), [](const Result& a, const Result& b)
+	{
+		return a.failure.empty() != b.failure.empty() ? a.failure.empty() : a.timings.Total < b.timings.Total;
+	});
+
+	const Result* fastest = nullptr;
+	printf("\nCenter error (pixels)                  Milliseconds per eye%s\n", threads > 1 ? ", on one core" : "");
+	printf("     p50    p90    p95    p99    max    total   resize gradient   voting     post\n");
+	for (const Result& result : results)
+	{
+		bool meetsTarget = target >= 0 && result.failure.empty() && result.Percentile(percentile) <= target;
+		if (meetsTarget && fastest == nullptr)
+			fastest = &result;
+		PrintResult(result, meetsTarget ? "*" : " ");
+	}
+
+	if (target < 0)
+		return 0;
+	if (fastest == nullptr)
+	{
+		printf("\nNo settings have a p%g center error of at most %g pixels\n", percentile, target);
+		return 2;
+	}
+
+	printf("\nFastest with a p%g center error of at most %g pixels:\n      %s\n", percentile, target, Describe(fastest->settings).c_str());
+	if (threads > 1)
+	{
+		Result alone = Evaluate(fastest->settings, samples, repeat, upsampled, track);
+		printf("On all cores:\n");
+		PrintResult(alone, " ");
+	}
+	return 0;
+}
@@ -46,6 +46,13 @@ PupilDetect::PupilDetectSettings* GetSettings(IPupilDetect* ii)
 	return ii->GetSettings();
 }
 
+PupilDetect::PupilTimings* GetTimings(IPupilDetect* ii)
+{
+	if (ii == nullptr)
+		return nullptr;
+	return ii->GetTimings();
+}
+
 void DestroyPupilDetect(IPupilDetect* ii)
 {
 	delete ii;
@@ -63,41 +70,86 @@ namespace PupilDetect
 		return &m_settings;
 	}
 
-	PupilInfo info;
+	// Buffers reused by every FindCenter call on the same thread.  The kiosk searches both eyes at once, on different threads.
+	// FindCenter and GetTimings hand out pointers to info and timings, see PupilDetect::FindCenter for how long they last.
+	struct FindCenterScratch
+	{
+		Mat grayImg;
+		Mat fastImg;
+		EyeCenter eyeCenter;
+		PupilInfo info;
+		PupilTimings timings;
+	};
+	static thread_local FindCenterScratch scratch;
+
+	PupilTimings* PupilDetect::GetTimings()
+	{
+		return &scratch.timings;
+	}
+
+	void ApplySettings(const PupilDetectSettings& settings, EyeCenter& eyeCenter)
+	{
+		eyeCenter.kFastEyeWidth = settings.FastEyeWidth;
+		eyeCenter.kWeightBlurSize = settings.WeightBlurSize;
+		eyeCenter.kEnableWeight = settings.EnableWeight;
+		eyeCenter.kWeightDivisor = settings.WeightDivisor;
+		eyeCenter.kGradientThreshold = settings.GradientThreshold;
+		eyeCenter.kEnablePostProcess = settings.EnablePostProcess;
+		eyeCenter.kPostProcessThreshold = settings.PostProcessThreshold;
+		eyeCenter.kMaxMag = settings.MaxMag;
+	}
+
+	void ScaleToFastEye(const Mat& eye, Mat& gray, Mat& fastEye, int fastWidth)
+	{
+		cvtColor(eye, gray, COLOR_BGRA2GRAY);
+		int fastHeight = (int)((((float)fastWidth) / eye.cols) * eye.rows);
+		cv::resize(gray, fastEye, cv::Size(fastWidth, fastHeight));
+	}
+
+	Point2f UnscaleFastPoint(Point p, Size eye, Size fastEye)
+	{
+		// cv::resize lines up pixel centers, so map the point back through them.
+		return Point2f((p.x + 0.5f) * eye.width / fastEye.width - 0.5f, (p.y + 0.5f) * eye.height / fastEye.height - 0.5f);
+	}
+
 	int PupilDetect::FindCenter(BYTE * pixels, int width, int height, PupilInfo** irisInfo, bool writeFiles, const char * fileNamePrefix)
 	{
+		int64 start = getTickCount();
+
 		Mat newImg = Mat(height, width, CV_8UC4, pixels);
 		//Mat newImg = imread("DebugImages/20160201_072423/left_orig2.png", CV_8UC4);
 
 		std::vector<int> compression_params;
-		compression_params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+		compression_params.push_back(IMWRITE_PNG_COMPRESSION);
 		compression_params.push_back(9);
 		auto prefix = std::string(fileNamePrefix);
 		if (writeFiles)
 			imwrite(prefix + "_orig.png", newImg, compression_params);
 
-		Mat biggerImg;
-		int scale = m_settings.ScaleInput;
-		cv::resize(newImg, biggerImg, cvSize(width * scale, height * scale));
-		if (writeFiles)
-			imwrite(prefix + "_bigger.png", biggerImg, compression_params);
+		int64 resizeStart = getTickCount();
+		ScaleToFastEye(newImg, scratch.grayImg, scratch.fastImg, m_settings.FastEyeWidth);
+		scratch.timings.Resize = (getTickCount() - resizeStart) * 1000.0 / getTickFrequency();
+		ApplySettings(m_settings, scratch.eyeCenter);
+		cv::Point pupil = scratch.eyeCenter.findFastEyeCenter(scratch.fastImg, writeFiles, prefix);
+		scratch.timings.Gradient = scratch.eyeCenter.gradientMS;
+		scratch.timings.Voting = scratch.eyeCenter.votingMS;
+		scratch.timings.PostProcess = scratch.eyeCenter.postProcessMS;
 
+		Point2f center = UnscaleFastPoint(pupil, newImg.size(), scratch.fastImg.size());
+		scratch.info.CenterX = center.x;
+		scratch.info.CenterY = center.y;
+		*irisInfo = &scratch.info;
+
+		if (writeFiles)
+		{
+			Mat visual;
+			cvtColor(newImg, visual, COLOR_BGRA2BGR);
+			line(visual, Point2f(scratch.info.CenterX, 0), Point2f(scratch.info.CenterX, (float)visual.rows), Scalar(0, 0, 255, 0), 1);
+			line(visual, Point2f(0, scratch.info.CenterY), Point2f((float)visual.cols, scratch.info.CenterY), Scalar(0, 0, 255, 0), 1);
+			imwrite(prefix + "_center.png", visual, compression_params);
+		}
+		scratch.timings.Total = (getTickCount() - start) * 1000.0 / getTickFrequency();
 
-		Mat grayImg;
-		cvtColor(biggerImg, grayImg, CV_BGRA2GRAY);
-		cv::Rect eyeRegion(0, 0, width * scale, height * scale);
-		auto eyeCenter = EyeCenter::EyeCenter();
-		eyeCenter.kFastEyeWidth = m_settings.FastEyeWidth;
-		eyeCenter.kWeightBlurSize = m_settings.WeightBlurSize;
-		eyeCenter.kEnableWeight = m_settings.EnableWeight;
-		eyeCenter.kWeightDivisor = m_settings.WeightDivisor;
-		eyeCenter.kGradientThreshold = m_settings.GradientThreshold;
-		eyeCenter.kEnablePostProcess = m_settings.EnablePostProcess;
-		eyeCenter.kPostProcessThreshold = m_settings.PostProcessThreshold;
-		eyeCenter.kMaxMag = m_settings.MaxMag;
-		cv::Point pupil = eyeCenter.findEyeCenter(grayImg, eyeRegion, "", writeFiles, prefix);
-		PupilInfo *info = new PupilInfo{ (float)pupil.x / scale, (float)pupil.y / scale };
-		*irisInfo = info;
 		return 1;// result;
 	}
 
@@ -4,13 +4,24 @@
 #pragma once
 #include "PupilDetectExports.h"
 
+#include <opencv2/core/core.hpp>
+
+class EyeCenter;
+
 namespace PupilDetect
 {
+	// Shared by PupilDetect and PupilTracker.
+	void ApplySettings(const PupilDetectSettings& settings, EyeCenter& eyeCenter);
+	// Gray at the eye's own size, then a single resample to the fastWidth wide image the center is searched in.
+	void ScaleToFastEye(const cv::Mat& eye, cv::Mat& gray, cv::Mat& fastEye, int fastWidth);
+	// Point in the fast eye image, in the eye image's pixels.
+	cv::Point2f UnscaleFastPoint(cv::Point p, cv::Size eye, cv::Size fastEye);
+
 	class PupilDetect :public IPupilDetect
 	{
 		PupilDetectSettings m_settings =
 		{
-			10, 		//	ScaleInput
+			10, 		//	ScaleInput (unused by FindCenter, see PupilDetectBenchmark --upsampled)
 			75, 		//	FastEyeWidth
 			9, 			//	WeightBlurSize
 			false, 		//	EnableWeight
@@ -23,8 +34,14 @@ namespace PupilDetect
 
 	public:
 		PupilDetect() {}
+		// *irisInfo points into buffers that belong to the calling thread, not to the caller or this PupilDetect.
+		// It is overwritten by the thread's next FindCenter (on any PupilDetect), and freed when the thread exits,
+		// so copy the center out before calling FindCenter again or handing it to another thread.
+		// PupilDetect.cs copies it in the same task that called FindCenter, and PupilDetectBenchmark before the next eye.
 		int FindCenter(BYTE * pixels, int width, int height, PupilInfo** irisInfo, bool writeFiles, const char *fileNamePrefix);
 		void SetSettings(PupilDetectSettings*);
 		PupilDetectSettings* GetSettings();
+		// Of the calling thread's last FindCenter, and valid for as long as its PupilInfo.
+		PupilTimings* GetTimings();
 	};
 }
\ No newline at end of file
@@ -4,16 +4,48 @@
 #pragma once
 #include "PupilInfo.h"
 
-class __declspec(dllexport) IPupilDetect
+// Only the DLL exports anything.  Elsewhere (eg: PupilDetectBenchmark on Linux) the sources are compiled in directly.
+#ifdef _WIN32
+#define PUPILDETECT_API __declspec(dllexport)
+#else
+#define PUPILDETECT_API
+#endif
+
+class PUPILDETECT_API IPupilDetect
 {
 public:
+	virtual ~IPupilDetect() {}
+	// The PupilInfo is owned by the DLL, and is valid until the calling thread's next FindCenter, see PupilDetect::FindCenter.
 	virtual int FindCenter(BYTE * pixels, int width, int height, PupilDetect::PupilInfo**, bool writeFiles, const char * fileName) = 0;
 	virtual void SetSettings(PupilDetect::PupilDetectSettings*) = 0;
 	virtual PupilDetect::PupilDetectSettings* GetSettings() = 0;
+	// Of the calling thread's last FindCenter.
+	virtual PupilDetect::PupilTimings* GetTimings() = 0;
+};
+
+// Follows the pupils of one person across the frames of a video, searching near the previous centers instead of the whole eye.
+// Uses the settings of the IPupilDetect it was created with, which must outlive it.
+class PUPILDETECT_API IPupilTracker
+{
+public:
+	virtual ~IPupilTracker() {}
+	// eye is 0 for the left eye, 1 for the right.  The PupilTrackInfo is owned by the tracker, and is valid until that eye's next frame.
+	virtual int TrackCenter(int eye, const PupilDetect::EyeImage*, PupilDetect::PupilTrackInfo**) = 0;
+	// Both eyes at the same time.
+	virtual int TrackCenters(const PupilDetect::EyeImage* leftEye, const PupilDetect::EyeImage* rightEye, PupilDetect::PupilTrackInfo** leftInfo, PupilDetect::PupilTrackInfo** rightInfo) = 0;
+	// Forget the previous centers, eg: when someone else walks up.  The next frame of each eye is searched in full.
+	virtual void Reset() = 0;
 };
 
-extern "C" __declspec(dllexport) IPupilDetect* CreatePupilDetect();
-extern "C" __declspec(dllexport) int FindCenter(IPupilDetect*, BYTE * pixels, int width, int height, PupilDetect::PupilInfo**, bool writeFiles, const char * fileName);
-extern "C" __declspec(dllexport) void SetSettings(IPupilDetect*, PupilDetect::PupilDetectSettings*);
-extern "C" __declspec(dllexport) PupilDetect::PupilDetectSettings* GetSettings(IPupilDetect*);
-extern "C" __declspec(dllexport) void DestroyPupilDetect(IPupilDetect*);
\ No newline at end of file
+extern "C" PUPILDETECT_API IPupilDetect* CreatePupilDetect();
+extern "C" PUPILDETECT_API int FindCenter(IPupilDetect*, BYTE * pixels, int width, int height, PupilDetect::PupilInfo**, bool writeFiles, const char * fileName);
+extern "C" PUPILDETECT_API void SetSettings(IPupilDetect*, PupilDetect::PupilDetectSettings*);
+extern "C" PUPILDETECT_API PupilDetect::PupilDetectSettings* GetSettings(IPupilDetect*);
+extern "C" PUPILDETECT_API PupilDetect::PupilTimings* GetTimings(IPupilDetect*);
+extern "C" PUPILDETECT_API void DestroyPupilDetect(IPupilDetect*);
+
+extern "C" PUPILDETECT_API IPupilTracker* CreatePupilTracker(IPupilDetect*);
+extern "C" PUPILDETECT_API int TrackCenter(IPupilTracker*, int eye, const PupilDetect::EyeImage*, PupilDetect::PupilTrackInfo**);
+extern "C" PUPILDETECT_API int TrackCenters(IPupilTracker*, const PupilDetect::EyeImage* leftEye, const PupilDetect::EyeImage* rightEye, PupilDetect::PupilTrackInfo** leftInfo, PupilDetect::PupilTrackInfo** rightInfo);
+extern "C" PUPILDETECT_API void ResetPupilTracker(IPupilTracker*);
+extern "C" PUPILDETECT_API void DestroyPupilTracker(IPupilTracker*);
\ No newline at end of file
@@ -11,8 +11,43 @@ namespace PupilDetect
 		float CenterY;
 	};
 
+	// Pixels (BGRA) of one eye, and where they are in the camera image so the tracker can follow the center as the eye moves.
+	struct EyeImage
+	{
+		BYTE* Pixels;
+		int Width;
+		int Height;
+		int Left;
+		int Top;
+	};
+
+	struct PupilTrackInfo
+	{
+		// In the eye image's pixels, like PupilInfo.
+		float CenterX;
+		float CenterY;
+		// 1 when the whole eye was searched, otherwise how strongly the tracked center was voted for compared with the last full search.
+		float Confidence;
+		// 1 if the whole eye was searched, because there was no previous center or the tracked center was not confident enough.
+		int FullSearch;
+	};
+
+	// Milliseconds each stage of finding a center took.
+	struct PupilTimings
+	{
+		// Gray conversion and resampling to FastEyeWidth.
+		double Resize;
+		double Gradient;
+		double Voting;
+		// Averaging the votes, finding the most voted center, and the flood fill when EnablePostProcess is set.
+		double PostProcess;
+		// All of FindCenter.
+		double Total;
+	};
+
 	struct PupilDetectSettings
 	{
+		// Only used by the upsampled pipeline PupilDetectBenchmark --upsampled compares against.  Kept for the layout of MPupilDetectSettings.
 		int ScaleInput;
 		int FastEyeWidth;
 		int WeightBlurSize;
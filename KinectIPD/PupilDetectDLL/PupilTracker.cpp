@@ -0,0 +1,172 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "PupilTracker.h"
+#include "PupilDetect.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "constants.h"
+
+using namespace cv;
+
+IPupilTracker* CreatePupilTracker(IPupilDetect* ii)
+{
+	if (ii == nullptr)
+		return nullptr;
+	return new PupilDetect::PupilTracker(ii);
+}
+
+int TrackCenter(IPupilTracker* tracker, int eye, const PupilDetect::EyeImage* image, PupilDetect::PupilTrackInfo** info)
+{
+	if (tracker == nullptr)
+		return 0;
+	return tracker->TrackCenter(eye, image, info);
+}
+
+int TrackCenters(IPupilTracker* tracker, const PupilDetect::EyeImage* leftEye, const PupilDetect::EyeImage* rightEye, PupilDetect::PupilTrackInfo** leftInfo, PupilDetect::PupilTrackInfo** rightInfo)
+{
+	if (tracker == nullptr)
+		return 0;
+	return tracker->TrackCenters(leftEye, rightEye, leftInfo, rightInfo);
+}
+
+void ResetPupilTracker(IPupilTracker* tracker)
+{
+	if (tracker == nullptr)
+		return;
+	tracker->Reset();
+}
+
+void DestroyPupilTracker(IPupilTracker* tracker)
+{
+	delete tracker;
+}
+
+namespace PupilDetect
+{
+	static bool IsValid(const EyeImage* image)
+	{
+		return image != nullptr && image->Pixels != nullptr && image->Width > 1 && image->Height > 1;
+	}
+
+	// Tracks the left eye on one thread and the right eye on another.
+	class EyeTracking : public ParallelLoopBody
+	{
+	public:
+		EyeTracking(PupilTracker& tracker, const EyeImage* images[2], const PupilDetectSettings& settings)
+			: m_tracker(tracker), m_images(images), m_settings(settings) {}
+
+		void operator()(const Range& range) const
+		{
+			for (int eye = range.start; eye < range.end; ++eye)
+				m_tracker.Track(eye, *m_images[eye], m_settings);
+		}
+
+	private:
+		PupilTracker& m_tracker;
+		const EyeImage** m_images;
+		const PupilDetectSettings& m_settings;
+	};
+
+	int PupilTracker::TrackCenter(int eye, const EyeImage* image, PupilTrackInfo** info)
+	{
+		if (eye < 0 || eye > 1 || !IsValid(image))
+			return 0;
+
+		PupilDetectSettings settings = *m_detect->GetSettings();
+		Track(eye, *image, settings);
+		*info = &m_eyes[eye].info;
+		return 1;
+	}
+
+	int PupilTracker::TrackCenters(const EyeImage* leftEye, const EyeImage* rightEye, PupilTrackInfo** leftInfo, PupilTrackInfo** rightInfo)
+	{
+		if (!IsValid(leftEye) || !IsValid(rightEye))
+			return 0;
+
+		PupilDetectSettings settings = *m_detect->GetSettings();
+		const EyeImage* images[2] = { leftEye, rightEye };
+		parallel_for_(Range(0, 2), EyeTracking(*this, images, settings));
+		*leftInfo = &m_eyes[0].info;
+		*rightInfo = &m_eyes[1].info;
+		return 1;
+	}
+
+	void PupilTracker::Reset()
+	{
+		for (EyeTrack& track : m_eyes)
+			track.reset = true;
+	}
+
+	void PupilTracker::Track(int eye, const EyeImage& image, const PupilDetectSettings& settings)
+	{
+		EyeTrack& track = m_eyes[eye];
+		if (track.reset.exchange(false))
+		{
+			track.tracking = false;
+			track.referenceVote = 0;
+		}
+
+		Mat newImg = Mat(image.Height, image.Width, CV_8UC4, image.Pixels);
+		ScaleToFastEye(newImg, track.grayImg, track.fastImg, settings.FastEyeWidth);
+		ApplySettings(settings, track.eyeCenter);
+
+		Point pupil;
+		double vote = 0;
+		float confidence = 0;
+		bool tracked = false;
+		if (track.tracking && track.referenceVote > 0)
+		{
+			// Previous center, in this frame's fast eye pixels.
+			Point seed(
+				cvRound((track.center.x - image.Left + 0.5f) * track.fastImg.cols / image.Width - 0.5f),
+				cvRound((track.center.y - image.Top + 0.5f) * track.fastImg.rows / image.Height - 0.5f));
+			if (Rect(0, 0, track.fastImg.cols, track.fastImg.rows).contains(seed))
+			{
+				// Half the resolution has a quarter of the gradients, and half the radius reaches as far.
+				pyrDown(track.fastImg, track.coarseImg);
+				ApplySettings(settings, track.coarseEyeCenter);
+				track.coarseEyeCenter.kMaxMag = settings.MaxMag / 2;
+				track.coarseEyeCenter.kWeightBlurSize = (settings.WeightBlurSize / 2) | 1;
+
+				int coarseRadius = kTrackSearchRadius / 2;
+				Point coarseSeed(seed.x / 2, seed.y / 2);
+				double coarseVote;
+				Point coarsePupil = track.coarseEyeCenter.findFastEyeCenterNear(track.coarseImg, coarseSeed, coarseRadius, coarseVote);
+
+				// On the edge of the window, but not of the eye, the pupil probably moved further than the window reaches.
+				bool onEdge =
+					(abs(coarsePupil.x - coarseSeed.x) == coarseRadius && coarsePupil.x > 0 && coarsePupil.x < track.coarseImg.cols - 1) ||
+					(abs(coarsePupil.y - coarseSeed.y) == coarseRadius && coarsePupil.y > 0 && coarsePupil.y < track.coarseImg.rows - 1);
+				if (!onEdge)
+				{
+					pupil = track.eyeCenter.findFastEyeCenterNear(track.fastImg, coarsePupil * 2, kTrackRefineRadius, vote);
+					confidence = (float)std::min(1.0, vote / track.referenceVote);
+					tracked = confidence >= kTrackMinConfidence;
+				}
+			}
+		}
+
+		if (tracked)
+		{
+			track.referenceVote = std::max(track.referenceVote, vote);
+		}
+		else
+		{
+			pupil = track.eyeCenter.findFastEyeCenter(track.fastImg, false, "", &vote);
+			track.referenceVote = vote;
+			confidence = 1;
+		}
+
+		Point2f center = UnscaleFastPoint(pupil, newImg.size(), track.fastImg.size());
+		track.info.CenterX = center.x;
+		track.info.CenterY = center.y;
+		track.info.Confidence = confidence;
+		track.info.FullSearch = tracked ? 0 : 1;
+		track.center = Point2f(image.Left + center.x, image.Top + center.y);
+		track.tracking = true;
+	}
+}
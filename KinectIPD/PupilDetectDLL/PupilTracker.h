@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include "PupilDetectExports.h"
+#include "findEyeCenter.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+
+namespace PupilDetect
+{
+	// Each frame's search starts from the previous frame's center: only the centers within kTrackSearchRadius of it are voted for,
+	// in a half resolution eye, then the centers within kTrackRefineRadius of that center in the full resolution eye.
+	// When the center found that way gets too few votes compared with the last full search (eg: after a blink, or when the pupil
+	// moved further than the window reaches), the whole eye is searched instead, like FindCenter does.
+	//
+	// Each eye has its own buffers, so both eyes can be tracked at the same time, but each eye from one thread at a time.
+	// PupilDetectBenchmark --track compares the tracked centers and latency with FindCenter's.
+	class PupilTracker : public IPupilTracker
+	{
+	public:
+		PupilTracker(IPupilDetect* detect) : m_detect(detect) {}
+		int TrackCenter(int eye, const EyeImage* image, PupilTrackInfo** info);
+		int TrackCenters(const EyeImage* leftEye, const EyeImage* rightEye, PupilTrackInfo** leftInfo, PupilTrackInfo** rightInfo);
+		void Reset();
+
+	private:
+		friend class EyeTracking;
+
+		struct EyeTrack
+		{
+			cv::Mat grayImg;
+			cv::Mat fastImg;
+			cv::Mat coarseImg;
+			EyeCenter eyeCenter;
+			EyeCenter coarseEyeCenter;
+
+			// Set by Reset, which can be called while the eye is being tracked.  Cleared by the eye's next frame.
+			std::atomic<bool> reset{ false };
+			// Center in the camera image in the previous frame.
+			bool tracking = false;
+			cv::Point2f center;
+			// Averaged vote at the center of the last full search.
+			double referenceVote = 0;
+			PupilTrackInfo info;
+		};
+
+		void Track(int eye, const EyeImage& image, const PupilDetectSettings& settings);
+
+		IPupilDetect* m_detect;
+		EyeTrack m_eyes[2];
+	};
+}
@@ -29,6 +29,14 @@ const float kSmoothFaceFactor = 0.005;
 //const bool kEnablePostProcess = true;
 //const float kPostProcessThreshold = 0.95;// 97;
 
+// Tracking
+// Fast eye pixels around the previous center that the tracker searches at half resolution,
+// then around the half resolution center at full resolution.
+const int kTrackSearchRadius = 8;
+const int kTrackRefineRadius = 2;
+// Below this vote at the tracked center, relative to the vote at the last full search's center, the whole eye is searched instead.
+const float kTrackMinConfidence = 0.8f;
+
 // Eye Corner
 const bool kEnableEyeCorner = false;
 
@@ -21,6 +21,11 @@
 #include <queue>
 #include <stdio.h>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define EYE_CENTER_SSE 1
+#include <xmmintrin.h>
+#endif
+
 #include "constants.h"
 #include "helpers.h"
 
@@ -68,8 +73,8 @@ void scaleToFastSize(const cv::Mat &src, cv::Mat &dst, float kFastEyeWidth) {
 	cv::resize(src, dst, cv::Size(kFastEyeWidth, (((float)kFastEyeWidth) / src.cols) * src.rows));
 }
 
-cv::Mat computeMatXGradient(const cv::Mat &mat) {
-	cv::Mat out(mat.rows, mat.cols, CV_64F);
+void computeMatXGradient(const cv::Mat &mat, cv::Mat &out) {
+	out.create(mat.rows, mat.cols, CV_64F);
 
 	for (int y = 0; y < mat.rows; ++y) {
 		const uchar *Mr = mat.ptr<uchar>(y);
@@ -81,12 +86,26 @@ cv::Mat computeMatXGradient(const cv::Mat &mat) {
 		}
 		Or[mat.cols - 1] = Mr[mat.cols - 1] - Mr[mat.cols - 2];
 	}
+}
+
+// Same as the X gradient of the transposed image, without the transposes.
+void computeMatYGradient(const cv::Mat &mat, cv::Mat &out) {
+	out.create(mat.rows, mat.cols, CV_64F);
 
-	return out;
+	for (int y = 0; y < mat.rows; ++y) {
+		const uchar *Pr = mat.ptr<uchar>(std::max(y - 1, 0));
+		const uchar *Nr = mat.ptr<uchar>(std::min(y + 1, mat.rows - 1));
+		double scale = (y == 0 || y == mat.rows - 1) ? 1.0 : 0.5;
+		double *Or = out.ptr<double>(y);
+		for (int x = 0; x < mat.cols; ++x) {
+			Or[x] = (Nr[x] - Pr[x]) * scale;
+		}
+	}
 }
 
 #pragma mark Main Algorithm
 
+// Reference implementation: tests every possible center for one gradient.  Only used by findReferenceEyeCenter.
 void testPossibleCentersFormula(int x, int y, const cv::Mat &weight, double gx, double gy, cv::Mat &out, bool kEnableWeight, float kWeightDivisor, float kMaxMag) {
 	// for all possible centers
 	for (int cy = 0; cy < out.rows; ++cy) {
@@ -118,24 +137,174 @@ void testPossibleCentersFormula(int x, int y, const cv::Mat &weight, double gx,
 	}
 }
 
+void testPossibleCenters(const cv::Mat &gradientX, const cv::Mat &gradientY, const cv::Mat &weight, cv::Mat &outSum, bool kEnableWeight, float kWeightDivisor, float kMaxMag) {
+	outSum = cv::Mat::zeros(weight.rows, weight.cols, CV_64F);
+	for (int y = 0; y < weight.rows; ++y) {
+		const double *Xr = gradientX.ptr<double>(y), *Yr = gradientY.ptr<double>(y);
+		for (int x = 0; x < weight.cols; ++x) {
+			double gX = Xr[x], gY = Yr[x];
+			if (gX == 0.0 && gY == 0.0) {
+				continue;
+			}
+			testPossibleCentersFormula(x, y, weight, gX, gY, outSum, kEnableWeight, kWeightDivisor, kMaxMag);
+		}
+	}
+}
+
+// Same votes as testPossibleCentersFormula, but only for the centers within kMaxMag of the gradient, in float.
+// voteWeight is the weight already divided by kWeightDivisor, or all ones when weighting is disabled.
+// Only the centers in window get votes, and out is window sized.
+void voteForCenters(int x, int y, float gx, float gy, const cv::Mat &voteWeight, cv::Mat &out, float kMaxMag, cv::Rect window) {
+	double maxMag2 = (double)kMaxMag * kMaxMag;
+	int radius = (int)kMaxMag;
+	int cyStart = std::max(window.y, y - radius), cyEnd = std::min(window.y + window.height - 1, y + radius);
+	for (int cy = cyStart; cy <= cyEnd; ++cy) {
+		// widest dx with dx^2 + dy^2 <= kMaxMag^2
+		int dy = y - cy;
+		int halfWidth = (int)sqrt(maxMag2 - dy * dy);
+		while ((double)(halfWidth + 1) * (halfWidth + 1) + dy * dy <= maxMag2) ++halfWidth;
+		while (halfWidth > 0 && (double)halfWidth * halfWidth + dy * dy > maxMag2) --halfWidth;
+		int cxStart = std::max(window.x, x - halfWidth), cxEnd = std::min(window.x + window.width - 1, x + halfWidth);
+		if (cxStart > cxEnd) {
+			continue;
+		}
+
+		float *Or = out.ptr<float>(cy - window.y) + (cxStart - window.x);
+		const float *Wr = voteWeight.ptr<float>(cy) + cxStart;
+		float dyGy = dy * gy;
+		float dy2 = (float)(dy * dy);
+		int cx = cxStart;
+#if EYE_CENTER_SSE
+		// 4 centers at a time, with a Newton step on the reciprocal square root.
+		// The distance is at least 1 except at the gradient itself, where the dot product is 0 anyway.
+		const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), threeHalves = _mm_set1_ps(1.5f), zero = _mm_setzero_ps();
+		const __m128 four = _mm_set1_ps(4.0f), gxV = _mm_set1_ps(gx), dyGyV = _mm_set1_ps(dyGy), dy2V = _mm_set1_ps(dy2);
+		__m128 dxV = _mm_sub_ps(_mm_set1_ps((float)(x - cx)), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+		for (; cx + 3 <= cxEnd; cx += 4) {
+			__m128 d2 = _mm_max_ps(_mm_add_ps(_mm_mul_ps(dxV, dxV), dy2V), one);
+			__m128 r = _mm_rsqrt_ps(d2);
+			r = _mm_mul_ps(r, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, d2), _mm_mul_ps(r, r))));
+			__m128 dotProduct = _mm_max_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(dxV, gxV), dyGyV), r), zero);
+			__m128 vote = _mm_mul_ps(_mm_mul_ps(dotProduct, dotProduct), _mm_loadu_ps(Wr + cx - cxStart));
+			_mm_storeu_ps(Or + cx - cxStart, _mm_add_ps(_mm_loadu_ps(Or + cx - cxStart), vote));
+			dxV = _mm_sub_ps(dxV, four);
+		}
+#endif
+		for (; cx <= cxEnd; ++cx) {
+			float dx = (float)(x - cx);
+			float d2 = std::max(dx * dx + dy2, 1.0f);
+			float dotProduct = std::max(0.0f, (dx * gx + dyGy) / std::sqrt(d2));
+			Or[cx - cxStart] += dotProduct * dotProduct * Wr[cx - cxStart];
+		}
+	}
+}
+
+// Each stripe of gradient rows votes into its own map, since its votes reach kMaxMag rows above and below it.
+class CenterVoting : public cv::ParallelLoopBody {
+public:
+	CenterVoting(const cv::Mat &gradientX, const cv::Mat &gradientY, const cv::Mat &voteWeight, float kMaxMag, std::vector<cv::Mat> &stripeSums)
+		: gradientX(gradientX), gradientY(gradientY), voteWeight(voteWeight), kMaxMag(kMaxMag), stripeSums(stripeSums) {}
+
+	void operator()(const cv::Range &range) const {
+		int numStripes = (int)stripeSums.size();
+		for (int stripe = range.start; stripe < range.end; ++stripe) {
+			cv::Mat &sum = stripeSums[stripe];
+			sum.create(voteWeight.rows, voteWeight.cols, CV_32F);
+			sum.setTo(0);
+			int yEnd = voteWeight.rows * (stripe + 1) / numStripes;
+			for (int y = voteWeight.rows * stripe / numStripes; y < yEnd; ++y) {
+				const double *Xr = gradientX.ptr<double>(y), *Yr = gradientY.ptr<double>(y);
+				for (int x = 0; x < voteWeight.cols; ++x) {
+					if (Xr[x] == 0.0 && Yr[x] == 0.0) {
+						continue;
+					}
+					voteForCenters(x, y, (float)Xr[x], (float)Yr[x], voteWeight, sum, kMaxMag, cv::Rect(0, 0, sum.cols, sum.rows));
+				}
+			}
+		}
+	}
+
+private:
+	const cv::Mat &gradientX, &gradientY, &voteWeight;
+	float kMaxMag;
+	std::vector<cv::Mat> &stripeSums;
+};
+
+// Votes of the gradients within kMaxMag of window for the centers in window only.  outSum is window sized.
+// Far cheaper than voteForAllCenters when the window is small.
+void voteForCentersInWindow(const cv::Mat &gradientX, const cv::Mat &gradientY, const cv::Mat &voteWeight, cv::Rect window, float kMaxMag, cv::Mat &outSum) {
+	outSum.create(window.height, window.width, CV_32F);
+	outSum.setTo(0);
+	int radius = (int)kMaxMag;
+	int yStart = std::max(0, window.y - radius), yEnd = std::min(gradientX.rows, window.y + window.height + radius);
+	int xStart = std::max(0, window.x - radius), xEnd = std::min(gradientX.cols, window.x + window.width + radius);
+	for (int y = yStart; y < yEnd; ++y) {
+		const double *Xr = gradientX.ptr<double>(y), *Yr = gradientY.ptr<double>(y);
+		for (int x = xStart; x < xEnd; ++x) {
+			if (Xr[x] == 0.0 && Yr[x] == 0.0) {
+				continue;
+			}
+			voteForCenters(x, y, (float)Xr[x], (float)Yr[x], voteWeight, outSum, kMaxMag, window);
+		}
+	}
+}
+
+void computeVoteWeight(const cv::Mat &weight, bool kEnableWeight, float kWeightDivisor, cv::Mat &voteWeight) {
+	if (kEnableWeight) {
+		weight.convertTo(voteWeight, CV_32F, 1.0 / kWeightDivisor);
+	}
+	else {
+		voteWeight.create(weight.rows, weight.cols, CV_32F);
+		voteWeight.setTo(1);
+	}
+}
+
+// voteWeight and stripeSums are scratch buffers, reused between calls.
+void voteForAllCenters(const cv::Mat &gradientX, const cv::Mat &gradientY, const cv::Mat &weight, cv::Mat &outSum, bool kEnableWeight, float kWeightDivisor, float kMaxMag,
+	cv::Mat &voteWeight, std::vector<cv::Mat> &stripeSums) {
+	computeVoteWeight(weight, kEnableWeight, kWeightDivisor, voteWeight);
+
+	stripeSums.resize(std::max(1, std::min(cv::getNumThreads(), weight.rows)));
+	cv::parallel_for_(cv::Range(0, (int)stripeSums.size()), CenterVoting(gradientX, gradientY, voteWeight, kMaxMag, stripeSums));
+
+	stripeSums[0].copyTo(outSum);
+	for (size_t i = 1; i < stripeSums.size(); ++i) {
+		outSum += stripeSums[i];
+	}
+}
+
 cv::Point EyeCenter::findEyeCenter(cv::Mat face, cv::Rect eye, std::string debugWindow, bool writeFiles, const std::string fileNamePrefix) {
 	cv::Mat eyeROIUnscaled = face(eye);
 	cv::Mat eyeROI;
 	scaleToFastSize(eyeROIUnscaled, eyeROI, kFastEyeWidth);
+	if (kPlotVectorField) {
+		imwrite("eyeFrame.png", eyeROIUnscaled);
+	}
+	if (writeFiles)
+		cv::imwrite(fileNamePrefix + "_eyeROIUnscaled.png", eyeROIUnscaled);
+
+	cv::Point maxP = findFastEyeCenter(eyeROI, writeFiles, fileNamePrefix);
+	if (writeFiles) {
+		cv::Mat visual;
+		cvtColor(face, visual, cv::COLOR_GRAY2BGR);
+		auto center = unscalePoint(maxP, eye, kFastEyeWidth);
+		line(visual, cv::Point2f(center.x, 0), cv::Point2f(center.x, visual.rows), cv::Scalar(0, 0, 255, 0), 2);
+		line(visual, cv::Point2f(0, center.y), cv::Point2f(visual.cols, center.y), cv::Scalar(0, 0, 255, 0), 2);
+		cv::imwrite(fileNamePrefix + "_center.png", visual);
+	}
+	return unscalePoint(maxP, eye, kFastEyeWidth);
+}
+
+void EyeCenter::computeGradients(const cv::Mat &eyeROI, bool writeFiles, const std::string &fileNamePrefix) {
 	//cv::equalizeHist(eyeROI, eyeROI);
-	// draw eye region
-	//rectangle(face,eye,1234);
-	int width = eyeROI.cols;
-	int height = eyeROI.rows;
 
 	//-- Find the gradient
-	cv::Mat gradientX = computeMatXGradient(eyeROI);
-	cv::Mat gradientY = computeMatXGradient(eyeROI.t()).t();
-	
+	computeMatXGradient(eyeROI, gradientX);
+	computeMatYGradient(eyeROI, gradientY);
 
 	//-- Normalize and threshold the gradient
 	// compute all the magnitudes
-	cv::Mat mags = matrixMagnitude(gradientX, gradientY);
+	cv::magnitude(gradientX, gradientY, mags);
 	//compute the threshold
 	double gradientThresh = computeDynamicThreshold(mags, kGradientThreshold);
 	//double gradientThresh = kGradientThreshold;
@@ -167,7 +336,6 @@ cv::Point EyeCenter::findEyeCenter(cv::Mat face, cv::Rect eye, std::string debug
 		cv::imwrite(fileNamePrefix + "_mags.png", mags);
 	//imshow(debugWindow,gradientX);
   //-- Create a blurred and inverted image for weighting
-	cv::Mat weight;
 	GaussianBlur(eyeROI, weight, cv::Size(kWeightBlurSize, kWeightBlurSize), 0, 0);
 	for (int y = 0; y < weight.rows; ++y) {
 		unsigned char *row = weight.ptr<unsigned char>(y);
@@ -178,26 +346,23 @@ cv::Point EyeCenter::findEyeCenter(cv::Mat face, cv::Rect eye, std::string debug
 	if (writeFiles)
 		cv::imwrite(fileNamePrefix + "_weight.png", weight);
 	//imshow(debugWindow,weight);
+}
+
+cv::Point EyeCenter::findFastEyeCenter(const cv::Mat &eyeROI, bool writeFiles, const std::string &fileNamePrefix, double *peakVote) {
+	int64 gradientStart = cv::getTickCount();
+	computeGradients(eyeROI, writeFiles, fileNamePrefix);
+	gradientMS = (cv::getTickCount() - gradientStart) * 1000.0 / cv::getTickFrequency();
 	//-- Run the algorithm!
-	cv::Mat outSum = cv::Mat::zeros(eyeROI.rows, eyeROI.cols, CV_64F);
 	// for each possible gradient location
 	// Note: these loops are reversed from the way the paper does them
 	// it evaluates every possible center for each gradient location instead of
 	// every possible gradient location for every center.
-	printf("Eye Size: %ix%i\n", outSum.cols, outSum.rows);
-	for (int y = 0; y < weight.rows; ++y) {
-		const double *Xr = gradientX.ptr<double>(y), *Yr = gradientY.ptr<double>(y);
-		for (int x = 0; x < weight.cols; ++x) {
-			double gX = Xr[x], gY = Yr[x];
-			if (gX == 0.0 && gY == 0.0) {
-				continue;
-			}
-			testPossibleCentersFormula(x, y, weight, gX, gY, outSum, kEnableWeight, kWeightDivisor, kMaxMag);
-		}
-	}
+	int64 votingStart = cv::getTickCount();
+	voteForAllCenters(gradientX, gradientY, weight, outSum, kEnableWeight, kWeightDivisor, kMaxMag, voteWeight, stripeSums);
+	votingMS = (cv::getTickCount() - votingStart) * 1000.0 / cv::getTickFrequency();
+	int64 postProcessStart = cv::getTickCount();
 	// scale all the values down, basically averaging them
 	double numGradients = (weight.rows*weight.cols);
-	cv::Mat out;
 	outSum.convertTo(out, CV_32F, 1.0 / numGradients);
 
 	//imshow(debugWindow,out);
@@ -211,16 +376,12 @@ cv::Point EyeCenter::findEyeCenter(cv::Mat face, cv::Rect eye, std::string debug
 	cv::minMaxLoc(out, NULL, &maxVal, NULL, &maxP);
 	//-- Flood fill the edges
 	if (kEnablePostProcess) {
-		cv::Mat floodClone;
 		//double floodThresh = computeDynamicThreshold(out, 1.5);
 		double floodThresh = maxVal *kPostProcessThreshold;
 		cv::threshold(out, floodClone, floodThresh, 0.0f, cv::THRESH_TOZERO);
 		if (kPlotVectorField) {
 			//plotVecField(gradientX, gradientY, floodClone);
-			imwrite("eyeFrame.png", eyeROIUnscaled);
 		}
-		if (writeFiles)
-			cv::imwrite(fileNamePrefix + "_eyeROIUnscaled.png", eyeROIUnscaled);
 		if (writeFiles)
 			;// cv::imwrite(fileNamePrefix + "_floodClone.png", floodClone);
 		cv::Mat mask = floodKillEdges(floodClone);
@@ -231,15 +392,41 @@ cv::Point EyeCenter::findEyeCenter(cv::Mat face, cv::Rect eye, std::string debug
 		// redo max
 		cv::minMaxLoc(out, NULL, &maxVal, NULL, &maxP, mask);
 	}
-	if (writeFiles) {
-		cv::Mat visual;
-		cvtColor(face, visual, CV_GRAY2BGR);
-		auto center = unscalePoint(maxP, eye, kFastEyeWidth);
-		line(visual, cv::Point2f(center.x, 0), cv::Point2f(center.x, visual.rows), cv::Scalar(0, 0, 255, 0), 2);
-		line(visual, cv::Point2f(0, center.y), cv::Point2f(visual.cols, center.y), cv::Scalar(0, 0, 255, 0), 2);
-		cv::imwrite(fileNamePrefix + "_center.png", visual);
+	if (peakVote != NULL)
+		*peakVote = maxVal;
+	postProcessMS = (cv::getTickCount() - postProcessStart) * 1000.0 / cv::getTickFrequency();
+	return maxP;
+}
+
+cv::Point EyeCenter::findReferenceEyeCenter(const cv::Mat &eyeROI, double *peakVote) {
+	computeGradients(eyeROI, false, "");
+	testPossibleCenters(gradientX, gradientY, weight, outSum, kEnableWeight, kWeightDivisor, kMaxMag);
+	cv::Point maxP;
+	double maxVal;
+	cv::minMaxLoc(outSum, NULL, &maxVal, NULL, &maxP);
+	// scaled like findFastEyeCenter's
+	if (peakVote != NULL)
+		*peakVote = maxVal / (eyeROI.rows*eyeROI.cols);
+	return maxP;
+}
+
+cv::Point EyeCenter::findFastEyeCenterNear(const cv::Mat &eyeROI, cv::Point seed, int radius, double &peakVote) {
+	computeGradients(eyeROI, false, "");
+	computeVoteWeight(weight, kEnableWeight, kWeightDivisor, voteWeight);
+
+	cv::Rect window = cv::Rect(seed.x - radius, seed.y - radius, 2 * radius + 1, 2 * radius + 1) & cv::Rect(0, 0, eyeROI.cols, eyeROI.rows);
+	if (window.area() == 0) {
+		peakVote = 0;
+		return seed;
 	}
-	return unscalePoint(maxP, eye, kFastEyeWidth);
+	voteForCentersInWindow(gradientX, gradientY, voteWeight, window, kMaxMag, outSum);
+
+	// scaled like findFastEyeCenter's
+	double numGradients = (eyeROI.rows*eyeROI.cols);
+	cv::Point maxP;
+	cv::minMaxLoc(outSum, NULL, &peakVote, NULL, &maxP);
+	peakVote /= numGradients;
+	return maxP + window.tl();
 }
 
 #pragma mark Postprocessing
@@ -2,6 +2,7 @@
 #define EYE_CENTER_H
 #pragma once
 #include <opencv2/imgproc/imgproc.hpp>
+#include <vector>
 
 class EyeCenter
 {
@@ -16,6 +17,28 @@ public:
 	float kPostProcessThreshold = 0.95;
 	float kMaxMag = 50;
 
+	// Milliseconds the stages of the last findFastEyeCenter took.
+	double gradientMS = 0;
+	double votingMS = 0;
+	double postProcessMS = 0;
+
 cv::Point findEyeCenter(cv::Mat face, cv::Rect eye, std::string debugWindow, bool writeFiles, const std::string fileNamePrefix);
+	// Center of an eye that is already kFastEyeWidth wide, in its pixels.
+	// Not thread safe: the buffers below are reused by every call.
+	// peakVote is the averaged vote at the center.
+	cv::Point findFastEyeCenter(const cv::Mat &eyeROI, bool writeFiles, const std::string &fileNamePrefix, double *peakVote = NULL);
+	// Same, but only considers the centers within radius pixels (in x and y) of seed, and does not post-process.
+	// Its peakVote is comparable with findFastEyeCenter's on the same eye.
+	cv::Point findFastEyeCenterNear(const cv::Mat &eyeROI, cv::Point seed, int radius, double &peakVote);
+	// Most voted center of the same eye, with the original voting that tests every center for every gradient, in double.
+	// Far slower, for PupilDetectTests to check the fast voting against.  Does not post-process.
+	cv::Point findReferenceEyeCenter(const cv::Mat &eyeROI, double *peakVote = NULL);
+
+private:
+	// Normalized gradients and the weight image of eyeROI.
+	void computeGradients(const cv::Mat &eyeROI, bool writeFiles, const std::string &fileNamePrefix);
+
+	cv::Mat gradientX, gradientY, mags, weight, voteWeight, outSum, out, floodClone;
+	std::vector<cv::Mat> stripeSums;
 };
 #endif
\ No newline at end of file
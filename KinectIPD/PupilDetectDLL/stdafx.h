@@ -5,11 +5,16 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files:
 #include <windows.h>
+#else
+// Everything but dllmain.cpp also builds elsewhere, for PupilDetectBenchmark.
+typedef unsigned char BYTE;
+#endif
 
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Checks that the fast center voting (only the centers within kMaxMag, in float, in SIMD and on all cores) finds the same centers
+// as the reference voting that tests every center for every gradient, on synthetic eye crops like the ones the kiosk passes to FindCenter.
+
+#include "stdafx.h"
+#include "PupilDetectTests.h"
+#include "PupilDetect.h"
+#include "findEyeCenter.h"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <random>
+
+namespace
+{
+	// An open eye in a BGRA crop: skin, the white of the eye, the iris and pupil centered on center, and a highlight off center,
+	// supersampled so the center can be anywhere between pixels, with a little noise.
+	cv::Mat MakeEyeCrop(int width, int height, cv::Point2f center, float irisRadius, std::mt19937& random)
+	{
+		const int samples = 4;
+		cv::Point2f opening(width * 0.5f, height * 0.55f);
+		float openingX = width * 0.45f, openingY = height * 0.38f;
+		cv::Point2f highlight(center.x + irisRadius * 0.35f, center.y - irisRadius * 0.35f);
+		std::normal_distribution<float> noise(0.0f, 3.0f);
+
+		cv::Mat crop(height, width, CV_8UC4);
+		for (int y = 0; y < height; ++y)
+		{
+			unsigned char* row = crop.ptr<unsigned char>(y);
+			for (int x = 0; x < width; ++x)
+			{
+				float bgr[3] = { 0, 0, 0 };
+				for (int sy = 0; sy < samples; ++sy)
+				{
+					for (int sx = 0; sx < samples; ++sx)
+					{
+						float px = x + (sx + 0.5f) / samples - 0.5f, py = y + (sy + 0.5f) / samples - 0.5f;
+						float ox = (px - opening.x) / openingX, oy = (py - opening.y) / openingY;
+						float iris = std::hypot(px - center.x, py - center.y);
+						float shine = std::hypot(px - highlight.x, py - highlight.y);
+
+						const float skin[3] = { 120, 150, 190 }, sclera[3] = { 215, 220, 225 }, brown[3] = { 60, 80, 105 }, pupil[3] = { 20, 20, 22 }, white[3] = { 250, 250, 250 };
+						const float* color = skin;
+						if (ox * ox + oy * oy <= 1)
+							color = shine < irisRadius * 0.12f ? white : iris < irisRadius * 0.45f ? pupil : iris < irisRadius ? brown : sclera;
+						for (int c = 0; c < 3; ++c)
+							bgr[c] += color[c];
+					}
+				}
+				for (int c = 0; c < 3; ++c)
+					row[x * 4 + c] = cv::saturate_cast<unsigned char>(bgr[c] / (samples * samples) + noise(random));
+				row[x * 4 + 3] = 255;
+			}
+		}
+		return crop;
+	}
+
+	// The settings the tests are run with: the DLL's defaults, the kiosk's, and a kMaxMag that cuts off most of the eye.
+	std::vector<PupilDetect::PupilDetectSettings> TestSettings()
+	{
+		IPupilDetect* detect = CreatePupilDetect();
+		PupilDetect::PupilDetectSettings defaults = *GetSettings(detect);
+		DestroyPupilDetect(detect);
+
+		PupilDetect::PupilDetectSettings kiosk = defaults;
+		kiosk.EnableWeight = true;
+		kiosk.WeightBlurSize = 7;
+		kiosk.WeightDivisor = 1;
+		kiosk.GradientThreshold = 50;
+
+		PupilDetect::PupilDetectSettings nearby = kiosk;
+		nearby.MaxMag = 15;
+
+		return { defaults, kiosk, nearby };
+	}
+
+	bool FastVotingMatchesReference()
+	{
+		bool passed = true;
+
+		// Fixed seed so every run checks the same eyes.
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		const cv::Size cropSizes[] = { cv::Size(60, 34), cv::Size(80, 45), cv::Size(110, 62) };
+
+		int numEyes = 0, numMismatches = 0, numMissed = 0;
+		double fastMS = 0, referenceMS = 0;
+		for (const PupilDetect::PupilDetectSettings& settings : TestSettings())
+		{
+			EyeCenter eyeCenter;
+			PupilDetect::ApplySettings(settings, eyeCenter);
+			// The reference does not post-process, so neither does the voting it is compared with.
+			eyeCenter.kEnablePostProcess = false;
+
+			for (const cv::Size& size : cropSizes)
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					float irisRadius = size.width * (0.15f + 0.05f * uniform(random));
+					cv::Point2f center(size.width * (0.35f + 0.3f * uniform(random)), size.height * (0.45f + 0.2f * uniform(random)));
+					cv::Mat crop = MakeEyeCrop(size.width, size.height, center, irisRadius, random);
+
+					cv::Mat gray, fastEye;
+					PupilDetect::ScaleToFastEye(crop, gray, fastEye, settings.FastEyeWidth);
+
+					double fastVote, referenceVote;
+					int64 start = cv::getTickCount();
+					cv::Point fast = eyeCenter.findFastEyeCenter(fastEye, false, "", &fastVote);
+					int64 middle = cv::getTickCount();
+					cv::Point reference = eyeCenter.findReferenceEyeCenter(fastEye, &referenceVote);
+					int64 end = cv::getTickCount();
+					fastMS += (middle - start) * 1000.0 / cv::getTickFrequency();
+					referenceMS += (end - middle) * 1000.0 / cv::getTickFrequency();
+
+					// The fast voting is in float, so its votes only agree to a few digits.
+					bool matches = abs(fast.x - reference.x) <= 1 && abs(fast.y - reference.y) <= 1 &&
+						std::abs(fastVote - referenceVote) <= 1e-3 * referenceVote;
+					if (!matches)
+					{
+						printf("    %ix%i eye, MaxMag %g: fast center (%i, %i) vote %g, reference (%i, %i) vote %g\n",
+							size.width, size.height, settings.MaxMag, fast.x, fast.y, fastVote, reference.x, reference.y, referenceVote);
+					}
+					numMismatches += matches ? 0 : 1;
+
+					// Both should be on the pupil, or the crops are not testing much.
+					cv::Point2f found = PupilDetect::UnscaleFastPoint(fast, crop.size(), fastEye.size());
+					numMissed += cv::norm(found - center) <= irisRadius * 0.45f ? 0 : 1;
+					numEyes++;
+				}
+			}
+		}
+
+		CHECK(numMismatches == 0);
+		CHECK(numMissed == 0);
+
+		printf("    %i eyes, fast voting %.2f ms, reference %.2f ms per eye\n", numEyes, fastMS / numEyes, referenceMS / numEyes);
+		return passed;
+	}
+}
+
+bool EyeCenterTests()
+{
+	bool passed = true;
+	CHECK(FastVotingMatchesReference());
+	return passed;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Unit tests for PupilDetectDLL's eye center search, from a command prompt.  Only depends on OpenCV, like PupilDetectBenchmark.
+//   pupildetecttests          runs every test, the exit code is the number of tests that failed
+//   pupildetecttests <test>   runs one test
+
+#include "PupilDetectTests.h"
+
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+namespace
+{
+	struct Test
+	{
+		const char* name;
+		bool(*run)();
+	};
+
+	const Test tests[] =
+	{
+		{ "EyeCenter", EyeCenterTests },
+	};
+
+	int Usage()
+	{
+		printf("Usage: pupildetecttests [test]\n\nTests:\n");
+		for (const Test& test : tests)
+		{
+			printf("  %s\n", test.name);
+		}
+		return -1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int numRun = 0;
+	int numFailed = 0;
+	for (const Test& test : tests)
+	{
+		if (argc >= 2 && std::string(argv[1]) != test.name)
+		{
+			continue;
+		}
+
+		printf("%s\n", test.name);
+		int64 start = cv::getTickCount();
+		bool passed = test.run();
+		printf("  %s (%.0f ms)\n", passed ? "passed" : "FAILED", (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency());
+
+		numRun++;
+		numFailed += passed ? 0 : 1;
+	}
+
+	if (numRun == 0)
+	{
+		return Usage();
+	}
+
+	printf("\n%i of %i tests passed.\n", numRun - numFailed, numRun);
+	return numFailed;
+}
@@ -50,8 +50,6 @@ bool CompositorInterface::Initialize(ID3D11Device* device, ID3D11ShaderResourceV
 
     _device = device;
 
-    hologramQueue = new HologramQueue();
-
     return SUCCEEDED(frameProvider->Initialize(colorSRV, outputTexture));
 }
 
@@ -315,23 +313,13 @@ bool CompositorInterface::OutputYUV()
     return frameProvider->OutputYUV();
 }
 
-FrameMessage* CompositorInterface::GetNextHologramFrame(LONGLONG timeStamp)
+bool CompositorInterface::AddHologramFrame(const FrameMessage& frame)
 {
-    if (hologramQueue == nullptr)
-    {
-        return nullptr;
-    }
-
-    return hologramQueue->GetNextFrame(timeStamp);
+    return hologramQueue.AddFrame(frame);
 }
 
-FrameMessage* CompositorInterface::FindClosestHologramFrame(LONGLONG timeStamp, LONGLONG frameOffset)
+bool CompositorInterface::FindClosestHologramFrame(LONGLONG timeStamp, LONGLONG frameOffset, FrameMessage& frame)
 {
-    if (hologramQueue == nullptr)
-    {
-        return nullptr;
-    }
-
-    return hologramQueue->FindClosestFrame(timeStamp, frameOffset);
+    return hologramQueue.FindClosestFrame(timeStamp, frameOffset, frame);
 }
 
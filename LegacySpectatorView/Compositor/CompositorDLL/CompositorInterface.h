@@ -42,7 +42,8 @@ private:
     LONGLONG prevAudioTime = INVALID_TIMESTAMP;
     ID3D11Device* _device;
 
-    HologramQueue* hologramQueue;
+    // Shared by the network threads that add poses and the render thread that looks them up.
+    HologramQueue hologramQueue;
     LONGLONG stubVideoTime = 0;
 
 #if USE_CANON_SDK
@@ -85,7 +86,7 @@ public:
 
     DLLEXPORT bool OutputYUV();
 
-    DLLEXPORT FrameMessage* GetNextHologramFrame(LONGLONG timeStamp);
-    DLLEXPORT FrameMessage* FindClosestHologramFrame(LONGLONG timeStamp, LONGLONG frameOffset);
+    DLLEXPORT bool AddHologramFrame(const FrameMessage& frame);
+    DLLEXPORT bool FindClosestHologramFrame(LONGLONG timeStamp, LONGLONG frameOffset, FrameMessage& frame);
 };
 
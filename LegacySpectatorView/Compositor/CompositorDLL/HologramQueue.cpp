@@ -1,54 +1,78 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // Licensed under the MIT License. See LICENSE in the project root for license information.
 
-#include "stdafx.h"
+// Does not use the precompiled header, so CompositorTests can build the queue without the capture SDKs.
 #include "HologramQueue.h"
 
-// These methods must all be called from the same thread.
-// Otherwise, a lock will need to be added which will substantially slow down the render thread.
-HologramQueue::HologramQueue()
+#include <algorithm>
+
+HologramQueue::HologramQueue() :
+    numFrames(0)
 {
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++)
-    {
-        m_holographicFrameQueue[i].timeStamp = INVALID_TIMESTAMP;
-        m_holographicFrameQueue[i].m_id = i;
-    }
+    InitializeCriticalSection(&writeLock);
 }
 
-FrameMessage* HologramQueue::GetNextFrame(LONGLONG timeStamp)
+HologramQueue::~HologramQueue()
 {
-    auto curIndex = m_nextIndex;
-    m_nextIndex = (m_nextIndex + 1) % MAX_QUEUE_SIZE;
+    DeleteCriticalSection(&writeLock);
+}
 
-    auto nextFrame = &m_holographicFrameQueue[curIndex];
-    nextFrame->timeStamp = timeStamp;
+bool HologramQueue::AddFrame(const FrameMessage& frame)
+{
+    EnterCriticalSection(&writeLock);
 
-    return nextFrame;
+    LONGLONG count = numFrames.load(std::memory_order_relaxed);
+    bool inOrder = count == 0 || frame.timeStamp >= frames[(count - 1) % MAX_QUEUE_SIZE].timeStamp;
+    if (inOrder)
+    {
+        // Publishing the previous frame told lookups this slot is no longer safe to read.
+        std::atomic_thread_fence(std::memory_order_release);
+        frames[count % MAX_QUEUE_SIZE] = frame;
+        numFrames.store(count + 1, std::memory_order_release);
+    }
+
+    LeaveCriticalSection(&writeLock);
+    return inOrder;
 }
 
-FrameMessage* HologramQueue::FindClosestFrame(LONGLONG timeStamp, LONGLONG frameOffset)
+bool HologramQueue::FindClosestFrame(LONGLONG timeStamp, LONGLONG frameOffset, FrameMessage& frame) const
 {
-    FrameMessage* closestFrameMessage = NULL;
-    LONGLONG smallestDelta = std::numeric_limits<LONGLONG>::max();
+    LONGLONG targetTime = timeStamp - frameOffset;
 
-    for (int i = 0; i < MAX_QUEUE_SIZE; i++)
+    while (true)
     {
-        LONGLONG frameTime = m_holographicFrameQueue[i].timeStamp;
-        LONGLONG delta = timeStamp - frameTime - frameOffset;
+        LONGLONG end = numFrames.load(std::memory_order_acquire);
+        if (end == 0)
+        {
+            return false;
+        }
+
+        LONGLONG begin = (std::max)((LONGLONG)0, end - (MAX_QUEUE_SIZE - 1));
 
-        if (delta >= 0 && delta < smallestDelta)
+        // First frame after targetTime.
+        LONGLONG low = begin, high = end;
+        while (low < high)
         {
-            smallestDelta = delta;
-            closestFrameMessage = &m_holographicFrameQueue[i];
+            LONGLONG middle = low + (high - low) / 2;
+            if (frames[middle % MAX_QUEUE_SIZE].timeStamp <= targetTime)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
         }
-    }
 
-    if (closestFrameMessage == nullptr)
-    {
         // Didn't find a match, give the last known frame
-        auto lastIndex = (((m_nextIndex - 1) % MAX_QUEUE_SIZE) + MAX_QUEUE_SIZE) % MAX_QUEUE_SIZE;
-        closestFrameMessage = &m_holographicFrameQueue[lastIndex];
-    }
+        LONGLONG index = (low > begin) ? low - 1 : end - 1;
+        frame = frames[index % MAX_QUEUE_SIZE];
 
-    return closestFrameMessage;
+        // Frames added during the search only overwrote slots it read if the oldest one it could read is gone.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (numFrames.load(std::memory_order_relaxed) - (MAX_QUEUE_SIZE - 1) <= begin)
+        {
+            return true;
+        }
+    }
 }
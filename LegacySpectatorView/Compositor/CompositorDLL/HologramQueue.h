@@ -5,40 +5,43 @@
 
 #include "DirectXHelper.h"
 #include "CompositorShared.h"
-#include <vector>
-#include <memory>
 #include <array>
+#include <atomic>
 
 #define MAX_QUEUE_SIZE 90
 
 #define INVALID_TIMESTAMP -1
 
-class HologramQueue;
-
 typedef struct
 {
-    friend class HologramQueue;
-public:
     LONGLONG timeStamp = INVALID_TIMESTAMP;
     float rotX, rotY, rotZ, rotW, posX, posY, posZ;
-
-    int GetId() const { return m_id; }
-private:
-    int m_id;
 } FrameMessage;
 
-static std::array<FrameMessage, MAX_QUEUE_SIZE> m_holographicFrameQueue;
-static BYTE* hologramQueueFrameData = new BYTE[HOLOGRAM_BUFSIZE];
-
+// The latest hologram poses in timestamp order, so the pose that matches a color frame can be binary searched.
+//
+// Poses are added from network callbacks and looked up on the render thread.  Lookups never wait:
+// a frame is written to the ring before it is published, and a lookup that read a slot while it was being overwritten retries.
+// Adding frames is serialized by a lock that only writers take.
 class HologramQueue
 {
 public:
     HologramQueue();
+    ~HologramQueue();
+
+    // Frames are kept in timestamp order, so a frame older than the newest one is dropped.  Returns false if it was dropped.
+    bool AddFrame(const FrameMessage& frame);
 
-    FrameMessage* GetNextFrame(LONGLONG timeStamp);
-    FrameMessage* FindClosestFrame(LONGLONG timeStamp, LONGLONG frameOffset);
+    // Copies the newest frame at or before timeStamp - frameOffset, or the newest frame if they are all later.
+    // Returns false if there are no frames yet.
+    bool FindClosestFrame(LONGLONG timeStamp, LONGLONG frameOffset, FrameMessage& frame) const;
 
 private:
-    int m_nextIndex = 0;
-};
+    // Frame i is in frames[i % MAX_QUEUE_SIZE].  The slot after the newest frame may be being overwritten,
+    // so only the latest MAX_QUEUE_SIZE - 1 frames can be looked up.
+    std::array<FrameMessage, MAX_QUEUE_SIZE> frames;
+    // Frames that have been published.
+    std::atomic<LONGLONG> numFrames;
 
+    CRITICAL_SECTION writeLock;
+};
@@ -0,0 +1,52 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <Windows.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Logs a failed check and fails the test it is in.  Each test starts with bool passed = true, and returns passed.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("    %s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            passed = false; \
+        } \
+    } while (false)
+
+class Stopwatch
+{
+public:
+    Stopwatch()
+    {
+        QueryPerformanceFrequency(&frequency);
+        Restart();
+    }
+
+    void Restart()
+    {
+        QueryPerformanceCounter(&start);
+    }
+
+    double ElapsedMS() const
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return (double)(now.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+    }
+
+private:
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start;
+};
+
+// Tests return false if any of their checks failed.
+bool HologramQueueTests();
+
+// Benchmarks print their results, args are the command line arguments after the benchmark's name.
+// They return false if they could not run.
+bool HologramQueueBenchmark(const std::vector<std::wstring>& args);
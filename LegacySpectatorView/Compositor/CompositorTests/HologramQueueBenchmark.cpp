@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Times HologramQueue lookups in a full ring against the linear search over every slot that it replaced.
+//   CompositorTests benchmark hologramqueue
+// The HologramQueue test checks that both find the same frames.
+
+#include "CompositorTests.h"
+#include "HologramQueue.h"
+
+#include <random>
+
+bool HologramQueueBenchmark(const std::vector<std::wstring>& args)
+{
+    const LONGLONG frameTime = 10;
+
+    HologramQueue queue;
+    std::vector<FrameMessage> slots;
+    for (LONGLONG i = 1; i < MAX_QUEUE_SIZE; i++)
+    {
+        FrameMessage frame;
+        frame.timeStamp = i * frameTime;
+        queue.AddFrame(frame);
+        slots.push_back(frame);
+    }
+
+    const int numLookups = 1000000;
+    std::mt19937 random(1);
+    std::vector<LONGLONG> targetTimes(numLookups);
+    for (LONGLONG& targetTime : targetTimes)
+    {
+        targetTime = std::uniform_int_distribution<LONGLONG>(0, MAX_QUEUE_SIZE * frameTime)(random);
+    }
+
+    // The checksums keep the lookups from being optimized away.
+    LONGLONG binaryChecksum = 0;
+    FrameMessage frame;
+    Stopwatch stopwatch;
+    for (LONGLONG targetTime : targetTimes)
+    {
+        queue.FindClosestFrame(targetTime, 0, frame);
+        binaryChecksum += frame.timeStamp;
+    }
+    double binaryMS = stopwatch.ElapsedMS();
+
+    LONGLONG linearChecksum = 0;
+    stopwatch.Restart();
+    for (LONGLONG targetTime : targetTimes)
+    {
+        const FrameMessage* closest = nullptr;
+        for (const FrameMessage& slot : slots)
+        {
+            if (slot.timeStamp <= targetTime && (closest == nullptr || slot.timeStamp > closest->timeStamp))
+            {
+                closest = &slot;
+            }
+        }
+        linearChecksum += closest != nullptr ? closest->timeStamp : slots.back().timeStamp;
+    }
+    double linearMS = stopwatch.ElapsedMS();
+
+    printf("%i lookups in %i frames\nBinary search: %.1f ns per lookup\nLinear search: %.1f ns per lookup%s\n",
+        numLookups, (int)slots.size(), binaryMS * 1e6 / numLookups, linearMS * 1e6 / numLookups,
+        binaryChecksum == linearChecksum ? "" : "\nERROR: the searches found different frames");
+    return true;
+}
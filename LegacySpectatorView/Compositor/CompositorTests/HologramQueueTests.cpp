@@ -0,0 +1,159 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Checks HologramQueue lookups against a linear search over the frames it keeps, including before the ring is full
+// and after frames that arrived out of order, and that readers on other threads never see a torn frame while frames are added.
+
+#include "CompositorTests.h"
+#include "HologramQueue.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+namespace
+{
+    const LONGLONG frameTime = 10;
+
+    // Every field of a test frame is its index, so a frame that was read while it was overwritten does not match.
+    FrameMessage MakeFrame(LONGLONG index)
+    {
+        FrameMessage frame;
+        frame.timeStamp = index * frameTime;
+        frame.rotX = frame.rotY = frame.rotZ = frame.rotW = frame.posX = frame.posY = frame.posZ = (float)index;
+        return frame;
+    }
+
+    bool IsWhole(const FrameMessage& frame)
+    {
+        float index = (float)(frame.timeStamp / frameTime);
+        return frame.timeStamp % frameTime == 0 && frame.rotX == index && frame.rotY == index && frame.rotZ == index &&
+            frame.rotW == index && frame.posX == index && frame.posY == index && frame.posZ == index;
+    }
+
+    // The search the queue used to do: every slot, newest at or before targetTime, or the newest frame if they are all later.
+    LONGLONG FindLinear(const std::vector<FrameMessage>& slots, LONGLONG newest, LONGLONG targetTime)
+    {
+        const FrameMessage* closest = nullptr;
+        for (const FrameMessage& slot : slots)
+        {
+            if (slot.timeStamp != INVALID_TIMESTAMP && slot.timeStamp <= targetTime && (closest == nullptr || slot.timeStamp > closest->timeStamp))
+            {
+                closest = &slot;
+            }
+        }
+        return closest != nullptr ? closest->timeStamp : newest;
+    }
+
+    bool MatchesLinearSearch()
+    {
+        bool passed = true;
+
+        HologramQueue queue;
+        std::vector<FrameMessage> slots(MAX_QUEUE_SIZE);
+        LONGLONG newest = INVALID_TIMESTAMP;
+        FrameMessage frame;
+        CHECK(!queue.FindClosestFrame(0, 0, frame));
+
+        // Fixed seed so every run looks up the same times.
+        std::mt19937 random(1);
+        int numMismatches = 0;
+        for (LONGLONG i = 1; i < MAX_QUEUE_SIZE * 4; i++)
+        {
+            // Every fifth frame is late.
+            LONGLONG index = (i % 5 == 0) ? i - 3 : i;
+            bool added = queue.AddFrame(MakeFrame(index));
+            CHECK(added == (index * frameTime >= newest));
+            if (added)
+            {
+                slots.erase(slots.begin());
+                slots.push_back(MakeFrame(index));
+                newest = index * frameTime;
+            }
+
+            // The ring only keeps MAX_QUEUE_SIZE - 1 frames that can be looked up.
+            std::vector<FrameMessage> visible(slots.begin() + 1, slots.end());
+            for (int j = 0; j < 20; j++)
+            {
+                LONGLONG targetTime = std::uniform_int_distribution<LONGLONG>(-frameTime, (i + 2) * frameTime)(random);
+                bool found = queue.FindClosestFrame(targetTime, 0, frame);
+                numMismatches += found && IsWhole(frame) && frame.timeStamp == FindLinear(visible, newest, targetTime) ? 0 : 1;
+            }
+        }
+        CHECK(numMismatches == 0);
+
+        // The offset is subtracted from the time asked for.
+        CHECK(queue.FindClosestFrame(newest, 5 * frameTime, frame));
+        CHECK(frame.timeStamp == FindLinear(std::vector<FrameMessage>(slots.begin() + 1, slots.end()), newest, newest - 5 * frameTime));
+
+        return passed;
+    }
+
+    // Readers on other threads never see a torn frame, or fall back to the newest frame while the frame they asked for is still in the ring.
+    bool ConcurrentReaders()
+    {
+        bool passed = true;
+
+        HologramQueue queue;
+        std::atomic<bool> writing{ true };
+        std::atomic<LONGLONG> numAdded{ 0 };
+        std::atomic<int> numTorn{ 0 };
+        std::atomic<int> numEarlyFallbacks{ 0 };
+        std::atomic<LONGLONG> numLookups{ 0 };
+
+        const int numReaders = 3;
+        std::vector<std::thread> readers;
+        for (int r = 0; r < numReaders; r++)
+        {
+            readers.push_back(std::thread([&, r]()
+            {
+                std::mt19937 random(r + 2);
+                FrameMessage frame;
+                LONGLONG readerLookups = 0;
+                while (writing)
+                {
+                    LONGLONG newest = numAdded.load() * frameTime;
+                    LONGLONG targetTime = newest - std::uniform_int_distribution<LONGLONG>(0, MAX_QUEUE_SIZE * frameTime)(random);
+                    if (queue.FindClosestFrame(targetTime, 0, frame))
+                    {
+                        bool fallback = frame.timeStamp > targetTime;
+                        bool ringFull = frame.timeStamp >= MAX_QUEUE_SIZE * frameTime;
+                        numTorn += IsWhole(frame) ? 0 : 1;
+                        numEarlyFallbacks += fallback && ringFull && targetTime >= frame.timeStamp - (MAX_QUEUE_SIZE - 2) * frameTime ? 1 : 0;
+                        readerLookups++;
+                    }
+                }
+                numLookups += readerLookups;
+            }));
+        }
+
+        // Write a frame every iteration, far faster than poses arrive, so readers are constantly overwritten.
+        const LONGLONG numWrites = 2000000;
+        for (LONGLONG i = 1; i <= numWrites; i++)
+        {
+            queue.AddFrame(MakeFrame(i));
+            numAdded = i;
+        }
+
+        writing = false;
+        for (std::thread& reader : readers)
+        {
+            reader.join();
+        }
+
+        CHECK(numLookups > 0);
+        CHECK(numTorn == 0);
+        CHECK(numEarlyFallbacks == 0);
+
+        printf("    %lld frames added, %lld lookups on %i threads\n", (long long)numWrites, (long long)numLookups.load(), numReaders);
+        return passed;
+    }
+}
+
+bool HologramQueueTests()
+{
+    bool passed = true;
+    CHECK(MatchesLinearSearch());
+    CHECK(ConcurrentReaders());
+    return passed;
+}
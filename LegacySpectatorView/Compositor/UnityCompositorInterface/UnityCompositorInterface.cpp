@@ -204,18 +204,18 @@ UNITYDLL void SetHologramPose(
     // Convert offset to microseconds.
     LONGLONG offset = (LONGLONG)(msOffset * 1000.0f);
 
-    auto hologramFrame = ci->GetNextHologramFrame(timestamp - offset);
-    if (hologramFrame != nullptr)
-    {
-        hologramFrame->rotX = rotX;
-        hologramFrame->rotY = rotY;
-        hologramFrame->rotZ = rotZ;
-        hologramFrame->rotW = rotW;
+    FrameMessage hologramFrame;
+    hologramFrame.timeStamp = timestamp - offset;
+    hologramFrame.rotX = rotX;
+    hologramFrame.rotY = rotY;
+    hologramFrame.rotZ = rotZ;
+    hologramFrame.rotW = rotW;
 
-        hologramFrame->posX = posX;
-        hologramFrame->posY = posY;
-        hologramFrame->posZ = posZ;
-    }
+    hologramFrame.posX = posX;
+    hologramFrame.posY = posY;
+    hologramFrame.posZ = posZ;
+
+    ci->AddHologramFrame(hologramFrame);
 }
 
 static bool newColorFrame = false;
@@ -244,19 +244,18 @@ UNITYDLL void UpdateSpectatorView()
     {
         LONGLONG frameDuration = ci->GetColorDuration();
         // Find a pose on the leading end of this color frame.
-        const auto frame = ci->FindClosestHologramFrame(
-            colorTime - frameDuration, (LONGLONG)(_frameOffset * (float)frameDuration));
-
-        if (frame != nullptr)
+        FrameMessage frame;
+        if (ci->FindClosestHologramFrame(
+            colorTime - frameDuration, (LONGLONG)(_frameOffset * (float)frameDuration), frame))
         {
-            thirdPose._rotX = frame->rotX;
-            thirdPose._rotY = frame->rotY;
-            thirdPose._rotZ = frame->rotZ;
-            thirdPose._rotW = frame->rotW;
-            thirdPose._posX = frame->posX;
-            thirdPose._posY = frame->posY;
-            thirdPose._posZ = frame->posZ;
-            thirdPose._timestamp = frame->timeStamp;
+            thirdPose._rotX = frame.rotX;
+            thirdPose._rotY = frame.rotY;
+            thirdPose._rotZ = frame.rotZ;
+            thirdPose._rotW = frame.rotW;
+            thirdPose._posX = frame.posX;
+            thirdPose._posY = frame.posY;
+            thirdPose._posZ = frame.posZ;
+            thirdPose._timestamp = frame.timeStamp;
             thirdPose._colorTime = colorTime;
         }
 
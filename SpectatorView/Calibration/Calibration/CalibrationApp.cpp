@@ -10,6 +10,7 @@
 
 CalibrationApp::CalibrationApp() :
     colorTexture(nullptr),
+    chessBoardDetector(cv::Size(GRID_CELLS_X - 1, GRID_CELLS_Y - 1)),
     calibrationPictureElapsedTime(0),
     photoIndex(0)
 {
@@ -20,8 +21,11 @@ CalibrationApp::CalibrationApp() :
     InitializeCriticalSection(&commandCriticalSection);
     InitializeCriticalSection(&calibrationPictureCriticalSection);
     InitializeCriticalSection(&chessBoardVisualCriticalSection);
+    InitializeCriticalSection(&photoVisualsCriticalSection);
+    InitializeCriticalSection(&refineCriticalSection);
 
     boardDimensions = cv::Size(GRID_CELLS_X - 1, GRID_CELLS_Y - 1);
+    incrementalCalibration = std::make_unique<IncrementalCalibration>(GetCalibrationOptions());
     colorBytes = new BYTE[FRAME_BUFSIZE];
 
     // Force 60fps
@@ -36,7 +40,7 @@ CalibrationApp::CalibrationApp() :
     calibrationFile = outputPath + L"CalibrationData.txt";
 
     captureText = L"Images captured: %d\nUseable images: %d\nCapture timer: %5.3f\n";
-    commandText = L"Commands:\nENTER - Perform calibration\nSPACE - Force image capture\nX - Delete captured images\nM - Mirror display\n";
+    commandText = L"Commands:\nENTER - Perform calibration\nSPACE - Force image capture\nX - Delete captured images\nR - Reprocess captured images\nM - Mirror display\n";
     camPhotoTitleText = L"Camera Image";
     holoPhotoTitleText = L"HoloLens Image";
 
@@ -65,6 +69,9 @@ CalibrationApp::CalibrationApp() :
 
 CalibrationApp::~CalibrationApp()
 {
+    pictureTasks.wait();
+    refineTask.wait();
+
     if (frameProvider != nullptr)
     {
         frameProvider->Dispose();
@@ -98,9 +105,10 @@ void CalibrationApp::Initialize(HWND window, int width, int height)
     client_config.set_credentials(cred);
     client_config.set_validate_certificates(false);
     httpClient = new http_client(HOLOLENS_ADDRESS, client_config);
+    mrcDownloader = std::make_unique<MRCDownloader>(httpClient);
 
     // Start the application with no MRC captures on the Hololens.
-    DeleteAllMRCFiles();
+    mrcDownloader->DeleteAll().wait();
 
     // Create textures, RT's and SRV's
     auto device = deviceResources->GetD3DDevice();
@@ -206,12 +214,21 @@ void CalibrationApp::Update(DX::StepTimer const& timer)
     // Take a calibration picture.
     if (keyState.Space && !prevKeyState.Space)
     {
-        pplx::create_task([=]()
+        pictureTasks.run([=]()
         {
             TakeCalibrationPicture();
         });
     }
 
+    // Find the chess boards in the captured images again.
+    if (keyState.R && !prevKeyState.R)
+    {
+        pplx::create_task([=]()
+        {
+            ReprocessCalibrationFiles();
+        });
+    }
+
     // Mirror the image output.
     if (keyState.M && !prevKeyState.M)
     {
@@ -223,6 +240,9 @@ void CalibrationApp::Update(DX::StepTimer const& timer)
     // Use the calibration pictures to stereo calibrate the camera rig.
     if (keyState.Enter && !prevKeyState.Enter)
     {
+        // Include the pictures that are still downloading.
+        pictureTasks.wait();
+
         EnterCriticalSection(&commandCriticalSection);
         PerformCalibration();
         LeaveCriticalSection(&commandCriticalSection);
@@ -240,7 +260,6 @@ void CalibrationApp::TakeCalibrationPicture()
 
     // Get latest hologram photo
     std::vector<cv::Point2f> corners;
-    cv::Mat grayscaleImage;
     cv::Mat cachedColorMat = cv::Mat(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC4);
 
     // Cache the latest color frame so we do not stall the UI thread while checking if there is a chess board in frame.
@@ -249,12 +268,15 @@ void CalibrationApp::TakeCalibrationPicture()
     LeaveCriticalSection(&photoTextureCriticalSection);
 
     // Only take the picture if a chessboard is in view.
-    if (!HasChessBoard(cachedColorMat, grayscaleImage, corners))
+    if (!chessBoardDetector.Detect(cachedColorMat, corners, false))
     {
         LeaveCriticalSection(&calibrationPictureCriticalSection);
         return;
     }
 
+    // The next picture can be taken before this one's files are written.
+    photoIndex = currentIndex + 1;
+
     // First take a picture from the Hololens.  This will take about a second.
     TakeMRCPicture();
 
@@ -263,16 +285,15 @@ void CalibrationApp::TakeCalibrationPicture()
     memcpy(cachedColorMat.data, latestColorMat.data, FRAME_BUFSIZE);
     LeaveCriticalSection(&photoTextureCriticalSection);
 
-    // Copy the latest MRC image from the Hololens to the calibration directory.
-    GetAllMRCFiles((LPTSTR)holoPath.c_str());
-    // Delete all of the MRC files on the device.
-    DeleteAllMRCFiles();
+    // Copy the latest MRC image from the Hololens to the calibration directory, then delete it from the device.
+    // This happens in the background, so the next picture can be taken while this one downloads.
+    pplx::task<bool> holoDownload = mrcDownloader->DownloadNewest(holoPath);
 
     LeaveCriticalSection(&calibrationPictureCriticalSection);
 
     cv::imwrite(cv::String(StringHelper::ws2s(camPath)), cachedColorMat);
 
-    ProcessChessBoards(currentIndex, cachedColorMat);
+    ProcessChessBoards(currentIndex, cachedColorMat, holoDownload);
 }
 
 // Take calibration pictures at a predetermined interval.
@@ -289,7 +310,7 @@ void CalibrationApp::TakeCalibrationPictureAtInterval(DX::StepTimer const& timer
     {
         calibrationPictureElapsedTime = 0;
 
-        pplx::create_task([=]()
+        pictureTasks.run([=]()
         {
             TakeCalibrationPicture();
         });
@@ -303,119 +324,196 @@ void CalibrationApp::DeleteOutputFiles()
     DirectoryHelper::DeleteFiles(outputPath, L".png");
     DirectoryHelper::DeleteFiles(outputPath, L"CalibrationData.txt");
 
+    ClearChessBoards();
+    photoIndex = 0;
+}
+
+// Forget every chess board that has been found.
+void CalibrationApp::ClearChessBoards()
+{
     chessBoardVisualMat = cv::Mat(HOLO_HEIGHT, HOLO_WIDTH, CV_8UC4, cv::Scalar(0));
     camPhotoMat = cv::Mat(HOLO_HEIGHT, HOLO_WIDTH, CV_8UC4, cv::Scalar(0));
     holoPhotoMat = cv::Mat(HOLO_HEIGHT, HOLO_WIDTH, CV_8UC4, cv::Scalar(0));
 
-    stereoObjectPoints.clear();
-    stereoColorImagePoints.clear();
-    stereoHoloImagePoints.clear();
     colorImagePoints.clear();
     holoImagePoints.clear();
     colorCorners.clear();
     holoCorners.clear();
 
-    photoIndex = 0;
+    // A solve that is still running is discarded.
+    EnterCriticalSection(&refineCriticalSection);
+    pendingRefinePairs.clear();
+    resetRefine = true;
+    calibrationStatusText.clear();
+    LeaveCriticalSection(&refineCriticalSection);
 }
 
-// Check if the image has a chessboard in it.
-// Output a grayscale converted image and the interior corners of the chessboard.
-bool CalibrationApp::HasChessBoard(cv::Mat image, cv::Mat& grayscaleImage, std::vector<cv::Point2f>& corners)
+// Assesses camera and HoloLens images for chess boards.
+void CalibrationApp::ProcessChessBoards(int currentIndex, cv::Mat& colorCameraImage, pplx::task<bool> holoDownload)
 {
-    cv::cvtColor(image, grayscaleImage, CV_RGBA2GRAY);
-
-    return cv::findChessboardCorners(grayscaleImage, boardDimensions, corners,
-        cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE + cv::CALIB_CB_FAST_CHECK);
+    ChessBoardPair pair;
+    DetectChessBoards(currentIndex, colorCameraImage, pair, holoDownload);
+    AddChessBoards(pair);
 }
 
-// Assesses camera and HoloLens images for chess boards.
-void CalibrationApp::ProcessChessBoards(int currentIndex, cv::Mat& colorCameraImage)
+void CalibrationApp::DetectChessBoards(int currentIndex, const cv::Mat& colorCameraImage, ChessBoardPair& pair, pplx::task<bool> holoDownload)
 {
-    bool validCameraImage = true;
-    bool validHoloImage = true;
     std::wstring pathRoot = outputPath + std::to_wstring(currentIndex).c_str() + L"_";
     std::wstring camPath = pathRoot + L"cam.png";
     std::wstring holPath = pathRoot + L"holo.jpg";
 
     OutputString((L"Parsing calibration files:\n    " + camPath + L"\n    " + holPath + L"\n").c_str());
 
-    // Get chessboard for DSLR picture
-    cv::Mat resizedColorImage_cam;
-    cv::resize(colorCameraImage, resizedColorImage_cam, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), 0, 0, cv::INTER_AREA);
+    int64 start = cv::getTickCount();
+    auto getSeconds = [](int64 start) { return (double)(cv::getTickCount() - start) / cv::getTickFrequency(); };
 
-    cv::Mat grayscaleImage_cam;;
-    if (HasChessBoard(resizedColorImage_cam, grayscaleImage_cam, colorCorners))
-    {
-        cv::cornerSubPix(grayscaleImage_cam, colorCorners, cv::Size(11, 11), cv::Size(-1, -1),
-            cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
-    }
-    else
-    {
-        OutputString((L"ERROR: Chess board not found in " + camPath + L".\n").c_str());
-        validCameraImage = false;
-    }
+    // The camera and HoloLens images are independent, so they are searched at the same time.
+    concurrency::parallel_invoke(
+        [&]()
+        {
+            int64 cameraStart = cv::getTickCount();
 
-    // Load Holo textures
-    cv::Mat colorImage_holo = cv::Mat(HOLO_HEIGHT, HOLO_WIDTH, CV_8UC4, cv::Scalar(0));
-    if (!DirectoryHelper::FileExists(holPath))
-    {
-        OutputString((L"ERROR: " + holPath + L" not found.\n").c_str());
-        validHoloImage = false;
-    }
-    else
+            // Get chessboard for DSLR picture
+            cv::Mat cameraImage = colorCameraImage;
+            if (cameraImage.empty())
+            {
+                cameraImage = cv::imread(StringHelper::ws2s(camPath).c_str(), cv::IMREAD_UNCHANGED);
+            }
+
+            if (cameraImage.empty())
+            {
+                OutputString((L"ERROR: " + camPath + L" not found.\n").c_str());
+                pair.colorImage = cv::Mat(HOLO_HEIGHT, HOLO_WIDTH, CV_8UC4, cv::Scalar(0));
+            }
+            else
+            {
+                cv::resize(cameraImage, pair.colorImage, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), 0, 0, cv::INTER_AREA);
+                pair.validCameraImage = chessBoardDetector.Detect(pair.colorImage, pair.colorCorners);
+                if (!pair.validCameraImage)
+                {
+                    OutputString((L"ERROR: Chess board not found in " + camPath + L".\n").c_str());
+                }
+            }
+
+            pair.cameraSeconds = getSeconds(cameraStart);
+        },
+        [&]()
+        {
+            int64 holoStart = cv::getTickCount();
+
+            // The camera photo is searched while the HoloLens photo downloads.
+            holoDownload.wait();
+
+            // Load Holo textures
+            if (!DirectoryHelper::FileExists(holPath))
+            {
+                OutputString((L"ERROR: " + holPath + L" not found.\n").c_str());
+                pair.holoImage = cv::Mat(HOLO_HEIGHT, HOLO_WIDTH, CV_8UC3, cv::Scalar(0));
+            }
+            else
+            {
+                pair.holoImage = cv::imread(StringHelper::ws2s(holPath).c_str(), cv::IMREAD_UNCHANGED);
+
+                // Get chess board data from HoloLens
+                pair.validHoloImage = chessBoardDetector.Detect(pair.holoImage, pair.holoCorners);
+                if (!pair.validHoloImage)
+                {
+                    OutputString((L"ERROR: Chess board not found in " + holPath + L".\n").c_str());
+                }
+            }
+
+            pair.holoSeconds = getSeconds(holoStart);
+        });
+
+    pair.seconds = getSeconds(start);
+}
+
+void CalibrationApp::AddChessBoards(ChessBoardPair& pair)
+{
+    if (pair.validCameraImage && pair.validHoloImage)
     {
-        colorImage_holo = cv::imread(StringHelper::ws2s(holPath).c_str(), cv::IMREAD_UNCHANGED);
+        EnterCriticalSection(&commandCriticalSection);
+        // If the entire chess board is found in both images, add this data to the points to calibrate.
+        colorCorners = pair.colorCorners;
+        holoCorners = pair.holoCorners;
+        colorImagePoints.push_back(colorCorners);
+        holoImagePoints.push_back(holoCorners);
+        LeaveCriticalSection(&commandCriticalSection);
+
+        RefineCalibration(pair.colorCorners, pair.holoCorners);
+
+        UpdateChessBoardVisual(pair.colorCorners);
+        OutputString(L"Completed parsing calibration files.\n");
     }
 
-    // Get chess board data from HoloLens
-    cv::Mat grayscaleImage_holo;
-    if (HasChessBoard(colorImage_holo, grayscaleImage_holo, holoCorners))
+    if (pair.colorImage.empty() || pair.holoImage.empty())
     {
-        cv::cornerSubPix(grayscaleImage_holo, holoCorners, cv::Size(11, 11), cv::Size(-1, -1),
-            cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
+        return;
     }
-    else
+
+    EnterCriticalSection(&photoVisualsCriticalSection);
+    memcpy(camPhotoMat.data, pair.colorImage.data, pair.colorImage.total() * pair.colorImage.elemSize());
+    camPhotoMat += pair.validCameraImage ? greenMat : redMat;
+    cv::cvtColor(pair.holoImage, holoPhotoMat, CV_BGR2BGRA);
+    holoPhotoMat += pair.validHoloImage ? greenMat : redMat;
+    LeaveCriticalSection(&photoVisualsCriticalSection);
+}
+
+void CalibrationApp::ReprocessCalibrationFiles()
+{
+    // No new pictures are taken while the old ones are reprocessed.
+    EnterCriticalSection(&calibrationPictureCriticalSection);
+
+    // Photo pairs are numbered from 0 with no gaps.
+    int numPairs = 0;
+    while (DirectoryHelper::FileExists(outputPath + std::to_wstring(numPairs) + L"_cam.png"))
     {
-        OutputString((L"ERROR: Chess board not found in " + holPath + L".\n").c_str());
-        validHoloImage = false;
+        numPairs++;
     }
 
-    if (validCameraImage && validHoloImage)
-    {
-        EnterCriticalSection(&commandCriticalSection);
-        colorImagePoints.push_back(colorCorners);
-        holoImagePoints.push_back(holoCorners);
+    EnterCriticalSection(&commandCriticalSection);
+    ClearChessBoards();
+    photoIndex = numPairs;
+    LeaveCriticalSection(&commandCriticalSection);
 
-        // If the entire chess board is found in both images, add this data to the points to calibrate.
-        size_t newSize = stereoObjectPoints.size() + 1;
-        stereoObjectPoints.resize(newSize);
-        stereoColorImagePoints.resize(newSize);
-        stereoHoloImagePoints.resize(newSize);
+    OutputString((L"Reprocessing " + std::to_wstring(numPairs) + L" calibration photo pairs.\n").c_str());
+
+    std::vector<ChessBoardPair> pairs(numPairs);
+    int64 start = cv::getTickCount();
+    concurrency::parallel_for(0, numPairs, [&](int i)
+    {
+        DetectChessBoards(i, cv::Mat(), pairs[i]);
 
-        // Add object-space points for stereo images that both have visible chess boards.
-        for (int i = 0; i < boardDimensions.height; i++)
+        // Only the last pair is displayed.
+        if (i != numPairs - 1)
         {
-            for (int j = 0; j < boardDimensions.width; j++)
-            {
-                stereoObjectPoints[stereoObjectPoints.size() - 1].push_back(
-                    cv::Point3f((float)(j * CHESS_SQUARE_SIZE), (float)(i * CHESS_SQUARE_SIZE), 0.0f));
-            }
+            pairs[i].colorImage.release();
+            pairs[i].holoImage.release();
         }
+    });
+    double seconds = (double)(cv::getTickCount() - start) / cv::getTickFrequency();
 
-        stereoColorImagePoints[stereoObjectPoints.size() - 1] = colorCorners;
-        stereoHoloImagePoints[stereoObjectPoints.size() - 1] = holoCorners;
-        LeaveCriticalSection(&commandCriticalSection);
+    // Added in order, so the calibration does not depend on which pair finished first.
+    double totalPairSeconds = 0;
+    for (int i = 0; i < numPairs; i++)
+    {
+        AddChessBoards(pairs[i]);
 
-        UpdateChessBoardVisual(colorCorners);
-        OutputString((L"Completed parsing calibration files: " + camPath + L", " + holPath + L".\n").c_str());
+        const ChessBoardPair& pair = pairs[i];
+        totalPairSeconds += pair.seconds;
+        OutputString((L"Pair " + std::to_wstring(i) + L" detection: " + std::to_wstring(pair.seconds * 1000) +
+            L" ms (camera " + std::to_wstring(pair.cameraSeconds * 1000) + (pair.validCameraImage ? L" ms, " : L" ms, no board, ") +
+            L"HoloLens " + std::to_wstring(pair.holoSeconds * 1000) + (pair.validHoloImage ? L" ms)\n" : L" ms, no board)\n")).c_str());
     }
 
-    EnterCriticalSection(&photoVisualsCriticalSection);
-    memcpy(camPhotoMat.data, resizedColorImage_cam.data, resizedColorImage_cam.total() * resizedColorImage_cam.elemSize());
-    camPhotoMat += validCameraImage ? greenMat : redMat;
-    cv::cvtColor(colorImage_holo, holoPhotoMat, CV_BGR2BGRA);
-    holoPhotoMat += validHoloImage ? greenMat : redMat;
-    LeaveCriticalSection(&photoVisualsCriticalSection);
+    if (numPairs > 0)
+    {
+        OutputString((L"Reprocessed " + std::to_wstring(numPairs) + L" pairs in " + std::to_wstring(seconds * 1000) +
+            L" ms, " + std::to_wstring(totalPairSeconds * 1000 / numPairs) + L" ms per pair, " +
+            std::to_wstring(colorImagePoints.size()) + L" usable.\n").c_str());
+    }
+
+    LeaveCriticalSection(&calibrationPictureCriticalSection);
 }
 
 void CalibrationApp::UpdateChessBoardVisual(std::vector<cv::Point2f>& colorCorners)
@@ -447,150 +545,117 @@ void CalibrationApp::UpdateChessBoardVisual(std::vector<cv::Point2f>& colorCorne
     LeaveCriticalSection(&chessBoardVisualCriticalSection);
 }
 
-// Use the calibration pictures to stereo calibrate the camera rig.
-void CalibrationApp::PerformCalibration()
+StereoCalibration::Options CalibrationApp::GetCalibrationOptions() const
 {
-    if (colorImagePoints.size() == 0 || holoImagePoints.size() == 0 || stereoColorImagePoints.size() == 0 || stereoHoloImagePoints.size() == 0)
-    {
-        OutputString(L"ERROR: Please take some valid chess board images before calibration.\n");
-        return;
-    }
+    StereoCalibration::Options options(boardDimensions, CHESS_SQUARE_SIZE, cv::Size(HOLO_WIDTH, HOLO_HEIGHT));
+#if DSLR_USE_KNOWN_INTRINSICS
+    options.focalLength = DSLR_FOCAL_LENGTH;
+    options.sensorWidth = DSLR_MATRIX_WIDTH;
+    options.sensorHeight = DSLR_MATRIX_HEIGHT;
+    options.fixFocalLength = DSLR_FIX_FOCAL_LENGTH;
+    options.fixPrincipalPoint = DSLR_FIX_PRINCIPAL_POINT;
+#endif
+
+    return options;
+}
 
-    //http://docs.opencv.org/2.4/modules/calib3d/doc/camera_calibration_and_3d_reconstruction.html#Mat initCameraMatrix2D(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints, Size imageSize, double aspectRatio)
-    // Add object-space points for all camera images.
-    std::vector<std::vector<cv::Point3f>> colorObjectPoints;
-    colorObjectPoints.resize(colorImagePoints.size());
-    for (int colorImagePoint = 0; colorImagePoint< colorImagePoints.size(); colorImagePoint++)
+void CalibrationApp::RefineCalibration(const std::vector<cv::Point2f>& colorCorners, const std::vector<cv::Point2f>& holoCorners)
+{
+    EnterCriticalSection(&refineCriticalSection);
+    pendingRefinePairs.emplace_back(colorCorners, holoCorners);
+    bool startThread = !refining;
+    refining = true;
+    LeaveCriticalSection(&refineCriticalSection);
+
+    if (startThread)
     {
-        for (int i = 0; i < boardDimensions.height; i++)
+        refineTask = pplx::create_task([=]()
         {
-            for (int j = 0; j < boardDimensions.width; j++)
-            {
-                colorObjectPoints[colorImagePoint].push_back(
-                    cv::Point3f((float)(j * CHESS_SQUARE_SIZE), (float)(i * CHESS_SQUARE_SIZE), 0.0f));
-            }
-        }
+            RefineCalibrationThread();
+        });
     }
+}
 
-    // Add object-space points for all Hololens images.
-    std::vector<std::vector<cv::Point3f>> holoObjectPoints;
-    holoObjectPoints.resize(holoImagePoints.size());
-    for (int holoImagePoint = 0; holoImagePoint< holoImagePoints.size(); holoImagePoint++)
+void CalibrationApp::RefineCalibrationThread()
+{
+    while (true)
     {
-        for (int i = 0; i < boardDimensions.height; i++)
+        EnterCriticalSection(&refineCriticalSection);
+        if (pendingRefinePairs.empty() && !resetRefine)
         {
-            for (int j = 0; j < boardDimensions.width; j++)
-            {
-                holoObjectPoints[holoImagePoint].push_back(cv::Point3f((float)(j * CHESS_SQUARE_SIZE), (float)(i * CHESS_SQUARE_SIZE), 0.0f));
-            }
+            refining = false;
+            LeaveCriticalSection(&refineCriticalSection);
+            return;
         }
-    }
-
-    double apertureWidth = 0;
-    double apertureHeight = 0;
-    double holoFovX, holoFovY, colorFovX, colorFovY = 0;
-    double focalLength = 0;
-    cv::Point2d principalPoint;
-    double aspectRatio = 0;
-
-    // Calibrate the individual cameras.
-    cv::Mat distCoeffColor, distCoeffHolo;
-    cv::Mat colorR, holoR, colorT, holoT;
-    
-#if DSLR_USE_KNOWN_INTRINSICS
-    double colorFocalLength = DSLR_FOCAL_LENGTH * std::min(HOLO_WIDTH / DSLR_MATRIX_WIDTH, HOLO_HEIGHT / DSLR_MATRIX_HEIGHT);
-    cv::Mat colorMat = (cv::Mat_<double>(3,3) << colorFocalLength, 0, HOLO_WIDTH / 2., 0, colorFocalLength, HOLO_HEIGHT / 2., 0, 0, 1);
-#else
-    cv::Mat colorMat = cv::initCameraMatrix2D(colorObjectPoints, colorImagePoints, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), (double)HOLO_HEIGHT / (double)HOLO_WIDTH);
-#endif
-    cv::Mat holoMat = cv::initCameraMatrix2D(holoObjectPoints, holoImagePoints, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), (double)HOLO_HEIGHT / (double)HOLO_WIDTH);
 
-    OutputString(L"Start Calibrating DSLR.\n");
-    int colorFlags = CV_CALIB_USE_INTRINSIC_GUESS;
-#if DSLR_USE_KNOWN_INTRINSICS
-    OutputString(L"Setting user-defined focal length before calibration: ");
-    OutputString(std::to_wstring(colorFocalLength).c_str());
-    OutputString(L"\n");
-#if DSLR_FIX_FOCAL_LENGTH
-    colorFlags |= CV_CALIB_FIX_FOCAL_LENGTH;
-#endif
-#if DSLR_FIX_PRINCIPAL_POINT
-    colorFlags |=  CV_CALIB_FIX_PRINCIPAL_POINT;
-#endif
-#endif
-    double colorRMS = cv::calibrateCamera(colorObjectPoints, colorImagePoints, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), colorMat, distCoeffColor, colorR, colorT, colorFlags);
-    OutputString(L"Done Calibrating DSLR.\n");
-    OutputString(L"Start Calibrating HoloLens.\n");
-    double holoRMS = cv::calibrateCamera(holoObjectPoints, holoImagePoints, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), holoMat, distCoeffHolo, holoR, holoT, CV_CALIB_USE_INTRINSIC_GUESS);
-    OutputString(L"Done Calibrating HoloLens.\n");
-
-    cv::calibrationMatrixValues(holoMat, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), apertureWidth, apertureHeight, holoFovX, holoFovY, focalLength, principalPoint, aspectRatio);
-    cv::calibrationMatrixValues(colorMat, cv::Size(HOLO_WIDTH, HOLO_HEIGHT), apertureWidth, apertureHeight, colorFovX, colorFovY, focalLength, principalPoint, aspectRatio);
-
-
-    // Output rotation, translation, essential matrix, fundamental matrix.
-    cv::Mat R, T, E, F;
-
-    //http://docs.opencv.org/2.4/modules/calib3d/doc/camera_calibration_and_3d_reconstruction.html#double stereoCalibrate(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints1, InputArrayOfArrays imagePoints2, InputOutputArray cameraMatrix1, InputOutputArray distCoeffs1, InputOutputArray cameraMatrix2, InputOutputArray distCoeffs2, Size imageSize, OutputArray R, OutputArray T, OutputArray E, OutputArray F, TermCriteria criteria, int flags)
-    // Stereo calibrate the two cameras.
-    OutputString(L"Start stereo calibrating.\n");
-    double rms = cv::stereoCalibrate(stereoObjectPoints, stereoHoloImagePoints, stereoColorImagePoints,
-        holoMat, distCoeffHolo,
-        colorMat, distCoeffColor,
-        cv::Size(HOLO_WIDTH, HOLO_HEIGHT),
-        R, T, E, F,
-        CV_CALIB_FIX_INTRINSIC
-    );
-    OutputString(L"Done stereo calibrating.\n");
+        bool reset = resetRefine;
+        resetRefine = false;
+        auto pairs = std::move(pendingRefinePairs);
+        pendingRefinePairs.clear();
+        LeaveCriticalSection(&refineCriticalSection);
 
-    // Write calibration data file:
-    // First Delete the old calibration file if one exists.
-    DeleteFile(calibrationFile.c_str());
-
-    std::ofstream calibrationfs;
-    calibrationfs.open(calibrationFile.c_str());
-
-    calibrationfs << "# Stereo RMS calibration error (Lower numbers are better)" << std::endl;
-    calibrationfs << "RMS: " << rms << std::endl;
-
-    calibrationfs << "# DSLR RMS calibration error (Lower numbers are better)" << std::endl;
-    calibrationfs << "DSLR RMS: " << colorRMS << std::endl;
-
-    calibrationfs << "# HoloLens RMS calibration error (Lower numbers are better)" << std::endl;
-    calibrationfs << "HoloLens RMS: " << holoRMS << std::endl;
+        if (reset)
+        {
+            incrementalCalibration->Clear();
+        }
 
-    calibrationfs << "# Delta in meters of Hololens from Camera:" << std::endl;
-    calibrationfs << "Translation: " << T.at<double>(0, 0) << ", " << T.at<double>(1, 0) << ", " << T.at<double>(2, 0) << std::endl;
+        for (auto& pair : pairs)
+        {
+            incrementalCalibration->Add(pair.first, pair.second);
+        }
 
-    calibrationfs << "# Row Major Matrix3x3 (This should be close to identity)" << std::endl;
-    calibrationfs << "Rotation: " << R.at<double>(0, 0) << ", " << R.at<double>(0, 1) << ", " << R.at<double>(0, 2) << ", " <<
-        R.at<double>(1, 0) << ", " << R.at<double>(1, 1) << ", " << R.at<double>(1, 2) << ", " << R.at<double>(2, 0) << ", " <<
-        R.at<double>(2, 1) << ", " << R.at<double>(2, 2) << std::endl;
+        if (pairs.empty() || !incrementalCalibration->Solve())
+        {
+            continue;
+        }
 
-    calibrationfs << "# Field of View of DSLR:" << std::endl;
-    calibrationfs << "DSLR_fov: " << colorFovX << ", " << colorFovY << std::endl;
+        const IncrementalCalibration::Stats& stats = incrementalCalibration->GetStats();
+        wchar_t statusBuffer[256];
+        swprintf(statusBuffer, 256, L"Running RMS: %.3f (%d of %d pictures)\nFocal length uncertainty: %.2f%%\n%ls",
+            stats.rms, stats.numWorkingViews, stats.numViews, stats.GetUncertainty() * 100,
+            stats.IsConverged() ? L"Enough pictures, press ENTER to calibrate.\n" : L"");
 
-    calibrationfs << "# Field of View of HoloLens:" << std::endl;
-    calibrationfs << "Holo_fov: " << holoFovX << ", " << holoFovY << std::endl;
+        OutputString((L"Refined calibration with " + std::to_wstring(stats.numWorkingViews) + L" of " + std::to_wstring(stats.numViews) +
+            L" pairs in " + std::to_wstring(stats.solveSeconds * 1000) + L" ms: RMS " + std::to_wstring(stats.rms) +
+            L" (camera " + std::to_wstring(stats.colorRMS) + L", HoloLens " + std::to_wstring(stats.holoRMS) +
+            L"), focal length uncertainty " + std::to_wstring(stats.GetUncertainty() * 100) + L"%.\n").c_str());
 
-    calibrationfs << "# DSLR distortion coefficients:" << std::endl;
-    calibrationfs << "DSLR_distortion: " << distCoeffColor.at<double>(0, 0) << ", " << distCoeffColor.at<double>(0, 1) << ", " <<
-        distCoeffColor.at<double>(0, 2) << ", " << distCoeffColor.at<double>(0, 3) << ", " << distCoeffColor.at<double>(0, 4) << std::endl;
+        // Pairs cleared during the solve were not part of it.
+        EnterCriticalSection(&refineCriticalSection);
+        if (!resetRefine)
+        {
+            calibrationStatusText = statusBuffer;
+        }
+        LeaveCriticalSection(&refineCriticalSection);
+    }
+}
 
-    calibrationfs << "# DSLR camera Matrix: fx, fy, cx, cy:" << std::endl;
-    calibrationfs << "DSLR_camera_Matrix: " << colorMat.at<double>(0, 0) << ", " << colorMat.at<double>(1, 1) << ", " <<
-        colorMat.at<double>(0, 2) << ", " << colorMat.at<double>(1, 2) << std::endl;
+// Use the calibration pictures to stereo calibrate the camera rig.
+void CalibrationApp::PerformCalibration()
+{
+    if (colorImagePoints.size() == 0 || holoImagePoints.size() == 0)
+    {
+        OutputString(L"ERROR: Please take some valid chess board images before calibration.\n");
+        return;
+    }
 
-    calibrationfs << "# HoloLens distortion coefficients:" << std::endl;
-    calibrationfs << "Holo_distortion: " << distCoeffHolo.at<double>(0, 0) << ", " << distCoeffHolo.at<double>(0, 1) << ", " <<
-        distCoeffHolo.at<double>(0, 2) << ", " << distCoeffHolo.at<double>(0, 3) << ", " << distCoeffHolo.at<double>(0, 4) << std::endl;
+    // The running calibration only uses a subset of the pairs, the final one uses them all.
+    OutputString(L"Start calibrating.\n");
+    StereoCalibration calibration;
+    calibration.Calibrate(colorImagePoints, holoImagePoints, GetCalibrationOptions());
+    if (calibration.initialColorFocalLength > 0)
+    {
+        OutputString((L"Used user-defined focal length before calibration: " + std::to_wstring(calibration.initialColorFocalLength) + L"\n").c_str());
+    }
+    OutputString(L"Done calibrating.\n");
 
-    calibrationfs << "# HoloLens camera Matrix: fx, fy, cx, cy:" << std::endl;
-    calibrationfs << "Holo_camera_Matrix: " << holoMat.at<double>(0, 0) << ", " << holoMat.at<double>(1, 1) << ", " <<
-        holoMat.at<double>(0, 2) << ", " << holoMat.at<double>(1, 2) << std::endl;
+    // Write calibration data file:
+    // First Delete the old calibration file if one exists.
+    DeleteFile(calibrationFile.c_str());
 
-    calibrationfs << "# Number of images captured: " << photoIndex << std::endl;
-    calibrationfs << "# Number of images used in calibration: " << stereoObjectPoints.size() << std::endl;
+    std::ofstream calibrationfs;
+    calibrationfs.open(calibrationFile.c_str());
+    calibration.Write(calibrationfs, photoIndex);
     calibrationfs.close();
 }
 
@@ -721,11 +786,23 @@ void CalibrationApp::Render()
         wchar_t tempBuffer[256];
         swprintf(tempBuffer, 256, captureText.c_str(),
             photoIndex,
-            stereoObjectPoints.size(),
+            colorImagePoints.size(),
             (CALIBRATION_FREQUENCY_SECONDS - calibrationPictureElapsedTime));
         spriteFont->DrawString(textSpriteBatch.get(), tempBuffer, XMFLOAT2(1.f, 1.f), Colors::Black);
         spriteFont->DrawString(textSpriteBatch.get(), tempBuffer, XMFLOAT2(0, 0), Colors::White);
 
+        // Draw running calibration text.
+        EnterCriticalSection(&refineCriticalSection);
+        std::wstring statusText = calibrationStatusText;
+        LeaveCriticalSection(&refineCriticalSection);
+        if (!statusText.empty())
+        {
+            auto captureTextRect = spriteFont->MeasureDrawBounds(tempBuffer, XMFLOAT2(0, 0));
+            auto statusYOffset = static_cast<float>(captureTextRect.bottom - captureTextRect.top + 10);
+            spriteFont->DrawString(textSpriteBatch.get(), statusText.c_str(), XMFLOAT2(1.f, statusYOffset + 1.f), Colors::Black);
+            spriteFont->DrawString(textSpriteBatch.get(), statusText.c_str(), XMFLOAT2(0, statusYOffset), Colors::White);
+        }
+
         // Draw command text.
         auto textRect = spriteFont->MeasureDrawBounds(commandText.c_str(), XMFLOAT2(0, 0));
         auto yOffset = static_cast<float>(screenRect.bottom - (textRect.bottom - textRect.top + 30));
@@ -901,177 +978,4 @@ void CalibrationApp::TakeMRCPicture()
         OutputString(StringHelper::s2ws(e.what()).c_str());
         OutputString(L"\n");
     }
-}
-
-// Delete all of the MRC files on the Hololens.
-void CalibrationApp::DeleteAllMRCFiles()
-{
-    uri_builder builder(U("/api/holographic/mrc/files"));
-
-    try
-    {
-        auto task = httpClient->request(methods::GET, builder.to_string()).then([](http_response response) -> pplx::task<json::value>
-        {
-            // If we get a valid response, return the extracted json. 
-            if (response.status_code() == status_codes::OK)
-            {
-                return response.extract_json();
-            }
-
-            // Otherwise return empty json. 
-            return pplx::task_from_result(json::value());
-        })
-            .then([=](pplx::task<json::value> previousTask)
-        {
-            const json::value& jv = previousTask.get();
-
-            // Iterate over the json to get the MRC file names.
-            for (auto iter = jv.as_object().cbegin(); iter != jv.as_object().cend(); iter++)
-            {
-                // Iterate over values in children to find the filename key.
-                json::array children = iter->second.as_array();
-
-                for (int i = 0; i < children.size(); i++)
-                {
-                    for (auto iter2 = children[i].as_object().cbegin(); iter2 != children[i].as_object().cend(); iter2++)
-                    {
-                        if (iter2->first == L"FileName")
-                        {
-                            // Convert this filename to base64.
-                            LPTSTR encodedString;
-                            StringHelper::base64_encode(StringHelper::ws2s(iter2->second.as_string()), encodedString);
-                            DeleteMRCFile(encodedString);
-                            HeapFree(GetProcessHeap(), HEAP_NO_SERIALIZE, encodedString);
-                        }
-                    }
-                }
-            }
-        });
-
-        // Wait for deletion before returning.
-        task.wait();
-    }
-    catch (const std::exception &e)
-    {
-        OutputString(L"Error deleting MRC files: ");
-        OutputString(StringHelper::s2ws(e.what()).c_str());
-        OutputString(L"\n");
-    }
-}
-
-// Delete a particular MRC file from the Hololens.  FileName must be base64 encoded.
-void CalibrationApp::DeleteMRCFile(LPTSTR fileName)
-{
-    uri_builder builder(U("/api/holographic/mrc/file"));
-    builder.append_query(U("filename"), fileName);
-
-    try
-    {
-        httpClient->request(methods::DEL, builder.to_string()).get();
-    }
-    catch (const std::exception &e)
-    {
-        OutputString(L"Error Deleting MRC file: ");
-        OutputString(StringHelper::s2ws(e.what()).c_str());
-        OutputString(L"\n");
-    }
-}
-
-// Get all of the MRC files on the Hololens and copy to the input path.
-void CalibrationApp::GetAllMRCFiles(LPTSTR holoPath)
-{
-    uri_builder builder(U("/api/holographic/mrc/files"));
-
-    try
-    {
-        auto task = httpClient->request(methods::GET, builder.to_string()).then([](http_response response) -> pplx::task<json::value>
-        {
-            // If we get a valid response, return the extracted json. 
-            if (response.status_code() == status_codes::OK)
-            {
-                return response.extract_json();
-            }
-
-            // Otherwise return empty json. 
-            return pplx::task_from_result(json::value());
-        })
-            .then([=](pplx::task<json::value> previousTask)
-        {
-            const json::value& jv = previousTask.get();
-
-            // Iterate over the json to get the MRC file names.
-            for (auto iter = jv.as_object().cbegin(); iter != jv.as_object().cend(); iter++)
-            {
-                // Iterate over values in children to find the filename key.
-                json::array children = iter->second.as_array();
-
-                for (int i = 0; i < children.size(); i++)
-                {
-                    for (auto iter2 = children[i].as_object().cbegin(); iter2 != children[i].as_object().cend(); iter2++)
-                    {
-                        if (iter2->first == L"FileName")
-                        {
-                            // Convert this filename to base64.
-                            LPTSTR encodedString;
-                            StringHelper::base64_encode(StringHelper::ws2s(iter2->second.as_string()), encodedString);
-                            GetMRCFile(encodedString, holoPath);
-                            HeapFree(GetProcessHeap(), HEAP_NO_SERIALIZE, encodedString);
-                        }
-                    }
-                }
-            }
-        });
-
-        // Wait for files to copy before returning.
-        task.wait();
-    }
-    catch (const std::exception &e)
-    {
-        OutputString(L"Error Getting MRC files: ");
-        OutputString(StringHelper::s2ws(e.what()).c_str());
-        OutputString(L"\n");
-    }
-}
-
-// Copy a particular MRC file from the Hololens to the local PC.  FileName must be base64 encoded.
-void CalibrationApp::GetMRCFile(LPTSTR fileName, LPTSTR holoPath)
-{
-    try
-    {
-        auto fileStream = std::make_shared<concurrency::streams::ostream>();
-
-        // Open stream to output file.
-        pplx::task<void> requestTask = concurrency::streams::fstream::open_ostream(holoPath).then([=](concurrency::streams::ostream outFile)
-        {
-            *fileStream = outFile;
-
-            uri_builder builder(U("/api/holographic/mrc/file"));
-            builder.append_query(U("filename"), fileName);
-            builder.append_query(U("op"), U("stream"));
-
-            return httpClient->request(methods::GET, builder.to_string()).get();
-        })
-
-            // Handle response headers arriving.
-            .then([=](http_response response)
-        {
-            // Write response body into the file.
-            return response.body().read_to_end(fileStream->streambuf());
-        })
-
-            // Close the file stream.
-            .then([=](size_t)
-        {
-            return fileStream->close().get();
-        });
-
-        // Wait for file copy to complete before returning.
-        requestTask.wait();
-    }
-    catch (const std::exception &e)
-    {
-        OutputString(L"Error Getting MRC file: ");
-        OutputString(StringHelper::s2ws(e.what()).c_str());
-        OutputString(L"\n");
-    }
 }
\ No newline at end of file
@@ -39,9 +39,15 @@
 #endif
 
 #include "ReadData.h"
+#include "ChessBoardDetector.h"
+#include "StereoCalibration.h"
+#include "IncrementalCalibration.h"
+#include "MRCDownloader.h"
 
 #include "opencv2/opencv.hpp"
 
+#include <ppl.h>
+
 //TODO: Update with the 3.x version of OpenCV you are using.
 #if _DEBUG
 #pragma comment(lib, "opencv_world341d")
@@ -100,20 +106,43 @@ private:
     void CreateWindowSizeDependentResources();
 
     // REST
-    void DeleteAllMRCFiles();
-    void DeleteMRCFile(LPTSTR fileName);
-    void GetAllMRCFiles(LPTSTR holoPath);
-    void GetMRCFile(LPTSTR fileName, LPTSTR outputHoloPath);
     void TakeMRCPicture();
 
     // Calibration
-    void ProcessChessBoards(int currentIndex, cv::Mat& colorCameraImage);
+    // Chess boards found in a camera and HoloLens photo pair.
+    struct ChessBoardPair
+    {
+        // Camera image at HoloLens resolution, and HoloLens image.  Empty once they are no longer needed for display.
+        cv::Mat colorImage;
+        cv::Mat holoImage;
+        std::vector<cv::Point2f> colorCorners;
+        std::vector<cv::Point2f> holoCorners;
+        bool validCameraImage = false;
+        bool validHoloImage = false;
+        // Detection time of each image, and of the pair.  The two images are processed concurrently.
+        double cameraSeconds = 0;
+        double holoSeconds = 0;
+        double seconds = 0;
+    };
+
+    void ProcessChessBoards(int currentIndex, cv::Mat& colorCameraImage, pplx::task<bool> holoDownload);
+    // Thread safe.  An empty colorCameraImage is loaded from the pair's camera photo.
+    // The HoloLens photo is loaded once holoDownload completes, the camera photo is searched in the meantime.
+    void DetectChessBoards(int currentIndex, const cv::Mat& colorCameraImage, ChessBoardPair& pair,
+        pplx::task<bool> holoDownload = pplx::task_from_result(true));
+    void AddChessBoards(ChessBoardPair& pair);
+    // Detect the chess boards in every photo pair in the output directory again, in parallel.
+    void ReprocessCalibrationFiles();
     void UpdateChessBoardVisual(std::vector<cv::Point2f>& colorCorners);
+    StereoCalibration::Options GetCalibrationOptions() const;
+    // Solve the running calibration with the pairs added since the last solve, on a background thread.
+    void RefineCalibration(const std::vector<cv::Point2f>& colorCorners, const std::vector<cv::Point2f>& holoCorners);
+    void RefineCalibrationThread();
     void PerformCalibration();
     void TakeCalibrationPicture();
     void TakeCalibrationPictureAtInterval(DX::StepTimer const& timer);
     void DeleteOutputFiles();
-    bool HasChessBoard(cv::Mat image, cv::Mat& grayscaleImage, std::vector<cv::Point2f>& corners);
+    void ClearChessBoards();
 
     void Blit(ID3D11ShaderResourceView* source, ID3D11RenderTargetView* dest, ID3D11PixelShader* shader);
 
@@ -164,16 +193,31 @@ private:
 
     // REST
     http_client* httpClient;
+    std::unique_ptr<MRCDownloader> mrcDownloader;
 
     // Calibration
     cv::Size boardDimensions;
+    ChessBoardDetector chessBoardDetector;
     double calibrationPictureElapsedTime;
+    // Calibration pictures that are being taken, downloaded or searched for chess boards.
+    concurrency::task_group pictureTasks;
     CRITICAL_SECTION photoTextureCriticalSection;
     CRITICAL_SECTION commandCriticalSection;
     CRITICAL_SECTION calibrationPictureCriticalSection;
     CRITICAL_SECTION chessBoardVisualCriticalSection;
     CRITICAL_SECTION photoVisualsCriticalSection;
 
+    // Running calibration, refined as each usable pair is added.  Only used by the refine thread.
+    std::unique_ptr<IncrementalCalibration> incrementalCalibration;
+    pplx::task<void> refineTask = pplx::task_from_result();
+    CRITICAL_SECTION refineCriticalSection;
+    // Pairs waiting for the refine thread.  Pairs that arrive during a solve are all added to the next one.
+    std::vector<std::pair<std::vector<cv::Point2f>, std::vector<cv::Point2f>>> pendingRefinePairs;
+    bool refining = false;
+    // Set when the chess boards are cleared, so the refine thread starts over.
+    bool resetRefine = false;
+    std::wstring calibrationStatusText;
+
     // Current photo number we are on.
     int photoIndex;
     std::wstring outputPath;
@@ -190,12 +234,7 @@ private:
     Microsoft::WRL::ComPtr<ID3D11PixelShader> yuv2rgbPS;
     Microsoft::WRL::ComPtr<ID3D11PixelShader> forceOpaquePS;
 
-    // Chessboard points in object space for boards that are visible in both camera and hololens pictures.
-    std::vector<std::vector<cv::Point3f>> stereoObjectPoints;
     // Chessboard points in image space for boards that are visible in both camera and hololens pictures.
-    std::vector<std::vector<cv::Point2f>> stereoColorImagePoints;
-    std::vector<std::vector<cv::Point2f>> stereoHoloImagePoints;
-    // Chessboard points in image space for all boards in camera and hololens picture.
     std::vector<std::vector<cv::Point2f>> colorImagePoints;
     std::vector<std::vector<cv::Point2f>> holoImagePoints;
     // Chessboard points in image space for the latest camera and hololens pictures.
@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "ChessBoardDetector.h"
+
+ChessBoardDetector::ChessBoardDetector(cv::Size boardDimensions, int searchWidth) :
+    boardDimensions(boardDimensions),
+    searchWidth(searchWidth)
+{
+}
+
+bool ChessBoardDetector::Detect(const cv::Mat& image, std::vector<cv::Point2f>& corners, bool refine) const
+{
+    corners.clear();
+    if (image.empty())
+    {
+        return false;
+    }
+
+    cv::Mat grayscaleImage = image;
+    if (image.channels() != 1)
+    {
+        cv::cvtColor(image, grayscaleImage, cv::COLOR_RGBA2GRAY);
+    }
+
+    // Search a downscaled copy, unless the image is already small.
+    cv::Mat searchImage = grayscaleImage;
+    if (searchWidth > 0 && grayscaleImage.cols > searchWidth)
+    {
+        int searchHeight = cvRound((double)grayscaleImage.rows * searchWidth / grayscaleImage.cols);
+        cv::resize(grayscaleImage, searchImage, cv::Size(searchWidth, searchHeight), 0, 0, cv::INTER_AREA);
+    }
+
+    if (!cv::findChessboardCorners(searchImage, boardDimensions, corners,
+        cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE + cv::CALIB_CB_FAST_CHECK))
+    {
+        return false;
+    }
+
+    if (searchImage.data != grayscaleImage.data)
+    {
+        // Pixel centers line up between the two images, not their top left corners.
+        float scaleX = (float)grayscaleImage.cols / searchImage.cols;
+        float scaleY = (float)grayscaleImage.rows / searchImage.rows;
+        for (cv::Point2f& corner : corners)
+        {
+            corner.x = (corner.x + 0.5f) * scaleX - 0.5f;
+            corner.y = (corner.y + 0.5f) * scaleY - 0.5f;
+        }
+    }
+
+    if (refine)
+    {
+        // The window is large enough to pull in corners that are off by a few pixels from the coarse search.
+        cv::cornerSubPix(grayscaleImage, corners, cv::Size(11, 11), cv::Size(-1, -1),
+            cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.1));
+    }
+
+    return true;
+}
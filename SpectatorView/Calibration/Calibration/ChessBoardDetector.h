@@ -0,0 +1,30 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "opencv2/opencv.hpp"
+
+#include <vector>
+
+//TODO: Width of the downscaled image chessboards are first searched for in.  Set this to 0 to search at full resolution.
+#define CHESSBOARD_SEARCH_WIDTH 640
+
+// Finds the interior corners of a chessboard, coarse to fine.
+// The board is searched for in a downscaled copy of the image with CALIB_CB_FAST_CHECK, so images without a board are rejected quickly,
+// then the corners that were found are refined with cornerSubPix against the full resolution image.
+//
+// Only depends on OpenCV.  Detect can be called from several threads at once.
+class ChessBoardDetector
+{
+public:
+    ChessBoardDetector(cv::Size boardDimensions, int searchWidth = CHESSBOARD_SEARCH_WIDTH);
+
+    // image is grayscale, or 3 or 4 channels in RGB order.  Corners are in image coordinates.
+    // Without refine, the corners are only as accurate as the downscaled search, which is enough to tell whether a board is in view.
+    bool Detect(const cv::Mat& image, std::vector<cv::Point2f>& corners, bool refine = true) const;
+
+private:
+    cv::Size boardDimensions;
+    int searchWidth;
+};
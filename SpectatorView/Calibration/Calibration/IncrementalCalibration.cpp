@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "IncrementalCalibration.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+double IncrementalCalibration::Stats::GetUncertainty() const
+{
+    if (colorFocalLength <= 0 || holoFocalLength <= 0)
+    {
+        return DBL_MAX;
+    }
+
+    return std::max(colorFocalLengthDeviation / colorFocalLength, holoFocalLengthDeviation / holoFocalLength);
+}
+
+IncrementalCalibration::IncrementalCalibration(const StereoCalibration::Options& options, int maxViews) :
+    options(options),
+    maxViews(std::max(maxViews, INCREMENTAL_CALIBRATION_MIN_VIEWS))
+{
+}
+
+void IncrementalCalibration::Add(const std::vector<cv::Point2f>& colorCorners, const std::vector<cv::Point2f>& holoCorners)
+{
+    colorImagePoints.push_back(colorCorners);
+    holoImagePoints.push_back(holoCorners);
+    stats.numViews++;
+}
+
+void IncrementalCalibration::Clear()
+{
+    colorImagePoints.clear();
+    holoImagePoints.clear();
+    calibration = StereoCalibration();
+    stats = Stats();
+}
+
+bool IncrementalCalibration::Solve()
+{
+    if ((int)colorImagePoints.size() < INCREMENTAL_CALIBRATION_MIN_VIEWS)
+    {
+        return false;
+    }
+
+    int64 start = cv::getTickCount();
+
+    // The cameras are refined in place, so the solve works on copies in case it fails.
+    StereoCalibration next = calibration;
+    next.colorMat = calibration.colorMat.clone();
+    next.distCoeffColor = calibration.distCoeffColor.clone();
+    next.holoMat = calibration.holoMat.clone();
+    next.distCoeffHolo = calibration.distCoeffHolo.clone();
+
+    try
+    {
+        // The first solve estimates the intrinsics from scratch, later ones start from the previous solution.
+        if (!next.Calibrate(colorImagePoints, holoImagePoints, options, true))
+        {
+            return false;
+        }
+    }
+    catch (const cv::Exception&)
+    {
+        return false;
+    }
+
+    if (!cv::checkRange(next.colorMat) || !cv::checkRange(next.holoMat) || !cv::checkRange(next.T) ||
+        next.colorDeviations.empty() || next.holoDeviations.empty())
+    {
+        return false;
+    }
+
+    calibration = next;
+
+    stats.numWorkingViews = (int)colorImagePoints.size();
+    stats.rms = calibration.rms;
+    stats.colorRMS = calibration.colorRMS;
+    stats.holoRMS = calibration.holoRMS;
+    stats.colorFocalLength = calibration.colorMat.at<double>(0, 0);
+    stats.colorFocalLengthDeviation = calibration.colorDeviations.at<double>(0);
+    stats.holoFocalLength = calibration.holoMat.at<double>(0, 0);
+    stats.holoFocalLengthDeviation = calibration.holoDeviations.at<double>(0);
+    stats.solveSeconds = (double)(cv::getTickCount() - start) / cv::getTickFrequency();
+
+    DropRedundantViews();
+    return true;
+}
+
+cv::Mat IncrementalCalibration::GetPoseFeatures() const
+{
+    const cv::Size& imageSize = options.imageSize;
+    cv::Mat features((int)colorImagePoints.size(), 5, CV_64F);
+
+    for (int i = 0; i < features.rows; i++)
+    {
+        // Where the board is in the image, and how much of it the board fills.
+        cv::Rect bounds = cv::boundingRect(colorImagePoints[i]);
+        features.at<double>(i, 0) = (bounds.x + bounds.width * 0.5) / imageSize.width;
+        features.at<double>(i, 1) = (bounds.y + bounds.height * 0.5) / imageSize.height;
+        features.at<double>(i, 2) = std::sqrt((double)bounds.area() / imageSize.area());
+
+        // Which way the board faces: the x and y of its normal in camera space.
+        cv::Mat rotation;
+        cv::Rodrigues(calibration.colorBoardRotations[i], rotation);
+        features.at<double>(i, 3) = rotation.at<double>(0, 2);
+        features.at<double>(i, 4) = rotation.at<double>(1, 2);
+    }
+
+    return features;
+}
+
+void IncrementalCalibration::DropRedundantViews()
+{
+    int numViews = (int)colorImagePoints.size();
+    if (numViews <= maxViews || (int)calibration.colorBoardRotations.size() != numViews ||
+        calibration.colorViewErrors.total() != (size_t)numViews || calibration.holoViewErrors.total() != (size_t)numViews)
+    {
+        return;
+    }
+
+    cv::Mat features = GetPoseFeatures();
+    std::vector<bool> keep(numViews, true);
+
+    for (int numKept = numViews; numKept > maxViews; numKept--)
+    {
+        // The two boards closest in pose add the least to each other.
+        double closestDistance = DBL_MAX;
+        int closestA = -1, closestB = -1;
+        for (int a = 0; a < numViews; a++)
+        {
+            for (int b = a + 1; b < numViews && keep[a]; b++)
+            {
+                double distance = keep[b] ? cv::norm(features.row(a), features.row(b), cv::NORM_L2SQR) : DBL_MAX;
+                if (distance < closestDistance)
+                {
+                    closestDistance = distance;
+                    closestA = a;
+                    closestB = b;
+                }
+            }
+        }
+
+        // Of those, keep the one both cameras agree on best.
+        auto getError = [&](int view)
+        {
+            double colorError = calibration.colorViewErrors.at<double>(view);
+            double holoError = calibration.holoViewErrors.at<double>(view);
+            return colorError * colorError + holoError * holoError;
+        };
+        keep[getError(closestA) > getError(closestB) ? closestA : closestB] = false;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < numViews; i++)
+    {
+        if (keep[i])
+        {
+            colorImagePoints[kept] = std::move(colorImagePoints[i]);
+            holoImagePoints[kept] = std::move(holoImagePoints[i]);
+            kept++;
+        }
+    }
+
+    colorImagePoints.resize(kept);
+    holoImagePoints.resize(kept);
+}
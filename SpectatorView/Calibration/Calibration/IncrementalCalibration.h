@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "StereoCalibration.h"
+
+//TODO: Photo pairs the running calibration is solved with.  More pairs are more accurate, but slower to solve.
+#define INCREMENTAL_CALIBRATION_VIEWS 20
+// Pairs needed before the first solve.
+#define INCREMENTAL_CALIBRATION_MIN_VIEWS 3
+// Focal length uncertainty (standard deviation over focal length) at which there are enough pictures.
+#define INCREMENTAL_CALIBRATION_CONVERGED 0.005
+
+// Refines the stereo calibration as each photo pair arrives, so the operator can see how good it is while taking pictures.
+//
+// Each solve starts from the previous solution's intrinsics, and only uses a bounded working set of pairs,
+// so adding a pair takes about the same time however many pictures have been taken.
+// Once the working set is full, the most redundant pair is dropped after each solve: of the two pairs whose chessboards are
+// closest in position, size and tilt, the one with the larger reprojection error.
+//
+// Only depends on OpenCV.  Not thread safe.
+class IncrementalCalibration
+{
+public:
+    class Stats
+    {
+    public:
+        // Pairs added, and pairs the latest solve used.
+        int numViews = 0;
+        int numWorkingViews = 0;
+
+        // RMS reprojection error of the latest solve.
+        double rms = 0;
+        double colorRMS = 0;
+        double holoRMS = 0;
+
+        // Focal length (fx) and its standard deviation in pixels.
+        double colorFocalLength = 0;
+        double colorFocalLengthDeviation = 0;
+        double holoFocalLength = 0;
+        double holoFocalLengthDeviation = 0;
+
+        double solveSeconds = 0;
+
+        // Largest focal length deviation over focal length, of either camera.  Lower is better.
+        double GetUncertainty() const;
+        bool IsConverged() const { return numWorkingViews > 0 && GetUncertainty() < INCREMENTAL_CALIBRATION_CONVERGED; }
+    };
+
+    IncrementalCalibration(const StereoCalibration::Options& options, int maxViews = INCREMENTAL_CALIBRATION_VIEWS);
+
+    // Corners of a chessboard found in both images of a pair.  Used by the next solve.
+    void Add(const std::vector<cv::Point2f>& colorCorners, const std::vector<cv::Point2f>& holoCorners);
+
+    // Refine the calibration with the pairs that have been added.  Returns false if there are not enough pairs yet,
+    // or the solve failed, in which case the previous solution is kept.
+    bool Solve();
+
+    void Clear();
+
+    const Stats& GetStats() const { return stats; }
+    // Latest solution.
+    const StereoCalibration& GetCalibration() const { return calibration; }
+
+private:
+    // Board position, size and tilt in the camera image of each working pair, from the latest solve.  One row per pair.
+    cv::Mat GetPoseFeatures() const;
+    // Shrink the working set to maxViews.  Must be called right after a solve, while its per pair results line up with the working set.
+    void DropRedundantViews();
+
+    StereoCalibration::Options options;
+    int maxViews;
+
+    std::vector<std::vector<cv::Point2f>> colorImagePoints;
+    std::vector<std::vector<cv::Point2f>> holoImagePoints;
+
+    StereoCalibration calibration;
+    Stats stats;
+};
@@ -0,0 +1,335 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "MRCDownloader.h"
+#include "StringHelper.h"
+
+#include <cpprest/filestream.h>
+#include <cpprest/json.h>
+
+using namespace web;
+using namespace web::http;
+using namespace web::http::client;
+
+MRCDownloader::MRCDownloader(http_client* client, int maxConcurrentRequests) :
+    client(client),
+    maxConcurrentRequests(std::max(maxConcurrentRequests, 1))
+{
+}
+
+pplx::task<void> MRCDownloader::AcquireSlot()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (numRequests < maxConcurrentRequests)
+    {
+        numRequests++;
+        return pplx::task_from_result();
+    }
+
+    pplx::task_completion_event<void> slot;
+    waitingRequests.push_back(slot);
+    return pplx::create_task(slot);
+}
+
+void MRCDownloader::ReleaseSlot()
+{
+    pplx::task_completion_event<void> next;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (waitingRequests.empty())
+        {
+            numRequests--;
+            return;
+        }
+
+        // The slot goes straight to the oldest waiting request.
+        next = waitingRequests.front();
+        waitingRequests.pop_front();
+    }
+
+    next.set();
+}
+
+template <typename T>
+pplx::task<T> MRCDownloader::Schedule(std::function<pplx::task<T>()> request)
+{
+    return AcquireSlot().then([=]()
+    {
+        return request();
+    })
+    .then([=](pplx::task<T> result)
+    {
+        ReleaseSlot();
+        return result;
+    });
+}
+
+std::wstring MRCDownloader::EncodeFileName(const std::wstring& fileName)
+{
+    std::wstring encodedFileName;
+    LPTSTR encodedString;
+    if (StringHelper::base64_encode(StringHelper::ws2s(fileName), encodedString))
+    {
+        encodedFileName = encodedString;
+        HeapFree(GetProcessHeap(), HEAP_NO_SERIALIZE, encodedString);
+    }
+
+    return encodedFileName;
+}
+
+void MRCDownloader::LogError(const wchar_t* message, const std::exception& e)
+{
+    OutputString(message);
+    OutputString(StringHelper::s2ws(e.what()).c_str());
+    OutputString(L"\n");
+}
+
+pplx::task<std::vector<std::wstring>> MRCDownloader::ListFiles()
+{
+    return Schedule<std::vector<std::wstring>>([=]()
+    {
+        uri_builder builder(U("/api/holographic/mrc/files"));
+
+        return client->request(methods::GET, builder.to_string()).then([](http_response response) -> pplx::task<json::value>
+        {
+            // If we get a valid response, return the extracted json.
+            if (response.status_code() == status_codes::OK)
+            {
+                return response.extract_json();
+            }
+
+            // Otherwise return empty json.
+            return pplx::task_from_result(json::value());
+        })
+        .then([](pplx::task<json::value> previousTask)
+        {
+            std::vector<std::wstring> fileNames;
+
+            try
+            {
+                const json::value& jv = previousTask.get();
+                if (!jv.is_object())
+                {
+                    return fileNames;
+                }
+
+                // Iterate over the json to get the MRC file names.
+                for (auto iter = jv.as_object().cbegin(); iter != jv.as_object().cend(); iter++)
+                {
+                    if (!iter->second.is_array())
+                    {
+                        continue;
+                    }
+
+                    // Iterate over values in children to find the filename key.
+                    for (const json::value& child : iter->second.as_array())
+                    {
+                        if (!child.is_object())
+                        {
+                            continue;
+                        }
+
+                        for (auto iter2 = child.as_object().cbegin(); iter2 != child.as_object().cend(); iter2++)
+                        {
+                            if (iter2->first == L"FileName")
+                            {
+                                fileNames.push_back(iter2->second.as_string());
+                            }
+                        }
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                LogError(L"Error Getting MRC files: ", e);
+                fileNames.clear();
+            }
+
+            return fileNames;
+        });
+    });
+}
+
+pplx::task<bool> MRCDownloader::Download(const std::wstring& fileName, const std::wstring& path)
+{
+    std::wstring encodedFileName = EncodeFileName(fileName);
+
+    return Schedule<bool>([=]()
+    {
+        auto fileStream = std::make_shared<concurrency::streams::ostream>();
+
+        // Open stream to output file.
+        return concurrency::streams::fstream::open_ostream(path).then([=](concurrency::streams::ostream outFile)
+        {
+            *fileStream = outFile;
+
+            uri_builder builder(U("/api/holographic/mrc/file"));
+            builder.append_query(U("filename"), encodedFileName);
+            builder.append_query(U("op"), U("stream"));
+
+            return client->request(methods::GET, builder.to_string());
+        })
+
+        // Handle response headers arriving.
+        .then([=](http_response response)
+        {
+            if (response.status_code() != status_codes::OK)
+            {
+                throw http_exception(L"Device Portal returned status " + std::to_wstring(response.status_code()));
+            }
+
+            // Write response body into the file as it arrives.
+            return response.body().read_to_end(fileStream->streambuf());
+        })
+
+        // Close the file stream.
+        .then([=](pplx::task<size_t> previousTask)
+        {
+            bool succeeded = false;
+            try
+            {
+                succeeded = previousTask.get() > 0;
+            }
+            catch (const std::exception &e)
+            {
+                LogError(L"Error Getting MRC file: ", e);
+            }
+
+            pplx::task<void> closeTask = fileStream->is_valid() ? fileStream->close() : pplx::task_from_result();
+            return closeTask.then([=](pplx::task<void> previousTask)
+            {
+                bool closed = true;
+                try
+                {
+                    previousTask.get();
+                }
+                catch (const std::exception &e)
+                {
+                    LogError(L"Error Getting MRC file: ", e);
+                    closed = false;
+                }
+
+                // Do not leave a partial photo behind, it would be mistaken for a complete one.
+                if (!succeeded || !closed)
+                {
+                    DeleteFileW(path.c_str());
+                }
+
+                return succeeded && closed;
+            });
+        });
+    });
+}
+
+pplx::task<bool> MRCDownloader::Delete(const std::wstring& fileName)
+{
+    std::wstring encodedFileName = EncodeFileName(fileName);
+
+    return Schedule<bool>([=]()
+    {
+        uri_builder builder(U("/api/holographic/mrc/file"));
+        builder.append_query(U("filename"), encodedFileName);
+
+        return client->request(methods::DEL, builder.to_string()).then([](pplx::task<http_response> previousTask)
+        {
+            try
+            {
+                return previousTask.get().status_code() == status_codes::OK;
+            }
+            catch (const std::exception &e)
+            {
+                LogError(L"Error Deleting MRC file: ", e);
+                return false;
+            }
+        });
+    });
+}
+
+pplx::task<int> MRCDownloader::Delete(const std::vector<std::wstring>& fileNames)
+{
+    if (fileNames.empty())
+    {
+        return pplx::task_from_result(0);
+    }
+
+    std::vector<pplx::task<bool>> deletes;
+    for (const std::wstring& fileName : fileNames)
+    {
+        deletes.push_back(Delete(fileName));
+    }
+
+    return pplx::when_all(deletes.begin(), deletes.end()).then([](std::vector<bool> deleted)
+    {
+        return (int)std::count(deleted.begin(), deleted.end(), true);
+    });
+}
+
+pplx::task<int> MRCDownloader::DeleteAll()
+{
+    return ListFiles().then([=](std::vector<std::wstring> fileNames)
+    {
+        return Delete(fileNames);
+    });
+}
+
+pplx::task<bool> MRCDownloader::DownloadNewest(const std::wstring& path)
+{
+    // Files are claimed one call at a time, so a call never claims a photo that was taken after the next call's.
+    pplx::task<std::vector<std::wstring>> claim;
+    {
+        std::lock_guard<std::mutex> guard(claimLock);
+        claim = lastClaim.then([=]()
+        {
+            return ListFiles();
+        })
+        .then([=](std::vector<std::wstring> fileNames)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::vector<std::wstring> newFiles;
+            for (const std::wstring& fileName : fileNames)
+            {
+                if (claimedFiles.insert(fileName).second)
+                {
+                    newFiles.push_back(fileName);
+                }
+            }
+
+            return newFiles;
+        });
+
+        lastClaim = claim.then([](pplx::task<std::vector<std::wstring>>) {});
+    }
+
+    return claim.then([=](std::vector<std::wstring> newFiles)
+    {
+        if (newFiles.empty())
+        {
+            OutputString(L"ERROR: No new MRC photo on the HoloLens.\n");
+            return pplx::task_from_result(false);
+        }
+
+        // The last file listed is the photo that was just taken.
+        return Download(newFiles.back(), path).then([=](bool downloaded)
+        {
+            std::vector<pplx::task<void>> deletes;
+            for (const std::wstring& fileName : newFiles)
+            {
+                deletes.push_back(Delete(fileName).then([=](bool deleted)
+                {
+                    // A file that is still on the device stays claimed, so it is not mistaken for a newer photo.
+                    if (deleted)
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        claimedFiles.erase(fileName);
+                    }
+                }));
+            }
+
+            return pplx::when_all(deletes.begin(), deletes.end()).then([=]()
+            {
+                return downloaded;
+            });
+        });
+    });
+}
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <cpprest/http_client.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+//TODO: Device Portal requests that can be in flight at once.
+#define MRC_MAX_CONCURRENT_REQUESTS 4
+
+// Lists, downloads and deletes mixed reality capture files through the HoloLens Device Portal.
+//
+// Every call returns a task instead of blocking, so callers can keep working (eg: searching the camera image for a chess board)
+// while a photo downloads.  Requests run concurrently, but at most maxConcurrentRequests are in flight at once,
+// and file bodies are streamed to disk as they arrive.
+//
+// Tasks never throw: failed requests are logged and complete with false.
+class MRCDownloader
+{
+public:
+    MRCDownloader(web::http::client::http_client* client, int maxConcurrentRequests = MRC_MAX_CONCURRENT_REQUESTS);
+
+    // Names of the MRC files on the device.  Empty if the request failed.
+    pplx::task<std::vector<std::wstring>> ListFiles();
+
+    pplx::task<bool> Download(const std::wstring& fileName, const std::wstring& path);
+    pplx::task<bool> Delete(const std::wstring& fileName);
+
+    // Delete every file at once.  Completes with the number of files that were deleted.
+    pplx::task<int> Delete(const std::vector<std::wstring>& fileNames);
+    pplx::task<int> DeleteAll();
+
+    // Download the newest file no earlier call has claimed to path, then delete it from the device.
+    // Photos can be taken while older ones are still downloading: each call claims the files that are new since the last one,
+    // so a file is never downloaded twice.  Older new files are only deleted.  Completes with false if there was no new file.
+    pplx::task<bool> DownloadNewest(const std::wstring& path);
+
+private:
+    // Runs request once a slot is free, and frees the slot when it completes.
+    template <typename T>
+    pplx::task<T> Schedule(std::function<pplx::task<T>()> request);
+    pplx::task<void> AcquireSlot();
+    void ReleaseSlot();
+
+    // The Device Portal takes file names base64 encoded.
+    static std::wstring EncodeFileName(const std::wstring& fileName);
+    static void LogError(const wchar_t* message, const std::exception& e);
+
+    web::http::client::http_client* client;
+    int maxConcurrentRequests;
+
+    std::mutex lock;
+    int numRequests = 0;
+    // Requests waiting for a slot, oldest first.
+    std::deque<pplx::task_completion_event<void>> waitingRequests;
+    // Files that DownloadNewest has claimed and that are still on the device.
+    std::set<std::wstring> claimedFiles;
+
+    // DownloadNewest claims files one call at a time.
+    std::mutex claimLock;
+    pplx::task<void> lastClaim = pplx::task_from_result();
+};
@@ -0,0 +1,148 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "StereoCalibration.h"
+
+#include <algorithm>
+
+bool StereoCalibration::Calibrate(const std::vector<std::vector<cv::Point2f>>& colorImagePoints,
+    const std::vector<std::vector<cv::Point2f>>& holoImagePoints, const Options& options, bool warmStart)
+{
+    if (colorImagePoints.empty() || colorImagePoints.size() != holoImagePoints.size())
+    {
+        return false;
+    }
+
+    warmStart = warmStart && !colorMat.empty() && !holoMat.empty();
+
+    const cv::Size& imageSize = options.imageSize;
+
+    //http://docs.opencv.org/2.4/modules/calib3d/doc/camera_calibration_and_3d_reconstruction.html#Mat initCameraMatrix2D(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints, Size imageSize, double aspectRatio)
+    // Object-space points are the same for every board.
+    std::vector<cv::Point3f> boardPoints;
+    for (int i = 0; i < options.boardDimensions.height; i++)
+    {
+        for (int j = 0; j < options.boardDimensions.width; j++)
+        {
+            boardPoints.push_back(cv::Point3f((float)(j * options.squareSize), (float)(i * options.squareSize), 0.0f));
+        }
+    }
+    std::vector<std::vector<cv::Point3f>> objectPoints(colorImagePoints.size(), boardPoints);
+
+    double apertureWidth = 0;
+    double apertureHeight = 0;
+    double focalLength = 0;
+    cv::Point2d principalPoint;
+    double aspectRatio = 0;
+
+    // Calibrate the individual cameras.
+    std::vector<cv::Mat> holoR, colorT, holoT;
+    cv::Mat colorExtrinsicDeviations, holoExtrinsicDeviations;
+
+    int colorFlags = cv::CALIB_USE_INTRINSIC_GUESS | options.colorFlags;
+    if (options.focalLength > 0)
+    {
+        initialColorFocalLength = options.focalLength *
+            std::min(imageSize.width / options.sensorWidth, imageSize.height / options.sensorHeight);
+
+        if (options.fixFocalLength)
+        {
+            colorFlags |= cv::CALIB_FIX_FOCAL_LENGTH;
+        }
+        if (options.fixPrincipalPoint)
+        {
+            colorFlags |= cv::CALIB_FIX_PRINCIPAL_POINT;
+        }
+    }
+    else
+    {
+        initialColorFocalLength = 0;
+    }
+
+    // Distortion coefficients are used as an initial guess too, so they are reset along with the camera matrices.
+    if (!warmStart)
+    {
+        distCoeffColor = cv::Mat();
+        distCoeffHolo = cv::Mat();
+
+        if (initialColorFocalLength > 0)
+        {
+            colorMat = (cv::Mat_<double>(3, 3) <<
+                initialColorFocalLength, 0, imageSize.width / 2., 0, initialColorFocalLength, imageSize.height / 2., 0, 0, 1);
+        }
+        else
+        {
+            colorMat = cv::initCameraMatrix2D(objectPoints, colorImagePoints, imageSize, (double)imageSize.height / (double)imageSize.width);
+        }
+        holoMat = cv::initCameraMatrix2D(objectPoints, holoImagePoints, imageSize, (double)imageSize.height / (double)imageSize.width);
+    }
+
+    colorRMS = cv::calibrateCamera(objectPoints, colorImagePoints, imageSize, colorMat, distCoeffColor, colorBoardRotations, colorT,
+        colorDeviations, colorExtrinsicDeviations, colorViewErrors, colorFlags);
+    holoRMS = cv::calibrateCamera(objectPoints, holoImagePoints, imageSize, holoMat, distCoeffHolo, holoR, holoT,
+        holoDeviations, holoExtrinsicDeviations, holoViewErrors, cv::CALIB_USE_INTRINSIC_GUESS | options.holoFlags);
+
+    cv::calibrationMatrixValues(holoMat, imageSize, apertureWidth, apertureHeight, holoFovX, holoFovY, focalLength, principalPoint, aspectRatio);
+    cv::calibrationMatrixValues(colorMat, imageSize, apertureWidth, apertureHeight, colorFovX, colorFovY, focalLength, principalPoint, aspectRatio);
+
+    // Output rotation, translation, essential matrix, fundamental matrix.
+    cv::Mat E, F;
+
+    //http://docs.opencv.org/2.4/modules/calib3d/doc/camera_calibration_and_3d_reconstruction.html#double stereoCalibrate(InputArrayOfArrays objectPoints, InputArrayOfArrays imagePoints1, InputArrayOfArrays imagePoints2, InputOutputArray cameraMatrix1, InputOutputArray distCoeffs1, InputOutputArray cameraMatrix2, InputOutputArray distCoeffs2, Size imageSize, OutputArray R, OutputArray T, OutputArray E, OutputArray F, TermCriteria criteria, int flags)
+    // Stereo calibrate the two cameras.
+    rms = cv::stereoCalibrate(objectPoints, holoImagePoints, colorImagePoints,
+        holoMat, distCoeffHolo,
+        colorMat, distCoeffColor,
+        imageSize,
+        R, T, E, F,
+        cv::CALIB_FIX_INTRINSIC
+    );
+
+    numImagesUsed = (int)objectPoints.size();
+    return true;
+}
+
+void StereoCalibration::Write(std::ostream& calibrationfs, int numImagesCaptured) const
+{
+    calibrationfs << "# Stereo RMS calibration error (Lower numbers are better)" << std::endl;
+    calibrationfs << "RMS: " << rms << std::endl;
+
+    calibrationfs << "# DSLR RMS calibration error (Lower numbers are better)" << std::endl;
+    calibrationfs << "DSLR RMS: " << colorRMS << std::endl;
+
+    calibrationfs << "# HoloLens RMS calibration error (Lower numbers are better)" << std::endl;
+    calibrationfs << "HoloLens RMS: " << holoRMS << std::endl;
+
+    calibrationfs << "# Delta in meters of Hololens from Camera:" << std::endl;
+    calibrationfs << "Translation: " << T.at<double>(0, 0) << ", " << T.at<double>(1, 0) << ", " << T.at<double>(2, 0) << std::endl;
+
+    calibrationfs << "# Row Major Matrix3x3 (This should be close to identity)" << std::endl;
+    calibrationfs << "Rotation: " << R.at<double>(0, 0) << ", " << R.at<double>(0, 1) << ", " << R.at<double>(0, 2) << ", " <<
+        R.at<double>(1, 0) << ", " << R.at<double>(1, 1) << ", " << R.at<double>(1, 2) << ", " << R.at<double>(2, 0) << ", " <<
+        R.at<double>(2, 1) << ", " << R.at<double>(2, 2) << std::endl;
+
+    calibrationfs << "# Field of View of DSLR:" << std::endl;
+    calibrationfs << "DSLR_fov: " << colorFovX << ", " << colorFovY << std::endl;
+
+    calibrationfs << "# Field of View of HoloLens:" << std::endl;
+    calibrationfs << "Holo_fov: " << holoFovX << ", " << holoFovY << std::endl;
+
+    calibrationfs << "# DSLR distortion coefficients:" << std::endl;
+    calibrationfs << "DSLR_distortion: " << distCoeffColor.at<double>(0, 0) << ", " << distCoeffColor.at<double>(0, 1) << ", " <<
+        distCoeffColor.at<double>(0, 2) << ", " << distCoeffColor.at<double>(0, 3) << ", " << distCoeffColor.at<double>(0, 4) << std::endl;
+
+    calibrationfs << "# DSLR camera Matrix: fx, fy, cx, cy:" << std::endl;
+    calibrationfs << "DSLR_camera_Matrix: " << colorMat.at<double>(0, 0) << ", " << colorMat.at<double>(1, 1) << ", " <<
+        colorMat.at<double>(0, 2) << ", " << colorMat.at<double>(1, 2) << std::endl;
+
+    calibrationfs << "# HoloLens distortion coefficients:" << std::endl;
+    calibrationfs << "Holo_distortion: " << distCoeffHolo.at<double>(0, 0) << ", " << distCoeffHolo.at<double>(0, 1) << ", " <<
+        distCoeffHolo.at<double>(0, 2) << ", " << distCoeffHolo.at<double>(0, 3) << ", " << distCoeffHolo.at<double>(0, 4) << std::endl;
+
+    calibrationfs << "# HoloLens camera Matrix: fx, fy, cx, cy:" << std::endl;
+    calibrationfs << "Holo_camera_Matrix: " << holoMat.at<double>(0, 0) << ", " << holoMat.at<double>(1, 1) << ", " <<
+        holoMat.at<double>(0, 2) << ", " << holoMat.at<double>(1, 2) << std::endl;
+
+    calibrationfs << "# Number of images captured: " << numImagesCaptured << std::endl;
+    calibrationfs << "# Number of images used in calibration: " << numImagesUsed << std::endl;
+}
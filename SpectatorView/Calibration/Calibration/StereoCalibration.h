@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "opencv2/opencv.hpp"
+
+#include <ostream>
+#include <vector>
+
+// Calibrates the camera and HoloLens individually, then the transform between them, from the chessboard corners found in photo pairs.
+// The results are written in the CalibrationData.txt format the compositor reads.
+//
+// Only depends on OpenCV, so the same calibration runs in the Calibration app and in CalibrationTool.
+class StereoCalibration
+{
+public:
+    class Options
+    {
+    public:
+        // boardDimensions is the number of interior corners, squareSize is in meters.
+        // Corners from both cameras are in imageSize (the camera photos are scaled to the HoloLens resolution).
+        Options(cv::Size boardDimensions, double squareSize, cv::Size imageSize) :
+            boardDimensions(boardDimensions),
+            squareSize(squareSize),
+            imageSize(imageSize)
+        {
+        }
+
+        cv::Size boardDimensions;
+        double squareSize;
+        cv::Size imageSize;
+
+        // Known camera intrinsics: lens focal length and sensor size in meters.  Leave focalLength at 0 to estimate it.
+        double focalLength = 0;
+        double sensorWidth = 0;
+        double sensorHeight = 0;
+        // Only with a known focal length: keep it, and keep the principal point at the center of the image.
+        bool fixFocalLength = false;
+        bool fixPrincipalPoint = false;
+
+        // Added to the cv::calibrateCamera flags of each camera (eg: cv::CALIB_ZERO_TANGENT_DIST).
+        int colorFlags = 0;
+        int holoFlags = 0;
+    };
+
+    // Each index is a photo pair with a chessboard found in both images.  Returns false if there are no pairs.
+    // With warmStart, both cameras start from the intrinsics of the previous calibration instead of estimating them from scratch.
+    bool Calibrate(const std::vector<std::vector<cv::Point2f>>& colorImagePoints,
+        const std::vector<std::vector<cv::Point2f>>& holoImagePoints, const Options& options, bool warmStart = false);
+
+    // numImagesCaptured includes the pairs that were not used in the calibration.
+    void Write(std::ostream& stream, int numImagesCaptured) const;
+
+    // Focal length in pixels the camera matrix started from, 0 if it was estimated from the corners.
+    double initialColorFocalLength = 0;
+
+    // Stereo, camera and HoloLens RMS reprojection error.
+    double rms = 0;
+    double colorRMS = 0;
+    double holoRMS = 0;
+
+    // HoloLens relative to the camera.
+    cv::Mat R, T;
+
+    double colorFovX = 0, colorFovY = 0;
+    double holoFovX = 0, holoFovY = 0;
+    cv::Mat colorMat, distCoeffColor;
+    cv::Mat holoMat, distCoeffHolo;
+
+    // Standard deviation of each camera's intrinsics: fx, fy, cx, cy, then the distortion coefficients.
+    cv::Mat colorDeviations, holoDeviations;
+    // RMS reprojection error of each pair in each camera.
+    cv::Mat colorViewErrors, holoViewErrors;
+    // Rotation (Rodrigues vector) of each pair's chessboard relative to the camera.
+    std::vector<cv::Mat> colorBoardRotations;
+
+    int numImagesUsed = 0;
+};
@@ -0,0 +1,20 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <Windows.h>
+#include <stdio.h>
+
+// Logs a failed check and fails the test it is in.  Each test starts with bool passed = true, and returns passed.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("    %s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            passed = false; \
+        } \
+    } while (false)
+
+// Tests return false if any of their checks failed.
+bool MRCDownloaderTests();
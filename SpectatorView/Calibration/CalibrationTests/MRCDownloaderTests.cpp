@@ -0,0 +1,466 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Runs MRCDownloader against a local stand-in for the HoloLens Device Portal that takes a while to answer each request.
+// Checks that no more than maxConcurrentRequests are in flight, that file bodies are written to disk as they arrive,
+// and that DownloadNewest gives every photo its own file when photos are taken while older ones are still downloading.
+// The stand-in listens on localhost, which may need the tests to run as administrator.
+
+#include "CalibrationTests.h"
+#include "MRCDownloader.h"
+#include "StringHelper.h"
+
+#include <cpprest/http_listener.h>
+#include <cpprest/json.h>
+#include <cpprest/producerconsumerstream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <thread>
+
+using namespace web;
+using namespace web::http;
+using namespace web::http::client;
+
+namespace
+{
+    const utility::string_t address = U("http://localhost:10090/");
+    const int latencyMS = 50;
+    const int numFiles = 16;
+    const size_t fileSize = 512 * 1024;
+
+    // Contents of a file on the stand-in device, different for every file name.
+    std::vector<unsigned char> GetFileContents(const std::wstring& fileName)
+    {
+        std::vector<unsigned char> contents(fileSize);
+        size_t seed = std::hash<std::wstring>()(fileName);
+        for (size_t i = 0; i < fileSize; i++)
+        {
+            contents[i] = (unsigned char)(seed + i * 31 + (i >> 8));
+        }
+
+        return contents;
+    }
+
+    bool IsFileValid(const std::wstring& path, const std::wstring& fileName)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        std::vector<unsigned char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        return contents == GetFileContents(fileName);
+    }
+
+    // Size of a file that is still open for writing, or -1 if it does not exist.
+    LONGLONG GetWrittenSize(const std::wstring& path)
+    {
+        // Only asking for attributes does not conflict with the writer's sharing mode.
+        HANDLE file = CreateFileW(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, 0, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return -1;
+        }
+
+        LARGE_INTEGER size = {};
+        GetFileSizeEx(file, &size);
+        CloseHandle(file);
+        return size.QuadPart;
+    }
+
+    // The Device Portal's MRC file API: lists, streams and deletes files, answering each request after latencyMS.
+    class StandInPortal
+    {
+    public:
+        StandInPortal() : listener(address)
+        {
+            listener.support(methods::GET, [this](http_request request) { Get(request); });
+            listener.support(methods::DEL, [this](http_request request) { Delete(request); });
+        }
+
+        bool Open()
+        {
+            try
+            {
+                listener.open().wait();
+                return true;
+            }
+            catch (const std::exception& e)
+            {
+                printf("    Could not start the Device Portal stand-in: %s\n", e.what());
+                return false;
+            }
+        }
+
+        // Every request has been answered once the downloader's tasks have completed.
+        ~StandInPortal()
+        {
+            listener.close().wait();
+        }
+
+        void AddFile(const std::wstring& fileName)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            // Encoded the way the Device Portal expects file names in queries.
+            std::wstring encodedFileName;
+            LPTSTR encodedString;
+            if (StringHelper::base64_encode(StringHelper::ws2s(fileName), encodedString))
+            {
+                encodedFileName = encodedString;
+                HeapFree(GetProcessHeap(), HEAP_NO_SERIALIZE, encodedString);
+            }
+            files.push_back(std::make_pair(encodedFileName, fileName));
+        }
+
+        bool IsEmpty()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return files.empty();
+        }
+
+        // The body of fileName is sent in two halves, and the second half is only sent once the first has reached path.
+        void StreamInHalves(const std::wstring& fileName, const std::wstring& path)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            streamedFileName = fileName;
+            streamedPath = path;
+        }
+
+        void ResetMaxInFlight()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            maxInFlight = 0;
+        }
+
+        int GetMaxInFlight()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return maxInFlight;
+        }
+
+        int GetNumDownloads(const std::wstring& fileName)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return numDownloads[fileName];
+        }
+
+        std::atomic<int> numListRequests{ 0 };
+        // Set once the first half of a streamed file was seen on disk before the second half was sent.
+        std::atomic<bool> streamedToDisk{ false };
+
+    private:
+        // Calls answer after latencyMS without blocking the listener.  The request counts as in flight until then.
+        void AfterLatency(std::function<void()> answer)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                numInFlight++;
+                maxInFlight = std::max(maxInFlight, numInFlight);
+            }
+
+            pplx::create_task([=]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(latencyMS));
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    numInFlight--;
+                }
+                answer();
+            });
+        }
+
+        // Name of the file a request is for, empty if it is not on the device.  lock must be held.
+        std::wstring FindFile(const http_request& request, bool erase)
+        {
+            auto query = uri::split_query(request.request_uri().query());
+            auto encodedFileName = query.find(U("filename"));
+            if (request.request_uri().path() != U("/api/holographic/mrc/file") || encodedFileName == query.end())
+            {
+                return std::wstring();
+            }
+
+            for (auto file = files.begin(); file != files.end(); file++)
+            {
+                if (file->first == uri::decode(encodedFileName->second))
+                {
+                    std::wstring fileName = file->second;
+                    if (erase)
+                    {
+                        files.erase(file);
+                    }
+                    return fileName;
+                }
+            }
+
+            return std::wstring();
+        }
+
+        void Get(http_request request)
+        {
+            AfterLatency([=]() mutable
+            {
+                if (request.request_uri().path() == U("/api/holographic/mrc/files"))
+                {
+                    json::value fileList = json::value::array();
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        for (size_t i = 0; i < files.size(); i++)
+                        {
+                            json::value entry;
+                            entry[U("FileName")] = json::value::string(files[i].second);
+                            fileList[i] = entry;
+                        }
+                    }
+
+                    json::value body;
+                    body[U("MrcRecordings")] = fileList;
+                    numListRequests++;
+                    request.reply(status_codes::OK, body);
+                    return;
+                }
+
+                std::wstring fileName, path;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    fileName = FindFile(request, false);
+                    numDownloads[fileName]++;
+                    path = fileName == streamedFileName ? streamedPath : std::wstring();
+                }
+
+                if (fileName.empty())
+                {
+                    request.reply(status_codes::NotFound);
+                    return;
+                }
+
+                std::vector<unsigned char> contents = GetFileContents(fileName);
+                if (path.empty())
+                {
+                    http_response response(status_codes::OK);
+                    response.set_body(contents);
+                    request.reply(response);
+                    return;
+                }
+
+                Stream(request, contents, path);
+            });
+        }
+
+        void Stream(http_request request, const std::vector<unsigned char>& contents, const std::wstring& path)
+        {
+            concurrency::streams::producer_consumer_buffer<uint8_t> body;
+            http_response response(status_codes::OK);
+            response.set_body(body.create_istream(), contents.size(), U("application/octet-stream"));
+            request.reply(response);
+
+            size_t half = contents.size() / 2;
+            body.putn_nocopy(contents.data(), half).wait();
+            body.sync().wait();
+
+            // A downloader that buffers the body in memory never writes the first half before it has the second.
+            auto start = std::chrono::steady_clock::now();
+            while (GetWrittenSize(path) < (LONGLONG)half && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            streamedToDisk = GetWrittenSize(path) >= (LONGLONG)half;
+
+            body.putn_nocopy(contents.data() + half, contents.size() - half).wait();
+            body.close(std::ios_base::out).wait();
+        }
+
+        void Delete(http_request request)
+        {
+            AfterLatency([=]() mutable
+            {
+                bool deleted = false;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    deleted = !FindFile(request, true).empty();
+                }
+
+                request.reply(deleted ? status_codes::OK : status_codes::NotFound);
+            });
+        }
+
+        web::http::experimental::listener::http_listener listener;
+
+        std::mutex lock;
+        // Files on the device, oldest first, as their encoded and plain names.
+        std::vector<std::pair<std::wstring, std::wstring>> files;
+        std::map<std::wstring, int> numDownloads;
+        std::wstring streamedFileName, streamedPath;
+        int numInFlight = 0;
+        int maxInFlight = 0;
+    };
+
+    std::wstring GetTestDirectory()
+    {
+        wchar_t tempPath[MAX_PATH];
+        GetTempPathW(MAX_PATH, tempPath);
+        std::wstring directory = std::wstring(tempPath) + L"MRCDownloaderTests\\";
+        CreateDirectoryW(directory.c_str(), nullptr);
+        return directory;
+    }
+
+    // Downloads and deletes every file, one request at a time and then concurrently.
+    bool BoundedConcurrency(const std::wstring& directory)
+    {
+        bool passed = true;
+
+        StandInPortal portal;
+        if (!portal.Open())
+        {
+            return false;
+        }
+
+        http_client client(address);
+        const int maxConcurrentRequests[] = { 1, MRC_MAX_CONCURRENT_REQUESTS };
+        double seconds[2] = {};
+        for (int run = 0; run < 2; run++)
+        {
+            for (int i = 0; i < numFiles; i++)
+            {
+                portal.AddFile(L"Photo" + std::to_wstring(i) + L".jpg");
+            }
+            portal.ResetMaxInFlight();
+
+            MRCDownloader downloader(&client, maxConcurrentRequests[run]);
+            auto start = std::chrono::steady_clock::now();
+
+            std::vector<std::wstring> fileNames = downloader.ListFiles().get();
+            std::vector<pplx::task<bool>> downloads;
+            for (size_t i = 0; i < fileNames.size(); i++)
+            {
+                downloads.push_back(downloader.Download(fileNames[i], directory + std::to_wstring(i) + L".jpg"));
+            }
+
+            std::vector<bool> downloaded = pplx::when_all(downloads.begin(), downloads.end()).get();
+            int numDeleted = downloader.DeleteAll().get();
+            seconds[run] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            CHECK((int)fileNames.size() == numFiles);
+            CHECK(std::count(downloaded.begin(), downloaded.end(), true) == numFiles);
+            CHECK(numDeleted == numFiles);
+            CHECK(portal.IsEmpty());
+            // Every slot is used, and never more.
+            CHECK(portal.GetMaxInFlight() == maxConcurrentRequests[run]);
+
+            for (size_t i = 0; i < fileNames.size(); i++)
+            {
+                CHECK(IsFileValid(directory + std::to_wstring(i) + L".jpg", fileNames[i]));
+                DeleteFileW((directory + std::to_wstring(i) + L".jpg").c_str());
+            }
+        }
+
+        printf("    %i files of %i KB with %i ms latency, one request at a time: %.0f ms, %i at a time: %.0f ms\n",
+            numFiles, (int)(fileSize / 1024), latencyMS, seconds[0] * 1000, MRC_MAX_CONCURRENT_REQUESTS, seconds[1] * 1000);
+        return passed;
+    }
+
+    bool StreamsToDisk(const std::wstring& directory)
+    {
+        bool passed = true;
+
+        StandInPortal portal;
+        if (!portal.Open())
+        {
+            return false;
+        }
+
+        http_client client(address);
+        MRCDownloader downloader(&client);
+
+        const std::wstring fileName = L"Streamed.jpg";
+        const std::wstring path = directory + fileName;
+        portal.AddFile(fileName);
+        portal.StreamInHalves(fileName, path);
+
+        CHECK(downloader.Download(fileName, path).get());
+        CHECK(portal.streamedToDisk);
+        CHECK(IsFileValid(path, fileName));
+        DeleteFileW(path.c_str());
+
+        // A failed download does not leave a file behind that could be mistaken for a photo.
+        const std::wstring missingPath = directory + L"Missing.jpg";
+        CHECK(!downloader.Download(L"Missing.jpg", missingPath).get());
+        CHECK(GetFileAttributesW(missingPath.c_str()) == INVALID_FILE_ATTRIBUTES);
+
+        return passed;
+    }
+
+    bool DownloadNewestClaimsEachPhoto(const std::wstring& directory)
+    {
+        bool passed = true;
+
+        StandInPortal portal;
+        if (!portal.Open())
+        {
+            return false;
+        }
+
+        http_client client(address);
+        MRCDownloader downloader(&client);
+
+        // Like the Calibration app, each photo is taken once the previous one has been looked for,
+        // so photos are taken while the previous ones are still downloading.
+        std::vector<pplx::task<bool>> photos;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < numFiles; i++)
+        {
+            int previousListRequests = portal.numListRequests;
+            portal.AddFile(L"Pipelined" + std::to_wstring(i) + L".jpg");
+            photos.push_back(downloader.DownloadNewest(directory + L"Pipelined" + std::to_wstring(i) + L".jpg"));
+            while (portal.numListRequests == previousListRequests)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        std::vector<bool> downloaded = pplx::when_all(photos.begin(), photos.end()).get();
+        double pipelinedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Every photo went to the file of the call that was made after it was taken.
+        CHECK(std::count(downloaded.begin(), downloaded.end(), true) == numFiles);
+        CHECK(portal.IsEmpty());
+        CHECK(portal.GetMaxInFlight() <= MRC_MAX_CONCURRENT_REQUESTS);
+        for (int i = 0; i < numFiles; i++)
+        {
+            std::wstring fileName = L"Pipelined" + std::to_wstring(i) + L".jpg";
+            CHECK(IsFileValid(directory + fileName, fileName));
+            CHECK(portal.GetNumDownloads(fileName) == 1);
+            DeleteFileW((directory + fileName).c_str());
+        }
+
+        // Of the photos that are new since the last call, only the newest is downloaded.  The older ones are only deleted.
+        portal.AddFile(L"Older.jpg");
+        portal.AddFile(L"Newer.jpg");
+        CHECK(downloader.DownloadNewest(directory + L"Newest.jpg").get());
+        CHECK(IsFileValid(directory + L"Newest.jpg", L"Newer.jpg"));
+        CHECK(portal.GetNumDownloads(L"Older.jpg") == 0);
+        CHECK(portal.IsEmpty());
+        DeleteFileW((directory + L"Newest.jpg").c_str());
+
+        // Nothing new, nothing to download.
+        CHECK(!downloader.DownloadNewest(directory + L"Nothing.jpg").get());
+        CHECK(GetFileAttributesW((directory + L"Nothing.jpg").c_str()) == INVALID_FILE_ATTRIBUTES);
+
+        printf("    %i photos taken while downloading: %.0f ms\n", numFiles, pipelinedSeconds * 1000);
+        return passed;
+    }
+}
+
+bool MRCDownloaderTests()
+{
+    bool passed = true;
+    std::wstring directory = GetTestDirectory();
+
+    CHECK(BoundedConcurrency(directory));
+    CHECK(StreamsToDisk(directory));
+    CHECK(DownloadNewestClaimsEachPhoto(directory));
+
+    RemoveDirectoryW(directory.c_str());
+    return passed;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Unit tests for the Calibration app's code that does not need a camera or a HoloLens, from a command prompt:
+//   CalibrationTests           runs every test, the exit code is the number of tests that failed
+//   CalibrationTests <test>    runs one test
+
+#include "CalibrationTests.h"
+
+#include <chrono>
+
+namespace
+{
+    struct Test
+    {
+        const wchar_t* name;
+        bool(*run)();
+    };
+
+    const Test tests[] =
+    {
+        { L"MRCDownloader", MRCDownloaderTests },
+    };
+
+    int Usage()
+    {
+        printf("Usage: CalibrationTests [test]\n\nTests:\n");
+        for (const Test& test : tests)
+        {
+            printf("  %ls\n", test.name);
+        }
+        return -1;
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    int numRun = 0;
+    int numFailed = 0;
+    for (const Test& test : tests)
+    {
+        if (argc >= 2 && _wcsicmp(argv[1], test.name) != 0)
+        {
+            continue;
+        }
+
+        printf("%ls\n", test.name);
+        auto start = std::chrono::steady_clock::now();
+        bool passed = test.run();
+        printf("  %s (%.0f ms)\n", passed ? "passed" : "FAILED",
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+        numRun++;
+        numFailed += passed ? 0 : 1;
+    }
+
+    if (numRun == 0)
+    {
+        return Usage();
+    }
+
+    printf("\n%i of %i tests passed.\n", numRun - numFailed, numRun);
+    return numFailed;
+}
@@ -0,0 +1,345 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Headless calibration from the photo pairs the Calibration app saved (N_cam.png and N_holo.jpg).
+// Chessboards are detected in parallel and the corners are cached next to the photos, so the calibration can be re-run with other options
+// without detecting them again.  Writes the same CalibrationData.txt as the Calibration app.
+//
+// Only depends on OpenCV.  Builds from the Calibration sln, or with the CMakeLists.txt next to this file elsewhere.
+
+#include "ChessBoardDetector.h"
+#include "StereoCalibration.h"
+#include "IncrementalCalibration.h"
+#include "CornerCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//TODO: Update with the 3.x version of OpenCV you are using.
+#if defined(_MSC_VER) && _DEBUG
+#pragma comment(lib, "opencv_world341d")
+#endif
+#if defined(_MSC_VER) && !_DEBUG
+#pragma comment(lib, "opencv_world341")
+#endif
+
+// Defaults match stdafx.h in the Calibration project.
+#define DEFAULT_GRID_CELLS_X 6
+#define DEFAULT_GRID_CELLS_Y 4
+#define DEFAULT_CHESS_SQUARE_SIZE 0.0677
+#define DEFAULT_HOLO_WIDTH 1408
+#define DEFAULT_HOLO_HEIGHT 792
+
+#define CORNER_CACHE_FILE "CalibrationCorners.bin"
+#define CALIBRATION_FILE "CalibrationData.txt"
+
+// One image of a photo pair.
+class Photo
+{
+public:
+    std::string path;
+    // Camera photos are scaled to the HoloLens resolution before detection, like in the Calibration app.
+    bool camera = false;
+    bool exists = false;
+    bool cached = false;
+    bool found = false;
+    uint64_t hash = 0;
+    std::vector<cv::Point2f> corners;
+    double seconds = 0;
+};
+
+static void PrintUsage()
+{
+    std::cout <<
+        "Usage: CalibrationTool <photo directory> [options]\n"
+        "  --output <file>              Calibration file to write.  Default: <photo directory>/" CALIBRATION_FILE "\n"
+        "  --cache <file>               Corner cache.  Default: <photo directory>/" CORNER_CACHE_FILE "\n"
+        "  --no-cache                   Detect every chessboard again, and do not write the cache.\n"
+        "  --board <columns>x<rows>     Cells in the chessboard.  Default: 6x4\n"
+        "  --square <meters>            Width of the chessboard squares.  Default: 0.0677\n"
+        "  --size <width>x<height>      HoloLens photo resolution.  Default: 1408x792\n"
+        "  --search-width <pixels>      Width chessboards are first searched for at, 0 for full resolution.  Default: 640\n"
+        "  --focal-length <meters>      Known camera lens focal length.  Requires --sensor.\n"
+        "  --sensor <width>x<height>    Known camera sensor size in meters, eg: 0.036x0.024\n"
+        "  --fix-focal-length           Keep the known focal length.\n"
+        "  --fix-principal-point        Keep the camera's principal point at the center of the image.\n"
+        "  --fix-aspect-ratio           Keep the aspect ratio of both cameras' focal lengths.\n"
+        "  --zero-tangent               Assume there is no tangential distortion in either camera.\n"
+        "  --fix-k3                     Do not estimate the third radial distortion coefficient of either camera.\n"
+        "  --incremental [views]        Replay the usable pairs one at a time through the running calibration the Calibration app shows,\n"
+        "                               and time each solve against a full calibration of the same pairs.  Default working set: 20\n";
+}
+
+static bool ReadFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream)
+    {
+        return false;
+    }
+
+    bytes.resize((size_t)stream.tellg());
+    stream.seekg(0);
+    return (bool)stream.read((char*)bytes.data(), bytes.size());
+}
+
+static bool FileExists(const std::string& path)
+{
+    return (bool)std::ifstream(path);
+}
+
+static double GetSeconds(int64 start)
+{
+    return (double)(cv::getTickCount() - start) / cv::getTickFrequency();
+}
+
+// Add the pairs to an IncrementalCalibration one at a time, solving after each, like the Calibration app does while pictures are taken.
+// Each solve is compared with a full StereoCalibration of every pair added so far.
+static void ReplayIncremental(const std::vector<std::vector<cv::Point2f>>& colorImagePoints,
+    const std::vector<std::vector<cv::Point2f>>& holoImagePoints, const StereoCalibration::Options& options, int maxViews)
+{
+    IncrementalCalibration incremental(options, maxViews);
+    double totalIncrementalSeconds = 0, totalBatchSeconds = 0;
+
+    printf("Pairs  Incremental ms  Views  RMS        Uncertainty  |  Batch ms  RMS\n");
+    for (size_t i = 0; i < colorImagePoints.size(); i++)
+    {
+        incremental.Add(colorImagePoints[i], holoImagePoints[i]);
+        bool solved = incremental.Solve();
+        const IncrementalCalibration::Stats& stats = incremental.GetStats();
+        if (solved)
+        {
+            totalIncrementalSeconds += stats.solveSeconds;
+        }
+
+        std::vector<std::vector<cv::Point2f>> colorPoints(colorImagePoints.begin(), colorImagePoints.begin() + i + 1);
+        std::vector<std::vector<cv::Point2f>> holoPoints(holoImagePoints.begin(), holoImagePoints.begin() + i + 1);
+        int64 start = cv::getTickCount();
+        StereoCalibration batch;
+        batch.Calibrate(colorPoints, holoPoints, options);
+        double batchSeconds = GetSeconds(start);
+        totalBatchSeconds += batchSeconds;
+
+        if (solved)
+        {
+            printf("%5d  %14.1f  %5d  %9.6f  %10.3f%%  |  %8.1f  %9.6f%s\n", (int)i + 1, stats.solveSeconds * 1000, stats.numWorkingViews,
+                stats.rms, stats.GetUncertainty() * 100, batchSeconds * 1000, batch.rms, stats.IsConverged() ? "  converged" : "");
+        }
+        else
+        {
+            printf("%5d  %14s  %5s  %9s  %11s  |  %8.1f  %9.6f\n", (int)i + 1, "-", "-", "-", "-", batchSeconds * 1000, batch.rms);
+        }
+    }
+
+    printf("Incremental solves took %.1f ms in total, batch calibrations %.1f ms.\n", totalIncrementalSeconds * 1000, totalBatchSeconds * 1000);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string directory = argv[1];
+    if (directory.back() != '/' && directory.back() != '\\')
+    {
+        directory += "/";
+    }
+
+    std::string outputPath = directory + CALIBRATION_FILE;
+    std::string cachePath = directory + CORNER_CACHE_FILE;
+    bool useCache = true;
+    int incrementalViews = 0;
+    int cellsX = DEFAULT_GRID_CELLS_X, cellsY = DEFAULT_GRID_CELLS_Y;
+    int searchWidth = CHESSBOARD_SEARCH_WIDTH;
+    cv::Size imageSize(DEFAULT_HOLO_WIDTH, DEFAULT_HOLO_HEIGHT);
+    StereoCalibration::Options options(cv::Size(), DEFAULT_CHESS_SQUARE_SIZE, imageSize);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        // Options with a value take the next argument.
+        auto next = [&]() { return i + 1 < argc ? argv[++i] : ""; };
+        bool valid = true;
+
+        if (arg == "--no-cache") { useCache = false; }
+        else if (arg == "--fix-focal-length") { options.fixFocalLength = true; }
+        else if (arg == "--fix-principal-point") { options.fixPrincipalPoint = true; }
+        else if (arg == "--fix-aspect-ratio") { options.colorFlags |= cv::CALIB_FIX_ASPECT_RATIO; options.holoFlags |= cv::CALIB_FIX_ASPECT_RATIO; }
+        else if (arg == "--zero-tangent") { options.colorFlags |= cv::CALIB_ZERO_TANGENT_DIST; options.holoFlags |= cv::CALIB_ZERO_TANGENT_DIST; }
+        else if (arg == "--fix-k3") { options.colorFlags |= cv::CALIB_FIX_K3; options.holoFlags |= cv::CALIB_FIX_K3; }
+        else if (arg == "--output") { outputPath = next(); valid = !outputPath.empty(); }
+        else if (arg == "--cache") { cachePath = next(); valid = !cachePath.empty(); }
+        else if (arg == "--board") { valid = sscanf(next(), "%dx%d", &cellsX, &cellsY) == 2 && cellsX > 3 && cellsY > 3; }
+        else if (arg == "--square") { valid = sscanf(next(), "%lf", &options.squareSize) == 1 && options.squareSize > 0; }
+        else if (arg == "--size") { valid = sscanf(next(), "%dx%d", &imageSize.width, &imageSize.height) == 2 && imageSize.area() > 0; }
+        else if (arg == "--search-width") { valid = sscanf(next(), "%d", &searchWidth) == 1 && searchWidth >= 0; }
+        else if (arg == "--focal-length") { valid = sscanf(next(), "%lf", &options.focalLength) == 1 && options.focalLength > 0; }
+        else if (arg == "--incremental")
+        {
+            incrementalViews = INCREMENTAL_CALIBRATION_VIEWS;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                valid = sscanf(next(), "%d", &incrementalViews) == 1 && incrementalViews >= INCREMENTAL_CALIBRATION_MIN_VIEWS;
+            }
+        }
+        else if (arg == "--sensor") { valid = sscanf(next(), "%lfx%lf", &options.sensorWidth, &options.sensorHeight) == 2 && options.sensorWidth > 0 && options.sensorHeight > 0; }
+        else { valid = false; }
+
+        if (!valid)
+        {
+            std::cerr << "ERROR: Invalid option " << arg << "\n";
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.focalLength > 0 && (options.sensorWidth <= 0 || options.sensorHeight <= 0))
+    {
+        std::cerr << "ERROR: --focal-length requires --sensor.\n";
+        return 1;
+    }
+
+    // Interior corners.
+    options.boardDimensions = cv::Size(cellsX - 1, cellsY - 1);
+    options.imageSize = imageSize;
+
+    // Photo pairs are numbered from 0 with no gaps.
+    std::vector<Photo> photos;
+    for (int i = 0; FileExists(directory + std::to_string(i) + "_cam.png"); i++)
+    {
+        Photo camera, holo;
+        camera.path = directory + std::to_string(i) + "_cam.png";
+        camera.camera = true;
+        holo.path = directory + std::to_string(i) + "_holo.jpg";
+        photos.push_back(camera);
+        photos.push_back(holo);
+    }
+
+    int numPairs = (int)photos.size() / 2;
+    if (numPairs == 0)
+    {
+        std::cerr << "ERROR: No calibration photos in " << directory << "\n";
+        return 2;
+    }
+
+    ChessBoardDetector detector(options.boardDimensions, searchWidth);
+    CornerCache cache(options.boardDimensions, searchWidth, imageSize);
+    if (useCache && cache.Load(cachePath))
+    {
+        std::cout << "Loaded " << cache.GetSize() << " photos from " << cachePath << "\n";
+    }
+
+    // Every image is independent, so all of them are hashed and searched at the same time.
+    int64 start = cv::getTickCount();
+    cv::parallel_for_(cv::Range(0, (int)photos.size()), [&](const cv::Range& range)
+    {
+        for (int i = range.start; i < range.end; i++)
+        {
+            Photo& photo = photos[i];
+            int64 photoStart = cv::getTickCount();
+
+            std::vector<unsigned char> bytes;
+            photo.exists = ReadFile(photo.path, bytes);
+            if (!photo.exists)
+            {
+                continue;
+            }
+
+            photo.hash = CornerCache::Hash(bytes);
+            photo.cached = useCache && cache.Find(photo.hash, photo.found, photo.corners);
+            if (!photo.cached)
+            {
+                cv::Mat image = cv::imdecode(bytes, cv::IMREAD_UNCHANGED);
+                if (photo.camera && !image.empty())
+                {
+                    cv::resize(image, image, imageSize, 0, 0, cv::INTER_AREA);
+                }
+
+                photo.found = detector.Detect(image, photo.corners);
+            }
+
+            photo.seconds = GetSeconds(photoStart);
+        }
+    });
+    double detectionSeconds = GetSeconds(start);
+
+    // Added in order, so the calibration does not depend on which photo finished first.
+    std::vector<std::vector<cv::Point2f>> colorImagePoints, holoImagePoints;
+    int numDetected = 0;
+    for (int i = 0; i < numPairs; i++)
+    {
+        Photo& camera = photos[i * 2];
+        Photo& holo = photos[i * 2 + 1];
+        for (Photo* photo : { &camera, &holo })
+        {
+            if (!photo->exists)
+            {
+                std::cout << "ERROR: " << photo->path << " not found.\n";
+                continue;
+            }
+
+            if (!photo->cached)
+            {
+                cache.Add(photo->hash, photo->found, photo->corners);
+                numDetected++;
+            }
+
+            if (!photo->found)
+            {
+                std::cout << "ERROR: Chess board not found in " << photo->path << (photo->cached ? " (cached).\n" : ".\n");
+            }
+        }
+
+        printf("Pair %d: camera %.1f ms%s, HoloLens %.1f ms%s\n", i,
+            camera.seconds * 1000, camera.cached ? " cached" : "", holo.seconds * 1000, holo.cached ? " cached" : "");
+
+        if (camera.found && holo.found)
+        {
+            colorImagePoints.push_back(camera.corners);
+            holoImagePoints.push_back(holo.corners);
+        }
+    }
+
+    printf("Processed %d pairs in %.1f ms, %d photos detected, %d cached, %d pairs usable.\n", numPairs, detectionSeconds * 1000,
+        numDetected, (int)photos.size() - numDetected, (int)colorImagePoints.size());
+
+    if (useCache && numDetected > 0 && !cache.Save(cachePath))
+    {
+        std::cerr << "ERROR: Could not write " << cachePath << "\n";
+    }
+
+    if (incrementalViews > 0)
+    {
+        ReplayIncremental(colorImagePoints, holoImagePoints, options, incrementalViews);
+    }
+
+    start = cv::getTickCount();
+    StereoCalibration calibration;
+    if (!calibration.Calibrate(colorImagePoints, holoImagePoints, options))
+    {
+        std::cerr << "ERROR: Please take some valid chess board images before calibration.\n";
+        return 2;
+    }
+    double calibrationSeconds = GetSeconds(start);
+
+    std::ofstream calibrationfs(outputPath, std::ios::trunc);
+    calibration.Write(calibrationfs, numPairs);
+    calibrationfs.close();
+    if (!calibrationfs)
+    {
+        std::cerr << "ERROR: Could not write " << outputPath << "\n";
+        return 2;
+    }
+
+    printf("Calibrated in %.1f ms: stereo RMS %f, camera RMS %f, HoloLens RMS %f.  Wrote %s\n", calibrationSeconds * 1000,
+        calibration.rms, calibration.colorRMS, calibration.holoRMS, outputPath.c_str());
+
+    return 0;
+}
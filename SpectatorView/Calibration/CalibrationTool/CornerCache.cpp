@@ -0,0 +1,136 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "CornerCache.h"
+
+#include <cstring>
+#include <fstream>
+
+#define CORNER_CACHE_MAGIC "SVCC"
+#define CORNER_CACHE_VERSION 1
+
+CornerCache::CornerCache(cv::Size boardDimensions, int searchWidth, cv::Size imageSize)
+{
+    settings[0] = boardDimensions.width;
+    settings[1] = boardDimensions.height;
+    settings[2] = searchWidth;
+    settings[3] = imageSize.width;
+    settings[4] = imageSize.height;
+}
+
+template <typename T>
+static bool Read(std::ifstream& stream, T& value)
+{
+    return (bool)stream.read((char*)&value, sizeof(T));
+}
+
+template <typename T>
+static void Write(std::ofstream& stream, const T& value)
+{
+    stream.write((const char*)&value, sizeof(T));
+}
+
+bool CornerCache::Load(const std::string& path)
+{
+    entries.clear();
+
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+    {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    int32_t fileSettings[5];
+    uint32_t numEntries = 0;
+    if (!stream.read(magic, sizeof(magic)) || memcmp(magic, CORNER_CACHE_MAGIC, sizeof(magic)) != 0 ||
+        !Read(stream, version) || version != CORNER_CACHE_VERSION ||
+        !Read(stream, fileSettings) || memcmp(fileSettings, settings, sizeof(settings)) != 0 ||
+        !Read(stream, numEntries))
+    {
+        return false;
+    }
+
+    // Every board has the same number of corners, anything else is a corrupt file.
+    const uint32_t numBoardCorners = (uint32_t)(settings[0] * settings[1]);
+    for (uint32_t i = 0; i < numEntries; i++)
+    {
+        uint64_t hash = 0;
+        uint8_t found = 0;
+        uint32_t numCorners = 0;
+        if (!Read(stream, hash) || !Read(stream, found) || !Read(stream, numCorners) ||
+            (numCorners != 0 && numCorners != numBoardCorners))
+        {
+            entries.clear();
+            return false;
+        }
+
+        Entry& entry = entries[hash];
+        entry.found = found != 0;
+        entry.corners.resize(numCorners);
+        if (numCorners > 0 && !stream.read((char*)entry.corners.data(), numCorners * sizeof(cv::Point2f)))
+        {
+            entries.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CornerCache::Save(const std::string& path) const
+{
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream)
+    {
+        return false;
+    }
+
+    stream.write(CORNER_CACHE_MAGIC, 4);
+    Write(stream, (uint32_t)CORNER_CACHE_VERSION);
+    Write(stream, settings);
+    Write(stream, (uint32_t)entries.size());
+
+    for (const auto& entry : entries)
+    {
+        Write(stream, entry.first);
+        Write(stream, (uint8_t)(entry.second.found ? 1 : 0));
+        Write(stream, (uint32_t)entry.second.corners.size());
+        stream.write((const char*)entry.second.corners.data(), entry.second.corners.size() * sizeof(cv::Point2f));
+    }
+
+    return (bool)stream;
+}
+
+bool CornerCache::Find(uint64_t hash, bool& found, std::vector<cv::Point2f>& corners) const
+{
+    auto entry = entries.find(hash);
+    if (entry == entries.end())
+    {
+        return false;
+    }
+
+    found = entry->second.found;
+    corners = entry->second.corners;
+    return true;
+}
+
+void CornerCache::Add(uint64_t hash, bool found, const std::vector<cv::Point2f>& corners)
+{
+    Entry& entry = entries[hash];
+    entry.found = found;
+    entry.corners = found ? corners : std::vector<cv::Point2f>();
+}
+
+uint64_t CornerCache::Hash(const std::vector<unsigned char>& bytes)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char byte : bytes)
+    {
+        hash ^= byte;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,50 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include "opencv2/opencv.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Chessboard corners found in calibration photos, keyed by a hash of the photo file's contents.
+// Photos that are already in the cache do not need to be decoded or searched again, so a calibration can be re-run with other options in milliseconds.
+//
+// The cache is a little endian binary file:
+//   "SVCC", version, board width, board height, search width, image width, image height, number of entries (uint32 / int32 each)
+//   Each entry: hash (uint64), found (uint8), number of corners (uint32), corners (float x, y)
+// A cache written with other detection settings is ignored, since its corners would not match.
+class CornerCache
+{
+public:
+    // The settings the corners were detected with.  imageSize is the size camera photos are scaled to before detection.
+    CornerCache(cv::Size boardDimensions, int searchWidth, cv::Size imageSize);
+
+    // Returns false if the file does not exist, is invalid, or was written with other settings.  The cache is empty then.
+    bool Load(const std::string& path);
+    bool Save(const std::string& path) const;
+
+    // Returns false if the photo is not in the cache.  found is false for photos without a chessboard, which are cached too.
+    bool Find(uint64_t hash, bool& found, std::vector<cv::Point2f>& corners) const;
+    void Add(uint64_t hash, bool found, const std::vector<cv::Point2f>& corners);
+
+    size_t GetSize() const { return entries.size(); }
+
+    // 64 bit FNV-1a.
+    static uint64_t Hash(const std::vector<unsigned char>& bytes);
+
+private:
+    class Entry
+    {
+    public:
+        bool found;
+        std::vector<cv::Point2f> corners;
+    };
+
+    // Detection settings, in the order they are stored.
+    int32_t settings[5];
+    std::unordered_map<uint64_t, Entry> entries;
+};
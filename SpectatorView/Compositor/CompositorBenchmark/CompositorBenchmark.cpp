@@ -0,0 +1,353 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "CompositorBenchmark.h"
+#include <algorithm>
+#include <fstream>
+#include <random>
+
+ID3D11Device* CompositorBenchmark::CreateDevice()
+{
+    ID3D11Device* device = nullptr;
+
+    // Fall back to the software rasterizer on machines without a GPU (eg: build agents).
+    D3D_DRIVER_TYPE driverTypes[] = { D3D_DRIVER_TYPE_HARDWARE, D3D_DRIVER_TYPE_WARP };
+    for (D3D_DRIVER_TYPE driverType : driverTypes)
+    {
+        if (SUCCEEDED(D3D11CreateDevice(NULL, driverType, NULL, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+            NULL, 0, D3D11_SDK_VERSION, &device, NULL, NULL)))
+        {
+            return device;
+        }
+    }
+
+    return nullptr;
+}
+
+bool CompositorBenchmark::Run(IFrameProvider* frameProvider, const Options& options)
+{
+    if (frameProvider == nullptr)
+    {
+        return false;
+    }
+
+    ID3D11Device* device = CreateDevice();
+    if (device == nullptr)
+    {
+        fwprintf(stderr, L"ERROR: Could not create a device for the compositor benchmark.\n");
+        return false;
+    }
+
+    // Stand-ins for the textures Unity creates.
+    ID3D11Texture2D* colorTexture = DirectXHelper::CreateTexture(device, FRAME_WIDTH, FRAME_HEIGHT, FRAME_BPP);
+    ID3D11Texture2D* videoTexture = DirectXHelper::CreateTexture(device, FRAME_WIDTH, FRAME_HEIGHT, FRAME_BPP);
+    ID3D11ShaderResourceView* colorSRV = nullptr;
+    if (colorTexture != nullptr)
+    {
+        colorSRV = DirectXHelper::CreateShaderResourceView(device, colorTexture);
+    }
+
+    CompositorInterface* ci = new CompositorInterface(frameProvider);
+    bool succeeded = colorSRV != nullptr && videoTexture != nullptr &&
+        ci->Initialize(device, colorSRV, videoTexture);
+
+    LARGE_INTEGER freq, start, stageStart, stageEnd, recordStart;
+    QueryPerformanceFrequency(&freq);
+
+    bool encode = succeeded && (options.record || options.replay) && ci->InitializeVideoEncoder(device);
+    bool record = encode && options.record;
+    if (record)
+    {
+        QueryPerformanceCounter(&recordStart);
+        if (options.renditions)
+        {
+            ci->StartRecording(COMPOSITOR_BENCHMARK_RENDITIONS);
+        }
+        else
+        {
+            ci->StartRecording();
+        }
+    }
+    bool replay = encode && options.replay && ci->StartReplay(0, 0);
+
+    Stage frameProviderStage(L"Frame provider update");
+    Stage poseStage(L"Pose lookup");
+    Stage recordingStage(L"Recording readback");
+    Stage audioStage(L"Audio queue");
+
+    static BYTE silence[AUDIO_BUFSIZE] = { 0 };
+    LONGLONG audioBytesPerSecond = AUDIO_SAMPLE_RATE * AUDIO_CHANNELS * 2;
+    LONGLONG audioBytesQueued = 0;
+
+    QueryPerformanceCounter(&start);
+
+    int numFrames = 0;
+    for (; succeeded && numFrames < options.numFrames; numFrames++)
+    {
+        LONGLONG frameTimeHNS = numFrames * ci->GetColorDuration();
+        float frameTime = (float)frameTimeHNS / S2HNS;
+
+        // Walk the camera in a circle so pose interpolation has real work to do.
+        XMFLOAT3 position(sinf(frameTime), 1.6f, cosf(frameTime));
+        XMFLOAT4 rotation(0, sinf(frameTime / 2), 0, cosf(frameTime / 2));
+
+        QueryPerformanceCounter(&stageStart);
+        ci->UpdateFrameProvider();
+        QueryPerformanceCounter(&stageEnd);
+        frameProviderStage.Add(stageEnd.QuadPart - stageStart.QuadPart);
+
+        stageStart = stageEnd;
+        ci->AddPoseToPoseCache(position, rotation, frameTime);
+        ci->GetPose(position, rotation, 0);
+        QueryPerformanceCounter(&stageEnd);
+        poseStage.Add(stageEnd.QuadPart - stageStart.QuadPart);
+
+        if (record || replay)
+        {
+            stageStart = stageEnd;
+            ci->UpdateVideoRecordingFrame(videoTexture);
+            QueryPerformanceCounter(&stageEnd);
+            recordingStage.Add(stageEnd.QuadPart - stageStart.QuadPart);
+        }
+
+        if (record)
+        {
+#if ENCODE_AUDIO
+            // Queue as much audio as this frame covers.
+            stageStart = stageEnd;
+            LONGLONG audioBytes = ((frameTimeHNS + ci->GetColorDuration()) * audioBytesPerSecond) / S2HNS;
+            for (; audioBytesQueued < audioBytes; audioBytesQueued += AUDIO_BUFSIZE)
+            {
+                // Stamp audio with the time it would have arrived at if frames were composited in real time, so it stays in sync with the video.
+                LONGLONG arrivalTime = recordStart.QuadPart + ((audioBytesQueued + AUDIO_BUFSIZE) * freq.QuadPart) / audioBytesPerSecond;
+                ci->RecordAudioFrameAsync(silence, arrivalTime);
+            }
+            QueryPerformanceCounter(&stageEnd);
+            audioStage.Add(stageEnd.QuadPart - stageStart.QuadPart);
+#endif
+        }
+
+        ci->Update();
+    }
+
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+
+    int captureFrameIndex = ci->GetCaptureFrameIndex();
+    int compositeFrameIndex = ci->GetCurrentCompositeFrame();
+
+    // Stopping flushes whatever the encoder has queued.
+    LONGLONG stopTime = 0;
+    int videoQueueDepth = 0, audioQueueDepth = 0, videoFramesDropped = 0, audioFramesDropped = 0;
+    std::vector<VideoEncoder::RenditionStats> renditions;
+    if (record)
+    {
+        QueryPerformanceCounter(&stageStart);
+        ci->StopRecording();
+        QueryPerformanceCounter(&stageEnd);
+        stopTime = stageEnd.QuadPart - stageStart.QuadPart;
+
+        ci->GetRecordingQueueStats(videoQueueDepth, audioQueueDepth, videoFramesDropped, audioFramesDropped);
+        renditions = ci->GetRenditionStats();
+    }
+
+    // Saving a replay should return straight away, stopping waits for it to be written.
+    LONGLONG saveReplayTime = 0, stopReplayTime = 0;
+    if (replay)
+    {
+        QueryPerformanceCounter(&stageStart);
+        ci->SaveReplay();
+        QueryPerformanceCounter(&stageEnd);
+        saveReplayTime = stageEnd.QuadPart - stageStart.QuadPart;
+
+        stageStart = stageEnd;
+        ci->StopReplay();
+        QueryPerformanceCounter(&stageEnd);
+        stopReplayTime = stageEnd.QuadPart - stageStart.QuadPart;
+    }
+
+    std::wstring outputPath = ci->GetOutputPath();
+    ci->StopFrameProvider();
+    delete ci;
+
+    SafeRelease(colorSRV);
+    SafeRelease(colorTexture);
+    SafeRelease(videoTexture);
+    SafeRelease(device);
+
+    if (!succeeded)
+    {
+        fwprintf(stderr, L"ERROR: Could not initialize the frame provider for the compositor benchmark.\n");
+        return false;
+    }
+
+    double seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+    auto toMS = [&](LONGLONG time) { return std::to_wstring((double)time * 1000.0 / freq.QuadPart); };
+
+    std::wstring report = L"Compositor benchmark: " + std::to_wstring(numFrames) + L" frames in " + std::to_wstring(seconds) + L" s (" +
+        std::to_wstring(numFrames / seconds) + L" fps), last capture frame: " + std::to_wstring(captureFrameIndex) +
+        L", last composite frame: " + std::to_wstring(compositeFrameIndex) + L"\n";
+
+    for (const Stage* stage : { &frameProviderStage, &poseStage, &recordingStage, &audioStage })
+    {
+        if (stage->count > 0)
+        {
+            report += std::wstring(L"  ") + stage->name + L" avg: " + toMS(stage->totalTime / stage->count) +
+                L" ms, max: " + toMS(stage->maxTime) + L" ms\n";
+        }
+    }
+
+    if (record)
+    {
+        report += L"  Stop recording: " + toMS(stopTime) + L" ms, video frames dropped: " + std::to_wstring(videoFramesDropped) +
+            L", audio frames dropped: " + std::to_wstring(audioFramesDropped) + L"\n";
+    }
+
+    // Scaling is split across cores on the video's encoder thread, encoding is on the rendition's own thread.
+    for (const VideoEncoder::RenditionStats& rendition : renditions)
+    {
+        report += L"  Rendition " + std::to_wstring(rendition.width) + L"x" + std::to_wstring(rendition.height) +
+            L": " + std::to_wstring(rendition.videoFramesEncoded) + L" frames, dropped: " + std::to_wstring(rendition.videoFramesDropped) +
+            L", scaling: " + std::to_wstring(rendition.resampleMS) + L" ms, encoder thread CPU: " + std::to_wstring(rendition.encoderCPUMS) +
+            L" ms per frame, " + (rendition.endOffsetHNS == 0 ? std::wstring(L"aligned with the video\n") :
+                L"ends " + std::to_wstring(rendition.endOffsetHNS / MS2HNS) + L" ms after the video\n");
+    }
+
+    if (replay)
+    {
+        report += L"  Save replay: " + toMS(saveReplayTime) + L" ms, until written: " + toMS(stopReplayTime) + L" ms\n";
+    }
+
+    Report(outputPath, report);
+    return true;
+}
+
+bool CompositorBenchmark::WriteSyntheticCaptureFile(LPCWSTR path, int numFrames)
+{
+    SyntheticFrameProvider frameProvider(FRAME_WIDTH, FRAME_HEIGHT, SYNTHETIC_FRAME_FPS, SYNTHETIC_FRAME_JITTER_MS, false);
+    frameProvider.Initialize(nullptr);
+
+    CaptureFileWriter writer;
+    if (!writer.Open(path, FRAME_WIDTH, FRAME_HEIGHT, frameProvider.GetFrameSize(), frameProvider.OutputYUV(), frameProvider.GetDurationHNS()))
+    {
+        fwprintf(stderr, L"ERROR: Could not create capture file.\n");
+        return false;
+    }
+
+    for (int i = 0; i < numFrames; i++)
+    {
+        // Each update captures one frame.
+        frameProvider.Update(0);
+
+        int frame = frameProvider.GetCaptureFrameIndex();
+        if (!writer.WriteFrame(frameProvider.GetFrameBytes(frame), frameProvider.GetTimestamp(frame)))
+        {
+            fwprintf(stderr, L"ERROR: Could not write to capture file.\n");
+            return false;
+        }
+    }
+
+    writer.Close();
+    frameProvider.Dispose();
+    return true;
+}
+
+bool CompositorBenchmark::RunPictures(int numPictures)
+{
+    wchar_t tempPath[MAX_PATH];
+    GetTempPathW(MAX_PATH, tempPath);
+
+    // A gradient with sensor-like noise, so compression does realistic work.
+    std::vector<BYTE> image(FRAME_WIDTH * FRAME_HEIGHT * 4);
+    std::mt19937 random(0);
+    std::uniform_int_distribution<int> noise(-8, 8);
+    auto clamp = [](int value) { return (BYTE)std::min(std::max(value, 0), 255); };
+    for (int y = 0; y < FRAME_HEIGHT; y++)
+    {
+        for (int x = 0; x < FRAME_WIDTH; x++)
+        {
+            BYTE* pixel = &image[(y * FRAME_WIDTH + x) * 4];
+            pixel[0] = clamp((x * 255) / FRAME_WIDTH + noise(random));
+            pixel[1] = clamp((y * 255) / FRAME_HEIGHT + noise(random));
+            pixel[2] = clamp(128 + noise(random));
+            pixel[3] = 255;
+        }
+    }
+
+    struct Configuration
+    {
+        LPCWSTR name;
+        PictureEncoder::Format format;
+        bool fastCompression;
+    };
+
+    const Configuration configurations[] =
+    {
+        { L"PNG", PictureEncoder::Format::PNG, false },
+        { L"PNG (fast)", PictureEncoder::Format::PNG, true },
+        { L"JPEG", PictureEncoder::Format::JPEG, false },
+        { L"JPEG (fast)", PictureEncoder::Format::JPEG, true },
+    };
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    std::wstring report;
+    for (const Configuration& configuration : configurations)
+    {
+        PictureEncoder pictureEncoder(FRAME_WIDTH, FRAME_HEIGHT);
+        pictureEncoder.SetFormat(configuration.format, configuration.fastCompression);
+        LPCWSTR extension = configuration.format == PictureEncoder::Format::JPEG ? L".jpg" : L".png";
+
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+
+        LONGLONG waitTime = 0;
+        for (int i = 0; i < numPictures; i++)
+        {
+            // Stands in for the render thread's readback: take a buffer, fill it and hand it off.
+            LARGE_INTEGER waitStart, waitEnd;
+            QueryPerformanceCounter(&waitStart);
+            BYTE* buffer = pictureEncoder.GetFreeBuffer();
+            while (buffer == nullptr)
+            {
+                Sleep(1);
+                buffer = pictureEncoder.GetFreeBuffer();
+            }
+            QueryPerformanceCounter(&waitEnd);
+            waitTime += waitEnd.QuadPart - waitStart.QuadPart;
+
+            memcpy(buffer, image.data(), image.size());
+            pictureEncoder.QueuePicture(buffer, std::wstring(tempPath) + L"PictureBenchmark_" + std::to_wstring(i) + extension);
+        }
+
+        pictureEncoder.WaitForIdle();
+        QueryPerformanceCounter(&end);
+
+        double seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+        report += std::wstring(configuration.name) + L" burst of " + std::to_wstring(numPictures) + L" pictures: " +
+            std::to_wstring(numPictures / seconds) + L" pictures/s, waiting for a free buffer: " +
+            std::to_wstring((double)waitTime * 1000.0 / freq.QuadPart / numPictures) + L" ms per picture\n";
+    }
+
+    for (int i = 0; i < numPictures; i++)
+    {
+        DeleteFileW((std::wstring(tempPath) + L"PictureBenchmark_" + std::to_wstring(i) + L".png").c_str());
+        DeleteFileW((std::wstring(tempPath) + L"PictureBenchmark_" + std::to_wstring(i) + L".jpg").c_str());
+    }
+
+    Report(L"", report);
+    return true;
+}
+
+void CompositorBenchmark::Report(const std::wstring& outputPath, const std::wstring& report)
+{
+    OutputDebugString(report.c_str());
+    wprintf(L"%ls", report.c_str());
+
+    if (!outputPath.empty())
+    {
+        std::wofstream file(outputPath + L"CompositorBenchmark.txt", std::ios::app);
+        file << report;
+    }
+}
@@ -0,0 +1,90 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include "CompositorInterface.h"
+#include "SyntheticFrameProvider.h"
+#include "CaptureFileFrameProvider.h"
+
+#pragma comment(lib, "d3d11")
+
+// Number of composited frames in a benchmark run.
+#define COMPOSITOR_BENCHMARK_FRAMES 1800
+
+// Renditions recorded by the renditions option.
+#define COMPOSITOR_BENCHMARK_RENDITIONS { { 1280, 720, 10 * 1000 * 1000 }, { 854, 480, 5 * 1000 * 1000 }, { 640, 360, 2 * 1000 * 1000 } }
+
+// Drives CompositorInterface as fast as it will go, without Unity or capture hardware, and reports how long each stage takes.
+// Every iteration does what the Unity plugin does for a rendered frame: update the frame provider, add a pose and look one up,
+// read back the video texture for recording and queue a frame of audio.
+// The report is printed and appended to CompositorBenchmark.txt in the HologramCapture folder.
+//
+// From a command prompt, next to CompositorDLL.dll:
+//   CompositorBenchmark synthetic [frames] [norecord] [replay] [renditions]
+//   CompositorBenchmark file <capture file> [frames] [norecord] [replay] [renditions]
+//   CompositorBenchmark capture <capture file> [frames]
+//   CompositorBenchmark pictures [pictures]
+// capture writes synthetic frames to a capture file, which can then be replayed with file.
+// pictures measures burst picture encoding throughput on the CPU (see RunPictures).
+// replay also encodes every frame for instant replay, then saves the replay and times how long the call takes.
+// renditions also records the COMPOSITOR_BENCHMARK_RENDITIONS, and reports what each costs and whether it stayed aligned with the video.
+class CompositorBenchmark
+{
+public:
+    struct Options
+    {
+        Options() :
+            numFrames(COMPOSITOR_BENCHMARK_FRAMES),
+            record(true),
+            replay(false),
+            renditions(false)
+        {
+        }
+
+        int numFrames;
+        // Encode a video while compositing.
+        bool record;
+        // Encode into the instant replay buffer while compositing, then save it.
+        bool replay;
+        // Record smaller copies of the video alongside it.
+        bool renditions;
+    };
+
+    // frameProvider should not be in real time mode.  The caller keeps ownership.
+    static bool Run(IFrameProvider* frameProvider, const Options& options = Options());
+
+    // Write numFrames synthetic frames and their timestamps to a capture file.
+    static bool WriteSyntheticCaptureFile(LPCWSTR path, int numFrames);
+
+    // Encode a burst of synthetic pictures to the temp folder with every format and report pictures per second.
+    // This only measures the CPU side of the pipeline.
+    static bool RunPictures(int numPictures);
+
+private:
+    class Stage
+    {
+    public:
+        Stage(LPCWSTR name) : name(name)
+        {
+        }
+
+        LPCWSTR name;
+        LONGLONG totalTime = 0;
+        LONGLONG maxTime = 0;
+        int count = 0;
+
+        void Add(LONGLONG time)
+        {
+            totalTime += time;
+            if (time > maxTime)
+            {
+                maxTime = time;
+            }
+            count++;
+        }
+    };
+
+    static ID3D11Device* CreateDevice();
+    // Print the report, and append it to CompositorBenchmark.txt in outputPath unless outputPath is empty.
+    static void Report(const std::wstring& outputPath, const std::wstring& report);
+};
@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Runs the compositor benchmark from a command prompt, see CompositorBenchmark.h for the modes and options.
+// The exit code is 0 if the benchmark ran.
+
+#include "CompositorBenchmark.h"
+
+int wmain(int argc, wchar_t* argv[])
+{
+    std::wstring mode = argc >= 2 ? argv[1] : L"synthetic";
+    std::wstring path;
+    int firstOption = 2;
+    if (mode == L"file" || mode == L"capture")
+    {
+        if (argc < 3)
+        {
+            printf("Usage: CompositorBenchmark %ls <capture file> [frames] [options]\n", mode.c_str());
+            return -1;
+        }
+        path = argv[2];
+        firstOption = 3;
+    }
+
+    CompositorBenchmark::Options options;
+    bool numFramesSet = false;
+    for (int i = firstOption; i < argc; i++)
+    {
+        if (_wcsicmp(argv[i], L"norecord") == 0)
+        {
+            options.record = false;
+        }
+        else if (_wcsicmp(argv[i], L"replay") == 0)
+        {
+            options.replay = true;
+        }
+        else if (_wcsicmp(argv[i], L"renditions") == 0)
+        {
+            options.renditions = true;
+        }
+        else if (_wtoi(argv[i]) > 0)
+        {
+            options.numFrames = _wtoi(argv[i]);
+            numFramesSet = true;
+        }
+        else
+        {
+            printf("Unknown option: %ls\n", argv[i]);
+            return -1;
+        }
+    }
+
+    bool succeeded = false;
+    if (mode == L"pictures")
+    {
+        succeeded = CompositorBenchmark::RunPictures(numFramesSet ? options.numFrames : NUM_PICTURE_BUFFERS * 4);
+    }
+    else if (mode == L"capture")
+    {
+        succeeded = CompositorBenchmark::WriteSyntheticCaptureFile(path.c_str(), options.numFrames);
+    }
+    else if (mode == L"file")
+    {
+        CaptureFileFrameProvider frameProvider(path, false);
+        succeeded = CompositorBenchmark::Run(&frameProvider, options);
+    }
+    else if (mode == L"synthetic")
+    {
+        SyntheticFrameProvider frameProvider(SYNTHETIC_FRAME_WIDTH, SYNTHETIC_FRAME_HEIGHT, SYNTHETIC_FRAME_FPS, SYNTHETIC_FRAME_JITTER_MS, false);
+        succeeded = CompositorBenchmark::Run(&frameProvider, options);
+    }
+    else
+    {
+        printf("Usage: CompositorBenchmark [synthetic | file <capture file> | capture <capture file> | pictures] [frames] [norecord] [replay] [renditions]\n");
+        return -1;
+    }
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "AudioRing.h"
+
+#include <algorithm>
+
+AudioRing::AudioRing(UINT32 channels, UINT32 sampleRate, UINT32 capacityFrames, UINT32 blockFrames, UINT32 spliceThresholdFrames) :
+    channels(channels),
+    sampleRate(sampleRate),
+    capacityFrames(capacityFrames),
+    blockFrames(blockFrames),
+    spliceThresholdFrames(spliceThresholdFrames),
+    samples(capacityFrames * channels),
+    block(blockFrames * channels),
+    readIndex(0),
+    writeIndex(0)
+{
+}
+
+void AudioRing::Reset()
+{
+    Gap gap;
+    while (gaps.TryPop(gap))
+    {
+    }
+
+    readIndex = 0;
+    writeIndex = 0;
+
+    timelineFrames = 0;
+    pendingSilenceFrames = 0;
+    silenceFrames = 0;
+    trimmedFrames = 0;
+    overflowFrames = 0;
+    maxDriftFrames = 0;
+
+    blockFill = 0;
+    hasNextGap = false;
+    silenceRemaining = 0;
+}
+
+bool AudioRing::QueueSilence()
+{
+    if (pendingSilenceFrames == 0)
+    {
+        return true;
+    }
+
+    Gap gap = { writeIndex.load(std::memory_order_relaxed), pendingSilenceFrames };
+    if (!gaps.TryPush(gap))
+    {
+        return false;
+    }
+
+    pendingSilenceFrames = 0;
+    return true;
+}
+
+bool AudioRing::Write(const short* source, UINT32 numFrames, LONGLONG time)
+{
+    // Where the packet starts on the timeline if it was played right before it arrived.
+    LONGLONG arrivalFrame = (time * sampleRate) / S2HNS - numFrames;
+    LONGLONG offset = arrivalFrame - timelineFrames;
+
+    if (offset > (LONGLONG)spliceThresholdFrames)
+    {
+        // Nothing arrived for a while, fill the gap with silence.
+        pendingSilenceFrames += offset;
+        silenceFrames += offset;
+        timelineFrames += offset;
+    }
+    else if (offset < -(LONGLONG)spliceThresholdFrames)
+    {
+        // More audio arrived than time has passed, drop the excess from the start of the packet.
+        UINT32 trim = (UINT32)std::min(-offset, (LONGLONG)numFrames);
+        source += trim * channels;
+        numFrames -= trim;
+        trimmedFrames += trim;
+        arrivalFrame += trim;
+    }
+
+    maxDriftFrames = std::max(maxDriftFrames, std::abs(arrivalFrame - timelineFrames));
+
+    // Silence has to be queued before anything that follows it.
+    UINT32 copied = 0;
+    if (QueueSilence())
+    {
+        LONGLONG index = writeIndex.load(std::memory_order_relaxed);
+        LONGLONG freeFrames = capacityFrames - (index - readIndex.load(std::memory_order_acquire));
+        copied = (UINT32)std::min((LONGLONG)numFrames, freeFrames);
+
+        UINT32 start = (UINT32)(index & (capacityFrames - 1));
+        UINT32 firstFrames = std::min(copied, capacityFrames - start);
+        memcpy(&samples[start * channels], source, firstFrames * GetFrameSize());
+        memcpy(&samples[0], source + firstFrames * channels, (copied - firstFrames) * GetFrameSize());
+
+        writeIndex.store(index + copied, std::memory_order_release);
+    }
+
+    timelineFrames += numFrames;
+
+    if (copied < numFrames)
+    {
+        // The consumer has fallen behind.  Keep the timeline moving so later audio is not pulled out of sync.
+        pendingSilenceFrames += numFrames - copied;
+        overflowFrames += numFrames - copied;
+        QueueSilence();
+        return false;
+    }
+
+    return true;
+}
+
+const short* AudioRing::ReadBlock()
+{
+    while (blockFill < blockFrames)
+    {
+        UINT32 frames = blockFrames - blockFill;
+
+        if (silenceRemaining > 0)
+        {
+            frames = (UINT32)std::min(silenceRemaining, (LONGLONG)frames);
+            memset(&block[blockFill * channels], 0, frames * GetFrameSize());
+            silenceRemaining -= frames;
+            blockFill += frames;
+            continue;
+        }
+
+        // Load the write index before looking for a gap: a gap is always queued before the samples that follow it,
+        // so any samples seen here cannot belong after a gap that has not been seen yet.
+        LONGLONG endIndex = writeIndex.load(std::memory_order_acquire);
+        LONGLONG index = readIndex.load(std::memory_order_relaxed);
+
+        if (!hasNextGap)
+        {
+            hasNextGap = gaps.TryPop(nextGap);
+        }
+
+        if (hasNextGap)
+        {
+            if (nextGap.index == index)
+            {
+                silenceRemaining = nextGap.frames;
+                hasNextGap = false;
+                continue;
+            }
+
+            endIndex = std::min(endIndex, nextGap.index);
+        }
+
+        frames = (UINT32)std::min(endIndex - index, (LONGLONG)frames);
+        if (frames == 0)
+        {
+            return nullptr;
+        }
+
+        UINT32 start = (UINT32)(index & (capacityFrames - 1));
+        UINT32 firstFrames = std::min(frames, capacityFrames - start);
+        memcpy(&block[blockFill * channels], &samples[start * channels], firstFrames * GetFrameSize());
+        memcpy(&block[(blockFill + firstFrames) * channels], &samples[0], (frames - firstFrames) * GetFrameSize());
+
+        readIndex.store(index + frames, std::memory_order_release);
+        blockFill += frames;
+    }
+
+    blockFill = 0;
+    return block.data();
+}
@@ -0,0 +1,104 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <atomic>
+
+#include "SPSCQueue.h"
+
+// Number of silence insertions that can wait for the consumer, this must be a power of 2.
+#define AUDIO_RING_GAP_CAPACITY 64
+
+// Interleaved 16 bit PCM ring for exactly one producer (the engine's audio thread) and one consumer (the encoder thread).
+// The producer writes packets of any size stamped with their arrival time, the consumer reads fixed size blocks.
+//
+// Everything written is placed on a sample accurate timeline: frame N of a recording plays at N / sampleRate seconds.
+// Packets are spliced into the timeline by their arrival time, so audio stays in sync with video:
+// - If the engine stalls or its audio listener is disabled, the next packet arrives late and the gap is filled with silence.
+// - If packets run ahead of their arrival times (eg: the audio device clock is faster than the performance counter) the excess is trimmed.
+// - Anything closer than spliceThresholdFrames is left alone, so bursty delivery from the engine does not cause splices.
+// If the consumer falls behind and the ring fills up, the rest of the packet is replaced with silence for the same reason.
+//
+// Storage is allocated up front, neither side allocates or takes a lock.
+class AudioRing
+{
+public:
+    // capacityFrames must be a power of 2.
+    AudioRing(UINT32 channels, UINT32 sampleRate, UINT32 capacityFrames, UINT32 blockFrames, UINT32 spliceThresholdFrames);
+
+    // Start a new timeline.  Neither the producer nor the consumer may be running.
+    void Reset();
+
+    // Producer only.  time is when the packet arrived, in 100 ns units since the timeline started.
+    // Returns false if the ring was full and some of the packet was replaced with silence.
+    bool Write(const short* samples, UINT32 numFrames, LONGLONG time);
+
+    // Consumer only.  Returns the next block of GetBlockFrames() frames, or nullptr until one is complete.
+    // The block is valid until the next call.
+    const short* ReadBlock();
+
+    // Start time of a block on the timeline, in 100 ns units.
+    LONGLONG GetBlockTime(LONGLONG block)
+    {
+        return (block * blockFrames * S2HNS) / sampleRate;
+    }
+
+    UINT32 GetBlockFrames() { return blockFrames; }
+    UINT32 GetFrameSize() { return channels * sizeof(short); }
+
+    // Number of frames written that the consumer has not read yet.  A snapshot from any other thread.
+    int GetBufferedFrames()
+    {
+        return (int)(writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire));
+    }
+
+    // Producer statistics for the current timeline, only consistent while the producer is not running.
+    LONGLONG GetTimelineFrames() { return timelineFrames; }
+    LONGLONG GetSilenceFrames() { return silenceFrames; }
+    LONGLONG GetTrimmedFrames() { return trimmedFrames; }
+    LONGLONG GetOverflowFrames() { return overflowFrames; }
+    // Largest distance between a packet's place on the timeline and its arrival time, after splicing.
+    LONGLONG GetMaxDriftFrames() { return maxDriftFrames; }
+
+private:
+    struct Gap
+    {
+        // Write index the silence goes before.
+        LONGLONG index;
+        LONGLONG frames;
+    };
+
+    // Producer only.  Returns true if no silence is left to queue.
+    bool QueueSilence();
+
+    UINT32 channels;
+    UINT32 sampleRate;
+    UINT32 capacityFrames;
+    UINT32 blockFrames;
+    UINT32 spliceThresholdFrames;
+
+    std::vector<short> samples;
+    SPSCQueue<Gap, AUDIO_RING_GAP_CAPACITY> gaps;
+
+    // Producer state.
+    LONGLONG timelineFrames = 0;
+    LONGLONG pendingSilenceFrames = 0;
+    LONGLONG silenceFrames = 0;
+    LONGLONG trimmedFrames = 0;
+    LONGLONG overflowFrames = 0;
+    LONGLONG maxDriftFrames = 0;
+
+    // Consumer state.
+    std::vector<short> block;
+    UINT32 blockFill = 0;
+    Gap nextGap;
+    bool hasNextGap = false;
+    LONGLONG silenceRemaining = 0;
+
+    // Keep the indices on separate cache lines so the producer and consumer do not contend.
+    alignas(64) std::atomic<LONGLONG> readIndex;
+    alignas(64) std::atomic<LONGLONG> writeIndex;
+};
@@ -0,0 +1,139 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <Windows.h>
+
+// Raw capture file, replayed by CaptureFileFrameProvider.
+// A fixed size header is followed by frameCount records.  Each record is a timestamp followed by the frame's bytes,
+// exactly as a frame provider would upload them to the color texture.
+// Records are padded to CAPTURE_FILE_ALIGNMENT so frames can be read straight out of a memory mapped view.
+#define CAPTURE_FILE_MAGIC      0x46435653 // "SVCF"
+#define CAPTURE_FILE_VERSION    1
+#define CAPTURE_FILE_ALIGNMENT  64
+
+struct CaptureFileHeader
+{
+    UINT magic;
+    UINT version;
+    UINT width;
+    UINT height;
+    UINT bytesPerFrame;
+    // Non-zero if frames are UYVY, see IFrameProvider::OutputYUV.
+    UINT outputYUV;
+    LONGLONG durationHNS;
+    UINT frameCount;
+    UINT reserved;
+    BYTE padding[CAPTURE_FILE_ALIGNMENT - 40];
+};
+
+static_assert(sizeof(CaptureFileHeader) == CAPTURE_FILE_ALIGNMENT, "CaptureFileHeader must be CAPTURE_FILE_ALIGNMENT bytes.");
+
+struct CaptureFileRecord
+{
+    // 100-nanosecond units, in the capturing provider's time base.
+    LONGLONG timeStamp;
+    BYTE padding[CAPTURE_FILE_ALIGNMENT - sizeof(LONGLONG)];
+    // Followed by bytesPerFrame bytes of frame data.
+};
+
+static_assert(sizeof(CaptureFileRecord) == CAPTURE_FILE_ALIGNMENT, "CaptureFileRecord must be CAPTURE_FILE_ALIGNMENT bytes.");
+
+class CaptureFile
+{
+public:
+    // Distance between consecutive records.
+    static size_t GetRecordSize(UINT bytesPerFrame)
+    {
+        size_t size = sizeof(CaptureFileRecord) + bytesPerFrame;
+        return (size + CAPTURE_FILE_ALIGNMENT - 1) & ~((size_t)CAPTURE_FILE_ALIGNMENT - 1);
+    }
+};
+
+// Writes frames to a capture file.  The frame count in the header is only valid after Close.
+class CaptureFileWriter
+{
+public:
+    ~CaptureFileWriter()
+    {
+        Close();
+    }
+
+    bool Open(LPCWSTR path, UINT width, UINT height, UINT bytesPerFrame, bool outputYUV, LONGLONG durationHNS)
+    {
+        Close();
+
+        file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        ZeroMemory(&header, sizeof(header));
+        header.magic = CAPTURE_FILE_MAGIC;
+        header.version = CAPTURE_FILE_VERSION;
+        header.width = width;
+        header.height = height;
+        header.bytesPerFrame = bytesPerFrame;
+        header.outputYUV = outputYUV ? 1 : 0;
+        header.durationHNS = durationHNS;
+        header.frameCount = 0;
+
+        return Write(&header, sizeof(header));
+    }
+
+    bool WriteFrame(const BYTE* bytes, LONGLONG timeStamp)
+    {
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        CaptureFileRecord record;
+        ZeroMemory(&record, sizeof(record));
+        record.timeStamp = timeStamp;
+
+        static const BYTE padding[CAPTURE_FILE_ALIGNMENT] = { 0 };
+        size_t paddingSize = CaptureFile::GetRecordSize(header.bytesPerFrame) - sizeof(record) - header.bytesPerFrame;
+
+        if (!Write(&record, sizeof(record)) ||
+            !Write(bytes, header.bytesPerFrame) ||
+            !Write(padding, paddingSize))
+        {
+            return false;
+        }
+
+        header.frameCount++;
+        return true;
+    }
+
+    void Close()
+    {
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+
+        // Rewrite the header with the final frame count.
+        SetFilePointer(file, 0, NULL, FILE_BEGIN);
+        Write(&header, sizeof(header));
+
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+
+private:
+    HANDLE file = INVALID_HANDLE_VALUE;
+    CaptureFileHeader header;
+
+    bool Write(const void* bytes, size_t length)
+    {
+        if (length == 0)
+        {
+            return true;
+        }
+
+        DWORD written = 0;
+        return WriteFile(file, bytes, (DWORD)length, &written, NULL) && written == length;
+    }
+};
@@ -0,0 +1,211 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "CaptureFileFrameProvider.h"
+#include "FrameTimer.h"
+
+CaptureFileFrameProvider::CaptureFileFrameProvider(const std::wstring& path, bool realTime) :
+    path(path),
+    realTime(realTime)
+{
+}
+
+CaptureFileFrameProvider::~CaptureFileFrameProvider()
+{
+    Dispose();
+}
+
+bool CaptureFileFrameProvider::OpenFile()
+{
+    file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        OutputDebugString((L"ERROR: Could not open capture file: " + path + L"\n").c_str());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) ||
+        fileSize.QuadPart < (LONGLONG)sizeof(CaptureFileHeader))
+    {
+        OutputDebugString(L"ERROR: Capture file is too small.\n");
+        return false;
+    }
+
+    // Mapping the whole file needs a 64 bit process for captures larger than the address space.
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL)
+    {
+        view = (const BYTE*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+
+    if (view == nullptr)
+    {
+        OutputDebugString(L"ERROR: Could not map capture file.\n");
+        return false;
+    }
+
+    header = (const CaptureFileHeader*)view;
+    recordSize = CaptureFile::GetRecordSize(header->bytesPerFrame);
+
+    if (header->magic != CAPTURE_FILE_MAGIC ||
+        header->version != CAPTURE_FILE_VERSION ||
+        header->frameCount == 0 ||
+        header->durationHNS <= 0 ||
+        (ULONGLONG)fileSize.QuadPart < sizeof(CaptureFileHeader) + header->frameCount * (ULONGLONG)recordSize)
+    {
+        OutputDebugString(L"ERROR: Capture file is not valid.\n");
+        header = nullptr;
+        return false;
+    }
+
+    loopDurationHNS = GetRecord(header->frameCount)->timeStamp - GetRecord(1)->timeStamp + header->durationHNS;
+    return true;
+}
+
+void CaptureFileFrameProvider::CloseFile()
+{
+    header = nullptr;
+
+    if (view != nullptr)
+    {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+
+    if (mapping != NULL)
+    {
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+}
+
+HRESULT CaptureFileFrameProvider::Initialize(ID3D11ShaderResourceView* srv)
+{
+    if (IsEnabled())
+    {
+        return S_OK;
+    }
+
+    if (!OpenFile())
+    {
+        CloseFile();
+        return E_FAIL;
+    }
+
+    // The color texture is optional, so files can be replayed without a device.
+    _colorSRV = srv;
+    _device = nullptr;
+    if (_colorSRV != nullptr)
+    {
+        _colorSRV->GetDevice(&_device);
+    }
+
+    // Frames are uploaded the same way their provider did: full rows of the color texture.
+    int stride = FRAME_WIDTH * FRAME_BPP;
+    uploadFrames = _colorSRV != nullptr &&
+        header->width == FRAME_WIDTH && header->height == FRAME_HEIGHT &&
+        header->bytesPerFrame <= FRAME_BUFSIZE && header->bytesPerFrame % stride == 0;
+    if (_colorSRV != nullptr && !uploadFrames)
+    {
+        OutputDebugString(L"Capture file frames do not match FRAME_WIDTH x FRAME_HEIGHT and will not be uploaded.\n");
+    }
+
+    captureFrameIndex = 0;
+
+    if (realTime)
+    {
+        stopCapture = false;
+        captureThread = std::thread(&CaptureFileFrameProvider::CaptureThread, this);
+    }
+
+    return S_OK;
+}
+
+bool CaptureFileFrameProvider::IsEnabled()
+{
+    return header != nullptr;
+}
+
+const CaptureFileRecord* CaptureFileFrameProvider::GetRecord(int frame)
+{
+    int fileFrame = (frame - 1) % (int)header->frameCount;
+    return (const CaptureFileRecord*)(view + sizeof(CaptureFileHeader) + fileFrame * recordSize);
+}
+
+LONGLONG CaptureFileFrameProvider::GetTimestamp(int frame)
+{
+    if (header == nullptr || frame <= 0)
+    {
+        return 0;
+    }
+
+    int loop = (frame - 1) / (int)header->frameCount;
+    return GetRecord(frame)->timeStamp + loop * loopDurationHNS;
+}
+
+void CaptureFileFrameProvider::CaptureThread()
+{
+    FrameTimer timer;
+    LONGLONG startHNS = timer.NowHNS();
+
+    LONGLONG firstTimeStamp = GetTimestamp(1);
+
+    for (int index = 1; !stopCapture; index++)
+    {
+        // Release each frame with the same spacing it was recorded with.
+        timer.WaitUntil(startHNS + GetTimestamp(index) - firstTimeStamp);
+
+        captureFrameIndex = index;
+    }
+}
+
+void CaptureFileFrameProvider::Update(int compositeFrameIndex)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    if (!realTime)
+    {
+        captureFrameIndex++;
+    }
+
+    if (uploadFrames && _device != nullptr && compositeFrameIndex > 0)
+    {
+        const BYTE* bytes = (const BYTE*)(GetRecord(compositeFrameIndex) + 1);
+        int stride = FRAME_WIDTH * FRAME_BPP;
+        DirectXHelper::UpdateSRV(_device, _colorSRV, bytes, stride, header->bytesPerFrame / stride);
+    }
+}
+
+void CaptureFileFrameProvider::StopCaptureThread()
+{
+    stopCapture = true;
+    if (captureThread.joinable())
+    {
+        captureThread.join();
+    }
+}
+
+void CaptureFileFrameProvider::Dispose()
+{
+    StopCaptureThread();
+
+    if (_device != nullptr)
+    {
+        _device->Release();
+        _device = nullptr;
+    }
+
+    CloseFile();
+    captureFrameIndex = 0;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include "IFrameProvider.h"
+#include <thread>
+#include <atomic>
+#include <string>
+
+#include "DirectXHelper.h"
+#include "CaptureFile.h"
+
+//TODO: Change this to the capture file to replay when USE_CAPTURE_FILE is set.
+// Relative paths are in the HologramCapture folder in My Documents.
+#define CAPTURE_FILE_NAME L"Capture.svcf"
+
+// Replays a capture file (see CaptureFile.h) instead of capturing from hardware, looping at the end of the file.
+// The file is memory mapped and frames are uploaded straight out of the mapped view.
+// Timestamps are the ones recorded in the file, offset by the length of the file on every loop.
+//
+// In real time mode frames are released on a capture thread with their recorded spacing.
+// Otherwise every Update captures exactly one frame, so a harness can drive the compositor as fast as it will go.
+class CaptureFileFrameProvider : public IFrameProvider
+{
+public:
+    CaptureFileFrameProvider(const std::wstring& path, bool realTime = true);
+    ~CaptureFileFrameProvider();
+
+    // Inherited via IFrameProvider
+    virtual HRESULT Initialize(ID3D11ShaderResourceView* srv) override;
+    virtual bool IsEnabled() override;
+    virtual void Update(int compositeFrameIndex) override;
+    virtual void Dispose() override;
+
+    virtual bool OutputYUV()
+    {
+        return header != nullptr && header->outputYUV != 0;
+    }
+
+    virtual LONGLONG GetTimestamp(int frame);
+
+    virtual LONGLONG GetDurationHNS()
+    {
+        if (header == nullptr)
+        {
+            return (LONGLONG)((1.0f / 60.0f) * S2HNS);
+        }
+
+        return header->durationHNS;
+    }
+
+    virtual int GetCaptureFrameIndex()
+    {
+        return captureFrameIndex;
+    }
+
+private:
+    std::wstring path;
+    bool realTime;
+    bool uploadFrames = false;
+
+    ID3D11ShaderResourceView* _colorSRV = nullptr;
+    ID3D11Device* _device = nullptr;
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    const BYTE* view = nullptr;
+    const CaptureFileHeader* header = nullptr;
+    size_t recordSize = 0;
+    // Time from the first frame to the first frame of the next loop.
+    LONGLONG loopDurationHNS = 0;
+
+    // Capture frame indices start at 1, which is the first frame in the file.
+    std::atomic<int> captureFrameIndex{ 0 };
+
+    std::thread captureThread;
+    std::atomic<bool> stopCapture{ false };
+    void CaptureThread();
+    void StopCaptureThread();
+
+    bool OpenFile();
+    void CloseFile();
+    const CaptureFileRecord* GetRecord(int frame);
+};
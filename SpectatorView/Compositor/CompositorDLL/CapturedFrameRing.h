@@ -0,0 +1,151 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <Windows.h>
+#include <atomic>
+
+// Ring of the most recent capture frames, indexed by capture frame index like the frame providers' buffer caches.
+// Instead of copying each frame, the ring holds a reference to the capture driver's frame until its slot is recycled,
+// so the capture callback only swaps pointers under the lock.
+// Frame can be any reference counted type with AddRef and Release (eg: IDeckLinkVideoInputFrame).
+// Only the newest NumRetained frames keep their reference.  Capture drivers have a fixed pool of frames,
+// so holding every cached slot could starve them.  Timestamps are kept for all NumSlots frames.
+template<class Frame, int NumSlots, int NumRetained>
+class CapturedFrameRing
+{
+    static_assert(NumRetained > 0 && NumRetained < NumSlots, "CapturedFrameRing must retain fewer frames than it has slots.");
+
+public:
+    CapturedFrameRing()
+    {
+        InitializeCriticalSection(&lock);
+        Reset();
+    }
+
+    ~CapturedFrameRing()
+    {
+        Clear();
+        DeleteCriticalSection(&lock);
+    }
+
+    // Capture thread.  Takes a reference to frame, whose bytes must stay valid until it is released.
+    void Push(Frame* frame, const BYTE* bytes, int length, LONGLONG timeStamp)
+    {
+        frame->AddRef();
+
+        Frame* expired = nullptr;
+        EnterCriticalSection(&lock);
+        int index = captureFrameIndex + 1;
+
+        // Stop retaining the frame that just fell out of the retained window.
+        // This is the only frame in the ring that could still be held.
+        if (index >= NumRetained)
+        {
+            Slot& oldest = slots[(index - NumRetained) % NumSlots];
+            expired = oldest.frame;
+            oldest.frame = nullptr;
+            oldest.bytes = nullptr;
+        }
+
+        Slot& slot = slots[index % NumSlots];
+        slot.index = index;
+        slot.frame = frame;
+        slot.bytes = bytes;
+        slot.length = length;
+        slot.timeStamp = timeStamp;
+
+        captureFrameIndex = index;
+        LeaveCriticalSection(&lock);
+
+        // Releasing may hand the frame back to the driver, so do it outside the lock.
+        if (expired != nullptr)
+        {
+            expired->Release();
+        }
+    }
+
+    // Takes a reference to the frame captured at index, so it cannot be recycled while it is being read.
+    // The caller must Release frame.  Returns false if the frame is no longer retained, or has not been captured yet.
+    bool Acquire(int index, Frame*& frame, const BYTE*& bytes, int& length)
+    {
+        EnterCriticalSection(&lock);
+        const Slot& slot = slots[index % NumSlots];
+        // The slot may hold a newer frame NumSlots captures later.
+        frame = slot.index == index ? slot.frame : nullptr;
+        bytes = slot.bytes;
+        length = slot.length;
+        if (frame != nullptr)
+        {
+            frame->AddRef();
+        }
+        LeaveCriticalSection(&lock);
+
+        return frame != nullptr;
+    }
+
+    LONGLONG GetTimestamp(int index)
+    {
+        return slots[index % NumSlots].timeStamp;
+    }
+
+    int GetCaptureFrameIndex()
+    {
+        return captureFrameIndex;
+    }
+
+    // Release every retained frame.  Call before the capture driver is stopped or reconfigured.
+    void Clear()
+    {
+        Frame* released[NumSlots];
+        int numReleased = 0;
+
+        EnterCriticalSection(&lock);
+        for (Slot& slot : slots)
+        {
+            if (slot.frame != nullptr)
+            {
+                released[numReleased++] = slot.frame;
+            }
+            slot.frame = nullptr;
+            slot.bytes = nullptr;
+        }
+        LeaveCriticalSection(&lock);
+
+        for (int i = 0; i < numReleased; i++)
+        {
+            released[i]->Release();
+        }
+    }
+
+    // Release every frame and restart capture frame indices.
+    void Reset()
+    {
+        Clear();
+
+        EnterCriticalSection(&lock);
+        for (Slot& slot : slots)
+        {
+            slot.index = -1;
+            slot.length = 0;
+            slot.timeStamp = 0;
+        }
+        captureFrameIndex = 0;
+        LeaveCriticalSection(&lock);
+    }
+
+private:
+    struct Slot
+    {
+        // Capture frame index of the frame in this slot.
+        int index = -1;
+        Frame* frame = nullptr;
+        const BYTE* bytes = nullptr;
+        int length = 0;
+        LONGLONG timeStamp = 0;
+    };
+
+    Slot slots[NumSlots];
+    std::atomic<int> captureFrameIndex;
+    CRITICAL_SECTION lock;
+};
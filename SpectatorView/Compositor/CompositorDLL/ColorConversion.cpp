@@ -0,0 +1,904 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "ColorConversion.h"
+
+#include <ppl.h>
+#include <intrin.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#define COLOR_CONVERSION_USE_SIMD 1
+#else
+#define COLOR_CONVERSION_USE_SIMD 0
+#endif
+
+// Fixed point precision of the conversion coefficients.
+// Every implementation does the same integer math, so they all round identically.
+#define COLOR_SHIFT 12
+#define COLOR_ROUND (1 << (COLOR_SHIFT - 1))
+
+// Chroma is computed from the sum of a 2x2 block of pixels, which adds 2 bits.
+#define CHROMA_SHIFT (COLOR_SHIFT + 2)
+#define CHROMA_BIAS ((128 << CHROMA_SHIFT) + (1 << (CHROMA_SHIFT - 1)))
+
+// Number of rows each parallel task converts.  Must be even so chroma rows are not split.
+#define COLOR_CONVERSION_ROWS_PER_TASK 32
+
+// Fixed point precision of the resampling weights.  The weights of each output pixel sum to exactly RESIZE_WEIGHT_ONE,
+// so a column of source pixels blends into a 16 bit value that is exactly 256 times a byte.
+#define RESIZE_WEIGHT_SHIFT 8
+#define RESIZE_WEIGHT_ONE (1 << RESIZE_WEIGHT_SHIFT)
+// The horizontal pass multiplies the blended columns by weights again, which adds RESIZE_WEIGHT_SHIFT twice.
+#define RESIZE_SHIFT (2 * RESIZE_WEIGHT_SHIFT)
+#define RESIZE_ROUND (1 << (RESIZE_SHIFT - 1))
+
+struct Coefficients
+{
+    // RGB to YUV, indexed by the byte position of each channel in the source pixel.
+    int y[3];
+    int u[3];
+    int v[3];
+    int yOffset;
+
+    // YUV to RGB, indexed by the byte position of each channel in the destination pixel.
+    int yScale;
+    int uToChannel[3];
+    int vToChannel[3];
+};
+
+namespace
+{
+    int ToFixed(double value)
+    {
+        return (int)(value * (1 << COLOR_SHIFT) + (value < 0 ? -0.5 : 0.5));
+    }
+
+    byte Clamp(int value)
+    {
+        return (byte)(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+}
+
+static Coefficients GetCoefficients(const ColorConversion::Options& options, bool bgra)
+{
+    double kr = 0.299, kb = 0.114;
+    if (options.colorSpace == ColorConversion::ColorSpace::BT709)
+    {
+        kr = 0.2126;
+        kb = 0.0722;
+    }
+    double kg = 1.0 - kr - kb;
+
+    bool limited = options.range == ColorConversion::ColorRange::Limited;
+    double yRange = limited ? 219.0 / 255.0 : 1.0;
+    double cRange = limited ? 224.0 / 255.0 : 1.0;
+
+    // Channel order is R, G, B.
+    double toY[3] = { kr, kg, kb };
+    double toU[3] = { -kr / (2.0 * (1.0 - kb)), -kg / (2.0 * (1.0 - kb)), 0.5 };
+    double toV[3] = { 0.5, -kg / (2.0 * (1.0 - kr)), -kb / (2.0 * (1.0 - kr)) };
+    double fromU[3] = { 0.0, -2.0 * kb * (1.0 - kb) / kg, 2.0 * (1.0 - kb) };
+    double fromV[3] = { 2.0 * (1.0 - kr), -2.0 * kr * (1.0 - kr) / kg, 0.0 };
+
+    Coefficients c;
+    for (int i = 0; i < 3; i++)
+    {
+        // BGRA stores blue first, so swap which channel each byte position maps to.
+        int channel = bgra ? 2 - i : i;
+        c.y[i] = ToFixed(toY[channel] * yRange);
+        c.u[i] = ToFixed(toU[channel] * cRange);
+        c.v[i] = ToFixed(toV[channel] * cRange);
+        c.uToChannel[i] = ToFixed(fromU[channel] / cRange);
+        c.vToChannel[i] = ToFixed(fromV[channel] / cRange);
+    }
+
+    c.yOffset = limited ? 16 : 0;
+    c.yScale = ToFixed(1.0 / yRange);
+    return c;
+}
+
+#pragma region Scalar
+static void RGBAToYRow_Scalar(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    for (int x = 0; x < width; x++, src += 4)
+    {
+        int y = (c.y[0] * src[0] + c.y[1] * src[1] + c.y[2] * src[2] + COLOR_ROUND) >> COLOR_SHIFT;
+        dst[x] = Clamp(y + c.yOffset);
+    }
+}
+
+// Writes width / 2 interleaved U, V pairs from two source rows.
+static void RGBAToUVRow_Scalar(const byte* src0, const byte* src1, byte* dst, int width, const Coefficients& c)
+{
+    for (int x = 0; x < width; x += 2, src0 += 8, src1 += 8, dst += 2)
+    {
+        int s0 = src0[0] + src0[4] + src1[0] + src1[4];
+        int s1 = src0[1] + src0[5] + src1[1] + src1[5];
+        int s2 = src0[2] + src0[6] + src1[2] + src1[6];
+
+        dst[0] = Clamp((c.u[0] * s0 + c.u[1] * s1 + c.u[2] * s2 + CHROMA_BIAS) >> CHROMA_SHIFT);
+        dst[1] = Clamp((c.v[0] * s0 + c.v[1] * s1 + c.v[2] * s2 + CHROMA_BIAS) >> CHROMA_SHIFT);
+    }
+}
+
+static inline void YUVToRGBAPixel(int y, int u, int v, byte* dst, const Coefficients& c)
+{
+    int luma = c.yScale * (y - c.yOffset) + COLOR_ROUND;
+    u -= 128;
+    v -= 128;
+
+    // Relies on >> being an arithmetic shift for negative values, as it is with MSVC and the SIMD versions.
+    for (int i = 0; i < 3; i++)
+    {
+        dst[i] = Clamp((luma + c.uToChannel[i] * u + c.vToChannel[i] * v) >> COLOR_SHIFT);
+    }
+    dst[3] = 255;
+}
+
+static void NV12ToRGBARow_Scalar(const byte* srcY, const byte* srcUV, byte* dst, int width, const Coefficients& c)
+{
+    for (int x = 0; x < width; x++)
+    {
+        const byte* uv = &srcUV[x & ~1];
+        YUVToRGBAPixel(srcY[x], uv[0], uv[1], &dst[x * 4], c);
+    }
+}
+
+static void UYVYToRGBARow_Scalar(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    for (int x = 0; x < width; x += 2, src += 4, dst += 8)
+    {
+        YUVToRGBAPixel(src[1], src[0], src[2], dst, c);
+        YUVToRGBAPixel(src[3], src[0], src[2], dst + 4, c);
+    }
+}
+static void BGRToBGRARow_Scalar(const byte* src, byte* dst, int width, const Coefficients&)
+{
+    for (int x = 0; x < width; x++, src += 3, dst += 4)
+    {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = 255;
+    }
+}
+
+// Blend numTaps source rows into one row of 16 bit values, for elements [start, end).
+static inline void ResizeVerticalElements_Scalar(const byte* const* src, const int* weights, int numTaps, unsigned short* dst, int start, int end)
+{
+    for (int x = start; x < end; x++)
+    {
+        int sum = 0;
+        for (int tap = 0; tap < numTaps; tap++)
+        {
+            sum += weights[tap] * src[tap][x];
+        }
+        dst[x] = (unsigned short)sum;
+    }
+}
+
+// Blend the taps of each output element from a row of the vertical pass, for elements [start, end).
+// Tap k of element i is src[offsets[i] + k * channels] with weight weights[k * count + i].
+static inline void ResizeHorizontalElements_Scalar(const unsigned short* src, const int* offsets, const int* weights, int numTaps, int channels, int count,
+    byte* dst, int start, int end)
+{
+    for (int i = start; i < end; i++)
+    {
+        int sum = 0;
+        for (int tap = 0; tap < numTaps; tap++)
+        {
+            sum += weights[tap * count + i] * src[offsets[i] + tap * channels];
+        }
+        dst[i] = (byte)((sum + RESIZE_ROUND) >> RESIZE_SHIFT);
+    }
+}
+
+static void ResizeVerticalRow_Scalar(const byte* const* src, const int* weights, int numTaps, unsigned short* dst, int count)
+{
+    ResizeVerticalElements_Scalar(src, weights, numTaps, dst, 0, count);
+}
+
+static void ResizeHorizontalRow_Scalar(const unsigned short* src, const int* offsets, const int* weights, int numTaps, int channels, int count, byte* dst)
+{
+    ResizeHorizontalElements_Scalar(src, offsets, weights, numTaps, channels, count, dst, 0, count);
+}
+#pragma endregion Scalar
+
+#if COLOR_CONVERSION_USE_SIMD
+#pragma region SSE4
+// Dot product of the first 3 bytes of each of 4 pixels with the given coefficients.
+static inline __m128i Dot3_SSE4(__m128i pixels, __m128i c0, __m128i c1, __m128i c2)
+{
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    __m128i ch0 = _mm_and_si128(pixels, byteMask);
+    __m128i ch1 = _mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask);
+    __m128i ch2 = _mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask);
+
+    return _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(ch0, c0), _mm_mullo_epi32(ch1, c1)), _mm_mullo_epi32(ch2, c2));
+}
+
+static void RGBAToYRow_SSE4(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    const __m128i c0 = _mm_set1_epi32(c.y[0]);
+    const __m128i c1 = _mm_set1_epi32(c.y[1]);
+    const __m128i c2 = _mm_set1_epi32(c.y[2]);
+    const __m128i round = _mm_set1_epi32(COLOR_ROUND);
+    const __m128i offset = _mm_set1_epi32(c.yOffset);
+
+    int x = 0;
+    for (; width - x >= 16; x += 16)
+    {
+        __m128i y[4];
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[(x + i * 4) * 4]));
+            y[i] = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(Dot3_SSE4(pixels, c0, c1, c2), round), COLOR_SHIFT), offset);
+        }
+
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(y[0], y[1]), _mm_packs_epi32(y[2], y[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), packed);
+    }
+
+    RGBAToYRow_Scalar(&src[x * 4], &dst[x], width - x, c);
+}
+
+static void RGBAToUVRow_SSE4(const byte* src0, const byte* src1, byte* dst, int width, const Coefficients& c)
+{
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    const __m128i bias = _mm_set1_epi32(CHROMA_BIAS);
+
+    int x = 0;
+    for (; width - x >= 8; x += 8)
+    {
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[x * 4]));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src0[x * 4 + 16]));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[x * 4]));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src1[x * 4 + 16]));
+
+        // Sum each channel over the 2x2 blocks, giving 4 sums per channel.
+        __m128i sums[3];
+        for (int i = 0; i < 3; i++)
+        {
+            __m128i a = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(a0, i * 8), byteMask), _mm_and_si128(_mm_srli_epi32(a1, i * 8), byteMask));
+            __m128i b = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(b0, i * 8), byteMask), _mm_and_si128(_mm_srli_epi32(b1, i * 8), byteMask));
+            sums[i] = _mm_hadd_epi32(a, b);
+        }
+
+        __m128i u = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(sums[0], _mm_set1_epi32(c.u[0])), _mm_mullo_epi32(sums[1], _mm_set1_epi32(c.u[1]))),
+            _mm_add_epi32(_mm_mullo_epi32(sums[2], _mm_set1_epi32(c.u[2])), bias));
+        __m128i v = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(sums[0], _mm_set1_epi32(c.v[0])), _mm_mullo_epi32(sums[1], _mm_set1_epi32(c.v[1]))),
+            _mm_add_epi32(_mm_mullo_epi32(sums[2], _mm_set1_epi32(c.v[2])), bias));
+        u = _mm_srai_epi32(u, CHROMA_SHIFT);
+        v = _mm_srai_epi32(v, CHROMA_SHIFT);
+
+        // u0 u1 u2 u3 v0 v1 v2 v3 -> u0 v0 u1 v1 u2 v2 u3 v3
+        __m128i uv = _mm_packs_epi32(u, v);
+        uv = _mm_unpacklo_epi16(uv, _mm_srli_si128(uv, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&dst[x]), _mm_packus_epi16(uv, uv));
+    }
+
+    RGBAToUVRow_Scalar(&src0[x * 4], &src1[x * 4], &dst[x], width - x, c);
+}
+
+// Converts 4 pixels given as 32 bit Y, U and V values and stores them as RGBA.
+static inline void StoreYUVAsRGBA_SSE4(__m128i y, __m128i u, __m128i v, byte* dst, const Coefficients& c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi32(255);
+
+    __m128i luma = _mm_add_epi32(_mm_mullo_epi32(_mm_sub_epi32(y, _mm_set1_epi32(c.yOffset)), _mm_set1_epi32(c.yScale)), _mm_set1_epi32(COLOR_ROUND));
+    u = _mm_sub_epi32(u, _mm_set1_epi32(128));
+    v = _mm_sub_epi32(v, _mm_set1_epi32(128));
+
+    __m128i rgba = _mm_set1_epi32(0xFF000000);
+    for (int i = 0; i < 3; i++)
+    {
+        __m128i channel = _mm_add_epi32(luma, _mm_add_epi32(_mm_mullo_epi32(u, _mm_set1_epi32(c.uToChannel[i])), _mm_mullo_epi32(v, _mm_set1_epi32(c.vToChannel[i]))));
+        channel = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(channel, COLOR_SHIFT), zero), max);
+        rgba = _mm_or_si128(rgba, _mm_slli_epi32(channel, i * 8));
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), rgba);
+}
+
+static void NV12ToRGBARow_SSE4(const byte* srcY, const byte* srcUV, byte* dst, int width, const Coefficients& c)
+{
+    int x = 0;
+    for (; width - x >= 4; x += 4)
+    {
+        __m128i y = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(&srcY[x])));
+        __m128i uv = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(&srcUV[x])));
+        __m128i u = _mm_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i v = _mm_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1));
+
+        StoreYUVAsRGBA_SSE4(y, u, v, &dst[x * 4], c);
+    }
+
+    NV12ToRGBARow_Scalar(&srcY[x], &srcUV[x], &dst[x * 4], width - x, c);
+}
+
+static void UYVYToRGBARow_SSE4(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    // Spread the Y, U and V bytes of 4 pixels (U0 Y0 V0 Y1 U1 Y2 V1 Y3) into 32 bit lanes.
+    const __m128i yShuffle = _mm_setr_epi8(1, -1, -1, -1, 3, -1, -1, -1, 5, -1, -1, -1, 7, -1, -1, -1);
+    const __m128i uShuffle = _mm_setr_epi8(0, -1, -1, -1, 0, -1, -1, -1, 4, -1, -1, -1, 4, -1, -1, -1);
+    const __m128i vShuffle = _mm_setr_epi8(2, -1, -1, -1, 2, -1, -1, -1, 6, -1, -1, -1, 6, -1, -1, -1);
+
+    int x = 0;
+    for (; width - x >= 4; x += 4)
+    {
+        __m128i uyvy = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&src[x * 2]));
+        StoreYUVAsRGBA_SSE4(_mm_shuffle_epi8(uyvy, yShuffle), _mm_shuffle_epi8(uyvy, uShuffle), _mm_shuffle_epi8(uyvy, vShuffle), &dst[x * 4], c);
+    }
+
+    UYVYToRGBARow_Scalar(&src[x * 2], &dst[x * 4], width - x, c);
+}
+static void BGRToBGRARow_SSE4(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+
+    int x = 0;
+    for (; width - x >= 16; x += 16)
+    {
+        // 16 pixels are 48 source bytes, each group of 4 pixels is 12 of them.
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x * 3]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x * 3 + 16]));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x * 3 + 32]));
+
+        __m128i* out = reinterpret_cast<__m128i*>(&dst[x * 4]);
+        _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(a, expand), alpha));
+        _mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), expand), alpha));
+        _mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(d, b, 8), expand), alpha));
+        _mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(d, 4), expand), alpha));
+    }
+
+    BGRToBGRARow_Scalar(&src[x * 3], &dst[x * 4], width - x, c);
+}
+
+// Weights are at most RESIZE_WEIGHT_ONE and sum to it, so the 16 bit products and sums never overflow.
+static void ResizeVerticalElements_SSE4(const byte* const* src, const int* weights, int numTaps, unsigned short* dst, int start, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = start;
+    for (; end - x >= 16; x += 16)
+    {
+        __m128i low = zero, high = zero;
+        for (int tap = 0; tap < numTaps; tap++)
+        {
+            __m128i weight = _mm_set1_epi16((short)weights[tap]);
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[tap][x]));
+            low = _mm_add_epi16(low, _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), weight));
+            high = _mm_add_epi16(high, _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), weight));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x + 8]), high);
+    }
+
+    ResizeVerticalElements_Scalar(src, weights, numTaps, dst, x, end);
+}
+
+static void ResizeVerticalRow_SSE4(const byte* const* src, const int* weights, int numTaps, unsigned short* dst, int count)
+{
+    ResizeVerticalElements_SSE4(src, weights, numTaps, dst, 0, count);
+}
+#pragma endregion SSE4
+
+#pragma region AVX2
+static inline __m256i Dot3_AVX2(__m256i pixels, __m256i c0, __m256i c1, __m256i c2)
+{
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    __m256i ch0 = _mm256_and_si256(pixels, byteMask);
+    __m256i ch1 = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask);
+    __m256i ch2 = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask);
+
+    return _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(ch0, c0), _mm256_mullo_epi32(ch1, c1)), _mm256_mullo_epi32(ch2, c2));
+}
+
+static void RGBAToYRow_AVX2(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    const __m256i c0 = _mm256_set1_epi32(c.y[0]);
+    const __m256i c1 = _mm256_set1_epi32(c.y[1]);
+    const __m256i c2 = _mm256_set1_epi32(c.y[2]);
+    const __m256i round = _mm256_set1_epi32(COLOR_ROUND);
+    const __m256i offset = _mm256_set1_epi32(c.yOffset);
+    // Packing works within 128 bit lanes, this puts the 4 byte groups back in pixel order.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+    int x = 0;
+    for (; width - x >= 32; x += 32)
+    {
+        __m256i y[4];
+        for (int i = 0; i < 4; i++)
+        {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[(x + i * 8) * 4]));
+            y[i] = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(Dot3_AVX2(pixels, c0, c1, c2), round), COLOR_SHIFT), offset);
+        }
+
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(y[0], y[1]), _mm256_packs_epi32(y[2], y[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[x]), _mm256_permutevar8x32_epi32(packed, order));
+    }
+
+    _mm256_zeroupper();
+    RGBAToYRow_SSE4(&src[x * 4], &dst[x], width - x, c);
+}
+
+static void RGBAToUVRow_AVX2(const byte* src0, const byte* src1, byte* dst, int width, const Coefficients& c)
+{
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i bias = _mm256_set1_epi32(CHROMA_BIAS);
+
+    int x = 0;
+    for (; width - x >= 16; x += 16)
+    {
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src0[x * 4]));
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src0[x * 4 + 32]));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src1[x * 4]));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src1[x * 4 + 32]));
+
+        // hadd works within 128 bit lanes, so the 8 block sums come out as 0 1 4 5 2 3 6 7.
+        __m256i sums[3];
+        for (int i = 0; i < 3; i++)
+        {
+            __m256i a = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(a0, i * 8), byteMask), _mm256_and_si256(_mm256_srli_epi32(a1, i * 8), byteMask));
+            __m256i b = _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(b0, i * 8), byteMask), _mm256_and_si256(_mm256_srli_epi32(b1, i * 8), byteMask));
+            sums[i] = _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+        }
+
+        __m256i u = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sums[0], _mm256_set1_epi32(c.u[0])), _mm256_mullo_epi32(sums[1], _mm256_set1_epi32(c.u[1]))),
+            _mm256_add_epi32(_mm256_mullo_epi32(sums[2], _mm256_set1_epi32(c.u[2])), bias));
+        __m256i v = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sums[0], _mm256_set1_epi32(c.v[0])), _mm256_mullo_epi32(sums[1], _mm256_set1_epi32(c.v[1]))),
+            _mm256_add_epi32(_mm256_mullo_epi32(sums[2], _mm256_set1_epi32(c.v[2])), bias));
+        u = _mm256_srai_epi32(u, CHROMA_SHIFT);
+        v = _mm256_srai_epi32(v, CHROMA_SHIFT);
+
+        // Per 128 bit lane: u0 u1 u2 u3 v0 v1 v2 v3 -> u0 v0 u1 v1 u2 v2 u3 v3, then gather both lanes' bytes into the low 16.
+        __m256i uv = _mm256_packs_epi32(u, v);
+        uv = _mm256_unpacklo_epi16(uv, _mm256_srli_si256(uv, 8));
+        uv = _mm256_permute4x64_epi64(_mm256_packus_epi16(uv, uv), _MM_SHUFFLE(3, 3, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[x]), _mm256_castsi256_si128(uv));
+    }
+
+    _mm256_zeroupper();
+    RGBAToUVRow_SSE4(&src0[x * 4], &src1[x * 4], &dst[x], width - x, c);
+}
+
+// Converts 8 pixels given as 32 bit Y, U and V values and stores them as RGBA.
+static inline void StoreYUVAsRGBA_AVX2(__m256i y, __m256i u, __m256i v, byte* dst, const Coefficients& c)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi32(255);
+
+    __m256i luma = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(y, _mm256_set1_epi32(c.yOffset)), _mm256_set1_epi32(c.yScale)), _mm256_set1_epi32(COLOR_ROUND));
+    u = _mm256_sub_epi32(u, _mm256_set1_epi32(128));
+    v = _mm256_sub_epi32(v, _mm256_set1_epi32(128));
+
+    __m256i rgba = _mm256_set1_epi32(0xFF000000);
+    for (int i = 0; i < 3; i++)
+    {
+        __m256i channel = _mm256_add_epi32(luma, _mm256_add_epi32(_mm256_mullo_epi32(u, _mm256_set1_epi32(c.uToChannel[i])), _mm256_mullo_epi32(v, _mm256_set1_epi32(c.vToChannel[i]))));
+        channel = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(channel, COLOR_SHIFT), zero), max);
+        rgba = _mm256_or_si256(rgba, _mm256_slli_epi32(channel, i * 8));
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), rgba);
+}
+
+static void NV12ToRGBARow_AVX2(const byte* srcY, const byte* srcUV, byte* dst, int width, const Coefficients& c)
+{
+    int x = 0;
+    for (; width - x >= 8; x += 8)
+    {
+        __m256i y = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&srcY[x])));
+        __m256i uv = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&srcUV[x])));
+        __m256i u = _mm256_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0));
+        __m256i v = _mm256_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1));
+
+        StoreYUVAsRGBA_AVX2(y, u, v, &dst[x * 4], c);
+    }
+
+    _mm256_zeroupper();
+    NV12ToRGBARow_SSE4(&srcY[x], &srcUV[x], &dst[x * 4], width - x, c);
+}
+
+static void UYVYToRGBARow_AVX2(const byte* src, byte* dst, int width, const Coefficients& c)
+{
+    // Gather the Y, U and V bytes of 8 pixels into the low 8 bytes, then widen them to 32 bit lanes.
+    const __m128i yShuffle = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i uShuffle = _mm_setr_epi8(0, 0, 4, 4, 8, 8, 12, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i vShuffle = _mm_setr_epi8(2, 2, 6, 6, 10, 10, 14, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    int x = 0;
+    for (; width - x >= 8; x += 8)
+    {
+        __m128i uyvy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[x * 2]));
+        StoreYUVAsRGBA_AVX2(
+            _mm256_cvtepu8_epi32(_mm_shuffle_epi8(uyvy, yShuffle)),
+            _mm256_cvtepu8_epi32(_mm_shuffle_epi8(uyvy, uShuffle)),
+            _mm256_cvtepu8_epi32(_mm_shuffle_epi8(uyvy, vShuffle)),
+            &dst[x * 4], c);
+    }
+
+    _mm256_zeroupper();
+    UYVYToRGBARow_SSE4(&src[x * 2], &dst[x * 4], width - x, c);
+}
+
+static void ResizeVerticalRow_AVX2(const byte* const* src, const int* weights, int numTaps, unsigned short* dst, int count)
+{
+    int x = 0;
+    for (; count - x >= 32; x += 32)
+    {
+        __m256i low = _mm256_setzero_si256(), high = _mm256_setzero_si256();
+        for (int tap = 0; tap < numTaps; tap++)
+        {
+            __m256i weight = _mm256_set1_epi16((short)weights[tap]);
+            const __m128i* pixels = reinterpret_cast<const __m128i*>(&src[tap][x]);
+            low = _mm256_add_epi16(low, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(pixels)), weight));
+            high = _mm256_add_epi16(high, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(pixels + 1)), weight));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[x]), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dst[x + 16]), high);
+    }
+
+    _mm256_zeroupper();
+    ResizeVerticalElements_SSE4(src, weights, numTaps, dst, x, count);
+}
+
+// Taps start at a different element for every output, so they are gathered.
+// Each gather reads 2 bytes past its element, the source row is padded for that.
+static void ResizeHorizontalRow_AVX2(const unsigned short* src, const int* offsets, const int* weights, int numTaps, int channels, int count, byte* dst)
+{
+    const __m256i elementMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i round = _mm256_set1_epi32(RESIZE_ROUND);
+    // After packing, elements 0-3 are in the first 4 bytes of each lane.
+    const __m256i lanes = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+    int i = 0;
+    for (; count - i >= 8; i += 8)
+    {
+        __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&offsets[i]));
+        __m256i sum = round;
+        for (int tap = 0; tap < numTaps; tap++)
+        {
+            __m256i values = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(src), index, 2), elementMask);
+            __m256i weight = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&weights[tap * count + i]));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(values, weight));
+            index = _mm256_add_epi32(index, _mm256_set1_epi32(channels));
+        }
+
+        __m256i result = _mm256_srli_epi32(sum, RESIZE_SHIFT);
+        result = _mm256_packus_epi32(result, result);
+        result = _mm256_packus_epi16(result, result);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&dst[i]), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(result, lanes)));
+    }
+
+    _mm256_zeroupper();
+    ResizeHorizontalElements_Scalar(src, offsets, weights, numTaps, channels, count, dst, i, count);
+}
+#pragma endregion AVX2
+#endif
+
+struct RowFunctions
+{
+    void(*rgbaToY)(const byte* src, byte* dst, int width, const Coefficients& c);
+    void(*rgbaToUV)(const byte* src0, const byte* src1, byte* dst, int width, const Coefficients& c);
+    void(*nv12ToRGBA)(const byte* srcY, const byte* srcUV, byte* dst, int width, const Coefficients& c);
+    void(*uyvyToRGBA)(const byte* src, byte* dst, int width, const Coefficients& c);
+    void(*bgrToBGRA)(const byte* src, byte* dst, int width, const Coefficients& c);
+    void(*resizeVertical)(const byte* const* src, const int* weights, int numTaps, unsigned short* dst, int count);
+    void(*resizeHorizontal)(const unsigned short* src, const int* offsets, const int* weights, int numTaps, int channels, int count, byte* dst);
+};
+
+static bool GetRowFunctions(ColorConversion::Implementation implementation, RowFunctions& functions)
+{
+    if (implementation == ColorConversion::Implementation::Auto)
+    {
+        implementation = ColorConversion::IsSupported(ColorConversion::Implementation::AVX2) ? ColorConversion::Implementation::AVX2
+            : (ColorConversion::IsSupported(ColorConversion::Implementation::SSE4) ? ColorConversion::Implementation::SSE4 : ColorConversion::Implementation::Scalar);
+    }
+
+    if (!ColorConversion::IsSupported(implementation))
+    {
+        return false;
+    }
+
+    switch (implementation)
+    {
+#if COLOR_CONVERSION_USE_SIMD
+    case ColorConversion::Implementation::AVX2:
+        // Expanding BGR is a byte shuffle that is limited by memory bandwidth, so it keeps the SSE4 kernel.
+        functions = { RGBAToYRow_AVX2, RGBAToUVRow_AVX2, NV12ToRGBARow_AVX2, UYVYToRGBARow_AVX2, BGRToBGRARow_SSE4,
+            ResizeVerticalRow_AVX2, ResizeHorizontalRow_AVX2 };
+        return true;
+    case ColorConversion::Implementation::SSE4:
+        // SSE4 has no gather, so the horizontal pass of a resize stays scalar.
+        functions = { RGBAToYRow_SSE4, RGBAToUVRow_SSE4, NV12ToRGBARow_SSE4, UYVYToRGBARow_SSE4, BGRToBGRARow_SSE4,
+            ResizeVerticalRow_SSE4, ResizeHorizontalRow_Scalar };
+        return true;
+#endif
+    default:
+        functions = { RGBAToYRow_Scalar, RGBAToUVRow_Scalar, NV12ToRGBARow_Scalar, UYVYToRGBARow_Scalar, BGRToBGRARow_Scalar,
+            ResizeVerticalRow_Scalar, ResizeHorizontalRow_Scalar };
+        return true;
+    }
+}
+
+bool ColorConversion::IsSupported(Implementation implementation)
+{
+#if COLOR_CONVERSION_USE_SIMD
+    struct CPUFeatures
+    {
+        bool sse4;
+        bool avx2;
+
+        CPUFeatures()
+        {
+            int info[4];
+            __cpuid(info, 1);
+            sse4 = (info[2] & (1 << 19)) != 0;
+
+            // AVX2 also needs the OS to save the upper halves of the ymm registers.
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool ymmEnabled = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            avx2 = sse4 && ymmEnabled && (info[1] & (1 << 5)) != 0;
+        }
+    };
+
+    // Conversions run on capture, render and encoder threads, and the first of them to get here initializes this.
+    static const CPUFeatures features;
+
+    switch (implementation)
+    {
+    case Implementation::SSE4:
+        return features.sse4;
+    case Implementation::AVX2:
+        return features.avx2;
+    default:
+        return true;
+    }
+#else
+    return implementation == Implementation::Auto || implementation == Implementation::Scalar;
+#endif
+}
+
+bool ColorConversion::Convert(Conversion conversion, bool bgra,
+    const byte* src, int srcStride, const byte* srcUV, int srcUVStride,
+    byte* dst, int dstStride, byte* dstUV, int dstUVStride,
+    int width, int height, const Options& options)
+{
+    if (src == nullptr || dst == nullptr || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    // YUV formats share chroma between pairs of pixels.
+    if (conversion != Conversion::BGRToBGRA && (width & 1) != 0)
+    {
+        return false;
+    }
+
+    bool nv12 = conversion == Conversion::RGBAToNV12 || conversion == Conversion::NV12ToRGBA;
+    if (nv12 && ((height & 1) != 0 || (conversion == Conversion::RGBAToNV12 ? dstUV : srcUV) == nullptr))
+    {
+        return false;
+    }
+
+    RowFunctions functions;
+    if (!GetRowFunctions(options.implementation, functions))
+    {
+        return false;
+    }
+
+    Coefficients c = GetCoefficients(options, bgra);
+
+    auto convertRows = [&](int startRow, int endRow)
+    {
+        for (int row = startRow; row < endRow; row++)
+        {
+            const byte* srcRow = src + (size_t)row * srcStride;
+            byte* dstRow = dst + (size_t)row * dstStride;
+
+            switch (conversion)
+            {
+            case Conversion::RGBAToNV12:
+                functions.rgbaToY(srcRow, dstRow, width, c);
+                if ((row & 1) == 0)
+                {
+                    functions.rgbaToUV(srcRow, srcRow + srcStride, dstUV + (size_t)(row / 2) * dstUVStride, width, c);
+                }
+                break;
+            case Conversion::NV12ToRGBA:
+                functions.nv12ToRGBA(srcRow, srcUV + (size_t)(row / 2) * srcUVStride, dstRow, width, c);
+                break;
+            case Conversion::UYVYToRGBA:
+                functions.uyvyToRGBA(srcRow, dstRow, width, c);
+                break;
+            case Conversion::BGRToBGRA:
+                functions.bgrToBGRA(srcRow, dstRow, width, c);
+                break;
+            }
+        }
+    };
+
+    int numTasks = (height + COLOR_CONVERSION_ROWS_PER_TASK - 1) / COLOR_CONVERSION_ROWS_PER_TASK;
+    if (!options.parallel || numTasks == 1)
+    {
+        convertRows(0, height);
+        return true;
+    }
+
+    concurrency::parallel_for(0, numTasks, [&](int task)
+    {
+        int startRow = task * COLOR_CONVERSION_ROWS_PER_TASK;
+        convertRows(startRow, (std::min)(startRow + COLOR_CONVERSION_ROWS_PER_TASK, height));
+    });
+
+    return true;
+}
+
+// Area resampling taps along one axis of a downscale.
+struct ResizeTaps
+{
+    // Every output element has numTaps taps, elements that cover fewer source pixels have taps with no weight.
+    int numTaps = 0;
+    // First source element of each output element.
+    std::vector<int> offsets;
+    // weights[tap * count + i] for output element i.
+    std::vector<int> weights;
+};
+
+// Each output pixel is the average of the source pixels it covers, weighted by how much of each it covers.
+// channels interleaved channels share the taps of their pixel.
+static void GetResizeTaps(int srcSize, int dstSize, int channels, ResizeTaps& taps)
+{
+    // Measured in units where a source pixel is dstSize long and an output pixel is srcSize long, so every edge is an integer.
+    taps.numTaps = 0;
+    for (int i = 0; i < dstSize; i++)
+    {
+        int first = (i * srcSize) / dstSize;
+        int last = ((i + 1) * srcSize - 1) / dstSize;
+        taps.numTaps = (std::max)(taps.numTaps, last - first + 1);
+    }
+
+    int count = dstSize * channels;
+    taps.offsets.resize(count);
+    taps.weights.assign((size_t)taps.numTaps * count, 0);
+
+    for (int i = 0; i < dstSize; i++)
+    {
+        int start = i * srcSize;
+        int end = start + srcSize;
+        int first = start / dstSize;
+        int last = (end - 1) / dstSize;
+
+        // Weights come from the rounded running total, so they always sum to exactly RESIZE_WEIGHT_ONE.
+        int covered = 0, weightSum = 0;
+        for (int tap = 0; tap <= last - first; tap++)
+        {
+            int pixel = first + tap;
+            covered += (std::min)((pixel + 1) * dstSize, end) - (std::max)(pixel * dstSize, start);
+            int total = (covered * RESIZE_WEIGHT_ONE + srcSize / 2) / srcSize;
+
+            for (int channel = 0; channel < channels; channel++)
+            {
+                taps.weights[(size_t)tap * count + i * channels + channel] = total - weightSum;
+            }
+            weightSum = total;
+        }
+
+        for (int channel = 0; channel < channels; channel++)
+        {
+            taps.offsets[i * channels + channel] = first * channels + channel;
+        }
+    }
+}
+
+static void ResizePlane(const RowFunctions& functions, const byte* src, int srcStride, int srcWidth, int srcHeight,
+    byte* dst, int dstStride, int dstWidth, int dstHeight, int channels, bool parallel)
+{
+    ResizeTaps columns, rows;
+    GetResizeTaps(srcWidth, dstWidth, channels, columns);
+    GetResizeTaps(srcHeight, dstHeight, 1, rows);
+
+    int srcCount = srcWidth * channels;
+    int dstCount = dstWidth * channels;
+
+    auto resizeRows = [&](int startRow, int endRow)
+    {
+        // Taps with no weight can read past the last pixel of a row, and gathers read one element past their tap.
+        std::vector<unsigned short> blended(srcCount + columns.numTaps * channels + 2, 0);
+        std::vector<const byte*> srcRows(rows.numTaps);
+        std::vector<int> rowWeights(rows.numTaps);
+
+        for (int row = startRow; row < endRow; row++)
+        {
+            for (int tap = 0; tap < rows.numTaps; tap++)
+            {
+                // Taps with no weight past the last row read the last row instead.
+                srcRows[tap] = src + (size_t)(std::min)(rows.offsets[row] + tap, srcHeight - 1) * srcStride;
+                rowWeights[tap] = rows.weights[(size_t)tap * dstHeight + row];
+            }
+
+            functions.resizeVertical(srcRows.data(), rowWeights.data(), rows.numTaps, blended.data(), srcCount);
+            functions.resizeHorizontal(blended.data(), columns.offsets.data(), columns.weights.data(), columns.numTaps, channels, dstCount,
+                dst + (size_t)row * dstStride);
+        }
+    };
+
+    int numTasks = (dstHeight + COLOR_CONVERSION_ROWS_PER_TASK - 1) / COLOR_CONVERSION_ROWS_PER_TASK;
+    if (!parallel || numTasks == 1)
+    {
+        resizeRows(0, dstHeight);
+        return;
+    }
+
+    concurrency::parallel_for(0, numTasks, [&](int task)
+    {
+        int startRow = task * COLOR_CONVERSION_ROWS_PER_TASK;
+        resizeRows(startRow, (std::min)(startRow + COLOR_CONVERSION_ROWS_PER_TASK, dstHeight));
+    });
+}
+
+bool ColorConversion::ResizeNV12(const byte* srcY, int srcYStride, const byte* srcUV, int srcUVStride, int srcWidth, int srcHeight,
+    byte* dstY, int dstYStride, byte* dstUV, int dstUVStride, int dstWidth, int dstHeight, const Options& options)
+{
+    if (srcY == nullptr || srcUV == nullptr || dstY == nullptr || dstUV == nullptr ||
+        dstWidth <= 0 || dstHeight <= 0 || dstWidth > srcWidth || dstHeight > srcHeight ||
+        ((srcWidth | srcHeight | dstWidth | dstHeight) & 1) != 0)
+    {
+        return false;
+    }
+
+    RowFunctions functions;
+    if (!GetRowFunctions(options.implementation, functions))
+    {
+        return false;
+    }
+
+    ResizePlane(functions, srcY, srcYStride, srcWidth, srcHeight, dstY, dstYStride, dstWidth, dstHeight, 1, options.parallel);
+    ResizePlane(functions, srcUV, srcUVStride, srcWidth / 2, srcHeight / 2, dstUV, dstUVStride, dstWidth / 2, dstHeight / 2, 2, options.parallel);
+    return true;
+}
+
+bool ColorConversion::RGBAToNV12(const byte* src, int srcStride, byte* dstY, int dstYStride, byte* dstUV, int dstUVStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::RGBAToNV12, false, src, srcStride, nullptr, 0, dstY, dstYStride, dstUV, dstUVStride, width, height, options);
+}
+
+bool ColorConversion::BGRAToNV12(const byte* src, int srcStride, byte* dstY, int dstYStride, byte* dstUV, int dstUVStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::RGBAToNV12, true, src, srcStride, nullptr, 0, dstY, dstYStride, dstUV, dstUVStride, width, height, options);
+}
+
+bool ColorConversion::NV12ToRGBA(const byte* srcY, int srcYStride, const byte* srcUV, int srcUVStride, byte* dst, int dstStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::NV12ToRGBA, false, srcY, srcYStride, srcUV, srcUVStride, dst, dstStride, nullptr, 0, width, height, options);
+}
+
+bool ColorConversion::NV12ToBGRA(const byte* srcY, int srcYStride, const byte* srcUV, int srcUVStride, byte* dst, int dstStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::NV12ToRGBA, true, srcY, srcYStride, srcUV, srcUVStride, dst, dstStride, nullptr, 0, width, height, options);
+}
+
+bool ColorConversion::UYVYToRGBA(const byte* src, int srcStride, byte* dst, int dstStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::UYVYToRGBA, false, src, srcStride, nullptr, 0, dst, dstStride, nullptr, 0, width, height, options);
+}
+
+bool ColorConversion::UYVYToBGRA(const byte* src, int srcStride, byte* dst, int dstStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::UYVYToRGBA, true, src, srcStride, nullptr, 0, dst, dstStride, nullptr, 0, width, height, options);
+}
+
+bool ColorConversion::BGRToBGRA(const byte* src, int srcStride, byte* dst, int dstStride, int width, int height, const Options& options)
+{
+    return Convert(Conversion::BGRToBGRA, false, src, srcStride, nullptr, 0, dst, dstStride, nullptr, 0, width, height, options);
+}
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// CPU color conversion between the compositor's RGBA frames and the YUV formats used by capture cards and the video encoder.
+// Every conversion has a scalar reference implementation and SSE4.1 / AVX2 versions that produce bit-identical output.
+// Rows are split across cores with PPL.
+//
+// Formats:
+//  - RGBA / BGRA: 4 bytes per pixel, alpha is written as 255.
+//  - NV12: full resolution Y plane followed by a half resolution plane of interleaved U, V.
+//  - UYVY: 2 bytes per pixel, U0 Y0 V0 Y1 (the capture card format, see DirectXHelper.h).
+//  - BGR: 3 bytes per pixel (OpenCV's capture format).
+//
+// NV12 frames can also be downscaled, for recording smaller copies of the composite.
+
+#pragma once
+#include <Windows.h>
+
+class ColorConversion
+{
+public:
+    enum class ColorSpace
+    {
+        BT601,
+        BT709
+    };
+
+    enum class ColorRange
+    {
+        // Y in [16, 235], U and V in [16, 240].
+        Limited,
+        Full
+    };
+
+    enum class Implementation
+    {
+        // Fastest implementation this CPU supports.
+        Auto,
+        Scalar,
+        SSE4,
+        AVX2
+    };
+
+    struct Options
+    {
+        // Defaults match the YUV shaders (BT.601 limited range).
+        Options() :
+            colorSpace(ColorSpace::BT601),
+            range(ColorRange::Limited),
+            implementation(Implementation::Auto),
+            parallel(true)
+        {
+        }
+
+        ColorSpace colorSpace;
+        ColorRange range;
+        Implementation implementation;
+        // Split rows across cores.
+        bool parallel;
+    };
+
+    // Strides are in bytes.  NV12 conversions require an even width and height.
+    // Return false if the arguments are invalid or the requested implementation is not supported by this CPU.
+    static bool RGBAToNV12(const byte* src, int srcStride, byte* dstY, int dstYStride, byte* dstUV, int dstUVStride, int width, int height, const Options& options = Options());
+    static bool BGRAToNV12(const byte* src, int srcStride, byte* dstY, int dstYStride, byte* dstUV, int dstUVStride, int width, int height, const Options& options = Options());
+    static bool NV12ToRGBA(const byte* srcY, int srcYStride, const byte* srcUV, int srcUVStride, byte* dst, int dstStride, int width, int height, const Options& options = Options());
+    static bool NV12ToBGRA(const byte* srcY, int srcYStride, const byte* srcUV, int srcUVStride, byte* dst, int dstStride, int width, int height, const Options& options = Options());
+    static bool UYVYToRGBA(const byte* src, int srcStride, byte* dst, int dstStride, int width, int height, const Options& options = Options());
+    static bool UYVYToBGRA(const byte* src, int srcStride, byte* dst, int dstStride, int width, int height, const Options& options = Options());
+
+    // Expand 3 byte pixels to 4 with an opaque alpha, keeping the channel order.  Any width is allowed.
+    // The color texture stores capture frames in BGRA order, so BGR frames are not swizzled.
+    static bool BGRToBGRA(const byte* src, int srcStride, byte* dst, int dstStride, int width, int height, const Options& options = Options());
+
+    // Area (box filter) downscale of an NV12 frame, each output pixel is the average of the source pixels it covers.
+    // The output must be no larger than the source in either dimension, and every size must be even.
+    // colorSpace and range are ignored.
+    static bool ResizeNV12(const byte* srcY, int srcYStride, const byte* srcUV, int srcUVStride, int srcWidth, int srcHeight,
+        byte* dstY, int dstYStride, byte* dstUV, int dstUVStride, int dstWidth, int dstHeight, const Options& options = Options());
+
+    static bool IsSupported(Implementation implementation);
+
+private:
+    enum class Conversion
+    {
+        RGBAToNV12,
+        NV12ToRGBA,
+        UYVYToRGBA,
+        BGRToBGRA
+    };
+
+    static bool Convert(Conversion conversion, bool bgra,
+        const byte* src, int srcStride, const byte* srcUV, int srcUVStride,
+        byte* dst, int dstStride, byte* dstUV, int dstUVStride,
+        int width, int height, const Options& options);
+};
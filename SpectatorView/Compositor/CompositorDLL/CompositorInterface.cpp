@@ -7,11 +7,7 @@
 
 CompositorInterface::CompositorInterface()
 {
-    wchar_t myDocumentsPath[1024];
-    SHGetFolderPathW(0, CSIDL_MYDOCUMENTS, 0, 0, myDocumentsPath);
-    outputPath = std::wstring(myDocumentsPath) + L"\\HologramCapture\\";
-
-    DirectoryHelper::CreateOutputDirectory(outputPath);
+    CreateOutputDirectory();
 
 #if USE_DECKLINK || USE_DECKLINK_SHUTTLE
     frameProvider = new DeckLinkManager();
@@ -22,11 +18,45 @@ CompositorInterface::CompositorInterface()
 #if USE_OPENCV
     frameProvider = new OpenCVFrameProvider();
 #endif
+#if USE_CAPTURE_FILE
+    std::wstring captureFilePath = CAPTURE_FILE_NAME;
+    if (PathIsRelative(captureFilePath.c_str()))
+    {
+        captureFilePath = outputPath + captureFilePath;
+    }
+    frameProvider = new CaptureFileFrameProvider(captureFilePath);
+#endif
+#if USE_SYNTHETIC_FRAMES
+    frameProvider = new SyntheticFrameProvider();
+#endif
+}
+
+CompositorInterface::CompositorInterface(IFrameProvider* frameProvider) :
+    frameProvider(frameProvider)
+{
+    CreateOutputDirectory();
 }
 
 CompositorInterface::~CompositorInterface()
 {
-    delete[] photoBytes;
+    delete videoEncoder;
+
+    // Finishes writing queued pictures.
+    delete pictureEncoder;
+    for (PictureReadback& readback : pictureReadbacks)
+    {
+        SafeRelease(readback.texture);
+    }
+    SafeRelease(pictureResolveTexture);
+}
+
+void CompositorInterface::CreateOutputDirectory()
+{
+    wchar_t myDocumentsPath[1024];
+    SHGetFolderPathW(0, CSIDL_MYDOCUMENTS, 0, 0, myDocumentsPath);
+    outputPath = std::wstring(myDocumentsPath) + L"\\HologramCapture\\";
+
+    DirectoryHelper::CreateOutputDirectory(outputPath);
 }
 
 bool CompositorInterface::Initialize(ID3D11Device* device, ID3D11ShaderResourceView* colorSRV, ID3D11Texture2D* outputTexture)
@@ -50,8 +80,6 @@ bool CompositorInterface::Initialize(ID3D11Device* device, ID3D11ShaderResourceV
         timeSynchronizer.Reset();
         poseCache.Reset();
         CurrentCompositeFrame = 0;
-
-        AllocateVideoBuffers();
     }
     return SUCCEEDED(hr);
 }
@@ -67,10 +95,7 @@ void CompositorInterface::UpdateFrameProvider()
 
 void CompositorInterface::Update()
 {
-    if (videoEncoder != nullptr)
-    {
-        videoEncoder->Update();
-    }
+    // Recorded frames are encoded on the VideoEncoder's own thread, so there is nothing to pump here.
 }
 
 void CompositorInterface::StopFrameProvider()
@@ -84,7 +109,6 @@ void CompositorInterface::StopFrameProvider()
     timeSynchronizer.Reset();
     CurrentCompositeFrame = 0;
     VideoTextureBuffer.ReleaseTextures();
-    FreeVideoBuffers();
 }
 
 LONGLONG CompositorInterface::GetTimestamp(int frame)
@@ -167,18 +191,148 @@ void CompositorInterface::TakePicture(ID3D11Texture2D* outputTexture)
         return;
     }
 
+    if (numPictureReadbacks == NUM_PICTURE_READBACKS)
+    {
+        OutputDebugString(L"Dropping picture, previous pictures are still being read back.\n");
+        if (pictureEncoder != nullptr)
+        {
+            pictureEncoder->AddDroppedPicture();
+        }
+        return;
+    }
+
+    D3D11_TEXTURE2D_DESC desc;
+    outputTexture->GetDesc(&desc);
+
+    if (pictureEncoder == nullptr)
+    {
+        pictureEncoder = new PictureEncoder(desc.Width, desc.Height);
+        pictureEncoder->SetCallback(pictureSavedCallback);
+    }
+
+    // Only the top mip of the first slice is read back, from a single-sample texture.
+    bool multisampled = desc.SampleDesc.Count > 1;
+    // ResolveSubresource needs a typed format, and render textures are often typeless so they can also be viewed as sRGB.
+    DXGI_FORMAT format = desc.Format;
+    if (format == DXGI_FORMAT_R8G8B8A8_TYPELESS)
+    {
+        format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    }
+    else if (format == DXGI_FORMAT_B8G8R8A8_TYPELESS)
+    {
+        format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    }
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.MiscFlags = 0;
+
+    if (multisampled && pictureResolveTexture == nullptr)
+    {
+        D3D11_TEXTURE2D_DESC resolveDesc = desc;
+        resolveDesc.Usage = D3D11_USAGE_DEFAULT;
+        resolveDesc.BindFlags = 0;
+        resolveDesc.CPUAccessFlags = 0;
+
+        if (FAILED(_device->CreateTexture2D(&resolveDesc, NULL, &pictureResolveTexture)))
+        {
+            return;
+        }
+    }
+
+    PictureReadback& readback = pictureReadbacks[(firstPictureReadback + numPictureReadbacks) % NUM_PICTURE_READBACKS];
+    if (readback.texture == nullptr)
+    {
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.BindFlags = 0;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+        if (FAILED(_device->CreateTexture2D(&desc, NULL, &readback.texture)))
+        {
+            return;
+        }
+    }
+
     ID3D11DeviceContext* context;
     _device->GetImmediateContext(&context);
-
-    // Get bytes from texture because screengrab does not support texture format provided by Unity.
-    DirectXHelper::GetBytesFromTexture(_device, outputTexture, FRAME_BPP, photoBytes);
-    ID3D11Texture2D* tex = DirectXHelper::CreateTexture(_device, photoBytes, FRAME_WIDTH, FRAME_HEIGHT, FRAME_BPP, DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+    ID3D11Texture2D* source = outputTexture;
+    if (multisampled)
+    {
+        context->ResolveSubresource(pictureResolveTexture, 0, outputTexture, 0, format);
+        source = pictureResolveTexture;
+    }
+    context->CopySubresourceRegion(readback.texture, 0, 0, 0, 0, source, 0, NULL);
+    context->Release();
 
     photoIndex++;
-    std::wstring photoPath = DirectoryHelper::FindUniqueFileName(outputPath, L"Photo", L".png", photoIndex);
+    readback.path = DirectoryHelper::FindUniqueFileName(outputPath, L"Photo", PICTURE_JPEG ? L".jpg" : L".png", photoIndex);
+    numPictureReadbacks++;
+}
+
+void CompositorInterface::UpdatePictures()
+{
+    if (numPictureReadbacks == 0 || _device == nullptr || pictureEncoder == nullptr)
+    {
+        return;
+    }
+
+    ID3D11DeviceContext* context;
+    _device->GetImmediateContext(&context);
+
+    while (numPictureReadbacks > 0)
+    {
+        PictureReadback& readback = pictureReadbacks[firstPictureReadback];
+
+        // Wait for a buffer before mapping, so a busy encoder does not hold the staging texture mapped.
+        BYTE* buffer = pictureEncoder->GetFreeBuffer();
+        if (buffer == nullptr)
+        {
+            break;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = context->Map(readback.texture, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        {
+            pictureEncoder->ReleaseBuffer(buffer);
+            break;
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            D3D11_TEXTURE2D_DESC desc;
+            readback.texture->GetDesc(&desc);
+
+            UINT stride = desc.Width * FRAME_BPP;
+            for (UINT y = 0; y < desc.Height; y++)
+            {
+                memcpy(&buffer[y * stride], (BYTE*)mapped.pData + y * mapped.RowPitch, stride);
+            }
+            context->Unmap(readback.texture, 0);
+
+            pictureEncoder->QueuePicture(buffer, readback.path);
+        }
+        else
+        {
+            OutputDebugString(L"ERROR: Could not read back picture.\n");
+            pictureEncoder->ReleaseBuffer(buffer);
+        }
+
+        firstPictureReadback = (firstPictureReadback + 1) % NUM_PICTURE_READBACKS;
+        numPictureReadbacks--;
+    }
+
+    context->Release();
+}
 
-    //TODO: Save each channel?
-    DirectX::SaveWICTextureToFile(context, tex, GUID_ContainerFormatPng, photoPath.c_str());
+void CompositorInterface::SetPictureSavedCallback(PictureSavedCallback callback)
+{
+    pictureSavedCallback = callback;
+    if (pictureEncoder != nullptr)
+    {
+        pictureEncoder->SetCallback(callback);
+    }
 }
 
 bool CompositorInterface::InitializeVideoEncoder(ID3D11Device* device)
@@ -190,6 +344,11 @@ bool CompositorInterface::InitializeVideoEncoder(ID3D11Device* device)
 }
 
 void CompositorInterface::StartRecording()
+{
+    StartRecording(VIDEO_RENDITIONS);
+}
+
+void CompositorInterface::StartRecording(std::vector<VideoEncoder::Rendition> renditions)
 {
     if (videoEncoder == nullptr)
     {
@@ -198,7 +357,14 @@ void CompositorInterface::StartRecording()
 
     videoIndex++;
     std::wstring videoPath = DirectoryHelper::FindUniqueFileName(outputPath, L"Video", L".mp4", videoIndex);
-    videoEncoder->StartRecording(videoPath.c_str(), ENCODE_AUDIO);
+
+    // Renditions share the video's number, so they sort next to it.
+    for (VideoEncoder::Rendition& rendition : renditions)
+    {
+        rendition.path = outputPath + std::to_wstring(videoIndex) + L"_Video_" + std::to_wstring(rendition.height) + L"p.mp4";
+    }
+
+    videoEncoder->StartRecording(videoPath.c_str(), ENCODE_AUDIO, renditions);
 }
 
 void CompositorInterface::StopRecording()
@@ -215,67 +381,105 @@ void CompositorInterface::StopRecording()
     lastVideoFrame = -1;
 }
 
-void CompositorInterface::UpdateVideoRecordingFrame(ID3D11Texture2D* videoTexture)
+void CompositorInterface::GetRecordingQueueStats(int& videoQueueDepth, int& audioQueueDepth, int& videoFramesDropped, int& audioFramesDropped)
 {
-    // We have an old frame, lets get the data and queue it now.
-    if (VideoTextureBuffer.IsDataAvailable())
+    if (videoEncoder == nullptr)
     {
-        videoBufferIndex = (videoBufferIndex + 1) % NUM_VIDEO_BUFFERS;
-        float bpp = 1.5f;
-
-        VideoTextureBuffer.FetchTextureData(_device, videoBytes[videoBufferIndex], bpp);
-        RecordFrameAsync(videoBytes[videoBufferIndex], queuedVideoFrameTime, queuedVideoFrameCount);
+        videoQueueDepth = audioQueueDepth = videoFramesDropped = audioFramesDropped = 0;
+        return;
     }
 
-    if (lastVideoFrame >= 0 && lastRecordedVideoFrame != lastVideoFrame)
+    videoQueueDepth = videoEncoder->GetVideoQueueDepth();
+    audioQueueDepth = videoEncoder->GetAudioQueueDepth();
+    videoFramesDropped = videoEncoder->GetNumVideoFramesDropped();
+    audioFramesDropped = videoEncoder->GetNumAudioFramesDropped();
+}
+
+std::vector<VideoEncoder::RenditionStats> CompositorInterface::GetRenditionStats()
+{
+    if (videoEncoder == nullptr)
     {
-        queuedVideoFrameCount = GetCurrentCompositeFrame() - lastVideoFrame;
-        if (queuedVideoFrameCount <= 0)
-            queuedVideoFrameCount = lastVideoFrame - lastRecordedVideoFrame;
-        if (queuedVideoFrameCount <= 0)
-            queuedVideoFrameCount = 1;
+        return std::vector<VideoEncoder::RenditionStats>();
+    }
 
-        lastRecordedVideoFrame = lastVideoFrame;
-        queuedVideoFrameTime = lastVideoFrame * GetColorDuration();
-        VideoTextureBuffer.PrepareTextureFetch(_device, videoTexture);
+    return videoEncoder->GetRenditionStats();
+}
+
+bool CompositorInterface::StartReplay(int seconds, int memoryMB)
+{
+    if (videoEncoder == nullptr)
+    {
+        return false;
     }
 
-    lastVideoFrame = GetCurrentCompositeFrame();
+    LONGLONG duration = (LONGLONG)(seconds > 0 ? seconds : REPLAY_SECONDS) * S2HNS;
+    size_t memoryBudget = (size_t)(memoryMB > 0 ? memoryMB : REPLAY_MEMORY_MB) * 1024 * 1024;
+    return videoEncoder->StartReplay(memoryBudget, duration);
 }
 
-void CompositorInterface::AllocateVideoBuffers()
+void CompositorInterface::StopReplay()
 {
-    if (videoBytes != nullptr)
+    if (videoEncoder == nullptr)
     {
         return;
     }
 
-    videoBytes = new byte*[NUM_VIDEO_BUFFERS];
+    videoEncoder->StopReplay();
+}
 
-    for (int i = 0; i < NUM_VIDEO_BUFFERS; i++)
+bool CompositorInterface::IsReplayEnabled()
+{
+    return videoEncoder != nullptr && videoEncoder->IsReplayEnabled();
+}
+
+bool CompositorInterface::SaveReplay()
+{
+    if (videoEncoder == nullptr)
     {
-        videoBytes[i] = new byte[(int)(1.5f * FRAME_WIDTH * FRAME_HEIGHT)];
+        return false;
     }
+
+    replayIndex++;
+    std::wstring replayPath = DirectoryHelper::FindUniqueFileName(outputPath, L"Replay", L".mp4", replayIndex);
+    return videoEncoder->SaveReplay(replayPath);
 }
 
-void CompositorInterface::FreeVideoBuffers()
+void CompositorInterface::UpdateVideoRecordingFrame(ID3D11Texture2D* videoTexture)
 {
-    if (videoBytes == nullptr)
+    // We have an old frame, lets get the data and queue it now.
+    if (VideoTextureBuffer.IsDataAvailable() && videoEncoder != nullptr)
     {
-        return;
+        // Read the frame straight into the encoder's buffer.  If the encoder has fallen behind, this frame is dropped.
+        VideoEncoder::FrameBuffer* frame = videoEncoder->GetVideoFrameBuffer();
+        if (frame != nullptr)
+        {
+            float bpp = 1.5f;
+
+            VideoTextureBuffer.FetchTextureData(_device, frame->data, bpp);
+            RecordFrameAsync(frame, queuedVideoFrameTime, queuedVideoFrameCount);
+        }
     }
 
-    for (int i = 0; i < NUM_VIDEO_BUFFERS; i++)
+    if (lastVideoFrame >= 0 && lastRecordedVideoFrame != lastVideoFrame)
     {
-        delete[] videoBytes[i];
+        queuedVideoFrameCount = GetCurrentCompositeFrame() - lastVideoFrame;
+        if (queuedVideoFrameCount <= 0)
+            queuedVideoFrameCount = lastVideoFrame - lastRecordedVideoFrame;
+        if (queuedVideoFrameCount <= 0)
+            queuedVideoFrameCount = 1;
+
+        lastRecordedVideoFrame = lastVideoFrame;
+        queuedVideoFrameTime = lastVideoFrame * GetColorDuration();
+        VideoTextureBuffer.PrepareTextureFetch(_device, videoTexture);
     }
-    delete[] videoBytes;
-    videoBytes = nullptr;
+
+    lastVideoFrame = GetCurrentCompositeFrame();
 }
 
-void CompositorInterface::RecordFrameAsync(byte* bytes, LONGLONG frameTime, int numFrames)
+void CompositorInterface::RecordFrameAsync(VideoEncoder::FrameBuffer* frame, LONGLONG frameTime, int numFrames)
 {
-    if (frameProvider == nullptr || videoEncoder == nullptr || _device == nullptr)
+    // The frame must always go back to the encoder, even if there is no frame provider to time it with.
+    if (videoEncoder == nullptr || frame == nullptr)
     {
         return;
     }
@@ -289,7 +493,7 @@ void CompositorInterface::RecordFrameAsync(byte* bytes, LONGLONG frameTime, int
         numFrames = 5;
     }
 
-    videoEncoder->QueueVideoFrame(bytes, frameTime, numFrames * frameProvider->GetDurationHNS());
+    videoEncoder->QueueVideoFrame(frame, frameTime, numFrames * GetColorDuration());
 }
 
 void CompositorInterface::RecordAudioFrameAsync(BYTE* audioFrame, LONGLONG frameTime)
@@ -299,6 +503,6 @@ void CompositorInterface::RecordAudioFrameAsync(BYTE* audioFrame, LONGLONG frame
         return;
     }
 
-    videoEncoder->QueueAudioFrame(audioFrame);
+    videoEncoder->QueueAudioFrame(audioFrame, frameTime);
 }
 #pragma endregion Recording
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include "DeckLinkManager.h"
 #include "ElgatoFrameProvider.h"
 #include "OpenCVFrameProvider.h"
+#include "CaptureFileFrameProvider.h"
+#include "SyntheticFrameProvider.h"
 
 #include "DirectXHelper.h"
 
@@ -20,6 +22,8 @@
 #include <wincodec.h>
 
 #include "VideoEncoder.h"
+#include "PictureEncoder.h"
+#include "ColorConversion.h"
 
 #include "BufferedTextureFetch.h"
 #include "PoseCache.h"
@@ -27,10 +31,11 @@
 
 class CompositorInterface
 {
-#define NUM_VIDEO_BUFFERS 10
 public:
     DLLEXPORT CompositorInterface();
-    ~CompositorInterface();
+    // Composite frames from the given provider instead of the one selected in CompositorConstants.h.  The caller keeps ownership.
+    DLLEXPORT CompositorInterface(IFrameProvider* frameProvider);
+    DLLEXPORT ~CompositorInterface();
 
     DLLEXPORT bool Initialize(ID3D11Device* device, ID3D11ShaderResourceView* colorSRV, ID3D11Texture2D* outputTexture);
     DLLEXPORT void UpdateFrameProvider();
@@ -51,13 +56,29 @@ public:
     }
 
     // Recording
+    // Render thread.  Only copies the output texture, the picture is read back by UpdatePictures and saved on a worker thread.
     DLLEXPORT void TakePicture(ID3D11Texture2D* outputTexture);
+    // Render thread, once per frame.  Hands pictures whose copies have finished on the GPU to the picture encoder.
+    DLLEXPORT void UpdatePictures();
+    DLLEXPORT void SetPictureSavedCallback(PictureSavedCallback callback);
     DLLEXPORT bool InitializeVideoEncoder(ID3D11Device* device);
     DLLEXPORT void StartRecording();
+    // Record smaller copies of the video alongside it, instead of the VIDEO_RENDITIONS.  Paths are filled in from the video's.
+    DLLEXPORT void StartRecording(std::vector<VideoEncoder::Rendition> renditions);
     DLLEXPORT void StopRecording();
-    DLLEXPORT void RecordFrameAsync(byte* bytes, LONGLONG frameTime, int numFrames);
+    DLLEXPORT void RecordFrameAsync(VideoEncoder::FrameBuffer* frame, LONGLONG frameTime, int numFrames);
     DLLEXPORT void RecordAudioFrameAsync(BYTE* audioFrame, LONGLONG frameTime);
     DLLEXPORT void UpdateVideoRecordingFrame(ID3D11Texture2D* videoTexture);
+    DLLEXPORT void GetRecordingQueueStats(int& videoQueueDepth, int& audioQueueDepth, int& videoFramesDropped, int& audioFramesDropped);
+    // Renditions of the last recording, once it has stopped.
+    DLLEXPORT std::vector<VideoEncoder::RenditionStats> GetRenditionStats();
+
+    // Instant replay.  Zero seconds or memory uses REPLAY_SECONDS and REPLAY_MEMORY_MB.
+    DLLEXPORT bool StartReplay(int seconds, int memoryMB);
+    DLLEXPORT void StopReplay();
+    DLLEXPORT bool IsReplayEnabled();
+    // Returns immediately, the replay is written on a background thread.
+    DLLEXPORT bool SaveReplay();
 
     // Poses
     DLLEXPORT void GetPose(XMFLOAT3& position, XMFLOAT4& rotation, int frameOffset);
@@ -86,6 +107,11 @@ public:
         return poseCache.LastSelectedIndex;
     }
 
+    DLLEXPORT std::wstring GetOutputPath()
+    {
+        return outputPath;
+    }
+
     DLLEXPORT void ResetPoseCache()
     {
         poseCache.Reset();
@@ -93,7 +119,7 @@ public:
     }
 
 private:
-    IFrameProvider* frameProvider;
+    IFrameProvider* frameProvider = nullptr;
     std::wstring outputPath;
     ID3D11Device* _device;
 
@@ -101,18 +127,32 @@ private:
     LONGLONG stubVideoTime = 0;
     int photoIndex = -1;
     int videoIndex = -1;
+    int replayIndex = -1;
     LONGLONG queuedVideoFrameTime;
     int queuedVideoFrameCount = 0;
     int lastRecordedVideoFrame = -1;
     int lastVideoFrame = -1;
     BufferedTextureFetch VideoTextureBuffer;
     VideoEncoder* videoEncoder = nullptr;
-    byte* photoBytes = new byte[FRAME_BUFSIZE];
-    byte** videoBytes = nullptr;
-    int videoBufferIndex = 0;
 
-    void AllocateVideoBuffers();
-    void FreeVideoBuffers();
+    // Pictures
+    // Staging textures that the output texture is copied to, read back in the order they were taken.
+    class PictureReadback
+    {
+    public:
+        ID3D11Texture2D* texture = nullptr;
+        std::wstring path;
+    };
+
+    PictureReadback pictureReadbacks[NUM_PICTURE_READBACKS];
+    // Single-sample copy of a multisampled output texture, since staging textures cannot be multisampled.
+    ID3D11Texture2D* pictureResolveTexture = nullptr;
+    int firstPictureReadback = 0;
+    int numPictureReadbacks = 0;
+    PictureEncoder* pictureEncoder = nullptr;
+    PictureSavedCallback pictureSavedCallback = nullptr;
+
+    void CreateOutputDirectory();
 
     // Pose
     PoseCache poseCache;
@@ -49,6 +49,7 @@ DeckLinkDevice::DeckLinkDevice(IDeckLink* device) :
     }
 
     captureFrameIndex = 0;
+    QueryPerformanceFrequency(&freq);
 
     if (m_deckLink != NULL)
     {
@@ -166,6 +167,7 @@ bool DeckLinkDevice::Init(ID3D11ShaderResourceView* colorSRV)
     }
 
     captureFrameIndex = 0;
+    frameRing.Reset();
 
     _colorSRV = colorSRV;
 
@@ -246,6 +248,9 @@ bool DeckLinkDevice::StartCapture(BMDDisplayMode videoDisplayMode)
         supportsOutput = false;
     }
 
+    captureFrameIndex = 0;
+    frameRing.Reset();
+
     // Start the capture
     if (m_deckLinkInput->StartStreams() != S_OK)
     {
@@ -254,7 +259,6 @@ bool DeckLinkDevice::StartCapture(BMDDisplayMode videoDisplayMode)
     }
 
     m_currentlyCapturing = true;
-    captureFrameIndex = 0;
 
     return true;
 }
@@ -274,6 +278,9 @@ void DeckLinkDevice::StopCapture()
         m_deckLinkInput->SetCallback(NULL);
     }
 
+    // Hand any retained frames back to the driver.
+    frameRing.Clear();
+
     if (supportsOutput && m_deckLinkOutput != NULL)
     {
         m_deckLinkOutput->StopScheduledPlayback(0, NULL, 0);
@@ -329,6 +336,9 @@ HRESULT DeckLinkDevice::VideoInputFormatChanged(/* in */ BMDVideoInputFormatChan
     m_deckLinkInput->StopStreams();
     m_deckLinkInput->FlushStreams();
 
+    // Retained frames are from the old format.
+    frameRing.Clear();
+
     if (supportsOutput && m_deckLinkOutput != NULL)
     {
         m_deckLinkOutput->StopScheduledPlayback(0, NULL, 0);
@@ -375,8 +385,17 @@ HRESULT DeckLinkDevice::VideoInputFrameArrived(/* in */ IDeckLinkVideoInputFrame
     LARGE_INTEGER time;
     QueryPerformanceCounter(&time);
 
-    BMDPixelFormat framePixelFormat = frame->GetPixelFormat();
+    // Get frame time.
+    LONGLONG t;
+    frame->GetStreamTime(&t, &frameDuration, S2HNS);
 
+#if DECKLINK_RETAIN_CAPTURE_FRAMES
+    // Hold a reference to the driver's frame instead of copying it.  The ring's lock only covers swapping pointers.
+    if (frame->GetBytes((void**)&localFrameBuffer) == S_OK)
+    {
+        frameRing.Push(frame, localFrameBuffer, frame->GetRowBytes() * frame->GetHeight(), t);
+    }
+#else
     EnterCriticalSection(&m_captureCardCriticalSection);
 
     if (frame->GetBytes((void**)&localFrameBuffer) == S_OK)
@@ -386,15 +405,12 @@ HRESULT DeckLinkDevice::VideoInputFrameArrived(/* in */ IDeckLinkVideoInputFrame
 
         memcpy(buffer, localFrameBuffer, frame->GetRowBytes() * frame->GetHeight());
     }
-    
 
-    LONGLONG t;
-    frame->GetStreamTime(&t, &frameDuration, S2HNS);
-
-    
-    // Get frame time.
     bufferCache[captureFrameIndex % MAX_NUM_CACHED_BUFFERS].timeStamp = t;
 
+    LeaveCriticalSection(&m_captureCardCriticalSection);
+#endif
+
     dirtyFrame = false;
 
     if (supportsOutput && m_deckLinkOutput != NULL && outputFrame != NULL)
@@ -404,21 +420,73 @@ HRESULT DeckLinkDevice::VideoInputFrameArrived(/* in */ IDeckLinkVideoInputFrame
         LeaveCriticalSection(&m_outputCriticalSection);
     }
 
-    LeaveCriticalSection(&m_captureCardCriticalSection);
+    RecordCallbackTime(time);
 
     return S_OK;
 }
 
+void DeckLinkDevice::RecordCallbackTime(const LARGE_INTEGER& start)
+{
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+
+    LONGLONG callbackTime = end.QuadPart - start.QuadPart;
+    totalCallbackTime += callbackTime;
+    if (callbackTime > maxCallbackTime)
+    {
+        maxCallbackTime = callbackTime;
+    }
+
+    if (++numCallbacks < DECKLINK_CALLBACK_STATS_FRAMES)
+    {
+        return;
+    }
+
+    OutputDebugString(L"DeckLink capture callback avg: ");
+    OutputDebugString(std::to_wstring((double)totalCallbackTime * 1000.0 / freq.QuadPart / numCallbacks).c_str());
+    OutputDebugString(L" ms, max: ");
+    OutputDebugString(std::to_wstring((double)maxCallbackTime * 1000.0 / freq.QuadPart).c_str());
+    OutputDebugString(L" ms");
+#if DECKLINK_RETAIN_CAPTURE_FRAMES
+    OutputDebugString(L", frames expired before they were composited: ");
+    OutputDebugString(std::to_wstring(numExpiredFrames).c_str());
+    numExpiredFrames = 0;
+#endif
+    OutputDebugString(L"\n");
+
+    totalCallbackTime = 0;
+    maxCallbackTime = 0;
+    numCallbacks = 0;
+}
+
 void DeckLinkDevice::Update(int compositeFrameIndex)
 {
     if (_colorSRV != nullptr &&
         device != nullptr)
     {
+#if DECKLINK_RETAIN_CAPTURE_FRAMES
+        // Our reference keeps the driver from recycling the frame while it is uploaded.
+        IDeckLinkVideoInputFrame* frame = nullptr;
+        const BYTE* bytes = nullptr;
+        int length = 0;
+        if (frameRing.Acquire(compositeFrameIndex, frame, bytes, length))
+        {
+            // YUV frames only fill part of the color texture.
+            DirectXHelper::UpdateSRV(device, _colorSRV, bytes, FRAME_WIDTH * FRAME_BPP, length / (FRAME_WIDTH * FRAME_BPP));
+            frame->Release();
+        }
+        else if (compositeFrameIndex > 0 && compositeFrameIndex != lastExpiredFrame)
+        {
+            lastExpiredFrame = compositeFrameIndex;
+            numExpiredFrames++;
+        }
+#else
         const BufferCache& buffer = bufferCache[compositeFrameIndex % MAX_NUM_CACHED_BUFFERS];
         if (buffer.buffer != nullptr)
         {
             DirectXHelper::UpdateSRV(device, _colorSRV, buffer.buffer, FRAME_WIDTH * FRAME_BPP);
         }
+#endif
 
         if (supportsOutput && device != nullptr && _outputTexture != nullptr)
         {
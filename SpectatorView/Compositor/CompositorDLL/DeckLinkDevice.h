@@ -35,6 +35,15 @@
 #include "DirectXHelper.h"
 #include <string>
 #include "BufferedTextureFetch.h"
+#include "CapturedFrameRing.h"
+
+//TODO: Set this to false to copy every captured frame into the compositor's own buffers instead of holding the driver's frames.
+#define DECKLINK_RETAIN_CAPTURE_FRAMES TRUE
+//TODO: Number of driver frames held at once when retaining capture frames.
+// This must cover how far behind capture the compositor renders.  Lower it if the capture card starts dropping frames.
+#define DECKLINK_RETAINED_FRAMES 8
+// Capture callback timing is logged after this many frames.
+#define DECKLINK_CALLBACK_STATS_FRAMES 600
 
 class DeckLinkDevice : public IDeckLinkInputCallback
 {
@@ -78,6 +87,18 @@ private:
     BufferCache bufferCache[MAX_NUM_CACHED_BUFFERS];
     int captureFrameIndex;
 
+    // Used instead of bufferCache when retaining capture frames.
+    CapturedFrameRing<IDeckLinkVideoInputFrame, MAX_NUM_CACHED_BUFFERS, DECKLINK_RETAINED_FRAMES> frameRing;
+    std::atomic<int> numExpiredFrames{ 0 };
+    int lastExpiredFrame = -1;
+
+    // Capture callback timing.
+    LARGE_INTEGER freq;
+    LONGLONG totalCallbackTime = 0;
+    LONGLONG maxCallbackTime = 0;
+    int numCallbacks = 0;
+    void RecordCallbackTime(const LARGE_INTEGER& start);
+
     bool dirtyFrame = true;
 
     ID3D11ShaderResourceView* _colorSRV = nullptr;
@@ -112,7 +133,11 @@ public:
 
     LONGLONG GetTimestamp(int frame)
     {
+#if DECKLINK_RETAIN_CAPTURE_FRAMES
+        return frameRing.GetTimestamp(frame);
+#else
         return bufferCache[frame % MAX_NUM_CACHED_BUFFERS].timeStamp;
+#endif
     }
 
     LONGLONG GetDurationHNS()
@@ -122,7 +147,11 @@ public:
 
     int GetCaptureFrameIndex()
     {
+#if DECKLINK_RETAIN_CAPTURE_FRAMES
+        return frameRing.GetCaptureFrameIndex();
+#else
         return captureFrameIndex;
+#endif
     }
 
     bool OutputYUV();
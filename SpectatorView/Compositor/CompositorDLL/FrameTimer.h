@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <Windows.h>
+#include "CompositorConstants.h"
+
+// Windows 10 1803 and later.  Older versions fail to create the timer and fall back to a regular one.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Paces a thread to QueryPerformanceCounter times, for frame providers that play frames back in real time.
+// Sleep only wakes on the system tick (~15.6 ms by default), so it would drift a 60 fps capture by up to a frame.
+// FrameTimer waits on a high resolution waitable timer until just before the target time and spins on QPC for the rest.
+// Timer resolution is not changed system wide.
+class FrameTimer
+{
+public:
+    FrameTimer()
+    {
+        QueryPerformanceFrequency(&freq);
+
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        spinHNS = MS2HNS;
+        if (timer == NULL)
+        {
+            // A regular timer fires on the system tick, so spin for the tick.
+            timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+            spinHNS = 16 * MS2HNS;
+        }
+    }
+
+    ~FrameTimer()
+    {
+        if (timer != NULL)
+        {
+            CloseHandle(timer);
+        }
+    }
+
+    FrameTimer(const FrameTimer&) = delete;
+    FrameTimer& operator=(const FrameTimer&) = delete;
+
+    // QueryPerformanceCounter in hundreds of nanoseconds, the clock frames are timestamped with.
+    LONGLONG NowHNS()
+    {
+        LARGE_INTEGER time;
+        QueryPerformanceCounter(&time);
+
+        // Split the conversion so it does not overflow after a few days of uptime.
+        return (time.QuadPart / freq.QuadPart) * S2HNS + ((time.QuadPart % freq.QuadPart) * S2HNS) / freq.QuadPart;
+    }
+
+    // Blocks until NowHNS reaches timeHNS.  Returns straight away if it already has.
+    void WaitUntil(LONGLONG timeHNS)
+    {
+        LONGLONG remainingHNS = timeHNS - NowHNS();
+        if (remainingHNS > spinHNS && timer != NULL)
+        {
+            // Negative due times are relative.
+            LARGE_INTEGER dueTime;
+            dueTime.QuadPart = -(remainingHNS - spinHNS);
+            if (SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE))
+            {
+                WaitForSingleObject(timer, INFINITE);
+            }
+        }
+
+        while (NowHNS() < timeHNS)
+        {
+            YieldProcessor();
+        }
+    }
+
+private:
+    LARGE_INTEGER freq;
+    HANDLE timer = NULL;
+    LONGLONG spinHNS;
+};
@@ -9,13 +9,6 @@
 OpenCVFrameProvider::OpenCVFrameProvider()
 {
     QueryPerformanceFrequency(&freq);
-    rgbaFrame = cv::Mat(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC4);
-
-    for (int i = 0; i < 4; i++)
-    {
-        rgbaConversion[i * 2] = i;
-        rgbaConversion[(i * 2) + 1] = i;
-    }
 
     for (int i = 0; i < MAX_NUM_CACHED_BUFFERS; i++)
     {
@@ -28,6 +21,8 @@ OpenCVFrameProvider::OpenCVFrameProvider()
 
 OpenCVFrameProvider::~OpenCVFrameProvider()
 {
+    Dispose();
+
     for (int i = 0; i < MAX_NUM_CACHED_BUFFERS; i++)
     {
         delete[] bufferCache[i].buffer;
@@ -53,6 +48,7 @@ HRESULT OpenCVFrameProvider::Initialize(ID3D11ShaderResourceView* srv)
     for (int i = 0; i < MAX_NUM_CACHED_BUFFERS; i++)
     {
         ZeroMemory(bufferCache[i].buffer, FRAME_BUFSIZE);
+        bufferCache[i].timeStamp = 0;
     }
 
     captureFrameIndex = 0;
@@ -62,12 +58,14 @@ HRESULT OpenCVFrameProvider::Initialize(ID3D11ShaderResourceView* srv)
         // Attempt to update camera resolution to desired resolution.
         // This must be called after opening.
         // Note: This may fail, and your capture will resume at the camera's native resolution.
-        // In this case, the Update loop will print an error with the expected frame resolution.
+        // In this case, the capture thread will print an error with the expected frame resolution.
         videoCapture->set(cv::CAP_PROP_FRAME_WIDTH, FRAME_WIDTH);
         videoCapture->set(cv::CAP_PROP_FRAME_HEIGHT, FRAME_HEIGHT);
 
         if (IsEnabled())
         {
+            stopCapture = false;
+            captureThread = std::thread(&OpenCVFrameProvider::CaptureThread, this);
             hr = S_OK;
         }
     }
@@ -85,53 +83,126 @@ bool OpenCVFrameProvider::IsEnabled()
     return false;
 }
 
-void OpenCVFrameProvider::Update(int compositeFrameIndex)
+void OpenCVFrameProvider::CaptureThread()
 {
-    if (!IsEnabled() ||
-        _colorSRV == nullptr ||
-        _device == nullptr)
-    {
-        return;
-    }
+    loggedFrameSizeError = false;
+    lastGrabTime = 0;
+    numStatsFrames = 0;
 
-    concurrency::create_task([=]
+    while (!stopCapture)
     {
-        if (videoCapture->grab())
+        // grab blocks until the camera delivers the next frame, so it paces this thread.
+        if (!videoCapture->grab())
         {
-            LARGE_INTEGER time;
-            QueryPerformanceCounter(&time);
+            Sleep(1);
+            continue;
+        }
+
+        // Timestamp as close to the exposure as we can get, before the frame is decoded.
+        LARGE_INTEGER time;
+        QueryPerformanceCounter(&time);
 
-            if (videoCapture->retrieve(frame))
+        if (!videoCapture->retrieve(frame))
+        {
+            continue;
+        }
+
+        if (frame.cols != FRAME_WIDTH || frame.rows != FRAME_HEIGHT || frame.type() != CV_8UC3)
+        {
+            if (!loggedFrameSizeError)
             {
-                latestTimeStamp = time.QuadPart;
-
-                double width = videoCapture->get(cv::CAP_PROP_FRAME_WIDTH);
-                double height = videoCapture->get(cv::CAP_PROP_FRAME_HEIGHT);
-
-                if (width != FRAME_WIDTH)
-                {
-                    OutputDebugString(L"ERROR: captured width does not equal FRAME_WIDTH.  Expecting: ");
-                    OutputDebugString(std::to_wstring(width).c_str());
-                    OutputDebugString(L"\n");
-                }
-
-                if (height != FRAME_HEIGHT)
-                {
-                    OutputDebugString(L"ERROR: captured height does not equal FRAME_HEIGHT.  Expecting: ");
-                    OutputDebugString(std::to_wstring(height).c_str());
-                    OutputDebugString(L"\n");
-                }
-
-                // Convert from rgb to rgba
-                mixChannels(&frame, 2, &rgbaFrame, 1, rgbaConversion, 4);
-
-                captureFrameIndex++;
-                BYTE* buffer = bufferCache[captureFrameIndex % MAX_NUM_CACHED_BUFFERS].buffer;
-                memcpy(buffer, rgbaFrame.data, FRAME_BUFSIZE);
-                bufferCache[captureFrameIndex % MAX_NUM_CACHED_BUFFERS].timeStamp = (latestTimeStamp * S2HNS) / freq.QuadPart;
+                OutputDebugString(L"ERROR: captured frame does not match FRAME_WIDTH x FRAME_HEIGHT BGR.  Captured: ");
+                OutputDebugString((std::to_wstring(frame.cols) + L"x" + std::to_wstring(frame.rows) + L"\n").c_str());
+                loggedFrameSizeError = true;
             }
+            continue;
         }
-    });
+
+        // Convert straight into the next cache slot.  Update reads the slot at the composite frame index,
+        // which trails the capture frame index, so this slot is not being uploaded.
+        int index = captureFrameIndex + 1;
+        BufferCache& slot = bufferCache[index % MAX_NUM_CACHED_BUFFERS];
+        ColorConversion::BGRToBGRA(frame.data, (int)frame.step, slot.buffer, FRAME_WIDTH * FRAME_BPP, FRAME_WIDTH, FRAME_HEIGHT);
+        slot.timeStamp = (time.QuadPart * S2HNS) / freq.QuadPart;
+
+        captureFrameIndex.store(index, std::memory_order_release);
+
+        RecordCaptureStats(time.QuadPart);
+    }
+}
+
+// Capture thread only.
+ULONGLONG OpenCVFrameProvider::GetCaptureCPUTime()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0;
+    }
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    // 100-nanosecond units
+    return kernel.QuadPart + user.QuadPart;
+}
+
+void OpenCVFrameProvider::RecordCaptureStats(LONGLONG grabTime)
+{
+    if (lastGrabTime == 0)
+    {
+        lastGrabTime = grabTime;
+        threadCPUTimeAtStats = GetCaptureCPUTime();
+        return;
+    }
+
+    double interval = (double)(grabTime - lastGrabTime) * 1000.0 / freq.QuadPart;
+    lastGrabTime = grabTime;
+
+    totalGrabInterval += interval;
+    totalSquaredGrabInterval += interval * interval;
+    if (interval > maxGrabInterval)
+    {
+        maxGrabInterval = interval;
+    }
+
+    if (++numStatsFrames < OPENCV_CAPTURE_STATS_FRAMES)
+    {
+        return;
+    }
+
+    double averageInterval = totalGrabInterval / numStatsFrames;
+    double variance = (totalSquaredGrabInterval / numStatsFrames) - (averageInterval * averageInterval);
+    ULONGLONG threadCPUTime = GetCaptureCPUTime();
+
+    OutputDebugString(L"OpenCV capture interval avg: ");
+    OutputDebugString(std::to_wstring(averageInterval).c_str());
+    OutputDebugString(L" ms, jitter: ");
+    OutputDebugString(std::to_wstring(sqrt(variance > 0 ? variance : 0)).c_str());
+    OutputDebugString(L" ms, max: ");
+    OutputDebugString(std::to_wstring(maxGrabInterval).c_str());
+    OutputDebugString(L" ms, capture thread CPU per frame: ");
+    OutputDebugString(std::to_wstring((double)(threadCPUTime - threadCPUTimeAtStats) / 10000.0 / numStatsFrames).c_str());
+    OutputDebugString(L" ms\n");
+
+    totalGrabInterval = 0;
+    totalSquaredGrabInterval = 0;
+    maxGrabInterval = 0;
+    threadCPUTimeAtStats = threadCPUTime;
+    numStatsFrames = 0;
+}
+
+void OpenCVFrameProvider::Update(int compositeFrameIndex)
+{
+    if (!IsEnabled() ||
+        _colorSRV == nullptr ||
+        _device == nullptr)
+    {
+        return;
+    }
 
     const BufferCache& buffer = bufferCache[compositeFrameIndex % MAX_NUM_CACHED_BUFFERS];
     if (buffer.buffer != nullptr)
@@ -140,15 +211,27 @@ void OpenCVFrameProvider::Update(int compositeFrameIndex)
     }
 }
 
+void OpenCVFrameProvider::StopCaptureThread()
+{
+    stopCapture = true;
+    if (captureThread.joinable())
+    {
+        captureThread.join();
+    }
+}
+
 void OpenCVFrameProvider::Dispose()
 {
+    // The capture thread uses videoCapture, so stop it first.
+    StopCaptureThread();
+
     if (videoCapture != nullptr)
     {
         videoCapture->release();
+        delete videoCapture;
         videoCapture = nullptr;
     }
 
     captureFrameIndex = 0;
 }
 #endif
-
@@ -5,34 +5,54 @@
 #if USE_OPENCV
 #include "IFrameProvider.h"
 #include <mutex>
+#include <thread>
+#include <atomic>
 
 //TODO: Update with the 3.x version of OpenCV you are using.
 #pragma comment(lib, "opencv_world341")
 #include "opencv2/opencv.hpp"
 
 #include "DirectXHelper.h"
+#include "ColorConversion.h"
 
 //TODO: Change this value to match the camera id you are using.
 // If your PC has an integrated webcam, that will probably be id 0.
 #define CAMERA_ID 0
 
+// Capture jitter and CPU time are logged after this many frames.
+#define OPENCV_CAPTURE_STATS_FRAMES 600
+
 class OpenCVFrameProvider : public IFrameProvider
 {
 private:
     std::mutex frameAccessLock;
     std::mutex videoLock;
 
-    LONGLONG latestTimeStamp = 0;
-
     LARGE_INTEGER freq;
 
     cv::VideoCapture* videoCapture = nullptr;
     ID3D11ShaderResourceView* _colorSRV;
     ID3D11Device* _device;
 
+    // Frames are grabbed, decoded and converted on a dedicated thread so Update only uploads.
+    std::thread captureThread;
+    std::atomic<bool> stopCapture{ false };
+    void CaptureThread();
+    void StopCaptureThread();
+
+    // Only touched by the capture thread.
     cv::Mat frame;
-    cv::Mat rgbaFrame;
-    int rgbaConversion[8];
+    bool loggedFrameSizeError = false;
+
+    // Capture timing, only touched by the capture thread.
+    LONGLONG lastGrabTime = 0;
+    double totalGrabInterval = 0;
+    double totalSquaredGrabInterval = 0;
+    double maxGrabInterval = 0;
+    ULONGLONG threadCPUTimeAtStats = 0;
+    int numStatsFrames = 0;
+    void RecordCaptureStats(LONGLONG grabTime);
+    ULONGLONG GetCaptureCPUTime();
 
     class BufferCache
     {
@@ -42,7 +62,8 @@ private:
     };
 
     BufferCache bufferCache[MAX_NUM_CACHED_BUFFERS];
-    int captureFrameIndex = 0;
+    // Published by the capture thread after the frame's slot has been written.
+    std::atomic<int> captureFrameIndex{ 0 };
 
 public:
     OpenCVFrameProvider();
@@ -0,0 +1,264 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "PictureEncoder.h"
+#include <algorithm>
+
+// Rows converted from BGRA to BGR per WritePixels call.
+#define PICTURE_STRIP_ROWS 64
+
+PictureEncoder::PictureEncoder(UINT width, UINT height) :
+    width(width),
+    height(height),
+    format(PICTURE_JPEG ? Format::JPEG : Format::PNG),
+    fastCompression(PICTURE_FAST_COMPRESSION)
+{
+    for (int i = 0; i < NUM_PICTURE_BUFFERS; i++)
+    {
+        buffers.push_back(new BYTE[width * height * 4]);
+    }
+    freeBuffers = buffers;
+
+    for (int i = 0; i < NUM_PICTURE_ENCODER_THREADS; i++)
+    {
+        encoderThreads.push_back(std::thread(&PictureEncoder::EncoderThread, this));
+    }
+}
+
+PictureEncoder::~PictureEncoder()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopEncoding = true;
+    }
+    pictureQueued.notify_all();
+
+    for (std::thread& thread : encoderThreads)
+    {
+        thread.join();
+    }
+
+    for (BYTE* buffer : buffers)
+    {
+        delete[] buffer;
+    }
+}
+
+void PictureEncoder::SetFormat(Format format, bool fastCompression)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    this->format = format;
+    this->fastCompression = fastCompression;
+}
+
+void PictureEncoder::SetCallback(PictureSavedCallback callback)
+{
+    this->callback = callback;
+}
+
+BYTE* PictureEncoder::GetFreeBuffer()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (freeBuffers.empty())
+    {
+        return nullptr;
+    }
+
+    BYTE* buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+void PictureEncoder::ReleaseBuffer(BYTE* buffer)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    freeBuffers.push_back(buffer);
+}
+
+void PictureEncoder::QueuePicture(BYTE* buffer, const std::wstring& path)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back({ buffer, path, format, fastCompression });
+    }
+    pictureQueued.notify_one();
+}
+
+void PictureEncoder::WaitForIdle()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    pictureWritten.wait(guard, [&] { return queue.empty() && numEncoding == 0; });
+}
+
+int PictureEncoder::GetQueueDepth()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return (int)queue.size() + numEncoding;
+}
+
+void PictureEncoder::EncoderThread()
+{
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    bool comInitialized = SUCCEEDED(hr);
+
+    IWICImagingFactory* factory = nullptr;
+    hr = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    if (FAILED(hr))
+    {
+        OutputDebugString(L"ERROR: Could not create a WIC factory for the picture encoder.\n");
+    }
+
+    BYTE* scratch = new BYTE[width * 3 * PICTURE_STRIP_ROWS];
+
+    while (true)
+    {
+        Picture picture;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            pictureQueued.wait(guard, [&] { return stopEncoding || !queue.empty(); });
+
+            // Finish every queued picture before stopping.
+            if (queue.empty())
+            {
+                break;
+            }
+
+            picture = queue.front();
+            queue.pop_front();
+            numEncoding++;
+        }
+
+        hr = (factory != nullptr) ? Encode(factory, picture, scratch) : E_FAIL;
+        if (FAILED(hr))
+        {
+            OutputDebugString((L"ERROR: Could not save picture: " + picture.path + L"\n").c_str());
+        }
+
+        PictureSavedCallback pictureSaved = callback;
+        if (pictureSaved != nullptr)
+        {
+            pictureSaved(picture.path.c_str(), SUCCEEDED(hr));
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            freeBuffers.push_back(picture.buffer);
+            numEncoding--;
+        }
+        pictureWritten.notify_all();
+    }
+
+    delete[] scratch;
+    SafeRelease(factory);
+
+    if (comInitialized)
+    {
+        CoUninitialize();
+    }
+}
+
+HRESULT PictureEncoder::Encode(IWICImagingFactory* factory, const Picture& picture, BYTE* scratch)
+{
+    IWICStream* stream = nullptr;
+    IWICBitmapEncoder* encoder = nullptr;
+    IWICBitmapFrameEncode* frame = nullptr;
+    IPropertyBag2* properties = nullptr;
+    IWICMetadataQueryWriter* metadata = nullptr;
+
+    bool jpeg = picture.format == Format::JPEG;
+
+    HRESULT hr = factory->CreateStream(&stream);
+    if (SUCCEEDED(hr)) { hr = stream->InitializeFromFilename(picture.path.c_str(), GENERIC_WRITE); }
+    if (SUCCEEDED(hr)) { hr = factory->CreateEncoder(jpeg ? GUID_ContainerFormatJpeg : GUID_ContainerFormatPng, NULL, &encoder); }
+    if (SUCCEEDED(hr)) { hr = encoder->Initialize(stream, WICBitmapEncoderNoCache); }
+    if (SUCCEEDED(hr)) { hr = encoder->CreateNewFrame(&frame, &properties); }
+
+    if (SUCCEEDED(hr))
+    {
+        // Unknown options are ignored by older codecs, so failures here are not fatal.
+        PROPBAG2 option = { 0 };
+        VARIANT value;
+        VariantInit(&value);
+
+        if (jpeg)
+        {
+            option.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
+            value.vt = VT_R4;
+            value.fltVal = PICTURE_JPEG_QUALITY;
+            (void)properties->Write(1, &option, &value);
+
+            option.pstrName = const_cast<LPOLESTR>(L"JpegYCrCbSubsampling");
+            value.vt = VT_UI1;
+            value.bVal = (BYTE)(picture.fastCompression ? WICJpegYCrCbSubsampling420 : WICJpegYCrCbSubsampling444);
+            (void)properties->Write(1, &option, &value);
+        }
+        else
+        {
+            // Adaptive filtering is most of the cost of PNG encoding.
+            option.pstrName = const_cast<LPOLESTR>(L"FilterOption");
+            value.vt = VT_UI1;
+            value.bVal = (BYTE)(picture.fastCompression ? WICPngFilterNone : WICPngFilterAdaptive);
+            (void)properties->Write(1, &option, &value);
+        }
+
+        hr = frame->Initialize(properties);
+    }
+
+    // Match what ScreenGrab writes for an sRGB texture: 24 bit BGR with sRGB metadata.
+    WICPixelFormatGUID pixelFormat = GUID_WICPixelFormat24bppBGR;
+    if (SUCCEEDED(hr)) { hr = frame->SetSize(width, height); }
+    if (SUCCEEDED(hr)) { hr = frame->SetPixelFormat(&pixelFormat); }
+    if (SUCCEEDED(hr) && !IsEqualGUID(pixelFormat, GUID_WICPixelFormat24bppBGR)) { hr = E_UNEXPECTED; }
+
+    if (SUCCEEDED(hr) && SUCCEEDED(frame->GetMetadataQueryWriter(&metadata)))
+    {
+        PROPVARIANT value;
+        PropVariantInit(&value);
+
+        if (jpeg)
+        {
+            value.vt = VT_UI2;
+            value.uiVal = 1;
+            (void)metadata->SetMetadataByName(L"System.Image.ColorSpace", &value);
+        }
+        else
+        {
+            value.vt = VT_UI1;
+            value.bVal = 0;
+            (void)metadata->SetMetadataByName(L"/sRGB/RenderingIntent", &value);
+        }
+    }
+
+    // Drop alpha a strip at a time instead of converting the whole picture into another buffer.
+    UINT srcStride = width * 4;
+    UINT dstStride = width * 3;
+    for (UINT y = 0; SUCCEEDED(hr) && y < height; y += PICTURE_STRIP_ROWS)
+    {
+        UINT rows = std::min(height - y, (UINT)PICTURE_STRIP_ROWS);
+        for (UINT row = 0; row < rows; row++)
+        {
+            const BYTE* src = &picture.buffer[(y + row) * srcStride];
+            BYTE* dst = &scratch[row * dstStride];
+            for (UINT x = 0; x < width; x++, src += 4, dst += 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+
+        hr = frame->WritePixels(rows, dstStride, rows * dstStride, scratch);
+    }
+
+    if (SUCCEEDED(hr)) { hr = frame->Commit(); }
+    if (SUCCEEDED(hr)) { hr = encoder->Commit(); }
+
+    SafeRelease(metadata);
+    SafeRelease(properties);
+    SafeRelease(frame);
+    SafeRelease(encoder);
+    SafeRelease(stream);
+
+    return hr;
+}
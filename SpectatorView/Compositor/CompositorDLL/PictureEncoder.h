@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <Windows.h>
+#include <wincodec.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+#pragma comment(lib, "windowscodecs")
+
+// Number of pooled picture buffers.  A picture holds its buffer from readback until its file is written,
+// so this is the longest burst that can be in flight.  Pictures taken when every buffer is in use are dropped.
+#define NUM_PICTURE_BUFFERS 8
+#define NUM_PICTURE_ENCODER_THREADS 2
+// Staging textures for reading pictures back from the GPU without stalling the render thread.
+// Pictures taken while every one is still waiting on the GPU (or for a picture buffer) are dropped.
+#define NUM_PICTURE_READBACKS 4
+
+//TODO: Set this to true to save pictures as JPEG instead of PNG.
+#define PICTURE_JPEG FALSE
+//TODO: Set this to true to encode pictures faster at the cost of larger files (unfiltered PNG, 4:2:0 JPEG).
+#define PICTURE_FAST_COMPRESSION FALSE
+#define PICTURE_JPEG_QUALITY 0.95f
+
+// Called on an encoder thread after each picture is written, or fails to be.
+typedef void(__stdcall *PictureSavedCallback)(LPCWSTR path, bool succeeded);
+
+// Encodes and writes pictures on a pool of worker threads, so the render thread only reads back pixels.
+// Pictures are 32 bit BGRA (as read back from the output texture) and are saved as 24 bit sRGB PNG or JPEG.
+class PictureEncoder
+{
+public:
+    enum class Format
+    {
+        PNG,
+        JPEG
+    };
+
+    PictureEncoder(UINT width, UINT height);
+    // Finishes every queued picture.
+    ~PictureEncoder();
+
+    void SetFormat(Format format, bool fastCompression);
+    void SetCallback(PictureSavedCallback callback);
+
+    // A pooled buffer of height rows of width * 4 bytes, or nullptr if every buffer is in use.
+    // Every buffer returned must be passed back to QueuePicture or ReleaseBuffer.
+    BYTE* GetFreeBuffer();
+    void ReleaseBuffer(BYTE* buffer);
+
+    // Hand a filled buffer to the encoder threads.
+    void QueuePicture(BYTE* buffer, const std::wstring& path);
+
+    // Blocks until every queued picture has been written.
+    void WaitForIdle();
+
+    int GetQueueDepth();
+    int GetNumPicturesDropped()
+    {
+        return numPicturesDropped;
+    }
+
+    void AddDroppedPicture()
+    {
+        numPicturesDropped++;
+    }
+
+private:
+    struct Picture
+    {
+        BYTE* buffer;
+        std::wstring path;
+        Format format;
+        bool fastCompression;
+    };
+
+    UINT width;
+    UINT height;
+    // Guarded by lock, copied into each picture when it is queued.
+    Format format;
+    bool fastCompression;
+    std::atomic<PictureSavedCallback> callback{ nullptr };
+
+    std::vector<BYTE*> buffers;
+    std::vector<BYTE*> freeBuffers;
+    std::deque<Picture> queue;
+    int numEncoding = 0;
+    std::mutex lock;
+    std::condition_variable pictureQueued;
+    std::condition_variable pictureWritten;
+    bool stopEncoding = false;
+    std::atomic<int> numPicturesDropped{ 0 };
+
+    std::vector<std::thread> encoderThreads;
+    void EncoderThread();
+
+    HRESULT Encode(IWICImagingFactory* factory, const Picture& picture, BYTE* scratch);
+};
@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "ReplayBuffer.h"
+
+#include <algorithm>
+
+ReplayBuffer::ReplayBuffer(size_t memoryBudget, LONGLONG durationHNS) :
+    arena(memoryBudget),
+    durationHNS(durationHNS)
+{
+}
+
+bool ReplayBuffer::Allocate(DWORD bytes, size_t& offset)
+{
+    if (samples.empty())
+    {
+        head = 0;
+        offset = 0;
+        return bytes <= arena.size();
+    }
+
+    size_t tail = samples.front().offset;
+    if (head > tail)
+    {
+        // Free space is after the newest sample and before the oldest one.
+        if (arena.size() - head >= bytes)
+        {
+            offset = head;
+            return true;
+        }
+
+        if (tail >= bytes)
+        {
+            offset = 0;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Wrapped around, free space is between the newest sample and the oldest one.
+    if (tail - head >= bytes)
+    {
+        offset = head;
+        return true;
+    }
+
+    return false;
+}
+
+void ReplayBuffer::EvictGOP()
+{
+    do
+    {
+        size -= samples.front().size;
+        samples.pop_front();
+    } while (!samples.empty() && !samples.front().keyFrame);
+}
+
+bool ReplayBuffer::Add(const BYTE* data, DWORD bytes, LONGLONG time, LONGLONG duration, bool keyFrame)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (keyFrame)
+    {
+        waitForKeyFrame = false;
+    }
+
+    if (waitForKeyFrame || bytes == 0)
+    {
+        return false;
+    }
+
+    if (bytes > arena.size())
+    {
+        // Nothing after this can be saved until the next keyframe.
+        samples.clear();
+        size = 0;
+        waitForKeyFrame = true;
+        return false;
+    }
+
+    // Drop the oldest GOP for as long as the rest still covers the duration.
+    while (samples.size() > 1)
+    {
+        auto nextGOP = std::find_if(samples.begin() + 1, samples.end(), [](const Sample& sample) { return sample.keyFrame; });
+        if (nextGOP == samples.end() || time + duration - nextGOP->time < durationHNS)
+        {
+            break;
+        }
+
+        EvictGOP();
+    }
+
+    // Then make room for the new sample.
+    size_t offset = 0;
+    while (!Allocate(bytes, offset))
+    {
+        bool oneGOP = std::none_of(samples.begin() + 1, samples.end(), [](const Sample& sample) { return sample.keyFrame; });
+        if (!keyFrame && oneGOP)
+        {
+            // The GOP being written does not fit on its own, it cannot be saved without its keyframe.
+            samples.clear();
+            size = 0;
+            waitForKeyFrame = true;
+            return false;
+        }
+
+        EvictGOP();
+    }
+
+    memcpy(&arena[offset], data, bytes);
+    samples.push_back({ offset, bytes, time, duration, keyFrame });
+    head = offset + bytes;
+    size += bytes;
+    return true;
+}
+
+void ReplayBuffer::SetHeader(const BYTE* data, UINT32 bytes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    header.assign(data, data + bytes);
+}
+
+void ReplayBuffer::Clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    samples.clear();
+    size = 0;
+    head = 0;
+    waitForKeyFrame = true;
+}
+
+bool ReplayBuffer::Snapshot(std::vector<Sample>& snapshotSamples, std::vector<BYTE>& data, std::vector<BYTE>& snapshotHeader)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (samples.empty())
+    {
+        return false;
+    }
+
+    snapshotSamples.clear();
+    snapshotSamples.reserve(samples.size());
+    data.resize(size);
+    snapshotHeader = header;
+
+    size_t offset = 0;
+    for (const Sample& sample : samples)
+    {
+        memcpy(&data[offset], &arena[sample.offset], sample.size);
+        snapshotSamples.push_back({ offset, sample.size, sample.time, sample.duration, sample.keyFrame });
+        offset += sample.size;
+    }
+
+    return true;
+}
+
+LONGLONG ReplayBuffer::GetDurationLocked()
+{
+    if (samples.empty())
+    {
+        return 0;
+    }
+
+    return samples.back().time + samples.back().duration - samples.front().time;
+}
+
+LONGLONG ReplayBuffer::GetDuration()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return GetDurationLocked();
+}
+
+size_t ReplayBuffer::GetSize()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return size;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+// Bounded ring of encoded video samples covering the last few seconds, for instant replay.
+// Sample data lives in one arena allocated up front, so adding a sample never allocates.
+//
+// Samples are evicted a whole GOP (a keyframe and the samples that depend on it) at a time, so the ring always starts on a keyframe
+// and any snapshot of it can be muxed without re-encoding.  Eviction happens when:
+// - The ring would cover more than duration without its oldest GOP.
+// - A new sample does not fit in the arena.  If the GOP being written fills the arena on its own, everything is dropped until the next keyframe.
+//
+// Samples are added by the encoder thread and copied out by the thread saving a replay.
+class ReplayBuffer
+{
+public:
+    class Sample
+    {
+    public:
+        // Offset into the arena, or into the snapshot's data.
+        size_t offset;
+        DWORD size;
+        LONGLONG time;
+        LONGLONG duration;
+        bool keyFrame;
+    };
+
+    ReplayBuffer(size_t memoryBudget, LONGLONG durationHNS);
+
+    // Returns false if the sample was dropped, because it does not follow a keyframe that is in the ring.
+    bool Add(const BYTE* data, DWORD size, LONGLONG time, LONGLONG duration, bool keyFrame);
+
+    // Codec configuration needed to mux the samples (eg: the H.264 sequence and picture parameter sets).
+    void SetHeader(const BYTE* data, UINT32 size);
+
+    void Clear();
+
+    // Copy everything in the ring, with offsets into data.  Returns false if the ring is empty.
+    bool Snapshot(std::vector<Sample>& samples, std::vector<BYTE>& data, std::vector<BYTE>& header);
+
+    // From the start of the first sample to the end of the last.
+    LONGLONG GetDuration();
+    size_t GetSize();
+    size_t GetMemoryBudget() { return arena.size(); }
+
+private:
+    // lock must be held.
+    bool Allocate(DWORD size, size_t& offset);
+    void EvictGOP();
+    LONGLONG GetDurationLocked();
+
+    std::vector<BYTE> arena;
+    std::deque<Sample> samples;
+    // End of the newest sample in the arena.
+    size_t head = 0;
+    size_t size = 0;
+    LONGLONG durationHNS;
+    // Set when samples are being dropped until the next keyframe.
+    bool waitForKeyFrame = true;
+
+    std::vector<BYTE> header;
+    std::mutex lock;
+};
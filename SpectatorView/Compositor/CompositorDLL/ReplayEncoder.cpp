@@ -0,0 +1,479 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "ReplayEncoder.h"
+
+#include "codecapi.h"
+#include <algorithm>
+
+ReplayEncoder::ReplayEncoder(UINT frameWidth, UINT frameHeight, UINT fps, size_t memoryBudget, LONGLONG durationHNS) :
+    frameWidth(frameWidth),
+    frameHeight(frameHeight),
+    fps(fps),
+    replay(memoryBudget, durationHNS)
+{
+    frameQueuedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+ReplayEncoder::~ReplayEncoder()
+{
+    if (encoderThread.joinable())
+    {
+        stopEncoding = true;
+        SetEvent(frameQueuedEvent);
+        encoderThread.join();
+    }
+
+    if (saveThread.joinable())
+    {
+        saveThread.join();
+    }
+
+    for (IMFMediaBuffer*& buffer : buffers)
+    {
+        SafeRelease(buffer);
+    }
+    CloseHandle(frameQueuedEvent);
+}
+
+HRESULT ReplayEncoder::CreateOutputType(IMFMediaType** type)
+{
+    IMFMediaType* outputType = NULL;
+
+    HRESULT hr = MFCreateMediaType(&outputType);
+    if (SUCCEEDED(hr)) { hr = outputType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video); }
+    if (SUCCEEDED(hr)) { hr = outputType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264); }
+    if (SUCCEEDED(hr)) { hr = outputType->SetUINT32(MF_MT_AVG_BITRATE, REPLAY_BITRATE); }
+    if (SUCCEEDED(hr)) { hr = outputType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive); }
+    if (SUCCEEDED(hr)) { hr = MFSetAttributeSize(outputType, MF_MT_FRAME_SIZE, frameWidth, frameHeight); }
+    if (SUCCEEDED(hr)) { hr = MFSetAttributeRatio(outputType, MF_MT_FRAME_RATE, fps, 1); }
+    if (SUCCEEDED(hr)) { hr = MFSetAttributeRatio(outputType, MF_MT_PIXEL_ASPECT_RATIO, 1, 1); }
+    if (SUCCEEDED(hr)) { hr = outputType->SetUINT32(MF_MT_MPEG2_PROFILE, eAVEncH264VProfile_High); }
+
+    if (SUCCEEDED(hr))
+    {
+        *type = outputType;
+    }
+    else
+    {
+        SafeRelease(outputType);
+    }
+
+    return hr;
+}
+
+bool ReplayEncoder::Initialize()
+{
+    // Frames are copied into these, so the replay never holds on to the recording's pooled buffers.
+    DWORD frameLength = (DWORD)(1.5f * frameWidth * frameHeight);
+    for (int i = 0; i < REPLAY_QUEUE_CAPACITY; i++)
+    {
+        IMFMediaBuffer* buffer = NULL;
+        if (FAILED(MFCreateMemoryBuffer(frameLength, &buffer)))
+        {
+            OutputDebugString(L"ERROR: Could not allocate instant replay frames.\n");
+            return false;
+        }
+        buffers.push_back(buffer);
+        freeBuffers.push_back(buffer);
+    }
+
+    std::promise<bool> initialized;
+    std::future<bool> result = initialized.get_future();
+    encoderThread = std::thread(&ReplayEncoder::EncoderThread, this, std::move(initialized));
+    return result.get();
+}
+
+HRESULT ReplayEncoder::CreateTransform()
+{
+    // Synchronous encoders only, so every frame can be encoded on the encoder thread as it is dequeued.
+    MFT_REGISTER_TYPE_INFO inputInfo = { MFMediaType_Video, MFVideoFormat_NV12 };
+    MFT_REGISTER_TYPE_INFO outputInfo = { MFMediaType_Video, MFVideoFormat_H264 };
+    IMFActivate** activates = NULL;
+    UINT32 numActivates = 0;
+
+    HRESULT hr = MFTEnumEx(MFT_CATEGORY_VIDEO_ENCODER, MFT_ENUM_FLAG_SYNCMFT | MFT_ENUM_FLAG_LOCALMFT | MFT_ENUM_FLAG_SORTANDFILTER,
+        &inputInfo, &outputInfo, &activates, &numActivates);
+    if (SUCCEEDED(hr) && numActivates == 0) { hr = MF_E_TOPO_CODEC_NOT_FOUND; }
+    if (SUCCEEDED(hr)) { hr = activates[0]->ActivateObject(IID_PPV_ARGS(&transform)); }
+
+    for (UINT32 i = 0; i < numActivates; i++)
+    {
+        activates[i]->Release();
+    }
+    CoTaskMemFree(activates);
+
+    // Low latency mode outputs every frame as soon as it is input, and a fixed GOP bounds how much is evicted at a time.
+    ICodecAPI* codecAPI = NULL;
+    if (SUCCEEDED(hr) && SUCCEEDED(transform->QueryInterface(IID_PPV_ARGS(&codecAPI))))
+    {
+        VARIANT value;
+        value.vt = VT_BOOL;
+        value.boolVal = VARIANT_TRUE;
+        codecAPI->SetValue(&CODECAPI_AVLowLatencyMode, &value);
+
+        value.vt = VT_UI4;
+        value.ulVal = fps * REPLAY_GOP_SECONDS;
+        codecAPI->SetValue(&CODECAPI_AVEncMPVGOPSize, &value);
+
+        value.ulVal = eAVEncCommonRateControlMode_CBR;
+        codecAPI->SetValue(&CODECAPI_AVEncCommonRateControlMode, &value);
+
+        value.ulVal = REPLAY_BITRATE;
+        codecAPI->SetValue(&CODECAPI_AVEncCommonMeanBitRate, &value);
+
+        SafeRelease(codecAPI);
+    }
+
+    // The encoder needs its output type before its input type.
+    IMFMediaType* outputType = NULL;
+    IMFMediaType* inputType = NULL;
+    if (SUCCEEDED(hr)) { hr = CreateOutputType(&outputType); }
+    if (SUCCEEDED(hr)) { hr = transform->SetOutputType(0, outputType, 0); }
+
+    if (SUCCEEDED(hr)) { hr = MFCreateMediaType(&inputType); }
+    if (SUCCEEDED(hr)) { hr = inputType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video); }
+    if (SUCCEEDED(hr)) { hr = inputType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12); }
+    if (SUCCEEDED(hr)) { hr = inputType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive); }
+    if (SUCCEEDED(hr)) { hr = MFSetAttributeSize(inputType, MF_MT_FRAME_SIZE, frameWidth, frameHeight); }
+    if (SUCCEEDED(hr)) { hr = MFSetAttributeRatio(inputType, MF_MT_FRAME_RATE, fps, 1); }
+    if (SUCCEEDED(hr)) { hr = MFSetAttributeRatio(inputType, MF_MT_PIXEL_ASPECT_RATIO, 1, 1); }
+    if (SUCCEEDED(hr)) { hr = transform->SetInputType(0, inputType, 0); }
+
+    SafeRelease(outputType);
+    SafeRelease(inputType);
+
+    // The encoder writes into our output buffer, which is large enough for an uncompressed frame.
+    MFT_OUTPUT_STREAM_INFO outputStreamInfo = {};
+    if (SUCCEEDED(hr)) { hr = transform->GetOutputStreamInfo(0, &outputStreamInfo); }
+    if (SUCCEEDED(hr)) { hr = MFCreateMemoryBuffer(std::max(outputStreamInfo.cbSize, (DWORD)(1.5f * frameWidth * frameHeight)), &outputBuffer); }
+    if (SUCCEEDED(hr)) { hr = MFCreateSample(&outputSample); }
+    if (SUCCEEDED(hr)) { hr = outputSample->AddBuffer(outputBuffer); }
+    if (SUCCEEDED(hr)) { hr = MFCreateSample(&inputSample); }
+
+    if (SUCCEEDED(hr)) { hr = transform->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0); }
+    if (SUCCEEDED(hr)) { hr = transform->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0); }
+
+    if (FAILED(hr))
+    {
+        OutputDebugString(L"ERROR: Could not create the instant replay encoder.\n");
+    }
+
+    return hr;
+}
+
+void ReplayEncoder::UpdateHeader()
+{
+    IMFMediaType* type = NULL;
+    UINT32 size = 0;
+
+    HRESULT hr = transform->GetOutputCurrentType(0, &type);
+    if (SUCCEEDED(hr)) { hr = type->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &size); }
+
+    if (SUCCEEDED(hr) && size > 0)
+    {
+        std::vector<BYTE> header(size);
+        if (SUCCEEDED(type->GetBlob(MF_MT_MPEG_SEQUENCE_HEADER, header.data(), size, NULL)))
+        {
+            replay.SetHeader(header.data(), size);
+            hasHeader = true;
+        }
+    }
+
+    SafeRelease(type);
+}
+
+HRESULT ReplayEncoder::ProcessOutput()
+{
+    while (true)
+    {
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        output.pSample = outputSample;
+        DWORD status = 0;
+
+        // The sample is reused, so clear the last frame's attributes (eg: CleanPoint) before the encoder sets this frame's.
+        outputSample->DeleteAllItems();
+        outputBuffer->SetCurrentLength(0);
+        HRESULT hr = transform->ProcessOutput(0, 1, &output, &status);
+        SafeRelease(output.pEvents);
+
+        if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT)
+        {
+            return S_FALSE;
+        }
+
+        if (hr == MF_E_TRANSFORM_STREAM_CHANGE)
+        {
+            // The encoder has new stream parameters, take its preferred output type and continue.
+            IMFMediaType* type = NULL;
+            hr = transform->GetOutputAvailableType(0, 0, &type);
+            if (SUCCEEDED(hr)) { hr = transform->SetOutputType(0, type, 0); }
+            SafeRelease(type);
+            hasHeader = false;
+
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+            continue;
+        }
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (!hasHeader)
+        {
+            UpdateHeader();
+        }
+
+        LONGLONG sampleTime = 0, sampleDuration = 0;
+        outputSample->GetSampleTime(&sampleTime);
+        outputSample->GetSampleDuration(&sampleDuration);
+        bool keyFrame = MFGetAttributeUINT32(outputSample, MFSampleExtension_CleanPoint, FALSE) != FALSE;
+
+        BYTE* data = NULL;
+        DWORD length = 0;
+        if (SUCCEEDED(outputBuffer->Lock(&data, NULL, &length)))
+        {
+            replay.Add(data, length, sampleTime, sampleDuration, keyFrame);
+            outputBuffer->Unlock();
+        }
+    }
+}
+
+IMFMediaBuffer* ReplayEncoder::GetFreeBuffer()
+{
+    std::lock_guard<std::mutex> guard(bufferLock);
+    if (freeBuffers.empty())
+    {
+        return nullptr;
+    }
+
+    IMFMediaBuffer* buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    return buffer;
+}
+
+void ReplayEncoder::ReleaseBuffer(IMFMediaBuffer* buffer)
+{
+    std::lock_guard<std::mutex> guard(bufferLock);
+    freeBuffers.push_back(buffer);
+}
+
+bool ReplayEncoder::QueueFrame(IMFMediaBuffer* buffer, LONGLONG duration)
+{
+    LONGLONG frameTime = time;
+    time += duration;
+
+    IMFMediaBuffer* copy = GetFreeBuffer();
+    if (copy == nullptr)
+    {
+        // Every copy is queued or being encoded.  Leave a gap in the replay rather than hold up the recording.
+        numFramesDropped++;
+        return false;
+    }
+
+    BYTE* source = NULL;
+    BYTE* destination = NULL;
+    DWORD length = 0, maxLength = 0;
+    HRESULT hr = buffer->Lock(&source, NULL, &length);
+    if (SUCCEEDED(hr))
+    {
+        hr = copy->Lock(&destination, &maxLength, NULL);
+        if (SUCCEEDED(hr))
+        {
+            length = (std::min)(length, maxLength);
+            memcpy(destination, source, length);
+            copy->Unlock();
+        }
+        buffer->Unlock();
+    }
+    if (SUCCEEDED(hr)) { hr = copy->SetCurrentLength(length); }
+
+    if (FAILED(hr))
+    {
+        ReleaseBuffer(copy);
+        numFramesDropped++;
+        return false;
+    }
+
+    // Cannot fail, the queue can hold every buffer.
+    frameQueue.TryPush({ copy, frameTime, duration });
+    SetEvent(frameQueuedEvent);
+    return true;
+}
+
+void ReplayEncoder::Encode(const Frame& frame)
+{
+    HRESULT hr = inputSample->AddBuffer(frame.buffer);
+    if (SUCCEEDED(hr)) { hr = inputSample->SetSampleTime(frame.time); }
+    if (SUCCEEDED(hr)) { hr = inputSample->SetSampleDuration(frame.duration); }
+    if (SUCCEEDED(hr))
+    {
+        hr = transform->ProcessInput(0, inputSample, 0);
+        if (hr == MF_E_NOTACCEPTING)
+        {
+            // Collect anything still waiting in the encoder and try again.
+            hr = ProcessOutput();
+            if (SUCCEEDED(hr)) { hr = transform->ProcessInput(0, inputSample, 0); }
+        }
+    }
+    if (SUCCEEDED(hr)) { hr = ProcessOutput(); }
+
+    // The encoder is done with the frame, let go of the copy.
+    inputSample->RemoveAllBuffers();
+
+    if (FAILED(hr))
+    {
+        OutputDebugString(L"Error encoding instant replay frame.\n");
+    }
+}
+
+void ReplayEncoder::EncoderThread(std::promise<bool> initialized)
+{
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    bool comInitialized = SUCCEEDED(hr);
+
+    hr = MFStartup(MF_VERSION);
+    bool mfStarted = SUCCEEDED(hr);
+
+    if (SUCCEEDED(hr)) { hr = CreateTransform(); }
+    initialized.set_value(SUCCEEDED(hr));
+
+    while (SUCCEEDED(hr) && !stopEncoding)
+    {
+        // Signalled after every push, so anything queued after the queue is seen empty wakes us again.
+        WaitForSingleObject(frameQueuedEvent, INFINITE);
+
+        Frame frame;
+        while (!stopEncoding && frameQueue.TryPop(frame))
+        {
+            Encode(frame);
+            ReleaseBuffer(frame.buffer);
+        }
+    }
+
+    if (transform != nullptr)
+    {
+        transform->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0);
+    }
+
+    SafeRelease(inputSample);
+    SafeRelease(outputSample);
+    SafeRelease(outputBuffer);
+    SafeRelease(transform);
+
+    if (mfStarted)
+    {
+        MFShutdown();
+    }
+    if (comInitialized)
+    {
+        CoUninitialize();
+    }
+}
+
+bool ReplayEncoder::Save(const std::wstring& path)
+{
+    if (saving.exchange(true))
+    {
+        return false;
+    }
+
+    // The last save has finished, so this does not wait.
+    if (saveThread.joinable())
+    {
+        saveThread.join();
+    }
+
+    saveThread = std::thread(&ReplayEncoder::SaveThread, this, path);
+    return true;
+}
+
+void ReplayEncoder::SaveThread(std::wstring path)
+{
+    // The sink writer is a COM object, and Media Foundation has to be started on every thread that uses it.
+    HRESULT hr = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+    bool comInitialized = SUCCEEDED(hr);
+
+    hr = MFStartup(MF_VERSION);
+    bool mfStarted = SUCCEEDED(hr);
+
+    // Copying the replay out only holds up the encoder thread for a memcpy, muxing happens without any locks.
+    std::vector<ReplayBuffer::Sample> samples;
+    std::vector<BYTE> data, header;
+    if (SUCCEEDED(hr)) { hr = replay.Snapshot(samples, data, header) ? S_OK : E_PENDING; }
+
+    IMFSinkWriter* sinkWriter = NULL;
+    IMFMediaType* type = NULL;
+    DWORD streamIndex = 0;
+
+    // The same type in and out, so the sink writer muxes the samples as they are.
+    if (SUCCEEDED(hr)) { hr = MFCreateSinkWriterFromURL(path.c_str(), NULL, NULL, &sinkWriter); }
+    if (SUCCEEDED(hr)) { hr = CreateOutputType(&type); }
+    if (SUCCEEDED(hr) && !header.empty()) { hr = type->SetBlob(MF_MT_MPEG_SEQUENCE_HEADER, header.data(), (UINT32)header.size()); }
+    if (SUCCEEDED(hr)) { hr = sinkWriter->AddStream(type, &streamIndex); }
+    if (SUCCEEDED(hr)) { hr = sinkWriter->SetInputMediaType(streamIndex, type, NULL); }
+    if (SUCCEEDED(hr)) { hr = sinkWriter->BeginWriting(); }
+
+    LONGLONG startTime = samples.empty() ? 0 : samples.front().time;
+    for (size_t i = 0; i < samples.size() && SUCCEEDED(hr); i++)
+    {
+        const ReplayBuffer::Sample& replaySample = samples[i];
+        IMFMediaBuffer* buffer = NULL;
+        IMFSample* sample = NULL;
+        BYTE* bytes = NULL;
+
+        hr = MFCreateMemoryBuffer(replaySample.size, &buffer);
+        if (SUCCEEDED(hr)) { hr = buffer->Lock(&bytes, NULL, NULL); }
+        if (SUCCEEDED(hr))
+        {
+            memcpy(bytes, &data[replaySample.offset], replaySample.size);
+            buffer->Unlock();
+        }
+        if (SUCCEEDED(hr)) { hr = buffer->SetCurrentLength(replaySample.size); }
+        if (SUCCEEDED(hr)) { hr = MFCreateSample(&sample); }
+        if (SUCCEEDED(hr)) { hr = sample->AddBuffer(buffer); }
+        if (SUCCEEDED(hr)) { hr = sample->SetSampleTime(replaySample.time - startTime); }
+        if (SUCCEEDED(hr)) { hr = sample->SetSampleDuration(replaySample.duration); }
+        if (SUCCEEDED(hr)) { hr = sample->SetUINT32(MFSampleExtension_CleanPoint, replaySample.keyFrame); }
+        if (SUCCEEDED(hr)) { hr = sinkWriter->WriteSample(streamIndex, sample); }
+
+        SafeRelease(sample);
+        SafeRelease(buffer);
+    }
+
+    if (SUCCEEDED(hr)) { hr = sinkWriter->Finalize(); }
+
+    SafeRelease(type);
+    SafeRelease(sinkWriter);
+
+    if (SUCCEEDED(hr))
+    {
+        LONGLONG duration = samples.back().time + samples.back().duration - startTime;
+        OutputDebugString((L"Saved replay: " + path + L" (" + std::to_wstring(duration / MS2HNS) + L" ms, " +
+            std::to_wstring(data.size() / 1024) + L" KB)\n").c_str());
+    }
+    else if (hr == E_PENDING)
+    {
+        OutputDebugString(L"Nothing has been encoded for instant replay yet.\n");
+    }
+    else
+    {
+        OutputDebugString((L"ERROR: Could not save replay: " + path + L"\n").c_str());
+    }
+
+    if (mfStarted)
+    {
+        MFShutdown();
+    }
+    if (comInitialized)
+    {
+        CoUninitialize();
+    }
+
+    saving = false;
+}
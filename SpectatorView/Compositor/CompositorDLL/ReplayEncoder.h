@@ -0,0 +1,111 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+#include <Windows.h>
+#include <mfapi.h>
+#include <mfidl.h>
+#include <Mfreadwrite.h>
+#include <mferror.h>
+
+#include "ReplayBuffer.h"
+#include "SPSCQueue.h"
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <mutex>
+
+// CODECAPI_ property GUIDs.
+#pragma comment(lib, "strmiids")
+
+//TODO: Default length and memory budget of the instant replay, when StartReplay is not given them.
+// The replay covers at least this many seconds, and at most one GOP more, unless it runs out of memory first.
+#define REPLAY_SECONDS 30
+#define REPLAY_MEMORY_MB 128
+// Bit rate and keyframe interval of the replay stream.  Replays are evicted a GOP at a time.
+#define REPLAY_BITRATE (20 * 1000 * 1000)
+#define REPLAY_GOP_SECONDS 1
+// Frames waiting for the replay encoder, this must be a power of 2.  Frames are dropped from the replay if it falls further behind.
+#define REPLAY_QUEUE_CAPACITY 4
+
+// Always-on H.264 encoder for instant replay.
+// Composite frames are copied into a small pool and encoded on the replay encoder's own thread into a ReplayBuffer,
+// which can be muxed to an MP4 at any time without re-encoding.  A slow software encode never holds up the recording.
+class ReplayEncoder
+{
+public:
+    ReplayEncoder(UINT frameWidth, UINT frameHeight, UINT fps, size_t memoryBudget, LONGLONG durationHNS);
+    // Stops the encoder thread and waits for a replay that is being saved.
+    ~ReplayEncoder();
+
+    // Starts the encoder thread and creates the encoder on it.  Returns false if there is no H.264 encoder.
+    bool Initialize();
+
+    // One producer thread only.  buffer is an NV12 frame, it is copied and no longer used once this returns.
+    // Never waits for the encoder: returns false if the encoder has fallen behind and the frame was dropped from the replay.
+    bool QueueFrame(IMFMediaBuffer* buffer, LONGLONG duration);
+    int GetNumFramesDropped() { return numFramesDropped; }
+
+    // Mux everything in the replay buffer to an MP4 on a background thread.
+    // Returns false if a replay is already being saved.
+    bool Save(const std::wstring& path);
+    bool IsSaving() { return saving; }
+
+    LONGLONG GetDuration() { return replay.GetDuration(); }
+
+private:
+    struct Frame
+    {
+        IMFMediaBuffer* buffer;
+        LONGLONG time;
+        LONGLONG duration;
+    };
+
+    // Encoder thread only.
+    HRESULT CreateTransform();
+    HRESULT CreateOutputType(IMFMediaType** type);
+    // Returns S_FALSE once the encoder needs more input.
+    HRESULT ProcessOutput();
+    void UpdateHeader();
+    void Encode(const Frame& frame);
+    void EncoderThread(std::promise<bool> initialized);
+
+    void SaveThread(std::wstring path);
+
+    IMFMediaBuffer* GetFreeBuffer();
+    void ReleaseBuffer(IMFMediaBuffer* buffer);
+
+    UINT frameWidth;
+    UINT frameHeight;
+    UINT fps;
+
+    // Media Foundation objects are created and used on the encoder thread only.
+    IMFTransform* transform = nullptr;
+    // Reused for every frame.
+    IMFSample* inputSample = nullptr;
+    IMFSample* outputSample = nullptr;
+    IMFMediaBuffer* outputBuffer = nullptr;
+    bool hasHeader = false;
+
+    // Pooled frame copies.  Buffers are taken by the producer and returned by the encoder thread, so the free list is locked.
+    std::vector<IMFMediaBuffer*> buffers;
+    std::vector<IMFMediaBuffer*> freeBuffers;
+    std::mutex bufferLock;
+
+    SPSCQueue<Frame, REPLAY_QUEUE_CAPACITY> frameQueue;
+    HANDLE frameQueuedEvent = NULL;
+    // Producer only.  Sample time of the next frame, dropped frames still move it on so the replay keeps real time.
+    LONGLONG time = 0;
+    std::atomic<int> numFramesDropped{ 0 };
+
+    std::thread encoderThread;
+    std::atomic<bool> stopEncoding{ false };
+
+    ReplayBuffer replay;
+
+    std::thread saveThread;
+    std::atomic<bool> saving{ false };
+};
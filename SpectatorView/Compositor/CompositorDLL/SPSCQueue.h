@@ -0,0 +1,60 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <atomic>
+
+// Fixed capacity queue for exactly one producer thread and one consumer thread.
+// Neither side takes a lock, so a slow consumer can never block the producer (and vice versa).
+// Capacity must be a power of 2.
+template<class T, int Capacity>
+class SPSCQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of 2.");
+
+public:
+    SPSCQueue() : head(0), tail(0)
+    {
+    }
+
+    // Producer only.  Returns false if the queue is full.
+    bool TryPush(const T& item)
+    {
+        unsigned int currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        items[currentTail & (Capacity - 1)] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only.  Returns false if the queue is empty.
+    bool TryPop(T& item)
+    {
+        unsigned int currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = items[currentHead & (Capacity - 1)];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of queued items.  Only a snapshot when called from a thread that is not the producer or consumer.
+    int Size()
+    {
+        return (int)(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+    }
+
+private:
+    T items[Capacity];
+
+    // Keep the indices on separate cache lines so the producer and consumer do not contend.
+    alignas(64) std::atomic<unsigned int> head;
+    alignas(64) std::atomic<unsigned int> tail;
+};
@@ -0,0 +1,196 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "stdafx.h"
+#include "SyntheticFrameProvider.h"
+#include "FrameTimer.h"
+
+SyntheticFrameProvider::SyntheticFrameProvider(int width, int height, int fps, float jitterMS, bool realTime) :
+    width(width),
+    height(height),
+    durationHNS(S2HNS / (fps > 0 ? fps : SYNTHETIC_FRAME_FPS)),
+    jitterHNS((LONGLONG)(jitterMS * MS2HNS)),
+    realTime(realTime)
+{
+    // Keep captured frames in order.
+    if (jitterHNS > durationHNS / 2)
+    {
+        jitterHNS = durationHNS / 2;
+    }
+
+    for (int i = 0; i < MAX_NUM_CACHED_BUFFERS; i++)
+    {
+        bufferCache[i].buffer = new BYTE[GetFrameSize()];
+        bufferCache[i].timeStamp = 0;
+    }
+
+    // 8 vertical color bars: white, yellow, cyan, green, magenta, red, blue, black (BGRA).
+    const BYTE bars[8][4] =
+    {
+        { 255, 255, 255, 255 },
+        { 0, 255, 255, 255 },
+        { 255, 255, 0, 255 },
+        { 0, 255, 0, 255 },
+        { 255, 0, 255, 255 },
+        { 0, 0, 255, 255 },
+        { 255, 0, 0, 255 },
+        { 0, 0, 0, 255 }
+    };
+
+    pattern = new BYTE[GetFrameSize()];
+    for (int x = 0; x < width; x++)
+    {
+        memcpy(&pattern[x * FRAME_BPP], bars[(x * 8) / width], FRAME_BPP);
+    }
+
+    for (int y = 1; y < height; y++)
+    {
+        memcpy(&pattern[y * width * FRAME_BPP], pattern, width * FRAME_BPP);
+    }
+}
+
+SyntheticFrameProvider::~SyntheticFrameProvider()
+{
+    Dispose();
+
+    for (int i = 0; i < MAX_NUM_CACHED_BUFFERS; i++)
+    {
+        delete[] bufferCache[i].buffer;
+    }
+
+    delete[] pattern;
+}
+
+HRESULT SyntheticFrameProvider::Initialize(ID3D11ShaderResourceView* srv)
+{
+    if (IsEnabled())
+    {
+        return S_OK;
+    }
+
+    // The color texture is optional, so frames can be generated without a device.
+    _colorSRV = srv;
+    _device = nullptr;
+    if (_colorSRV != nullptr)
+    {
+        _colorSRV->GetDevice(&_device);
+    }
+
+    uploadFrames = _colorSRV != nullptr && width == FRAME_WIDTH && height == FRAME_HEIGHT;
+    if (_colorSRV != nullptr && !uploadFrames)
+    {
+        OutputDebugString(L"Synthetic frames do not match FRAME_WIDTH x FRAME_HEIGHT and will not be uploaded.\n");
+    }
+
+    for (int i = 0; i < MAX_NUM_CACHED_BUFFERS; i++)
+    {
+        bufferCache[i].timeStamp = 0;
+    }
+
+    random.seed(0);
+    captureFrameIndex = 0;
+    isEnabled = true;
+
+    if (realTime)
+    {
+        stopCapture = false;
+        captureThread = std::thread(&SyntheticFrameProvider::CaptureThread, this);
+    }
+
+    return S_OK;
+}
+
+bool SyntheticFrameProvider::IsEnabled()
+{
+    return isEnabled;
+}
+
+LONGLONG SyntheticFrameProvider::GetJitterHNS()
+{
+    if (jitterHNS <= 0)
+    {
+        return 0;
+    }
+
+    std::uniform_int_distribution<LONGLONG> distribution(-jitterHNS, jitterHNS);
+    return distribution(random);
+}
+
+// Capture thread in real time mode, render thread otherwise.
+void SyntheticFrameProvider::CaptureFrame(LONGLONG timeStamp)
+{
+    int index = captureFrameIndex + 1;
+    BufferCache& slot = bufferCache[index % MAX_NUM_CACHED_BUFFERS];
+
+    memcpy(slot.buffer, pattern, GetFrameSize());
+
+    // Sweep a grey bar across the frame so consecutive frames differ.
+    int barWidth = std::max(width / 32, 1);
+    int barX = (index * 8) % std::max(width - barWidth, 1);
+    for (int y = 0; y < height; y++)
+    {
+        memset(&slot.buffer[(y * width + barX) * FRAME_BPP], 128, barWidth * FRAME_BPP);
+    }
+
+    memcpy(slot.buffer, &index, sizeof(index));
+    slot.timeStamp = timeStamp;
+
+    captureFrameIndex.store(index, std::memory_order_release);
+}
+
+void SyntheticFrameProvider::CaptureThread()
+{
+    FrameTimer timer;
+    LONGLONG startHNS = timer.NowHNS();
+
+    for (int index = 1; !stopCapture; index++)
+    {
+        // Wait until this frame's jittered capture time.
+        timer.WaitUntil(startHNS + index * durationHNS + GetJitterHNS());
+
+        // Timestamp with when the frame was actually generated, like a capture card would.
+        CaptureFrame(timer.NowHNS());
+    }
+}
+
+void SyntheticFrameProvider::Update(int compositeFrameIndex)
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    if (!realTime)
+    {
+        int index = captureFrameIndex + 1;
+        CaptureFrame(index * durationHNS + GetJitterHNS());
+    }
+
+    if (uploadFrames && _device != nullptr)
+    {
+        DirectXHelper::UpdateSRV(_device, _colorSRV, GetFrameBytes(compositeFrameIndex), width * FRAME_BPP);
+    }
+}
+
+void SyntheticFrameProvider::StopCaptureThread()
+{
+    stopCapture = true;
+    if (captureThread.joinable())
+    {
+        captureThread.join();
+    }
+}
+
+void SyntheticFrameProvider::Dispose()
+{
+    StopCaptureThread();
+
+    if (_device != nullptr)
+    {
+        _device->Release();
+        _device = nullptr;
+    }
+
+    isEnabled = false;
+    captureFrameIndex = 0;
+}
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include "IFrameProvider.h"
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+
+#include "DirectXHelper.h"
+
+//TODO: Change these values to match the camera you want to simulate.
+#define SYNTHETIC_FRAME_WIDTH       FRAME_WIDTH
+#define SYNTHETIC_FRAME_HEIGHT      FRAME_HEIGHT
+#define SYNTHETIC_FRAME_FPS         60
+// Each frame's capture time is offset by a random amount up to this many milliseconds either way.
+#define SYNTHETIC_FRAME_JITTER_MS   2.0f
+
+// Generates a moving test pattern instead of capturing from a camera, so the compositor can be profiled without capture hardware.
+// Frames are BGRA, and the capture frame index is stored in the first pixel so it can be read back downstream.
+// Frames are only uploaded to the color texture if the resolution matches FRAME_WIDTH x FRAME_HEIGHT.
+//
+// In real time mode a capture thread generates frames at the configured rate and timestamps them when they are generated.
+// Otherwise every Update captures exactly one frame, with timestamps that advance by the frame duration,
+// so a harness can drive the compositor as fast as it will go.
+class SyntheticFrameProvider : public IFrameProvider
+{
+public:
+    SyntheticFrameProvider(int width = SYNTHETIC_FRAME_WIDTH, int height = SYNTHETIC_FRAME_HEIGHT,
+        int fps = SYNTHETIC_FRAME_FPS, float jitterMS = SYNTHETIC_FRAME_JITTER_MS, bool realTime = true);
+    ~SyntheticFrameProvider();
+
+    // Inherited via IFrameProvider
+    virtual HRESULT Initialize(ID3D11ShaderResourceView* srv) override;
+    virtual bool IsEnabled() override;
+    virtual void Update(int compositeFrameIndex) override;
+    virtual void Dispose() override;
+
+    virtual bool OutputYUV()
+    {
+        return false;
+    }
+
+    virtual LONGLONG GetTimestamp(int frame)
+    {
+        return bufferCache[frame % MAX_NUM_CACHED_BUFFERS].timeStamp;
+    }
+
+    virtual LONGLONG GetDurationHNS()
+    {
+        return durationHNS;
+    }
+
+    virtual int GetCaptureFrameIndex()
+    {
+        return captureFrameIndex;
+    }
+
+    // Bytes of the frame captured at index, valid until MAX_NUM_CACHED_BUFFERS more frames are captured.
+    const BYTE* GetFrameBytes(int frame)
+    {
+        return bufferCache[frame % MAX_NUM_CACHED_BUFFERS].buffer;
+    }
+
+    int GetFrameSize()
+    {
+        return width * height * FRAME_BPP;
+    }
+
+private:
+    int width;
+    int height;
+    LONGLONG durationHNS;
+    LONGLONG jitterHNS;
+    bool realTime;
+
+    bool isEnabled = false;
+    bool uploadFrames = false;
+
+    ID3D11ShaderResourceView* _colorSRV = nullptr;
+    ID3D11Device* _device = nullptr;
+
+    class BufferCache
+    {
+    public:
+        BYTE * buffer;
+        LONGLONG timeStamp;
+    };
+
+    BufferCache bufferCache[MAX_NUM_CACHED_BUFFERS];
+    // Published after the frame's slot has been written.
+    std::atomic<int> captureFrameIndex{ 0 };
+
+    // Color bars that every frame starts from.
+    BYTE* pattern = nullptr;
+    std::mt19937 random;
+
+    std::thread captureThread;
+    std::atomic<bool> stopCapture{ false };
+    void CaptureThread();
+    void StopCaptureThread();
+
+    LONGLONG GetJitterHNS();
+    void CaptureFrame(LONGLONG timeStamp);
+};
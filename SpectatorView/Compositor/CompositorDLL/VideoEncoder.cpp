@@ -8,7 +8,7 @@
 
 
 VideoEncoder::VideoEncoder(UINT frameWidth, UINT frameHeight, UINT frameStride, UINT fps,
-    UINT32 audioBufferSize, UINT32 audioSampleRate, UINT32 audioChannels, UINT32 audioBPS) :
+    UINT32 audioBufferSize, UINT32 audioSampleRate, UINT32 audioChannels, UINT32 audioBPS, UINT32 bitRate) :
     frameWidth(frameWidth),
     frameHeight(frameHeight),
     frameStride(frameStride),
@@ -17,15 +17,32 @@ VideoEncoder::VideoEncoder(UINT frameWidth, UINT frameHeight, UINT frameStride,
     audioChannels(audioChannels),
     audioBPS(audioBPS),
     fps(fps),
-    bitRate(62 * 1000 * 1000 + 500 * 1000), // 62,5 MBit/s
+    bitRate(bitRate),
     videoEncodingFormat(MFVideoFormat_H264),
-    isRecording(false)
+    isRecording(false),
+    sampleFreeCallback(this),
+    audioRing(audioChannels, audioSampleRate, AUDIO_RING_FRAMES, audioBufferSize / (audioChannels * sizeof(short)),
+        (audioSampleRate * AUDIO_SPLICE_THRESHOLD_MS) / 1000)
 {
     inputFormat = MFVideoFormat_NV12;
+
+    framesQueuedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
 }
 
 VideoEncoder::~VideoEncoder()
 {
+    if (encoderThread.joinable())
+    {
+        stopEncoding = true;
+        SetEvent(framesQueuedEvent);
+        encoderThread.join();
+    }
+
+    StopRenditions();
+    delete replayEncoder;
+
+    FreeFrameBuffers();
+    CloseHandle(framesQueuedEvent);
     MFShutdown();
 }
 
@@ -35,27 +52,202 @@ bool VideoEncoder::Initialize(ID3D11Device* device)
     hr = MFStartup(MF_VERSION);
 
     QueryPerformanceFrequency(&freq);
+    this->device = device;
 
     MFCreateDXGIDeviceManager(&resetToken, &deviceManager);
 
-    if (deviceManager != nullptr)
+    if (deviceManager != nullptr && device != nullptr)
     {
         OutputDebugString(L"Resetting device manager with graphics device.\n");
         deviceManager->ResetDevice(device, resetToken);
     }
 
-    numFramesRecorded = 0;
-    numAudioFramesRecorded = 0;
+    videoQueue.Reset();
+
+    if (SUCCEEDED(hr) && !AllocateFrameBuffers())
+    {
+        OutputDebugString(L"Error allocating video encoder frame buffers.\n");
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (SUCCEEDED(hr) && !encoderThread.joinable())
+    {
+        encoderThread = std::thread([this] { EncodeFrames(); });
+    }
 
     return SUCCEEDED(hr);
 }
 
+bool VideoEncoder::AllocateFrameBuffers()
+{
+    if (!frameBuffers.empty())
+    {
+        return true;
+    }
+
+    DWORD videoLength = (DWORD)(1.5f * frameWidth * frameHeight);
+
+    for (int i = 0; i < NUM_VIDEO_BUFFERS + NUM_AUDIO_BUFFERS; i++)
+    {
+        FrameBuffer* frame = new FrameBuffer();
+        frame->isAudio = i >= NUM_VIDEO_BUFFERS;
+        frame->length = frame->isAudio ? audioBufferSize : videoLength;
+        frameBuffers.push_back(frame);
+
+        // Tracked samples tell us when the sink writer has let go of them, so their buffers can be safely reused.
+        // The pool only holds the IMFSample reference, otherwise the sample would never be released.
+        IMFTrackedSample* trackedSample = NULL;
+        HRESULT hr = MFCreateTrackedSample(&trackedSample);
+        if (SUCCEEDED(hr)) { hr = trackedSample->QueryInterface(IID_PPV_ARGS(&frame->sample)); }
+        if (SUCCEEDED(hr)) { frame->trackedSample = trackedSample; }
+        SafeRelease(trackedSample);
+
+        if (SUCCEEDED(hr)) { hr = MFCreateMemoryBuffer(frame->length, &frame->mediaBuffer); }
+        if (SUCCEEDED(hr)) { hr = frame->mediaBuffer->SetCurrentLength(frame->length); }
+        if (SUCCEEDED(hr)) { hr = frame->sample->AddBuffer(frame->mediaBuffer); }
+
+        if (FAILED(hr))
+        {
+            FreeFrameBuffers();
+            return false;
+        }
+
+        if (frame->isAudio)
+        {
+            freeAudioBuffers.push_back(frame);
+        }
+        else
+        {
+            freeVideoBuffers.push_back(frame);
+        }
+    }
+
+    return true;
+}
+
+void VideoEncoder::FreeFrameBuffers()
+{
+    std::lock_guard<std::mutex> lock(frameBufferLock);
+
+    for (FrameBuffer* frame : frameBuffers)
+    {
+        SafeRelease(frame->mediaBuffer);
+        SafeRelease(frame->sample);
+        delete frame;
+    }
+
+    frameBuffers.clear();
+    freeVideoBuffers.clear();
+    freeAudioBuffers.clear();
+}
+
+STDMETHODIMP VideoEncoder::SampleFreeCallback::QueryInterface(REFIID riid, void** ppv)
+{
+    if (ppv == nullptr)
+    {
+        return E_POINTER;
+    }
+
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IMFAsyncCallback))
+    {
+        *ppv = static_cast<IMFAsyncCallback*>(this);
+        return S_OK;
+    }
+
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+}
+
+STDMETHODIMP VideoEncoder::SampleFreeCallback::Invoke(IMFAsyncResult* result)
+{
+    IUnknown* object = nullptr;
+    IMFSample* sample = nullptr;
+
+    HRESULT hr = result->GetObject(&object);
+    if (SUCCEEDED(hr)) { hr = object->QueryInterface(IID_PPV_ARGS(&sample)); }
+    SafeRelease(object);
+
+    if (SUCCEEDED(hr))
+    {
+        // The reference from QueryInterface becomes the pool's reference again.
+        encoder->ReleaseFrameBuffer(sample);
+    }
+
+    return hr;
+}
+
+VideoEncoder::FrameBuffer* VideoEncoder::GetFreeFrameBuffer(bool isAudio)
+{
+    std::lock_guard<std::mutex> lock(frameBufferLock);
+
+    std::vector<FrameBuffer*>& freeBuffers = isAudio ? freeAudioBuffers : freeVideoBuffers;
+    if (freeBuffers.empty())
+    {
+        return nullptr;
+    }
+
+    FrameBuffer* frame = freeBuffers.back();
+    freeBuffers.pop_back();
+    return frame;
+}
+
+void VideoEncoder::ReleaseFrameBuffer(IMFSample* sample)
+{
+    // frameBuffers does not change while recording, so it can be searched without the lock.
+    for (FrameBuffer* frame : frameBuffers)
+    {
+        if (frame->sample == sample)
+        {
+            ReleaseFrameBuffer(frame);
+
+            if (frame->isAudio)
+            {
+                // Wake the encoder thread in case audio is waiting for a buffer.
+                SetEvent(framesQueuedEvent);
+            }
+            return;
+        }
+    }
+}
+
+void VideoEncoder::ReleaseFrameBuffer(FrameBuffer* frame)
+{
+    std::lock_guard<std::mutex> lock(frameBufferLock);
+    if (frame->isAudio)
+    {
+        freeAudioBuffers.push_back(frame);
+    }
+    else
+    {
+        freeVideoBuffers.push_back(frame);
+    }
+}
+
+ULONGLONG VideoEncoder::GetEncoderCPUTime()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!encoderThread.joinable() ||
+        !GetThreadTimes(encoderThread.native_handle(), &creationTime, &exitTime, &kernelTime, &userTime))
+    {
+        return 0;
+    }
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+
+    // 100-nanosecond units
+    return kernel.QuadPart + user.QuadPart;
+}
+
 bool VideoEncoder::IsRecording()
 {
     return isRecording;
 }
 
-void VideoEncoder::StartRecording(LPCWSTR videoPath, bool encodeAudio)
+void VideoEncoder::StartRecording(LPCWSTR videoPath, bool encodeAudio, const std::vector<Rendition>& renditions)
 {
     std::unique_lock<std::shared_mutex> lock(videoStateLock);
 
@@ -65,8 +257,18 @@ void VideoEncoder::StartRecording(LPCWSTR videoPath, bool encodeAudio)
     }
 
     // Reset previous times to get valid data for this recording.
-    numFramesRecorded = 0;
-    numAudioFramesRecorded = 0;
+    videoQueue.Reset();
+    writtenVideoEndTime = 0;
+    numAudioBlocksRecorded = 0;
+    audioRing.Reset();
+    QueryPerformanceCounter(&recordingStartTime);
+
+    numVideoFramesEncoded = 0;
+    numAudioFramesEncoded = 0;
+    numVideoFramesDropped = 0;
+    numAudioFramesDropped = 0;
+    recordingIndex++;
+    encoderCPUTimeAtStart = GetEncoderCPUTime();
 
     HRESULT hr = E_PENDING;
 
@@ -162,8 +364,33 @@ void VideoEncoder::StartRecording(LPCWSTR videoPath, bool encodeAudio)
     }
 
     isRecording = true;
+    isRecordingAudio = ENCODE_AUDIO && encodeAudio;
     acceptQueuedFrames = true;
 
+    renditionStats.clear();
+    for (const Rendition& rendition : renditions)
+    {
+        if (rendition.width > frameWidth || rendition.height > frameHeight || ((rendition.width | rendition.height) & 1) != 0)
+        {
+            OutputDebugString((L"Skipping rendition " + rendition.path + L", it must have an even size no larger than the recording.\n").c_str());
+            continue;
+        }
+
+        VideoEncoder* encoder = new VideoEncoder(rendition.width, rendition.height, rendition.width, fps,
+            audioBufferSize, audioSampleRate, audioChannels, audioBPS, rendition.bitRate);
+        if (!encoder->Initialize(device))
+        {
+            OutputDebugString((L"Error starting rendition " + rendition.path + L".\n").c_str());
+            delete encoder;
+            continue;
+        }
+
+        encoder->StartRecording(rendition.path.c_str(), encodeAudio);
+        // Audio is timed from the same start as this recording's.
+        encoder->recordingStartTime = recordingStartTime;
+        this->renditions.push_back({ encoder, 0, 0 });
+    }
+
     SafeRelease(pVideoTypeOut);
     SafeRelease(pVideoTypeIn);
 
@@ -173,165 +400,202 @@ void VideoEncoder::StartRecording(LPCWSTR videoPath, bool encodeAudio)
 #endif
 }
 
-void VideoEncoder::WriteAudio(byte* buffer)
+void VideoEncoder::EncodeFrames()
+{
+    while (!stopEncoding)
+    {
+        // Producers signal after every push, so anything queued after the queues are seen empty wakes us again.
+        WaitForSingleObject(framesQueuedEvent, INFINITE);
+
+        FrameBuffer* frame = nullptr;
+        while (!stopEncoding)
+        {
+            // Audio buffers are the scarcer resource, so always write all queued audio before the next video frame.
+            EncodeAudio();
+
+            // Drop the oldest video if the encoder has fallen behind.
+            bool popped = videoQueue.Pop(frame, [this](FrameBuffer* dropped)
+            {
+                if (acceptQueuedFrames && dropped->recordingIndex == recordingIndex)
+                {
+                    numVideoFramesDropped++;
+                }
+                ReleaseFrameBuffer(dropped);
+            });
+
+            if (!popped)
+            {
+                break;
+            }
+
+            WriteFrame(frame);
+        }
+    }
+}
+
+void VideoEncoder::EncodeAudio()
 {
     std::shared_lock<std::shared_mutex> lock(videoStateLock);
 
-#if ENCODE_AUDIO
-    if (!isRecording)
+    if (sinkWriter == NULL || !isRecording || !isRecordingAudio)
     {
         return;
     }
 
-    LONGLONG sampleTime = numAudioFramesRecorded * AUDIO_POLLING_RATE_HNS;
-    LONGLONG duration = AUDIO_POLLING_RATE_HNS;
-
-    // Copy frame to a temporary buffer and process on a background thread.
-    byte* tmpAudioBuffer = new byte[audioBufferSize];
-    memcpy(tmpAudioBuffer, buffer, audioBufferSize);
-
-    concurrency::create_task([=]()
+    while (true)
     {
-        std::shared_lock<std::shared_mutex> lock(videoStateLock);
-
-        HRESULT hr = E_PENDING;
-        if (sinkWriter == NULL || !isRecording)
+        FrameBuffer* frame = GetFreeFrameBuffer(true);
+        if (frame == nullptr)
         {
-            OutputDebugString(L"Must start recording before writing audio frames.\n");
-            delete[] tmpAudioBuffer;
+            // The sink writer still holds every audio buffer, the encoder thread is woken again when it releases one.
             return;
         }
 
-        IMFSample* pAudioSample = NULL;
-        IMFMediaBuffer* pAudioBuffer = NULL;
-
-        const DWORD cbAudioBuffer = audioBufferSize;
-
-        BYTE* pData = NULL;
-
-        hr = MFCreateMemoryBuffer(cbAudioBuffer, &pAudioBuffer);
-        if (SUCCEEDED(hr)) { hr = pAudioBuffer->Lock(&pData, NULL, NULL); }
-        memcpy(pData, tmpAudioBuffer, cbAudioBuffer);
-        if (pAudioBuffer)
-        {
-            pAudioBuffer->Unlock();
-        }
-
-        if (SUCCEEDED(hr)) { hr = MFCreateSample(&pAudioSample); }
-        if (SUCCEEDED(hr)) { hr = pAudioSample->SetSampleTime(sampleTime); }
-        if (SUCCEEDED(hr)) { hr = pAudioSample->SetSampleDuration(duration); }
-        if (SUCCEEDED(hr)) { hr = pAudioBuffer->SetCurrentLength(cbAudioBuffer); }
-        if (SUCCEEDED(hr)) { hr = pAudioSample->AddBuffer(pAudioBuffer); }
-
-        if (SUCCEEDED(hr)) { hr = sinkWriter->WriteSample(audioStreamIndex, pAudioSample); }
-
-        SafeRelease(pAudioSample);
-        SafeRelease(pAudioBuffer);
-
-        if (FAILED(hr))
+        const short* block = audioRing.ReadBlock();
+        BYTE* data = NULL;
+        if (block == nullptr || FAILED(frame->mediaBuffer->Lock(&data, NULL, NULL)))
         {
-            OutputDebugString(L"Error writing audio frame.\n");
+            ReleaseFrameBuffer(frame);
+            return;
         }
+        memcpy(data, block, frame->length);
+        frame->mediaBuffer->Unlock();
 
-        delete[] tmpAudioBuffer;
-    });
+        // Times come from the number of samples written, so they never accumulate rounding error.
+        frame->sampleTime = audioRing.GetBlockTime(numAudioBlocksRecorded);
+        frame->duration = audioRing.GetBlockTime(numAudioBlocksRecorded + 1) - frame->sampleTime;
+        frame->recordingIndex = recordingIndex;
+        numAudioBlocksRecorded++;
 
-    numAudioFramesRecorded++;
-#endif
+        WriteSample(frame);
+    }
 }
 
-void VideoEncoder::WriteVideo(byte* buffer, LONGLONG duration)
+void VideoEncoder::WriteFrame(FrameBuffer* frame)
 {
     std::shared_lock<std::shared_mutex> lock(videoStateLock);
 
-    if (!isRecording)
+    if (replayEncoder != nullptr)
     {
-        return;
+        // Copied for the replay encoder's own thread before the frame is handed to the sink writer, which may return it to the pool.
+        replayEncoder->QueueFrame(frame->mediaBuffer, frame->duration);
     }
 
-    LONGLONG sampleTime = numFramesRecorded * duration;
+    if (sinkWriter == NULL || !isRecording || frame->recordingIndex != recordingIndex)
+    {
+        // Queued before the recording it belonged to was stopped.
+        ReleaseFrameBuffer(frame);
+        return;
+    }
 
-    // Copy frame to a temporary buffer and process on a background thread.
-    BYTE* tmpVideoBuffer = new BYTE[(int)(1.5f * frameHeight * frameWidth)];
-    memcpy(tmpVideoBuffer, buffer, (int)(1.5f * frameHeight * frameWidth));
+    // Scaled before the frame is handed to the sink writer, which may return it to the pool.
+    WriteRenditions(frame);
+    WriteSample(frame);
+}
 
-    concurrency::create_task([=]()
+void VideoEncoder::WriteRenditions(FrameBuffer* frame)
+{
+    BYTE* data = NULL;
+    if (renditions.empty() || FAILED(frame->mediaBuffer->Lock(&data, NULL, NULL)))
     {
-        std::shared_lock<std::shared_mutex> lock(videoStateLock);
+        return;
+    }
 
-        HRESULT hr = E_PENDING;
-        if (sinkWriter == NULL || !isRecording)
+    const BYTE* uv = data + (size_t)frameWidth * frameHeight;
+    for (RenditionEncoder& rendition : renditions)
+    {
+        VideoEncoder* encoder = rendition.encoder;
+        FrameBuffer* scaled = encoder->GetVideoFrameBuffer();
+        if (scaled == nullptr)
         {
-            OutputDebugString(L"Must start recording before writing video frames.\n");
-            delete[] tmpVideoBuffer;
-            return;
+            // The rendition's encoder has fallen behind, it counts the dropped frame.
+            continue;
         }
 
-        LONG cbWidth = frameWidth;
-        DWORD cbBuffer = (int)(1.5f * frameWidth * frameHeight);
-        DWORD imageHeight = (int)(1.5f * frameHeight);
+        // Every rendition is scaled from the full size frame, each one split across cores.
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+        ColorConversion::ResizeNV12(data, frameWidth, uv, frameWidth, frameWidth, frameHeight,
+            scaled->data, encoder->frameWidth, scaled->data + (size_t)encoder->frameWidth * encoder->frameHeight, encoder->frameWidth,
+            encoder->frameWidth, encoder->frameHeight);
+        QueryPerformanceCounter(&end);
+        rendition.resampleTime += end.QuadPart - start.QuadPart;
+        rendition.numFramesScaled++;
+
+        encoder->QueueRenditionFrame(scaled, *frame);
+    }
 
-        IMFSample* pVideoSample = NULL;
-        IMFMediaBuffer* pVideoBuffer = NULL;
-        BYTE* pData = NULL;
+    frame->mediaBuffer->Unlock();
+}
 
-        // Create a new memory buffer.
-        hr = MFCreateMemoryBuffer(cbBuffer, &pVideoBuffer);
+void VideoEncoder::StopRenditions()
+{
+    for (RenditionEncoder& rendition : renditions)
+    {
+        VideoEncoder* encoder = rendition.encoder;
+        OutputDebugString((L"Rendition " + std::to_wstring(encoder->frameWidth) + L"x" + std::to_wstring(encoder->frameHeight) + L": ").c_str());
+        encoder->StopRecording();
+
+        RenditionStats stats;
+        stats.width = encoder->frameWidth;
+        stats.height = encoder->frameHeight;
+        stats.videoFramesEncoded = encoder->numVideoFramesEncoded;
+        stats.videoFramesDropped = encoder->numVideoFramesDropped;
+        stats.resampleMS = (double)rendition.resampleTime * 1000.0 / freq.QuadPart / (std::max)(rendition.numFramesScaled, 1);
+        stats.encoderCPUMS = (double)(encoder->GetEncoderCPUTime() - encoder->encoderCPUTimeAtStart) / MS2HNS / (std::max)(stats.videoFramesEncoded, 1);
+        stats.endOffsetHNS = encoder->writtenVideoEndTime - writtenVideoEndTime;
+        renditionStats.push_back(stats);
+
+        OutputDebugString((L"Rendition scaling per frame: " + std::to_wstring(stats.resampleMS) + L" ms, ends " +
+            std::to_wstring(stats.endOffsetHNS / MS2HNS) + L" ms after the recording.\n").c_str());
+
+        delete encoder;
+    }
 
-        // Lock the buffer and copy the video frame to the buffer.
-        if (SUCCEEDED(hr)) { hr = pVideoBuffer->Lock(&pData, NULL, NULL); }
+    renditions.clear();
+}
 
-        if (SUCCEEDED(hr))
-        {
-            //TODO: Can pVideoBuffer be created from an ID3D11Texture2D*?
-            hr = MFCopyImage(
-                pData,                      // Destination buffer.
-                cbWidth,                    // Destination stride.
-                tmpVideoBuffer,
-                cbWidth,                    // Source stride.
-                cbWidth,                    // Image width in bytes.
-                imageHeight                 // Image height in pixels.
-            );
-        }
+void VideoEncoder::WriteSample(FrameBuffer* frame)
+{
+    // The sample calls sampleFreeCallback once the sink writer releases it, which returns it to the pool.
+    IMFSample* sample = frame->sample;
+    HRESULT hr = frame->trackedSample->SetAllocator(&sampleFreeCallback, NULL);
+    if (FAILED(hr))
+    {
+        OutputDebugString(L"Error tracking pooled frame.\n");
+        ReleaseFrameBuffer(frame);
+        return;
+    }
 
-        if (pVideoBuffer)
+    hr = sample->SetSampleTime(frame->sampleTime); //100-nanosecond units
+    if (SUCCEEDED(hr)) { hr = sample->SetSampleDuration(frame->duration); } //100-nanosecond units
+    if (SUCCEEDED(hr)) { hr = sinkWriter->WriteSample(frame->isAudio ? audioStreamIndex : videoStreamIndex, sample); }
+
+    if (SUCCEEDED(hr))
+    {
+        if (frame->isAudio)
         {
-            pVideoBuffer->Unlock();
+            numAudioFramesEncoded++;
         }
-
-        // Set the data length of the buffer.
-        if (SUCCEEDED(hr)) { hr = pVideoBuffer->SetCurrentLength(cbBuffer); }
-
-        // Create a media sample and add the buffer to the sample.
-        if (SUCCEEDED(hr)) { hr = MFCreateSample(&pVideoSample); }
-        if (SUCCEEDED(hr)) { hr = pVideoSample->AddBuffer(pVideoBuffer); }
-
-        if (SUCCEEDED(hr)) { hr = pVideoSample->SetSampleTime(sampleTime); } //100-nanosecond units
-        if (SUCCEEDED(hr)) { hr = pVideoSample->SetSampleDuration(duration); } //100-nanosecond units
-
-        // Send the sample to the Sink Writer.
-        if (SUCCEEDED(hr)) { hr = sinkWriter->WriteSample(videoStreamIndex, pVideoSample); }
-
-        SafeRelease(pVideoSample);
-        SafeRelease(pVideoBuffer);
-        delete[] tmpVideoBuffer;
-
-        if (FAILED(hr))
+        else
         {
-            OutputDebugString(L"Error writing video frame.\n");
+            numVideoFramesEncoded++;
+            writtenVideoEndTime = frame->sampleTime + frame->duration;
         }
-    });
+    }
+    else
+    {
+        OutputDebugString(frame->isAudio ? L"Error writing audio frame.\n" : L"Error writing video frame.\n");
+    }
 
-    numFramesRecorded++;
+    // Give up our reference, the sample comes back through sampleFreeCallback.
+    sample->Release();
 }
 
 void VideoEncoder::StopRecording()
 {
     std::unique_lock<std::shared_mutex> lock(videoStateLock);
 
-    numFramesRecorded = 0;
-    numAudioFramesRecorded = 0;
-
     if (sinkWriter == NULL || !isRecording)
     {
         OutputDebugString(L"Must start recording before it can be stopped.\n");
@@ -339,107 +603,194 @@ void VideoEncoder::StopRecording()
     }
 
     // Clear any async frames.
-    acceptQueuedFrames = false;
+    // The encoder thread is the only consumer of the queues. It returns anything still queued to the pool once it sees recording has stopped.
+    acceptQueuedFrames = replayEncoder != nullptr;
+    numVideoFramesDropped += videoQueue.Size();
+    numAudioFramesDropped += GetAudioQueueDepth();
 
-    std::mutex completion_mutex;
+    if (videoStreamIndex != NULL)
+    {
+        sinkWriter->Flush(videoStreamIndex);
+    }
+    if (audioStreamIndex != NULL)
+    {
+        sinkWriter->Flush(audioStreamIndex);
+    }
 
-    bool doneCleaningVideoTasks = false;
-    bool doneCleaningAudioTasks = false;
+    sinkWriter->Finalize();
+    SafeRelease(sinkWriter);
 
-    std::unique_lock<std::mutex> completion_lock(completion_mutex);
-    std::condition_variable completion_lock_check;
+    isRecording = false;
 
-    concurrency::create_task([&]
+    ULONGLONG encoderCPUTime = GetEncoderCPUTime() - encoderCPUTimeAtStart;
+    OutputDebugString(L"Recording stopped.  Video frames encoded: ");
+    OutputDebugString(std::to_wstring(numVideoFramesEncoded).c_str());
+    OutputDebugString(L", dropped: ");
+    OutputDebugString(std::to_wstring(numVideoFramesDropped).c_str());
+    OutputDebugString(L".  Audio frames encoded: ");
+    OutputDebugString(std::to_wstring(numAudioFramesEncoded).c_str());
+    OutputDebugString(L", dropped: ");
+    OutputDebugString(std::to_wstring(numAudioFramesDropped).c_str());
+    OutputDebugString(L".  Encoder thread CPU per video frame: ");
+    OutputDebugString(std::to_wstring(numVideoFramesEncoded > 0 ? (double)encoderCPUTime / MS2HNS / numVideoFramesEncoded : 0.0).c_str());
+    OutputDebugString(L" ms\n");
+
+    if (isRecordingAudio)
     {
-        while (!videoQueue.empty())
-        {
-            videoQueue.pop();
-        }
+        // Audio that did not fit the timeline, and how far the end of the audio is from the end of the video.
+        auto toMS = [this](LONGLONG frames) { return std::to_wstring((frames * 1000) / (LONGLONG)audioSampleRate); };
+        LONGLONG audioEndTime = audioRing.GetBlockTime(numAudioBlocksRecorded);
+        OutputDebugString((L"Audio silence inserted: " + toMS(audioRing.GetSilenceFrames()) +
+            L" ms, trimmed: " + toMS(audioRing.GetTrimmedFrames()) +
+            L" ms, overflowed: " + toMS(audioRing.GetOverflowFrames()) +
+            L" ms, max drift: " + toMS(audioRing.GetMaxDriftFrames()) +
+            L" ms.  Audio ends " + std::to_wstring((audioEndTime - videoQueue.GetEndTime()) / MS2HNS) + L" ms after video.\n").c_str());
+    }
+    isRecordingAudio = false;
+    videoQueue.Reset();
 
-        {
-            std::lock_guard<std::mutex> lk(completion_mutex);
-            doneCleaningVideoTasks = true;
-        }
-        completion_lock_check.notify_one();
-    });
+    StopRenditions();
+}
 
-    concurrency::create_task([&]
+bool VideoEncoder::StartReplay(size_t memoryBudget, LONGLONG durationHNS)
+{
+    std::unique_lock<std::shared_mutex> lock(videoStateLock);
+
+    if (replayEncoder != nullptr)
     {
-        while (!audioQueue.empty())
-        {
-            audioQueue.pop();
-        }
+        return true;
+    }
 
-        {
-            std::lock_guard<std::mutex> lk(completion_mutex);
-            doneCleaningAudioTasks = true;
-        }
-        completion_lock_check.notify_one();
-    });
+    replayEncoder = new ReplayEncoder(frameWidth, frameHeight, fps, memoryBudget, durationHNS);
+    if (!replayEncoder->Initialize())
+    {
+        delete replayEncoder;
+        replayEncoder = nullptr;
+        return false;
+    }
 
-    completion_lock_check.wait(completion_lock, [&] {return doneCleaningVideoTasks && doneCleaningAudioTasks; });
+    acceptQueuedFrames = true;
+    return true;
+}
 
-    if (videoStreamIndex != NULL)
+void VideoEncoder::StopReplay()
+{
+    std::unique_lock<std::shared_mutex> lock(videoStateLock);
+
+    if (replayEncoder != nullptr && replayEncoder->GetNumFramesDropped() > 0)
     {
-        sinkWriter->Flush(videoStreamIndex);
+        OutputDebugString((L"Instant replay frames dropped: " + std::to_wstring(replayEncoder->GetNumFramesDropped()) + L"\n").c_str());
     }
-    if (audioStreamIndex != NULL)
+
+    // Waits for a replay that is still being saved.
+    delete replayEncoder;
+    replayEncoder = nullptr;
+    acceptQueuedFrames = isRecording;
+}
+
+bool VideoEncoder::IsReplayEnabled()
+{
+    std::shared_lock<std::shared_mutex> lock(videoStateLock);
+    return replayEncoder != nullptr;
+}
+
+bool VideoEncoder::SaveReplay(const std::wstring& path)
+{
+    std::shared_lock<std::shared_mutex> lock(videoStateLock);
+    return replayEncoder != nullptr && replayEncoder->Save(path);
+}
+
+VideoEncoder::FrameBuffer* VideoEncoder::GetVideoFrameBuffer()
+{
+    std::shared_lock<std::shared_mutex> lock(videoStateLock);
+    if (!acceptQueuedFrames)
     {
-        sinkWriter->Flush(audioStreamIndex);
+        return nullptr;
     }
 
-    sinkWriter->Finalize();
-    SafeRelease(sinkWriter);
+    FrameBuffer* frame = GetFreeFrameBuffer(false);
+    if (frame == nullptr)
+    {
+        // Every video buffer is queued or still held by the sink writer, so drop the new frame.
+        numVideoFramesDropped++;
+        return nullptr;
+    }
 
-    isRecording = false;
+    if (FAILED(frame->mediaBuffer->Lock(&frame->data, NULL, NULL)))
+    {
+        ReleaseFrameBuffer(frame);
+        return nullptr;
+    }
+
+    return frame;
 }
 
-void VideoEncoder::QueueVideoFrame(byte* buffer, LONGLONG timestamp, LONGLONG duration)
+void VideoEncoder::QueueVideoFrame(FrameBuffer* frame, LONGLONG timestamp, LONGLONG duration)
 {
+    if (frame == nullptr)
+    {
+        return;
+    }
+
+    frame->mediaBuffer->Unlock();
+    frame->data = nullptr;
+
     std::shared_lock<std::shared_mutex> lock(videoStateLock);
 
-    if (acceptQueuedFrames)
+    if (!acceptQueuedFrames)
     {
-        videoQueue.push(VideoInput(buffer, duration));
+        ReleaseFrameBuffer(frame);
+        return;
     }
+
+    // Frames queued only for instant replay do not belong to any recording.
+    frame->recordingIndex = isRecording ? recordingIndex.load() : 0;
+
+    // Cannot fail, the queue can hold every video buffer.
+    videoQueue.Push(frame, duration);
+    SetEvent(framesQueuedEvent);
 }
 
-void VideoEncoder::QueueAudioFrame(byte* buffer)
+void VideoEncoder::QueueRenditionFrame(FrameBuffer* frame, const FrameBuffer& source)
 {
+    frame->mediaBuffer->Unlock();
+    frame->data = nullptr;
+
     std::shared_lock<std::shared_mutex> lock(videoStateLock);
 
-    if (acceptQueuedFrames)
+    if (!acceptQueuedFrames)
     {
-        audioQueue.push(AudioInput(buffer));
+        ReleaseFrameBuffer(frame);
+        return;
     }
+
+    frame->recordingIndex = isRecording ? recordingIndex.load() : 0;
+    videoQueue.Push(frame, source);
+    SetEvent(framesQueuedEvent);
 }
 
-void VideoEncoder::Update()
+void VideoEncoder::QueueAudioFrame(byte* buffer, LONGLONG timestamp)
 {
+#if ENCODE_AUDIO
     std::shared_lock<std::shared_mutex> lock(videoStateLock);
-    if (!isRecording)
+
+    if (!acceptQueuedFrames || !isRecordingAudio)
     {
         return;
     }
 
-    while (!videoQueue.empty())
+    // Never waits on the encoder, if it has fallen too far behind the ring replaces this audio with silence.
+    LONGLONG time = ((timestamp - recordingStartTime.QuadPart) * S2HNS) / freq.QuadPart;
+    if (!audioRing.Write((const short*)buffer, audioBufferSize / audioRing.GetFrameSize(), time))
     {
-        if (isRecording)
-        {
-            VideoInput input = videoQueue.front();
-            WriteVideo(input.sharedBuffer, input.duration);
-            videoQueue.pop();
-        }
+        numAudioFramesDropped++;
     }
 
-    while (!audioQueue.empty())
+    SetEvent(framesQueuedEvent);
+
+    for (RenditionEncoder& rendition : renditions)
     {
-        if (isRecording)
-        {
-            AudioInput input = audioQueue.front();
-            WriteAudio(input.buffer);
-            delete[] input.buffer;
-            audioQueue.pop();
-        }
+        rendition.encoder->QueueAudioFrame(buffer, timestamp);
     }
+#endif
 }
@@ -14,8 +14,16 @@
 #include <shared_mutex>
 
 #include "DirectXHelper.h"
+#include "VideoFrameQueue.h"
+#include "AudioRing.h"
+#include "ReplayEncoder.h"
+#include "ColorConversion.h"
 
-#include <queue>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 #pragma comment(lib, "mf")
 #pragma comment(lib, "mfreadwrite")
@@ -24,67 +32,213 @@
 
 #define INVALID_TIMESTAMP -1
 
+// 62,5 MBit/s
+#define VIDEO_BITRATE (62 * 1000 * 1000 + 500 * 1000)
+
+// Number of pooled frame buffers.  A frame holds its buffer from the time it is queued until the sink writer releases it.
+#define NUM_VIDEO_BUFFERS 10
+#define NUM_AUDIO_BUFFERS 16
+
+// Input queue capacity, this must be a power of 2 that can hold every pooled video buffer.
+#define VIDEO_QUEUE_CAPACITY 16
+
+// Overflow policy:
+// Video: once the encoder is this many frames behind, the oldest queued frames are dropped so recording stays close to live.
+// If every video buffer is still in use, the new frame is dropped.
+#define VIDEO_QUEUE_DROP_DEPTH (NUM_VIDEO_BUFFERS / 2)
+// Audio: engine audio goes into a ring of AUDIO_RING_FRAMES and never blocks the audio thread.
+// If the encoder falls far enough behind to fill the ring, the audio that does not fit is replaced with silence.
+
 class VideoEncoder
 {
 public:
     VideoEncoder(UINT frameWidth, UINT frameHeight, UINT frameStride, UINT fps,
-        UINT32 audioBufferSize, UINT32 audioSampleRate, UINT32 audioChannels, UINT32 audioBPS);
+        UINT32 audioBufferSize, UINT32 audioSampleRate, UINT32 audioChannels, UINT32 audioBPS, UINT32 bitRate = VIDEO_BITRATE);
     ~VideoEncoder();
 
     bool Initialize(ID3D11Device* device);
 
-    void StartRecording(LPCWSTR videoPath, bool encodeAudio = false);
+    // A smaller copy of every recording, written alongside it from the same frames.
+    // Width and height must be even and no larger than the recording's.
+    struct Rendition
+    {
+        UINT width;
+        UINT height;
+        UINT32 bitRate;
+        std::wstring path;
+    };
+
+    // Each rendition gets its own encoder thread and sink writer.  Frames are scaled on this encoder's thread,
+    // and given the same sample times as the full size frames so every rendition stays frame aligned with the recording.
+    void StartRecording(LPCWSTR videoPath, bool encodeAudio = false, const std::vector<Rendition>& renditions = std::vector<Rendition>());
     bool IsRecording();
     void StopRecording();
 
-    // Used for recording video from a background thread.
-    void QueueVideoFrame(byte* buffer, LONGLONG timestamp, LONGLONG duration);
-    void QueueAudioFrame(byte* buffer);
-
-    // Do not call this from a background thread.
-    void Update();
-
-private:
-    void WriteVideo(byte* buffer, LONGLONG duration);
-    void WriteAudio(byte* buffer);
+    class RenditionStats
+    {
+    public:
+        UINT width;
+        UINT height;
+        int videoFramesEncoded;
+        int videoFramesDropped;
+        // Average time to scale a frame, and encoder thread CPU time per frame encoded.
+        double resampleMS;
+        double encoderCPUMS;
+        // End of the rendition's last frame minus the end of the recording's last frame, 0 if it ends on the same frame.
+        LONGLONG endOffsetHNS;
+    };
 
-    LARGE_INTEGER freq;
+    // Renditions of the last recording, available once it has stopped.
+    const std::vector<RenditionStats>& GetRenditionStats() { return renditionStats; }
 
-    LONGLONG numFramesRecorded = 0;
-    LONGLONG numAudioFramesRecorded = 0;
+    // Instant replay: while enabled, every video frame is also encoded into an in-memory replay of the last few seconds,
+    // whether or not a recording is in progress.
+    bool StartReplay(size_t memoryBudget, LONGLONG durationHNS);
+    void StopReplay();
+    bool IsReplayEnabled();
+    // Write the replay to an MP4 on a background thread.  Returns false if replay is disabled or a replay is already being saved.
+    bool SaveReplay(const std::wstring& path);
 
-    class VideoInput
+    // A pooled media buffer that a frame is written into and encoded from without being copied again.
+    class FrameBuffer
     {
     public:
-        byte* sharedBuffer;
-        LONGLONG duration;
-
-        VideoInput(byte* buffer, LONGLONG duration)
-        {
-            this->sharedBuffer = buffer;
-            this->duration = duration;
-        }
+        // Valid from GetVideoFrameBuffer until the frame is queued.
+        byte* data = nullptr;
+
+    private:
+        friend class VideoEncoder;
+        template<class, int, int> friend class VideoFrameQueue;
+
+        IMFSample* sample = nullptr;
+        // Same object as sample, not separately referenced.
+        IMFTrackedSample* trackedSample = nullptr;
+        IMFMediaBuffer* mediaBuffer = nullptr;
+        DWORD length = 0;
+        bool isAudio = false;
+
+        LONGLONG sampleTime = 0;
+        LONGLONG duration = 0;
+
+        // Recording this frame was queued for, so late frames are not written into the next recording.
+        int recordingIndex = 0;
     };
 
-    class AudioInput
+    // Get a buffer to write the next video frame into.
+    // Returns nullptr if the encoder has fallen behind, in which case the frame should be dropped.
+    // Every buffer returned must be passed back to QueueVideoFrame.
+    FrameBuffer* GetVideoFrameBuffer();
+
+    // Used for recording video from a background thread.
+    void QueueVideoFrame(FrameBuffer* frame, LONGLONG timestamp, LONGLONG duration);
+    // timestamp is the performance counter value when the audio arrived, it is used to keep audio in sync with video.
+    void QueueAudioFrame(byte* buffer, LONGLONG timestamp);
+
+    // Number of frames waiting to be encoded.
+    int GetVideoQueueDepth() { return videoQueue.Size(); }
+    int GetAudioQueueDepth() { return audioRing.GetBufferedFrames() / audioRing.GetBlockFrames(); }
+
+    // Number of frames dropped during the current (or last) recording.
+    int GetNumVideoFramesDropped() { return numVideoFramesDropped; }
+    int GetNumAudioFramesDropped() { return numAudioFramesDropped; }
+
+private:
+    // Returns pooled samples once the sink writer has released them.
+    class SampleFreeCallback : public IMFAsyncCallback
     {
     public:
-        byte* buffer = new byte[AUDIO_BUFSIZE];
+        SampleFreeCallback(VideoEncoder* encoder) : encoder(encoder) {}
+
+        STDMETHODIMP QueryInterface(REFIID riid, void** ppv);
+        // Lifetime is owned by the VideoEncoder.
+        STDMETHODIMP_(ULONG) AddRef() { return 1; }
+        STDMETHODIMP_(ULONG) Release() { return 1; }
 
-        AudioInput(byte* buffer)
-        {
-            memcpy(this->buffer, buffer, AUDIO_BUFSIZE);
-        }
+        STDMETHODIMP GetParameters(DWORD*, DWORD*) { return E_NOTIMPL; }
+        STDMETHODIMP Invoke(IMFAsyncResult* result);
+
+    private:
+        VideoEncoder* encoder;
     };
 
+    bool AllocateFrameBuffers();
+    void FreeFrameBuffers();
+    FrameBuffer* GetFreeFrameBuffer(bool isAudio);
+    void ReleaseFrameBuffer(IMFSample* sample);
+    void ReleaseFrameBuffer(FrameBuffer* frame);
+
+    void EncodeFrames();
+    void EncodeAudio();
+    void WriteFrame(FrameBuffer* frame);
+    // videoStateLock must be held.
+    void WriteSample(FrameBuffer* frame);
+    void WriteRenditions(FrameBuffer* frame);
+    void StopRenditions();
+
+    // Queue a frame scaled from source by the encoder this is a rendition of, with source's sample time.
+    void QueueRenditionFrame(FrameBuffer* frame, const FrameBuffer& source);
+
+    LARGE_INTEGER freq;
+    LARGE_INTEGER recordingStartTime;
+
+    // End of the last video frame written to the sink writer.
+    LONGLONG writtenVideoEndTime = 0;
+    // Only used by the encoder thread.
+    LONGLONG numAudioBlocksRecorded = 0;
+
+    // Pooled frame buffers.
+    // Buffers are returned from sink writer threads, so the free lists are locked.
+    std::vector<FrameBuffer*> frameBuffers;
+    std::vector<FrameBuffer*> freeVideoBuffers;
+    std::vector<FrameBuffer*> freeAudioBuffers;
+    std::mutex frameBufferLock;
+    SampleFreeCallback sampleFreeCallback;
+
+    // Video frames come from the render thread and audio from the audio thread.
+    // The encoder thread is the only consumer of both, it cuts audio into blocks of audioBufferSize as buffers become free.
+    VideoFrameQueue<FrameBuffer, VIDEO_QUEUE_CAPACITY, VIDEO_QUEUE_DROP_DEPTH> videoQueue;
+    AudioRing audioRing;
+    static_assert(VIDEO_QUEUE_CAPACITY >= NUM_VIDEO_BUFFERS, "Video queue must be able to hold every video buffer.");
+    HANDLE framesQueuedEvent = NULL;
+
+    std::thread encoderThread;
+    std::atomic<bool> stopEncoding{ false };
+
+    // Incremented every time recording starts.
+    std::atomic<int> recordingIndex{ 0 };
+
+    // Statistics for the current recording.
+    std::atomic<int> numVideoFramesEncoded{ 0 };
+    std::atomic<int> numAudioFramesEncoded{ 0 };
+    std::atomic<int> numVideoFramesDropped{ 0 };
+    std::atomic<int> numAudioFramesDropped{ 0 };
+    ULONGLONG encoderCPUTimeAtStart = 0;
+    ULONGLONG GetEncoderCPUTime();
+
     IMFSinkWriter* sinkWriter;
     DWORD videoStreamIndex;
     DWORD audioStreamIndex;
 
-    byte* nullAudioBuffer = new byte[AUDIO_BUFSIZE];
-
     bool isRecording = false;
-    bool acceptQueuedFrames = false;
+    bool isRecordingAudio = false;
+    // Only changed while videoStateLock is held exclusively.
+    ReplayEncoder* replayEncoder = nullptr;
+
+    class RenditionEncoder
+    {
+    public:
+        VideoEncoder* encoder;
+        // Performance counter ticks spent scaling frames for this rendition.
+        LONGLONG resampleTime;
+        int numFramesScaled;
+    };
+
+    // Only changed while videoStateLock is held exclusively.
+    std::vector<RenditionEncoder> renditions;
+    std::vector<RenditionStats> renditionStats;
+    // Not referenced, only used to initialize renditions.
+    ID3D11Device* device = nullptr;
+    std::atomic<bool> acceptQueuedFrames{ false };
 
     // Video Parameters.
     UINT frameWidth;
@@ -101,9 +255,6 @@ private:
     UINT32 audioChannels;
     UINT32 audioBPS;
 
-    std::queue<VideoInput> videoQueue;
-    std::queue<AudioInput> audioQueue;
-
     std::shared_mutex videoStateLock;
 
     IMFDXGIDeviceManager* deviceManager = NULL;
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include <Windows.h>
+#include "SPSCQueue.h"
+
+// Video frames waiting for an encoder thread, stamped with the sample times they are written with.
+// A recording's frames are timed by the number of frames queued, never by when they arrive.  Frames scaled for a rendition
+// take the times of the frame they were scaled from, so a rendition stays frame aligned with its recording whichever
+// frames either of them drops.
+// Frame can be any type with sampleTime and duration members (eg: VideoEncoder::FrameBuffer).
+template<class Frame, int Capacity, int DropDepth>
+class VideoFrameQueue
+{
+    static_assert(DropDepth > 0 && DropDepth < Capacity, "VideoFrameQueue must drop frames before it is full.");
+
+public:
+    // Producer only.  Queues the next frame of a recording.
+    bool Push(Frame* frame, LONGLONG duration)
+    {
+        if (!PushAt(frame, numFramesQueued * duration, duration))
+        {
+            return false;
+        }
+
+        numFramesQueued++;
+        return true;
+    }
+
+    // Producer only.  Queues a frame scaled from source, with source's sample time.
+    bool Push(Frame* frame, const Frame& source)
+    {
+        return PushAt(frame, source.sampleTime, source.duration);
+    }
+
+    // Consumer only.  Pops the next frame to encode.
+    // While the consumer is more than DropDepth frames behind, the oldest frames are passed to drop instead, so encoding stays close to live.
+    template<class Drop>
+    bool Pop(Frame*& frame, Drop drop)
+    {
+        while (queue.Size() > DropDepth && queue.TryPop(frame))
+        {
+            drop(frame);
+        }
+
+        return queue.TryPop(frame);
+    }
+
+    // Producer only.  Times the next frame pushed from zero, frames that are still queued keep their times.
+    void Reset()
+    {
+        numFramesQueued = 0;
+        endTime = 0;
+    }
+
+    int Size()
+    {
+        return queue.Size();
+    }
+
+    // Producer only.  End of the last frame queued since Reset.
+    LONGLONG GetEndTime()
+    {
+        return endTime;
+    }
+
+private:
+    bool PushAt(Frame* frame, LONGLONG sampleTime, LONGLONG duration)
+    {
+        // Stamped before it is pushed, once it is queued the frame belongs to the consumer.
+        frame->sampleTime = sampleTime;
+        frame->duration = duration;
+        if (!queue.TryPush(frame))
+        {
+            return false;
+        }
+
+        endTime = sampleTime + duration;
+        return true;
+    }
+
+    SPSCQueue<Frame*, Capacity> queue;
+
+    // Only used by the producer.
+    LONGLONG numFramesQueued = 0;
+    LONGLONG endTime = 0;
+};
@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Replaces the global operator new for the whole test executable, so benchmarks can report how often the code they time allocates.
+
+#include "CompositorTests.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+namespace
+{
+    std::atomic<long long> allocationCount{ 0 };
+}
+
+long long GetAllocationCount()
+{
+    return allocationCount.load();
+}
+
+void* operator new(size_t size)
+{
+    allocationCount++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    allocationCount++;
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,239 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Checks that AudioRing keeps recorded audio in sync with the video: stalls become silence, audio that runs ahead is trimmed,
+// and an hour of simulated bursty, stalling engine audio from a drifting clock never drifts past the splice threshold.
+
+#include "CompositorTests.h"
+#include "CompositorConstants.h"
+#include "AudioRing.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    const UINT32 packetFrames = AUDIO_BUFSIZE / (AUDIO_CHANNELS * sizeof(short));
+    const UINT32 thresholdFrames = (AUDIO_SAMPLE_RATE * AUDIO_SPLICE_THRESHOLD_MS) / 1000;
+
+    LONGLONG FramesToHNS(LONGLONG frames)
+    {
+        return (frames * S2HNS) / AUDIO_SAMPLE_RATE;
+    }
+
+    // Every frame of a packet holds its frame number on the device, so silence (0) and dropped audio are easy to tell apart.
+    void FillPacket(std::vector<short>& packet, LONGLONG firstFrame)
+    {
+        for (UINT32 i = 0; i < packetFrames; i++)
+        {
+            short value = (short)(1 + (firstFrame + i) % 30000);
+            for (UINT32 c = 0; c < AUDIO_CHANNELS; c++)
+            {
+                packet[i * AUDIO_CHANNELS + c] = value;
+            }
+        }
+    }
+
+    // Counts silent frames in every complete block.
+    LONGLONG ReadSilentFrames(AudioRing& ring, LONGLONG& framesRead)
+    {
+        LONGLONG silentFrames = 0;
+        const short* block = nullptr;
+        while ((block = ring.ReadBlock()) != nullptr)
+        {
+            for (UINT32 i = 0; i < ring.GetBlockFrames(); i++)
+            {
+                silentFrames += block[i * AUDIO_CHANNELS] == 0 ? 1 : 0;
+            }
+            framesRead += ring.GetBlockFrames();
+        }
+        return silentFrames;
+    }
+
+    bool StallsBecomeSilence()
+    {
+        bool passed = true;
+
+        AudioRing ring(AUDIO_CHANNELS, AUDIO_SAMPLE_RATE, AUDIO_RING_FRAMES, packetFrames, thresholdFrames);
+        std::vector<short> packet(packetFrames * AUDIO_CHANNELS);
+
+        // Two packets on time, then nothing for a second.
+        FillPacket(packet, 0);
+        CHECK(ring.Write(packet.data(), packetFrames, FramesToHNS(packetFrames)));
+        FillPacket(packet, packetFrames);
+        CHECK(ring.Write(packet.data(), packetFrames, FramesToHNS(2 * packetFrames)));
+
+        const LONGLONG stallFrames = AUDIO_SAMPLE_RATE;
+        FillPacket(packet, 2 * packetFrames);
+        CHECK(ring.Write(packet.data(), packetFrames, FramesToHNS(3 * packetFrames + stallFrames)));
+
+        CHECK(ring.GetSilenceFrames() == stallFrames);
+        CHECK(ring.GetTrimmedFrames() == 0);
+        CHECK(ring.GetTimelineFrames() == 3 * packetFrames + stallFrames);
+
+        LONGLONG framesRead = 0;
+        LONGLONG silentFrames = ReadSilentFrames(ring, framesRead);
+        CHECK(framesRead == 3 * packetFrames + stallFrames - (3 * packetFrames + stallFrames) % packetFrames);
+        CHECK(silentFrames == stallFrames);
+
+        // Anything within the splice threshold is left alone.
+        ring.Reset();
+        FillPacket(packet, 0);
+        CHECK(ring.Write(packet.data(), packetFrames, FramesToHNS(packetFrames + thresholdFrames)));
+        CHECK(ring.GetSilenceFrames() == 0);
+
+        return passed;
+    }
+
+    bool RunningAheadIsTrimmed()
+    {
+        bool passed = true;
+
+        AudioRing ring(AUDIO_CHANNELS, AUDIO_SAMPLE_RATE, AUDIO_RING_FRAMES, packetFrames, thresholdFrames);
+        std::vector<short> packet(packetFrames * AUDIO_CHANNELS);
+
+        // Packets keep arriving at the same time, so the timeline runs ahead of the clock.
+        LONGLONG time = FramesToHNS(packetFrames);
+        for (int i = 0; i < 8; i++)
+        {
+            FillPacket(packet, i * packetFrames);
+            CHECK(ring.Write(packet.data(), packetFrames, time));
+
+            LONGLONG framesRead = 0;
+            ReadSilentFrames(ring, framesRead);
+        }
+
+        CHECK(ring.GetTrimmedFrames() > 0);
+        CHECK(ring.GetSilenceFrames() == 0);
+        CHECK(ring.GetMaxDriftFrames() <= thresholdFrames);
+        CHECK(ring.GetTimelineFrames() <= packetFrames + thresholdFrames + packetFrames);
+
+        return passed;
+    }
+
+    bool OverflowKeepsTimelineMoving()
+    {
+        bool passed = true;
+
+        AudioRing ring(AUDIO_CHANNELS, AUDIO_SAMPLE_RATE, AUDIO_RING_FRAMES, packetFrames, thresholdFrames);
+        std::vector<short> packet(packetFrames * AUDIO_CHANNELS);
+
+        // The consumer does not read, so the ring fills up.
+        const int numPackets = 2 * AUDIO_RING_FRAMES / packetFrames;
+        int numFull = 0;
+        for (int i = 0; i < numPackets; i++)
+        {
+            FillPacket(packet, i * packetFrames);
+            numFull += ring.Write(packet.data(), packetFrames, FramesToHNS((i + 1) * packetFrames)) ? 0 : 1;
+        }
+
+        CHECK(numFull > 0);
+        CHECK(ring.GetBufferedFrames() == AUDIO_RING_FRAMES);
+        CHECK(ring.GetOverflowFrames() == (LONGLONG)numPackets * packetFrames - AUDIO_RING_FRAMES);
+        CHECK(ring.GetTimelineFrames() == (LONGLONG)numPackets * packetFrames);
+
+        // Once the consumer catches up, the lost audio plays back as silence and the timeline is intact.
+        LONGLONG framesRead = 0;
+        LONGLONG silentFrames = ReadSilentFrames(ring, framesRead);
+        CHECK(framesRead == ring.GetTimelineFrames());
+        CHECK(silentFrames == ring.GetOverflowFrames());
+
+        return passed;
+    }
+
+    // Feeds an hour of simulated engine audio through a ring, reading it back like the encoder thread.
+    bool SessionStaysInSync()
+    {
+        bool passed = true;
+        const double sessionSeconds = 60.0 * 60.0;
+
+        AudioRing ring(AUDIO_CHANNELS, AUDIO_SAMPLE_RATE, AUDIO_RING_FRAMES, packetFrames, thresholdFrames);
+        std::vector<short> packet(packetFrames * AUDIO_CHANNELS);
+
+        // Fixed seed so every run simulates the same session.
+        std::mt19937 random(1);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        double packetSeconds = (double)packetFrames / AUDIO_SAMPLE_RATE;
+        LONGLONG deviceFrames = 0;
+        double stalledSeconds = 0;
+        double burstEnd = 0;
+        double lastArrival = 0;
+        double consumerPausedUntil = 0;
+
+        LONGLONG numPackets = 0, framesRead = 0, silentFramesRead = 0;
+        Stopwatch stopwatch;
+
+        double arrival = 0;
+        while (arrival < sessionSeconds)
+        {
+            // The audio device clock runs fast for the first half of the session and slow for the second.
+            double clockRate = arrival < sessionSeconds / 2 ? 1.0 + 500e-6 : 1.0 - 500e-6;
+
+            // Every few minutes the listener is disabled (or the engine hitches) and no audio is produced for a while.
+            if (uniform(random) < 1.0 / 15000)
+            {
+                stalledSeconds += 0.5 + 2.5 * uniform(random);
+            }
+
+            FillPacket(packet, deviceFrames);
+            deviceFrames += packetFrames;
+
+            // Packets normally arrive with a few ms of jitter, but sometimes several arrive at once.
+            double played = deviceFrames / (AUDIO_SAMPLE_RATE * clockRate) + stalledSeconds;
+            if (played > burstEnd && uniform(random) < 1.0 / 500)
+            {
+                burstEnd = played + 2 * packetSeconds;
+            }
+            arrival = std::max(std::max(played, burstEnd) + 0.004 * uniform(random), lastArrival);
+            lastArrival = arrival;
+
+            // Rarely, the encoder thread stops reading for longer than the ring can hold.
+            if (arrival > consumerPausedUntil && uniform(random) < 1.0 / 50000)
+            {
+                consumerPausedUntil = arrival + 0.5;
+            }
+
+            ring.Write(packet.data(), packetFrames, (LONGLONG)(arrival * S2HNS));
+            if (arrival > consumerPausedUntil)
+            {
+                silentFramesRead += ReadSilentFrames(ring, framesRead);
+            }
+
+            numPackets++;
+        }
+        double elapsedMS = stopwatch.ElapsedMS();
+
+        // Everything on the timeline has been read, apart from the last partial block.
+        // Every frame read is either audio that was written or silence that was accounted for.
+        LONGLONG audioFramesWritten = deviceFrames - ring.GetTrimmedFrames() - ring.GetOverflowFrames();
+        LONGLONG silenceWritten = ring.GetSilenceFrames() + ring.GetOverflowFrames();
+        LONGLONG unread = ring.GetTimelineFrames() - framesRead;
+        CHECK(ring.GetMaxDriftFrames() <= thresholdFrames);
+        CHECK(unread >= 0 && unread < packetFrames);
+        CHECK(silentFramesRead <= silenceWritten && silentFramesRead + unread >= silenceWritten);
+        CHECK(framesRead - silentFramesRead <= audioFramesWritten && framesRead - silentFramesRead + unread >= audioFramesWritten);
+
+        // The simulation has to hit every case for the checks above to mean anything.
+        CHECK(ring.GetSilenceFrames() > 0);
+        CHECK(ring.GetTrimmedFrames() > 0);
+        CHECK(ring.GetOverflowFrames() > 0);
+
+        auto toMS = [](LONGLONG frames) { return (frames * 1000) / AUDIO_SAMPLE_RATE; };
+        printf("    %.0f s, %lld packets, max drift: %lld ms, silence inserted: %lld ms, trimmed: %lld ms, overflowed: %lld ms, %.2f us per packet\n",
+            sessionSeconds, (long long)numPackets, (long long)toMS(ring.GetMaxDriftFrames()), (long long)toMS(ring.GetSilenceFrames()),
+            (long long)toMS(ring.GetTrimmedFrames()), (long long)toMS(ring.GetOverflowFrames()), elapsedMS * 1000.0 / numPackets);
+
+        return passed;
+    }
+}
+
+bool AudioRingTests()
+{
+    bool passed = true;
+    CHECK(StallsBecomeSilence());
+    CHECK(RunningAheadIsTrimmed());
+    CHECK(OverflowKeepsTimelineMoving());
+    CHECK(SessionStaysInSync());
+    return passed;
+}
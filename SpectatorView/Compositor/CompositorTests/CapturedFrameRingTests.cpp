@@ -0,0 +1,285 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Runs CapturedFrameRing against a mock capture driver with a fixed pool of reference counted frames, like DeckLink's,
+// with a capture thread pushing frames while a render thread acquires them the way DeckLinkDevice::Update does.
+
+#include "CompositorTests.h"
+#include "CapturedFrameRing.h"
+
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace
+{
+    const int numSlots = 20;
+    const int numRetained = 8;
+    const int frameLength = 4096;
+
+    class MockCaptureDriver;
+
+    // Stands in for IDeckLinkVideoInputFrame: the driver gets the frame back when the last reference is released.
+    class MockCaptureFrame
+    {
+    public:
+        ULONG AddRef()
+        {
+            return ++refCount;
+        }
+
+        ULONG Release();
+
+        // Every byte of a frame is derived from its capture index, so a recycled frame shows up as the wrong bytes.
+        void Fill(int frameIndex)
+        {
+            index = frameIndex;
+            memset(bytes, (byte)(frameIndex * 31 + 7), frameLength);
+        }
+
+        bool Holds(int frameIndex) const
+        {
+            if (index != frameIndex)
+            {
+                return false;
+            }
+
+            for (byte value : bytes)
+            {
+                if (value != (byte)(frameIndex * 31 + 7))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::atomic<ULONG> refCount{ 0 };
+        MockCaptureDriver* driver = nullptr;
+        int index = -1;
+        byte bytes[frameLength];
+    };
+
+    class MockCaptureDriver
+    {
+    public:
+        MockCaptureDriver(int poolSize) : frames(poolSize)
+        {
+            for (MockCaptureFrame& frame : frames)
+            {
+                frame.driver = this;
+                freeFrames.push_back(&frame);
+            }
+        }
+
+        // Fills a free frame and returns it with the driver's reference, or returns nullptr if every frame is held.
+        MockCaptureFrame* Capture(int frameIndex)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (freeFrames.empty())
+            {
+                numStarved++;
+                return nullptr;
+            }
+
+            MockCaptureFrame* frame = freeFrames.back();
+            freeFrames.pop_back();
+
+            numRecycledWhileHeld += frame->refCount != 0 ? 1 : 0;
+            frame->Fill(frameIndex);
+            frame->AddRef();
+            return frame;
+        }
+
+        void Return(MockCaptureFrame* frame)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            freeFrames.push_back(frame);
+        }
+
+        int NumFree()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return (int)freeFrames.size();
+        }
+
+        int numStarved = 0;
+        int numRecycledWhileHeld = 0;
+
+    private:
+        std::vector<MockCaptureFrame> frames;
+        std::vector<MockCaptureFrame*> freeFrames;
+        std::mutex lock;
+    };
+
+    ULONG MockCaptureFrame::Release()
+    {
+        ULONG count = --refCount;
+        if (count == 0)
+        {
+            driver->Return(this);
+        }
+        return count;
+    }
+
+    typedef CapturedFrameRing<MockCaptureFrame, numSlots, numRetained> Ring;
+
+    // The capture callback: the driver's reference only lasts for the callback, the ring keeps its own.
+    bool CaptureInto(MockCaptureDriver& driver, Ring& ring, int frameIndex)
+    {
+        MockCaptureFrame* frame = driver.Capture(frameIndex);
+        if (frame == nullptr)
+        {
+            return false;
+        }
+
+        ring.Push(frame, frame->bytes, frameLength, (LONGLONG)frameIndex * 166666);
+        frame->Release();
+        return true;
+    }
+
+    bool RetainsNewestFrames()
+    {
+        bool passed = true;
+
+        // Retained frames, plus the one being captured.
+        MockCaptureDriver driver(numRetained + 1);
+        Ring ring;
+
+        const int numFrames = 3 * numSlots + 5;
+        for (int i = 1; i <= numFrames; i++)
+        {
+            CHECK(CaptureInto(driver, ring, i));
+        }
+        CHECK(ring.GetCaptureFrameIndex() == numFrames);
+        CHECK(driver.numStarved == 0);
+        CHECK(driver.NumFree() == 1);
+
+        for (int i = numFrames - numSlots - 2; i <= numFrames + 2; i++)
+        {
+            MockCaptureFrame* frame = nullptr;
+            const BYTE* bytes = nullptr;
+            int length = 0;
+            bool acquired = ring.Acquire(i, frame, bytes, length);
+
+            bool retained = i > numFrames - numRetained && i <= numFrames;
+            CHECK(acquired == retained);
+            if (acquired)
+            {
+                CHECK(frame->Holds(i));
+                CHECK(bytes == frame->bytes);
+                CHECK(length == frameLength);
+                CHECK(ring.GetTimestamp(i) == (LONGLONG)i * 166666);
+                frame->Release();
+            }
+        }
+
+        // Every frame goes back to the driver.
+        ring.Clear();
+        CHECK(driver.NumFree() == numRetained + 1);
+
+        MockCaptureFrame* frame = nullptr;
+        const BYTE* bytes = nullptr;
+        int length = 0;
+        CHECK(!ring.Acquire(numFrames, frame, bytes, length));
+
+        ring.Reset();
+        CHECK(ring.GetCaptureFrameIndex() == 0);
+        CHECK(CaptureInto(driver, ring, 1));
+        CHECK(ring.Acquire(1, frame, bytes, length));
+        CHECK(frame->Holds(1));
+        frame->Release();
+        CHECK(!ring.Acquire(1 + numSlots, frame, bytes, length));
+
+        return passed;
+    }
+
+    // A capture thread pushes frames as fast as it can while the render thread acquires frames a random number of frames behind,
+    // holds them for a moment, and checks that they were not recycled while it held them.
+    bool CaptureAndRenderThreads()
+    {
+        bool passed = true;
+
+        // Retained frames, the one being captured, and the one the render thread holds.
+        MockCaptureDriver driver(numRetained + 2);
+        Ring ring;
+
+        const int numAttempts = 100000;
+        std::atomic<bool> rendering{ true };
+        int numFrames = 0;
+        std::thread captureThread([&]
+        {
+            while (rendering)
+            {
+                while (!CaptureInto(driver, ring, numFrames + 1))
+                {
+                    std::this_thread::yield();
+                }
+                numFrames++;
+                std::this_thread::yield();
+            }
+        });
+
+        std::mt19937 random(3);
+        std::uniform_int_distribution<int> lag(0, numSlots + 4);
+        int numAcquired = 0;
+        int numExpired = 0;
+        int numWrongFrame = 0;
+        int numChangedWhileHeld = 0;
+        int numAcquiredOutsideWindow = 0;
+        for (int attempt = 0; attempt < numAttempts; attempt++)
+        {
+            std::this_thread::yield();
+            int newest = ring.GetCaptureFrameIndex();
+            int frameLag = lag(random);
+            int index = newest - frameLag;
+            if (index <= 0)
+            {
+                continue;
+            }
+
+            MockCaptureFrame* frame = nullptr;
+            const BYTE* bytes = nullptr;
+            int length = 0;
+            if (!ring.Acquire(index, frame, bytes, length))
+            {
+                numExpired++;
+                continue;
+            }
+
+            numAcquired++;
+            // The capture index only grows, so a frame that was already outside the retained window can never be acquired.
+            numAcquiredOutsideWindow += frameLag >= numRetained ? 1 : 0;
+            numWrongFrame += frame->Holds(index) ? 0 : 1;
+
+            std::this_thread::yield();
+            numChangedWhileHeld += frame->Holds(index) ? 0 : 1;
+            frame->Release();
+        }
+
+        rendering = false;
+        captureThread.join();
+        ring.Clear();
+
+        CHECK(numAcquired > 0);
+        CHECK(numExpired > 0);
+        CHECK(numWrongFrame == 0);
+        CHECK(numChangedWhileHeld == 0);
+        CHECK(numAcquiredOutsideWindow == 0);
+        CHECK(driver.numRecycledWhileHeld == 0);
+        // The ring never holds more than numRetained frames, so the driver always has one free.
+        CHECK(driver.numStarved == 0);
+        CHECK(driver.NumFree() == numRetained + 2);
+
+        printf("    %i frames captured, %i acquired, %i expired before they were acquired\n", numFrames, numAcquired, numExpired);
+        return passed;
+    }
+}
+
+bool CapturedFrameRingTests()
+{
+    bool passed = true;
+    CHECK(RetainsNewestFrames());
+    CHECK(CaptureAndRenderThreads());
+    return passed;
+}
@@ -0,0 +1,140 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Reports the throughput of each color conversion kernel this CPU supports at 1080p and 4K, single threaded so the numbers
+// compare kernels rather than core counts, and of the default (fastest kernel, rows split across cores).
+//   CompositorTests benchmark colorconversion
+// The ColorConversion test checks that the kernels match the scalar reference.
+
+#include "CompositorTests.h"
+#include "ColorConversion.h"
+
+namespace
+{
+    typedef ColorConversion::Implementation Implementation;
+
+    struct Configuration
+    {
+        const char* name;
+        Implementation implementation;
+        bool parallel;
+    };
+
+    const Configuration configurations[] =
+    {
+        { "Scalar", Implementation::Scalar, false },
+        { "SSE4", Implementation::SSE4, false },
+        { "AVX2", Implementation::AVX2, false },
+        { "Auto, parallel", Implementation::Auto, true },
+    };
+
+    std::vector<byte> RandomBytes(size_t size)
+    {
+        std::vector<byte> bytes(size);
+        unsigned int seed = 1;
+        for (byte& value : bytes)
+        {
+            seed = seed * 1103515245 + 12345;
+            value = (byte)(seed >> 16);
+        }
+        return bytes;
+    }
+
+    double MegapixelsPerSecond(int width, int height, double ms)
+    {
+        return ms > 0 ? (double)width * height / 1000.0 / ms : 0;
+    }
+
+    void BenchmarkConversions(int width, int height)
+    {
+        std::vector<byte> frame = RandomBytes((size_t)width * height * 4);
+        std::vector<byte> nv12 = RandomBytes((size_t)width * height * 3 / 2);
+        std::vector<byte> out((size_t)width * height * 4);
+        size_t planeSize = (size_t)width * height;
+
+        printf("\n%ix%i, MP/s\n", width, height);
+        printf("%-16s %12s %12s %12s %12s\n", "kernel", "RGBA->NV12", "NV12->RGBA", "UYVY->RGBA", "BGR->BGRA");
+
+        for (const Configuration& configuration : configurations)
+        {
+            if (!ColorConversion::IsSupported(configuration.implementation))
+            {
+                continue;
+            }
+
+            ColorConversion::Options options;
+            options.implementation = configuration.implementation;
+            options.parallel = configuration.parallel;
+
+            double toNV12 = FastestMS([&]
+            {
+                ColorConversion::RGBAToNV12(frame.data(), width * 4, out.data(), width, out.data() + planeSize, width, width, height, options);
+            }, 300);
+            double fromNV12 = FastestMS([&]
+            {
+                ColorConversion::NV12ToRGBA(nv12.data(), width, nv12.data() + planeSize, width, out.data(), width * 4, width, height, options);
+            }, 300);
+            double fromUYVY = FastestMS([&]
+            {
+                ColorConversion::UYVYToRGBA(frame.data(), width * 2, out.data(), width * 4, width, height, options);
+            }, 300);
+            double fromBGR = FastestMS([&]
+            {
+                ColorConversion::BGRToBGRA(frame.data(), width * 3, out.data(), width * 4, width, height, options);
+            }, 300);
+
+            printf("%-16s %12.0f %12.0f %12.0f %12.0f\n", configuration.name,
+                MegapixelsPerSecond(width, height, toNV12), MegapixelsPerSecond(width, height, fromNV12),
+                MegapixelsPerSecond(width, height, fromUYVY), MegapixelsPerSecond(width, height, fromBGR));
+        }
+    }
+
+    void BenchmarkResize(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+    {
+        std::vector<byte> src = RandomBytes((size_t)srcWidth * srcHeight * 3 / 2);
+        std::vector<byte> dst((size_t)dstWidth * dstHeight * 3 / 2);
+        size_t srcPlaneSize = (size_t)srcWidth * srcHeight;
+        size_t dstPlaneSize = (size_t)dstWidth * dstHeight;
+
+        printf("%4ix%-4i to %4ix%-4i", srcWidth, srcHeight, dstWidth, dstHeight);
+        for (const Configuration& configuration : configurations)
+        {
+            if (!ColorConversion::IsSupported(configuration.implementation))
+            {
+                printf(" %16s", "-");
+                continue;
+            }
+
+            ColorConversion::Options options;
+            options.implementation = configuration.implementation;
+            options.parallel = configuration.parallel;
+
+            double ms = FastestMS([&]
+            {
+                ColorConversion::ResizeNV12(src.data(), srcWidth, src.data() + srcPlaneSize, srcWidth, srcWidth, srcHeight,
+                    dst.data(), dstWidth, dst.data() + dstPlaneSize, dstWidth, dstWidth, dstHeight, options);
+            }, 300);
+            printf(" %16.2f", ms);
+        }
+        printf("\n");
+    }
+}
+
+bool ColorConversionBenchmark(const std::vector<std::wstring>& args)
+{
+    BenchmarkConversions(1920, 1080);
+    BenchmarkConversions(3840, 2160);
+
+    printf("\nNV12 resize, ms per frame\n%-22s", "");
+    for (const Configuration& configuration : configurations)
+    {
+        printf(" %16s", configuration.name);
+    }
+    printf("\n");
+
+    BenchmarkResize(1920, 1080, 1280, 720);
+    BenchmarkResize(1920, 1080, 960, 540);
+    BenchmarkResize(3840, 2160, 1920, 1080);
+
+    return true;
+}
@@ -0,0 +1,235 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Checks that every SIMD color conversion and resize kernel this CPU supports is bit-exact with the scalar reference,
+// for every color space, range and channel order, and that splitting rows across cores does not change the output.
+
+#include "CompositorTests.h"
+#include "ColorConversion.h"
+
+namespace
+{
+    typedef ColorConversion::Implementation Implementation;
+
+    const Implementation simdImplementations[] = { Implementation::SSE4, Implementation::AVX2 };
+
+    const char* GetName(Implementation implementation)
+    {
+        switch (implementation)
+        {
+        case Implementation::SSE4:
+            return "SSE4";
+        case Implementation::AVX2:
+            return "AVX2";
+        default:
+            return "Scalar";
+        }
+    }
+
+    // A deterministic pseudo random frame covers every byte value in every channel.
+    std::vector<byte> RandomBytes(size_t size)
+    {
+        std::vector<byte> bytes(size);
+        unsigned int seed = 1;
+        for (byte& value : bytes)
+        {
+            seed = seed * 1103515245 + 12345;
+            value = (byte)(seed >> 16);
+        }
+        return bytes;
+    }
+
+    // Output of one implementation for every conversion.
+    struct Outputs
+    {
+        std::vector<byte> nv12;
+        std::vector<byte> fromNV12;
+        std::vector<byte> fromUYVY;
+        std::vector<byte> fromBGR;
+
+        Outputs(int width, int height) :
+            nv12((size_t)width * height * 3 / 2),
+            fromNV12((size_t)width * height * 4),
+            fromUYVY((size_t)width * height * 4),
+            fromBGR((size_t)width * height * 4)
+        {
+        }
+
+        bool operator==(const Outputs& other) const
+        {
+            return nv12 == other.nv12 && fromNV12 == other.fromNV12 && fromUYVY == other.fromUYVY && fromBGR == other.fromBGR;
+        }
+    };
+
+    // NV12 to RGBA starts from nv12Input, so every implementation sees the same input.
+    bool ConvertAll(const std::vector<byte>& frame, const std::vector<byte>& nv12Input, int width, int height, bool bgra,
+        const ColorConversion::Options& options, Outputs& outputs)
+    {
+        size_t planeSize = (size_t)width * height;
+        bool converted = bgra
+            ? ColorConversion::BGRAToNV12(frame.data(), width * 4, outputs.nv12.data(), width, outputs.nv12.data() + planeSize, width, width, height, options)
+            : ColorConversion::RGBAToNV12(frame.data(), width * 4, outputs.nv12.data(), width, outputs.nv12.data() + planeSize, width, width, height, options);
+
+        converted &= bgra
+            ? ColorConversion::NV12ToBGRA(nv12Input.data(), width, nv12Input.data() + planeSize, width, outputs.fromNV12.data(), width * 4, width, height, options)
+            : ColorConversion::NV12ToRGBA(nv12Input.data(), width, nv12Input.data() + planeSize, width, outputs.fromNV12.data(), width * 4, width, height, options);
+
+        // The first half of the random frame doubles as a UYVY frame, and the first three quarters as a BGR frame.
+        converted &= bgra
+            ? ColorConversion::UYVYToBGRA(frame.data(), width * 2, outputs.fromUYVY.data(), width * 4, width, height, options)
+            : ColorConversion::UYVYToRGBA(frame.data(), width * 2, outputs.fromUYVY.data(), width * 4, width, height, options);
+
+        converted &= ColorConversion::BGRToBGRA(frame.data(), width * 3, outputs.fromBGR.data(), width * 4, width, height, options);
+        return converted;
+    }
+
+    bool MatchesScalar(int width, int height)
+    {
+        bool passed = true;
+
+        std::vector<byte> frame = RandomBytes((size_t)width * height * 4);
+        std::vector<byte> nv12Input = RandomBytes((size_t)width * height * 3 / 2);
+        Outputs expected(width, height), actual(width, height);
+
+        for (ColorConversion::ColorSpace colorSpace : { ColorConversion::ColorSpace::BT601, ColorConversion::ColorSpace::BT709 })
+        {
+            for (ColorConversion::ColorRange range : { ColorConversion::ColorRange::Limited, ColorConversion::ColorRange::Full })
+            {
+                for (bool bgra : { false, true })
+                {
+                    ColorConversion::Options options;
+                    options.colorSpace = colorSpace;
+                    options.range = range;
+                    options.implementation = Implementation::Scalar;
+                    options.parallel = false;
+                    CHECK(ConvertAll(frame, nv12Input, width, height, bgra, options, expected));
+
+                    // Splitting rows into tasks has to give the same frame.
+                    options.implementation = Implementation::Auto;
+                    options.parallel = true;
+                    CHECK(ConvertAll(frame, nv12Input, width, height, bgra, options, actual));
+                    CHECK(actual == expected);
+
+                    for (Implementation implementation : simdImplementations)
+                    {
+                        if (!ColorConversion::IsSupported(implementation))
+                        {
+                            continue;
+                        }
+
+                        options.implementation = implementation;
+                        options.parallel = false;
+                        CHECK(ConvertAll(frame, nv12Input, width, height, bgra, options, actual));
+                        if (!(actual == expected))
+                        {
+                            printf("    %s does not match the scalar reference at %ix%i, %s %s range %s\n", GetName(implementation), width, height,
+                                colorSpace == ColorConversion::ColorSpace::BT601 ? "BT.601" : "BT.709",
+                                range == ColorConversion::ColorRange::Limited ? "limited" : "full", bgra ? "BGRA" : "RGBA");
+                            passed = false;
+                        }
+                    }
+                }
+            }
+        }
+
+        return passed;
+    }
+
+    bool ResizeMatchesScalar(int srcWidth, int srcHeight, int dstWidth, int dstHeight)
+    {
+        bool passed = true;
+
+        std::vector<byte> src = RandomBytes((size_t)srcWidth * srcHeight * 3 / 2);
+        size_t srcPlaneSize = (size_t)srcWidth * srcHeight;
+        size_t dstPlaneSize = (size_t)dstWidth * dstHeight;
+        std::vector<byte> expected(dstPlaneSize * 3 / 2), actual(expected.size());
+
+        auto resize = [&](Implementation implementation, bool parallel, std::vector<byte>& dst)
+        {
+            ColorConversion::Options options;
+            options.implementation = implementation;
+            options.parallel = parallel;
+            return ColorConversion::ResizeNV12(src.data(), srcWidth, src.data() + srcPlaneSize, srcWidth, srcWidth, srcHeight,
+                dst.data(), dstWidth, dst.data() + dstPlaneSize, dstWidth, dstWidth, dstHeight, options);
+        };
+
+        CHECK(resize(Implementation::Scalar, false, expected));
+
+        if (srcWidth == dstWidth * 2 && srcHeight == dstHeight * 2)
+        {
+            // Halving is a rounded 2x2 average.
+            int numWrong = 0;
+            for (int y = 0; y < dstHeight; y++)
+            {
+                for (int x = 0; x < dstWidth; x++)
+                {
+                    const byte* block = &src[(size_t)y * 2 * srcWidth + x * 2];
+                    int sum = block[0] + block[1] + block[srcWidth] + block[srcWidth + 1];
+                    numWrong += expected[(size_t)y * dstWidth + x] == (sum + 2) / 4 ? 0 : 1;
+                }
+            }
+            CHECK(numWrong == 0);
+        }
+
+        CHECK(resize(Implementation::Auto, true, actual));
+        CHECK(actual == expected);
+
+        for (Implementation implementation : simdImplementations)
+        {
+            if (!ColorConversion::IsSupported(implementation))
+            {
+                continue;
+            }
+
+            CHECK(resize(implementation, false, actual));
+            if (actual != expected)
+            {
+                printf("    %s resize from %ix%i to %ix%i does not match the scalar reference\n", GetName(implementation), srcWidth, srcHeight, dstWidth, dstHeight);
+                passed = false;
+            }
+        }
+
+        return passed;
+    }
+
+    bool RejectsInvalidSizes()
+    {
+        bool passed = true;
+
+        std::vector<byte> frame = RandomBytes(64 * 64 * 4);
+        std::vector<byte> out(64 * 64 * 4);
+
+        // NV12 and UYVY share chroma between pixel pairs, BGR does not.
+        CHECK(!ColorConversion::RGBAToNV12(frame.data(), 63 * 4, out.data(), 63, out.data() + 63 * 64, 63, 63, 64));
+        CHECK(!ColorConversion::RGBAToNV12(frame.data(), 64 * 4, out.data(), 64, out.data() + 64 * 63, 64, 64, 63));
+        CHECK(!ColorConversion::UYVYToRGBA(frame.data(), 63 * 2, out.data(), 63 * 4, 63, 64));
+        CHECK(ColorConversion::BGRToBGRA(frame.data(), 63 * 3, out.data(), 63 * 4, 63, 63));
+
+        // Resizing only downscales.
+        CHECK(!ColorConversion::ResizeNV12(frame.data(), 32, frame.data() + 32 * 32, 32, 32, 32, out.data(), 64, out.data() + 64 * 64, 64, 64, 64));
+
+        return passed;
+    }
+}
+
+bool ColorConversionTests()
+{
+    bool passed = true;
+    printf("    SIMD kernels supported: SSE4 %s, AVX2 %s\n",
+        ColorConversion::IsSupported(Implementation::SSE4) ? "yes" : "no", ColorConversion::IsSupported(Implementation::AVX2) ? "yes" : "no");
+
+    CHECK(MatchesScalar(1920, 1080));
+    // Odd sized rows exercise every SIMD tail, and a single row pair every task boundary.
+    CHECK(MatchesScalar(1922, 6));
+    CHECK(MatchesScalar(2, 2));
+    CHECK(MatchesScalar(34, 66));
+
+    // The sizes recordings are scaled to, and a ratio that is not a simple fraction.
+    CHECK(ResizeMatchesScalar(1920, 1080, 1280, 720));
+    CHECK(ResizeMatchesScalar(1920, 1080, 960, 540));
+    CHECK(ResizeMatchesScalar(1922, 1080, 1006, 302));
+    CHECK(ResizeMatchesScalar(64, 64, 64, 64));
+
+    CHECK(RejectsInvalidSizes());
+    return passed;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+
+// Like CompositorDLL's stdafx.h, so std::min and std::max are not the Windows macros in any test.
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Logs a failed check and fails the test it is in.  Each test starts with bool passed = true, and returns passed.
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("    %s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            passed = false; \
+        } \
+    } while (false)
+
+class Stopwatch
+{
+public:
+    Stopwatch()
+    {
+        QueryPerformanceFrequency(&frequency);
+        Restart();
+    }
+
+    void Restart()
+    {
+        QueryPerformanceCounter(&start);
+    }
+
+    double ElapsedMS() const
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        return (double)(now.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+    }
+
+private:
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start;
+};
+
+// Runs pass until minimumMS has elapsed, and returns the fastest pass in ms.
+template<typename Pass>
+double FastestMS(Pass pass, double minimumMS = 1000)
+{
+    double fastest = 1e30;
+    Stopwatch total;
+    do
+    {
+        Stopwatch stopwatch;
+        pass();
+        double elapsed = stopwatch.ElapsedMS();
+        fastest = elapsed < fastest ? elapsed : fastest;
+    } while (total.ElapsedMS() < minimumMS);
+
+    return fastest;
+}
+
+inline double MBPerSecond(double bytes, double ms)
+{
+    return ms > 0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0;
+}
+
+// Number of times operator new has been called in this process, see AllocationCounter.cpp.
+long long GetAllocationCount();
+
+// Tests return false if any of their checks failed.
+bool SpatialMappingEncoderTests();
+bool PoseDatagramTests();
+bool SPSCQueueTests();
+bool ColorConversionTests();
+bool CapturedFrameRingTests();
+bool AudioRingTests();
+bool ReplayBufferTests();
+bool VideoFrameQueueTests();
+
+// Benchmarks print their results, args are the command line arguments after the benchmark's name.
+// They return false if they could not run (eg: a corpus file could not be read).
+bool SpatialMappingBenchmark(const std::vector<std::wstring>& args);
+bool SpatialMappingSerializeBenchmark(const std::vector<std::wstring>& args);
+bool PoseReplayBenchmark(const std::vector<std::wstring>& args);
+bool ColorConversionBenchmark(const std::vector<std::wstring>& args);
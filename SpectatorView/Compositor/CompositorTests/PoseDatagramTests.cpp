@@ -0,0 +1,264 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Sends pose datagrams over loopback through a shim that drops and reorders them, and checks what PoseDatagramReceiver delivers.
+
+// CompositorTests.h defines WIN32_LEAN_AND_MEAN, so its Windows.h does not pull in the original winsock.h before Winsock 2.
+#include "CompositorTests.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "PoseDatagramReceiver.h"
+
+#include <random>
+#include <thread>
+
+namespace
+{
+    // Away from DEFAULT_POSE_PORT, so the test can run next to a compositor.
+    const int testPort = DEFAULT_POSE_PORT + 100;
+
+    // Builds datagrams the way SpectatorViewSocket::SendPoseDatagram does.
+    // The pose with sequence number s has posX == s, so the receiver's output can be checked against what was sent.
+    class PoseDatagramSender
+    {
+    public:
+        PoseDatagramSender()
+        {
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            freq = frequency.QuadPart;
+
+            datagram.sequence = 0;
+            datagram.numPoses = 0;
+            datagram.numNewPoses = 0;
+        }
+
+        const PoseDatagram& Next(int numNewPoses)
+        {
+            int numRepeated = datagram.numPoses;
+            if (numRepeated > POSE_DATAGRAM_REDUNDANCY - numNewPoses)
+            {
+                numRepeated = POSE_DATAGRAM_REDUNDANCY - numNewPoses;
+            }
+
+            memmove(&datagram.poses[numNewPoses], &datagram.poses[0], numRepeated * sizeof(SVPose));
+
+            LARGE_INTEGER qpc;
+            QueryPerformanceCounter(&qpc);
+            for (int i = 0; i < numNewPoses; i++)
+            {
+                SVPose pose;
+                pose.sentTime = (qpc.QuadPart * S2HNS) / freq;
+                pose.posX = (float)(datagram.sequence + numNewPoses - i);
+                datagram.poses[i] = pose;
+            }
+
+            datagram.sequence += numNewPoses;
+            datagram.numPoses = numRepeated + numNewPoses;
+            datagram.numNewPoses = numNewPoses;
+            return datagram;
+        }
+
+    private:
+        LONGLONG freq;
+        PoseDatagram datagram;
+    };
+
+    bool RejectsDuplicateAndStaleDatagrams()
+    {
+        bool passed = true;
+
+        PoseDatagramSender sender;
+        PoseDatagram first = sender.Next(POSE_SAMPLES_PER_SEND);
+        PoseDatagram second = sender.Next(POSE_SAMPLES_PER_SEND);
+        PoseDatagram third = sender.Next(POSE_SAMPLES_PER_SEND);
+
+        PoseDatagramReceiver receiver;
+        SVPose poses[POSE_DATAGRAM_REDUNDANCY];
+
+        CHECK(receiver.Process(first, poses) == POSE_SAMPLES_PER_SEND);
+        CHECK(receiver.Process(first, poses) == 0);
+
+        // second was lost, third carries its poses too.  They come out oldest first.
+        CHECK(receiver.Process(third, poses) == 2 * POSE_SAMPLES_PER_SEND);
+        CHECK(poses[0].posX == (float)(first.sequence + 1));
+        CHECK(poses[2 * POSE_SAMPLES_PER_SEND - 1].posX == (float)third.sequence);
+
+        // second arriving late has nothing new.
+        CHECK(receiver.Process(second, poses) == 0);
+
+        // A datagram from before the sequence window is dropped and counted as late.
+        PoseDatagram newer;
+        for (int i = 0; i * POSE_SAMPLES_PER_SEND <= 2 * POSE_SEQUENCE_WINDOW; i++)
+        {
+            newer = sender.Next(POSE_SAMPLES_PER_SEND);
+        }
+        CHECK(receiver.Process(newer, poses) == POSE_DATAGRAM_REDUNDANCY);
+        CHECK(receiver.Process(third, poses) == 0);
+        CHECK(receiver.GetStatistics().numLatePoses == POSE_DATAGRAM_REDUNDANCY);
+        CHECK(receiver.GetStatistics().numDuplicateDatagrams == 3);
+
+        return passed;
+    }
+
+    bool LossyLoopback()
+    {
+        bool passed = true;
+
+        const int numDatagrams = 2000;
+        const int lossPercent = 10;
+        const int reorderPercent = 10;
+
+        WSASession session;
+        UDPSocket receiveSocket;
+        UDPSocket sendSocket;
+
+        sockaddr_storage loopback = {};
+        sockaddr_in* address = (sockaddr_in*)&loopback;
+        address->sin_family = AF_INET;
+        address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (!receiveSocket.Bind(testPort) || !sendSocket.SetDestination(loopback, sizeof(sockaddr_in), testPort))
+        {
+            printf("    Could not open loopback sockets on port %i.\n", testPort);
+            return false;
+        }
+
+        // Number of times each sequence number was delivered.
+        std::vector<int> deliveries((numDatagrams + 1) * POSE_SAMPLES_PER_SEND + 1, 0);
+        bool posesMatch = true;
+        unsigned int newestDelivered = 0;
+        // Datagrams that arrived after a newer one, they may only fill holes behind the newest pose.
+        int numStaleDatagrams = 0;
+
+        PoseDatagramReceiver receiver;
+        std::thread receiveThread([&]
+        {
+            byte bytes[DATAGRAM_BUFLEN];
+            PoseDatagram datagram;
+            SVPose poses[POSE_DATAGRAM_REDUNDANCY];
+            while (true)
+            {
+                // Anything that is not a pose datagram ends the test.
+                int length = receiveSocket.ReceiveData(bytes, DATAGRAM_BUFLEN);
+                if (length != sizeof(PoseDatagram))
+                {
+                    break;
+                }
+
+                memcpy(&datagram, bytes, sizeof(PoseDatagram));
+                numStaleDatagrams += datagram.sequence < newestDelivered ? 1 : 0;
+
+                int numPoses = receiver.Process(datagram, poses);
+                for (int i = 0; i < numPoses; i++)
+                {
+                    unsigned int sequence = (unsigned int)poses[i].posX;
+                    if (sequence >= deliveries.size())
+                    {
+                        posesMatch = false;
+                        continue;
+                    }
+                    deliveries[sequence]++;
+
+                    if (sequence > newestDelivered)
+                    {
+                        newestDelivered = sequence;
+                    }
+                }
+            }
+        });
+
+        // The shim: drop some datagrams, and deliver others after the one that follows them.
+        std::vector<bool> shouldArrive((numDatagrams + 1) * POSE_SAMPLES_PER_SEND + 1, false);
+        auto send = [&](const PoseDatagram& datagram)
+        {
+            for (int i = 0; i < datagram.numPoses; i++)
+            {
+                shouldArrive[datagram.sequence - i] = true;
+            }
+            sendSocket.SendData((const byte*)&datagram, sizeof(PoseDatagram));
+        };
+
+        std::mt19937 random(7);
+        std::uniform_int_distribution<int> percent(0, 99);
+        PoseDatagramSender sender;
+        PoseDatagram held;
+        bool holding = false;
+        unsigned int lastSequence = 0;
+        for (int i = 0; i < numDatagrams; i++)
+        {
+            const PoseDatagram& datagram = sender.Next(POSE_SAMPLES_PER_SEND);
+            lastSequence = datagram.sequence;
+
+            // The receiver treats everything before the first pose it sees as delivered, and the newest pose has to be known,
+            // so the first and last datagrams always go through.
+            int roll = (i == 0 || i == numDatagrams - 1) ? 100 : percent(random);
+            if (roll < lossPercent)
+            {
+                continue;
+            }
+
+            if (roll < lossPercent + reorderPercent && !holding)
+            {
+                held = datagram;
+                holding = true;
+                continue;
+            }
+
+            send(datagram);
+            if (holding)
+            {
+                send(held);
+                holding = false;
+            }
+
+            // Give the receiver a chance to keep up, like poses sent once a frame.
+            if (i % 8 == 0)
+            {
+                Sleep(1);
+            }
+        }
+
+        // Loopback can still drop the stop datagram if the receive buffer is full, so send a few.
+        for (int i = 0; i < 3; i++)
+        {
+            int stop = 0;
+            sendSocket.SendData((const byte*)&stop, sizeof(stop));
+        }
+        receiveThread.join();
+
+        int numDuplicates = 0;
+        int numMissing = 0;
+        int numUnexpected = 0;
+        for (size_t sequence = 1; sequence < deliveries.size(); sequence++)
+        {
+            numDuplicates += deliveries[sequence] > 1 ? 1 : 0;
+            numMissing += (shouldArrive[sequence] && deliveries[sequence] == 0) ? 1 : 0;
+            numUnexpected += (!shouldArrive[sequence] && deliveries[sequence] > 0) ? 1 : 0;
+        }
+
+        CHECK(posesMatch);
+        CHECK(numDuplicates == 0);
+        CHECK(numMissing == 0);
+        CHECK(numUnexpected == 0);
+        CHECK(newestDelivered == lastSequence);
+        CHECK(numStaleDatagrams > 0);
+
+        PoseDatagramStatistics statistics = receiver.GetStatistics();
+        printf("    %i datagrams received (%i out of order), %i duplicates discarded, %i poses recovered from redundancy, %i lost, %i late\n",
+            statistics.numDatagrams, numStaleDatagrams, statistics.numDuplicateDatagrams, statistics.numRecoveredPoses, statistics.numLostPoses, statistics.numLatePoses);
+        printf("    added latency avg %.3f ms, max %.3f ms, longest gap between poses %.3f ms\n",
+            statistics.averageAddedLatency, statistics.maxAddedLatency, statistics.maxArrivalGap);
+
+        return passed;
+    }
+}
+
+bool PoseDatagramTests()
+{
+    bool passed = true;
+    CHECK(RejectsDuplicateAndStaleDatagrams());
+    CHECK(LossyLoopback());
+    return passed;
+}
@@ -0,0 +1,332 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Replays a head motion recording through each pose sampling cadence, and reports the bandwidth it takes
+// and the error of the pose the compositor interpolates for each color frame.
+//   CompositorTests benchmark posereplay [recording.csv|synthetic] [capture latency ms]
+// A recording is one pose per line: seconds, position x, y, z (meters), rotation x, y, z, w.
+// Record it at a higher rate than the cadences being compared, it is interpolated between lines.
+// Without a recording, a minute of synthetic head motion with quick head turns is used.
+//
+// For each cadence, this simulates SpectatorViewSocket::SendPose on the HoloLens's 60Hz frame loop:
+// once POSE_SAMPLES_PER_SEND * POSE_SAMPLE_INTERVAL_MS have elapsed, it samples that many poses spread back over the elapsed time.
+// Poses reach the compositor's PoseCache networkDelayMS after they are sent.  For every 59.94Hz color frame,
+// the compositor looks up the pose at the frame's time minus the capture latency, and that is compared to the recording.
+
+#include "CompositorTests.h"
+#include "NetworkPacketStructure.h"
+#include "PoseCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <sstream>
+
+namespace
+{
+    const double frameRate = 60.0;
+    // 59.94Hz, so the color frames drift through every phase of the HoloLens's frames.
+    const double cameraFrameRate = 60000.0 / 1001.0;
+    const double networkDelayMS = 5.0;
+    const double defaultCaptureLatencyMS = 50.0;
+
+    // IPv4 + UDP, and IPv4 + TCP without options.
+    const int udpHeaderBytes = 28;
+    const int tcpHeaderBytes = 40;
+
+    const float pi = 3.14159265f;
+
+    struct RecordedPose
+    {
+        double time;
+        XMFLOAT3 position;
+        XMFLOAT4 rotation;
+    };
+
+    struct Cadence
+    {
+        const char* name;
+        int samplesPerSend;
+        double sampleIntervalMS;
+        bool datagrams;
+    };
+
+    // The first row is how poses were sent before batching: one pose per frame on the TCP stream.
+    const Cadence cadences[] =
+    {
+        { "1 per frame, TCP", 1, 0, false },
+        { "1 x 16ms, UDP", 1, 16, true },
+        { "2 x 8ms, UDP", 2, 8, true },
+        { "4 x 8ms, UDP", 4, 8, true },
+        { "4 x 4ms, UDP", 4, 4, true },
+        { "8 x 4ms, UDP", 8, 4, true },
+        { "4 x 16ms, UDP", 4, 16, true },
+    };
+
+    XMFLOAT4 FromYawPitchRoll(float yaw, float pitch, float roll)
+    {
+        float cy = cosf(yaw * 0.5f), sy = sinf(yaw * 0.5f);
+        float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+        float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+
+        return XMFLOAT4(
+            cy * sp * cr + sy * cp * sr,
+            sy * cp * cr - cy * sp * sr,
+            cy * cp * sr - sy * sp * cr,
+            cy * cp * cr + sy * sp * sr);
+    }
+
+    // The angle between two rotations in degrees, from the rotation that takes one to the other.
+    // acos of their dot product loses everything under a few hundredths of a degree to float rounding.
+    double AngleBetween(const XMFLOAT4& a, const XMFLOAT4& b)
+    {
+        // conjugate(a) * b
+        double w = (double)a.w * b.w + (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+        double x = (double)a.w * b.x - (double)a.x * b.w - (double)a.y * b.z + (double)a.z * b.y;
+        double y = (double)a.w * b.y + (double)a.x * b.z - (double)a.y * b.w - (double)a.z * b.x;
+        double z = (double)a.w * b.z - (double)a.x * b.y + (double)a.y * b.x - (double)a.z * b.w;
+
+        return 2.0 * atan2(sqrt(x * x + y * y + z * z), fabs(w)) * 180.0 / pi;
+    }
+
+    // Swaying while standing, looking around, and a quick 90 degree head turn every few seconds.
+    void CreateSyntheticRecording(std::vector<RecordedPose>& recording)
+    {
+        const double duration = 60.0;
+        const double rate = 1000.0;
+
+        for (int i = 0; i <= (int)(duration * rate); i++)
+        {
+            float t = (float)(i / rate);
+
+            // Turns take 300ms, starting every 4 seconds, alternating left and right.
+            float turn = 0;
+            for (float start = 2.0f; start < t; start += 4.0f)
+            {
+                float progress = (std::min)((t - start) / 0.3f, 1.0f);
+                float eased = progress * progress * (3 - 2 * progress);
+                turn += (((int)(start / 4.0f) % 2 == 0) ? 1.0f : -1.0f) * eased * pi / 2;
+            }
+
+            float yaw = turn + 0.35f * sinf(2 * pi * 0.3f * t);
+            float pitch = 0.15f * sinf(2 * pi * 0.7f * t + 1.0f);
+            float roll = 0.03f * sinf(2 * pi * 1.1f * t);
+
+            RecordedPose pose;
+            pose.time = i / rate;
+            pose.position = XMFLOAT3(
+                0.05f * sinf(2 * pi * 0.5f * t) + 0.01f * sinf(2 * pi * 1.7f * t),
+                1.6f + 0.02f * sinf(2 * pi * 1.9f * t),
+                0.04f * sinf(2 * pi * 0.4f * t + 2.0f));
+            pose.rotation = FromYawPitchRoll(yaw, pitch, roll);
+            recording.push_back(pose);
+        }
+    }
+
+    bool LoadRecording(const std::wstring& path, std::vector<RecordedPose>& recording)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            printf("Could not read %ls\n", path.c_str());
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream values(line);
+
+            RecordedPose pose;
+            if (values >> pose.time
+                >> pose.position.x >> pose.position.y >> pose.position.z
+                >> pose.rotation.x >> pose.rotation.y >> pose.rotation.z >> pose.rotation.w)
+            {
+                recording.push_back(pose);
+            }
+        }
+
+        if (recording.size() < 2)
+        {
+            printf("%ls has fewer than 2 poses.\n", path.c_str());
+            return false;
+        }
+
+        // Start at 0 so the float timestamps PoseCache uses keep their precision.
+        double start = recording[0].time;
+        for (RecordedPose& pose : recording)
+        {
+            pose.time -= start;
+        }
+
+        return true;
+    }
+
+    // The recorded pose at time, interpolated between the recorded poses around it.
+    RecordedPose Sample(const std::vector<RecordedPose>& recording, double time)
+    {
+        auto next = std::lower_bound(recording.begin(), recording.end(), time, [](const RecordedPose& pose, double time)
+        {
+            return pose.time < time;
+        });
+
+        if (next == recording.begin())
+        {
+            return recording.front();
+        }
+        if (next == recording.end())
+        {
+            return recording.back();
+        }
+
+        const RecordedPose& prev = *(next - 1);
+        float t = (float)((time - prev.time) / (next->time - prev.time));
+
+        RecordedPose pose;
+        pose.time = time;
+        XMStoreFloat3(&pose.position, XMVectorLerp(XMLoadFloat3(&prev.position), XMLoadFloat3(&next->position), t));
+        XMStoreFloat4(&pose.rotation, XMQuaternionSlerp(XMLoadFloat4(&prev.rotation), XMLoadFloat4(&next->rotation), t));
+        return pose;
+    }
+
+    double Percentile(std::vector<double>& values, double percentile)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+
+        size_t index = (std::min)(values.size() - 1, (size_t)(percentile * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    void Replay(const std::vector<RecordedPose>& recording, const Cadence& cadence, double captureLatencyMS)
+    {
+        struct SentPose
+        {
+            double arrivalTime;
+            RecordedPose pose;
+        };
+
+        // The HoloLens frame loop, see SpectatorViewSocket::SendPose.
+        std::vector<SentPose> sent;
+        double bytes = 0;
+        double duration = recording.back().time;
+        double sampleInterval = cadence.sampleIntervalMS / 1000.0;
+        double lastSampleTime = 0;
+        for (double now = 0; now <= duration; now += 1.0 / frameRate)
+        {
+            double elapsed = now - lastSampleTime;
+            if (elapsed < cadence.samplesPerSend * sampleInterval)
+            {
+                continue;
+            }
+
+            double spacing = elapsed / cadence.samplesPerSend;
+            if (lastSampleTime == 0 || spacing > 2 * sampleInterval)
+            {
+                spacing = sampleInterval;
+            }
+
+            for (int i = cadence.samplesPerSend - 1; i >= 0; i--)
+            {
+                SentPose sentPose;
+                sentPose.arrivalTime = now + networkDelayMS / 1000.0;
+                sentPose.pose = Sample(recording, (std::max)(0.0, now - i * spacing));
+                sent.push_back(sentPose);
+            }
+            lastSampleTime = now;
+
+            if (cadence.datagrams)
+            {
+                // Datagrams always carry the previous batch as well.
+                bytes += udpHeaderBytes + (sizeof(PoseDatagram) - sizeof(((PoseDatagram*)nullptr)->poses))
+                    + 2 * cadence.samplesPerSend * sizeof(SVPose);
+            }
+            else
+            {
+                bytes += cadence.samplesPerSend * (tcpHeaderBytes + sizeof(SVPose));
+            }
+        }
+
+        // The compositor's color frames.
+        PoseCache cache;
+        std::vector<double> positionErrors;
+        std::vector<double> rotationErrors;
+        size_t nextSent = 0;
+        for (double frameTime = 0; frameTime <= duration; frameTime += 1.0 / cameraFrameRate)
+        {
+            while (nextSent < sent.size() && sent[nextSent].arrivalTime <= frameTime)
+            {
+                const RecordedPose& pose = sent[nextSent++].pose;
+                cache.AddPose(pose.position, pose.rotation, (float)pose.time);
+            }
+
+            double poseTime = frameTime - captureLatencyMS / 1000.0;
+            if (poseTime < 1.0)
+            {
+                // Let the cache fill first.
+                continue;
+            }
+
+            XMFLOAT3 position;
+            XMFLOAT4 rotation;
+            if (!cache.GetPose(position, rotation, (float)poseTime))
+            {
+                continue;
+            }
+
+            RecordedPose truth = Sample(recording, poseTime);
+            float dx = position.x - truth.position.x;
+            float dy = position.y - truth.position.y;
+            float dz = position.z - truth.position.z;
+            positionErrors.push_back(1000.0 * sqrt(dx * dx + dy * dy + dz * dz));
+
+            rotationErrors.push_back(AngleBetween(rotation, truth.rotation));
+        }
+
+        double averagePosition = 0;
+        for (double error : positionErrors) { averagePosition += error; }
+        averagePosition /= (std::max)((size_t)1, positionErrors.size());
+
+        double averageRotation = 0;
+        for (double error : rotationErrors) { averageRotation += error; }
+        averageRotation /= (std::max)((size_t)1, rotationErrors.size());
+
+        printf("%-18s %8.0f %9.1f %8.2f %8.2f %8.2f %8.3f %8.3f %8.3f\n", cadence.name,
+            sent.size() / duration, bytes / duration / 1024.0,
+            averagePosition, Percentile(positionErrors, 0.95), Percentile(positionErrors, 1.0),
+            averageRotation, Percentile(rotationErrors, 0.95), Percentile(rotationErrors, 1.0));
+    }
+}
+
+bool PoseReplayBenchmark(const std::vector<std::wstring>& args)
+{
+    std::vector<RecordedPose> recording;
+    if (!args.empty() && args[0] != L"synthetic")
+    {
+        if (!LoadRecording(args[0], recording))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        printf("No recording given, using synthetic head motion.\n");
+        CreateSyntheticRecording(recording);
+    }
+
+    double captureLatencyMS = args.size() >= 2 ? _wtof(args[1].c_str()) : defaultCaptureLatencyMS;
+
+    printf("%.0f seconds, %.0fms capture latency, %.0fms network delay.\n\n", recording.back().time, captureLatencyMS, networkDelayMS);
+    printf("%-18s %8s %9s %8s %8s %8s %8s %8s %8s\n", "cadence", "poses/s", "KB/s", "mm avg", "mm p95", "mm max", "deg avg", "deg p95", "deg max");
+
+    for (const Cadence& cadence : cadences)
+    {
+        Replay(recording, cadence, captureLatencyMS);
+    }
+
+    return true;
+}
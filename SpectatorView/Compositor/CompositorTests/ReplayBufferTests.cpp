@@ -0,0 +1,176 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Checks ReplayBuffer's keyframe alignment, and its eviction against a simulated stream of GOPs that is limited first by
+// duration, then by memory, and then has GOPs that are larger than the memory budget now and then.
+
+#include "CompositorTests.h"
+#include "CompositorConstants.h"
+#include "ReplayBuffer.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    typedef ReplayBuffer::Sample Sample;
+
+    const LONGLONG frameDuration = S2HNS / 30;
+    const int gopFrames = 30;
+    const LONGLONG replayDuration = 5 * S2HNS;
+
+    // Every byte of a sample is derived from its frame index, so a sample copied from the wrong place shows up as the wrong bytes.
+    void Fill(std::vector<BYTE>& bytes, DWORD size, int index)
+    {
+        bytes.resize(size);
+        for (DWORD i = 0; i < size; i++)
+        {
+            bytes[i] = (BYTE)(index * 7 + i);
+        }
+    }
+
+    bool Add(ReplayBuffer& replay, std::vector<BYTE>& frame, DWORD size, int index)
+    {
+        Fill(frame, size, index);
+        return replay.Add(frame.data(), size, index * frameDuration, frameDuration, index % gopFrames == 0);
+    }
+
+    bool StartsOnKeyFrame()
+    {
+        bool passed = true;
+
+        ReplayBuffer replay(64 << 10, replayDuration);
+        std::vector<BYTE> frame;
+        std::vector<Sample> snapshot;
+        std::vector<BYTE> data, header;
+
+        // Nothing is kept until the first keyframe.
+        CHECK(!replay.Snapshot(snapshot, data, header));
+        CHECK(!Add(replay, frame, 100, 1));
+        CHECK(!replay.Snapshot(snapshot, data, header));
+
+        const BYTE parameterSets[] = { 0, 0, 0, 1, 0x67 };
+        replay.SetHeader(parameterSets, sizeof(parameterSets));
+        CHECK(Add(replay, frame, 100, 0));
+        CHECK(Add(replay, frame, 100, 1));
+        CHECK(replay.Snapshot(snapshot, data, header));
+        CHECK(snapshot.size() == 2 && snapshot.front().keyFrame && !snapshot.back().keyFrame);
+        CHECK(data.size() == 200 && replay.GetSize() == 200);
+        CHECK(header.size() == sizeof(parameterSets) && header.back() == 0x67);
+        CHECK(replay.GetDuration() == 2 * frameDuration);
+
+        // A sample that could never fit drops everything until the next keyframe.
+        CHECK(!Add(replay, frame, (DWORD)replay.GetMemoryBudget() + 1, 2));
+        CHECK(!replay.Snapshot(snapshot, data, header));
+        CHECK(!Add(replay, frame, 100, 3));
+        CHECK(Add(replay, frame, 100, gopFrames));
+        CHECK(replay.Snapshot(snapshot, data, header) && snapshot.size() == 1);
+
+        replay.Clear();
+        CHECK(!replay.Snapshot(snapshot, data, header));
+        CHECK(replay.GetDuration() == 0 && replay.GetSize() == 0);
+        CHECK(!Add(replay, frame, 100, gopFrames + 1));
+
+        return passed;
+    }
+
+    // Starts on a keyframe, is contiguous, fits the budget and holds the samples it was given.
+    bool IsValidSnapshot(const std::vector<Sample>& snapshot, const std::vector<BYTE>& data, size_t memoryBudget)
+    {
+        if (!snapshot.front().keyFrame || data.size() > memoryBudget)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < snapshot.size(); i++)
+        {
+            const Sample& sample = snapshot[i];
+            int sampleIndex = (int)(sample.time / frameDuration);
+            if ((i > 0 && sample.time != snapshot[i - 1].time + snapshot[i - 1].duration) ||
+                sample.keyFrame != (sampleIndex % gopFrames == 0) ||
+                data[sample.offset] != (BYTE)(sampleIndex * 7) ||
+                data[sample.offset + sample.size - 1] != (BYTE)(sampleIndex * 7 + sample.size - 1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Takes a snapshot after every frame of a minute of simulated stream.
+    bool SimulatedStream()
+    {
+        bool passed = true;
+
+        // Fixed seed so every run simulates the same stream.
+        std::mt19937 random(1);
+        std::vector<BYTE> frame;
+        std::vector<Sample> snapshot;
+        std::vector<BYTE> data, header;
+
+        // Each phase is {memory budget, average frame size}: the first is limited by duration, the second by memory,
+        // and the third has GOPs that are larger than the budget now and then.
+        const size_t phases[][2] = { { 4 << 20, 2000 }, { 256 << 10, 4000 }, { 64 << 10, 1600 } };
+
+        int numSnapshots = 0, numDropped = 0;
+        int numInvalid = 0, numUnneededGOPs = 0, numTooShort = 0;
+        LONGLONG maxDuration = 0;
+        for (const auto& phase : phases)
+        {
+            ReplayBuffer replay(phase[0], replayDuration);
+            std::uniform_int_distribution<int> frameSize(1, (int)phase[1] * 2);
+            int phaseDropped = 0;
+
+            for (int index = 0; index < 30 * 60; index++)
+            {
+                // Keyframes are several times larger than the frames that depend on them.
+                DWORD size = (DWORD)frameSize(random) * (index % gopFrames == 0 ? 8 : 1);
+                phaseDropped += Add(replay, frame, size, index) ? 0 : 1;
+
+                if (!replay.Snapshot(snapshot, data, header))
+                {
+                    continue;
+                }
+                numSnapshots++;
+
+                LONGLONG duration = replay.GetDuration();
+                numInvalid += IsValidSnapshot(snapshot, data, phase[0]) && duration >= frameDuration ? 0 : 1;
+
+                // Never keeps a GOP it does not need: without its oldest GOP the ring would be too short.
+                auto nextGOP = std::find_if(snapshot.begin() + 1, snapshot.end(), [](const Sample& sample) { return sample.keyFrame; });
+                if (nextGOP != snapshot.end() && snapshot.back().time + frameDuration - nextGOP->time >= replayDuration)
+                {
+                    numUnneededGOPs++;
+                }
+
+                // Covers the whole duration, unless memory ran out or the stream has not been going that long.
+                if (phase[0] == phases[0][0] && index * frameDuration >= replayDuration && duration < replayDuration)
+                {
+                    numTooShort++;
+                }
+                maxDuration = std::max(maxDuration, duration);
+            }
+
+            // Only the last phase has GOPs that do not fit.
+            CHECK((phaseDropped > 0) == (phase[0] == phases[2][0]));
+            numDropped += phaseDropped;
+        }
+
+        CHECK(numInvalid == 0);
+        CHECK(numUnneededGOPs == 0);
+        CHECK(numTooShort == 0);
+        CHECK(maxDuration >= replayDuration && maxDuration < replayDuration + gopFrames * frameDuration);
+
+        printf("    %i snapshots, %i samples dropped waiting for a keyframe, longest replay: %lld ms\n",
+            numSnapshots, numDropped, (long long)(maxDuration / MS2HNS));
+        return passed;
+    }
+}
+
+bool ReplayBufferTests()
+{
+    bool passed = true;
+    CHECK(StartsOnKeyFrame());
+    CHECK(SimulatedStream());
+    return passed;
+}
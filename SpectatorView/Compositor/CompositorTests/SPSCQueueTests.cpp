@@ -0,0 +1,146 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Checks SPSCQueue, which feeds frames from the render thread to VideoEncoder's encoder thread,
+// on its own and with a producer and consumer thread racing each other.
+
+#include "CompositorTests.h"
+#include "SPSCQueue.h"
+
+#include <thread>
+
+namespace
+{
+    // Larger than a pointer, so a frame read before the producer finished writing it shows up as mismatched words.
+    struct Frame
+    {
+        unsigned int sequence;
+        unsigned int pixels[15];
+
+        void Fill(unsigned int s)
+        {
+            sequence = s;
+            for (unsigned int& pixel : pixels)
+            {
+                pixel = s * 2654435761u;
+            }
+        }
+
+        bool IsIntact() const
+        {
+            for (unsigned int pixel : pixels)
+            {
+                if (pixel != sequence * 2654435761u)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    bool FullAndEmpty()
+    {
+        bool passed = true;
+
+        SPSCQueue<int, 4> queue;
+        int item = -1;
+        CHECK(!queue.TryPop(item));
+        CHECK(queue.Size() == 0);
+
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK(queue.TryPush(i));
+        }
+        CHECK(!queue.TryPush(4));
+        CHECK(queue.Size() == 4);
+
+        // Wrap around the end of the storage a few times.
+        for (int i = 4; i < 14; i++)
+        {
+            CHECK(queue.TryPop(item));
+            CHECK(item == i - 4);
+            CHECK(queue.TryPush(i));
+        }
+
+        for (int i = 10; i < 14; i++)
+        {
+            CHECK(queue.TryPop(item));
+            CHECK(item == i);
+        }
+        CHECK(!queue.TryPop(item));
+        CHECK(queue.Size() == 0);
+
+        return passed;
+    }
+
+    // The producer pushes numFrames numbered frames, retrying while the queue is full, like the render thread with a slow encoder.
+    // The consumer has to see every frame exactly once, in order, and intact.
+    template<int Capacity>
+    bool ProducerConsumer(unsigned int numFrames)
+    {
+        bool passed = true;
+
+        SPSCQueue<Frame, Capacity> queue;
+        int maxSize = 0;
+
+        std::thread producer([&]
+        {
+            Frame frame;
+            for (unsigned int s = 1; s <= numFrames; s++)
+            {
+                frame.Fill(s);
+                while (!queue.TryPush(frame))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        unsigned int expected = 1;
+        int numOutOfOrder = 0;
+        int numTorn = 0;
+        Frame frame;
+        while (expected <= numFrames)
+        {
+            int size = queue.Size();
+            maxSize = size > maxSize ? size : maxSize;
+
+            if (!queue.TryPop(frame))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            numTorn += frame.IsIntact() ? 0 : 1;
+            if (frame.sequence != expected)
+            {
+                numOutOfOrder++;
+                // Resynchronize, so one lost frame is not also reported as every frame after it.
+                expected = frame.sequence;
+            }
+            expected++;
+        }
+
+        producer.join();
+
+        CHECK(numOutOfOrder == 0);
+        CHECK(numTorn == 0);
+        CHECK(expected == numFrames + 1);
+        CHECK(maxSize <= Capacity);
+        CHECK(!queue.TryPop(frame));
+
+        return passed;
+    }
+}
+
+bool SPSCQueueTests()
+{
+    bool passed = true;
+    CHECK(FullAndEmpty());
+
+    // A queue of 2 makes the two threads hand off nearly every frame, the largest VideoEncoder uses exercises the usual case.
+    CHECK(ProducerConsumer<2>(200000));
+    CHECK(ProducerConsumer<16>(1000000));
+    return passed;
+}
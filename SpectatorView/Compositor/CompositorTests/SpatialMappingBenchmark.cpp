@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Encodes and decodes a corpus of spatial mapping meshes with and without the entropy stage,
+// and reports the compression ratio and MB/s of each.
+//   CompositorTests benchmark spatialmapping [sync files]
+// The corpus is syncs saved by the compositor with SAVE_SPATIAL_MAPPING_SYNCS, from HologramCapture\SpatialMapping.
+// Without any files, a synthetic room of grid meshes is used instead.
+// MB/s are measured against the size of the meshes in the original float format, like the compositor's log.
+
+#include "SpatialMappingCorpus.h"
+
+bool SpatialMappingBenchmark(const std::vector<std::wstring>& args)
+{
+    std::vector<SpatialMappingCorpusMesh> corpus;
+    if (!LoadSpatialMappingCorpus(args, corpus))
+    {
+        return false;
+    }
+
+    double unencodedBytes = 0;
+    int maxEncodedBytes = 0;
+    int numVertices = 0;
+    int numIndices = 0;
+    for (const SpatialMappingCorpusMesh& mesh : corpus)
+    {
+        unencodedBytes += SpatialMappingEncoder::GetUnencodedSize(mesh.NumVertices(), (int)mesh.indices.size());
+        maxEncodedBytes += SpatialMappingEncoder::GetMaxEncodedSize(mesh.NumVertices(), (int)mesh.indices.size());
+        numVertices += mesh.NumVertices();
+        numIndices += (int)mesh.indices.size();
+    }
+
+    printf("%i meshes, %i vertices, %i indices, %.0f bytes in the float format.\n\n", (int)corpus.size(), numVertices, numIndices, unencodedBytes);
+    printf("%-10s %12s %8s %12s %12s\n", "entropy", "bytes", "ratio", "encode MB/s", "decode MB/s");
+
+    std::vector<byte> encoded(maxEncodedBytes);
+    SpatialMappingScratch scratch;
+    std::vector<float> vertices;
+    std::vector<short> indices;
+    for (bool entropyCode : { false, true })
+    {
+        int encodedBytes = 0;
+        double encodeMS = FastestMS([&]
+        {
+            encodedBytes = 0;
+            for (const SpatialMappingCorpusMesh& mesh : corpus)
+            {
+                encodedBytes += SpatialMappingEncoder::Encode(mesh.header,
+                    mesh.positions.data(), 4, mesh.NumVertices(),
+                    mesh.indices.data(), (int)mesh.indices.size(),
+                    entropyCode, &encoded[encodedBytes], scratch);
+            }
+        });
+
+        // Decode the way the compositor does, into arrays Unity would read.
+        bool decoded = true;
+        double decodeMS = FastestMS([&]
+        {
+            int readIndex = 0;
+            while (readIndex < encodedBytes)
+            {
+                SpatialMappingMeshHeader header;
+                decoded &= SpatialMappingEncoder::ReadHeader(&encoded[readIndex], encodedBytes - readIndex, header);
+                if (!decoded)
+                {
+                    break;
+                }
+                readIndex += sizeof(SpatialMappingMeshHeader);
+
+                vertices.resize(header.numVertices * 3);
+                indices.resize(header.numIndices);
+                decoded &= SpatialMappingEncoder::Decode(header, &encoded[readIndex], vertices.data(), indices.data(), scratch);
+                readIndex += header.payloadByteLength;
+            }
+        });
+
+        if (!decoded)
+        {
+            printf("Could not decode the corpus after encoding it.\n");
+            return false;
+        }
+
+        printf("%-10s %12i %8.2f %12.1f %12.1f\n", entropyCode ? "on" : "off", encodedBytes, unencodedBytes / encodedBytes,
+            MBPerSecond(unencodedBytes, encodeMS), MBPerSecond(unencodedBytes, decodeMS));
+    }
+
+    return true;
+}
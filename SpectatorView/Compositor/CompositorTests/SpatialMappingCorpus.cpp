@@ -0,0 +1,127 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "SpatialMappingCorpus.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <random>
+
+namespace
+{
+    // Undo the compositor's decode, to get back the positions and indices the HoloLens encoded.
+    bool LoadSync(const std::wstring& path, std::vector<SpatialMappingCorpusMesh>& corpus)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<byte> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!file.is_open() || bytes.size() < sizeof(SpatialMappingSyncHeader))
+        {
+            printf("Could not read %ls\n", path.c_str());
+            return false;
+        }
+
+        SpatialMappingSyncHeader syncHeader;
+        memcpy(&syncHeader, bytes.data(), sizeof(syncHeader));
+        int length = (int)bytes.size();
+        int numRemovedSurfaces = (std::max)(0, (std::min)(syncHeader.numRemovedSurfaces, length / (int)sizeof(GUID)));
+        int readIndex = sizeof(SpatialMappingSyncHeader) + numRemovedSurfaces * sizeof(GUID);
+
+        std::vector<float> vertices;
+        std::vector<short> indices;
+        SpatialMappingScratch scratch;
+        for (int i = 0; i < syncHeader.numMeshes; i++)
+        {
+            SpatialMappingCorpusMesh mesh;
+            if (readIndex > length || !SpatialMappingEncoder::ReadHeader(bytes.data() + readIndex, length - readIndex, mesh.header))
+            {
+                printf("%ls is truncated or malformed\n", path.c_str());
+                return false;
+            }
+            readIndex += sizeof(SpatialMappingMeshHeader);
+
+            vertices.resize(mesh.header.numVertices * 3);
+            indices.resize(mesh.header.numIndices);
+            if (!SpatialMappingEncoder::Decode(mesh.header, bytes.data() + readIndex, vertices.data(), indices.data(), scratch))
+            {
+                printf("Could not decode mesh %i of %ls\n", i, path.c_str());
+                return false;
+            }
+            readIndex += mesh.header.payloadByteLength;
+
+            for (int v = 0; v < mesh.header.numVertices; v++)
+            {
+                mesh.positions.push_back((short)vertices[v * 3]);
+                mesh.positions.push_back((short)vertices[v * 3 + 1]);
+                mesh.positions.push_back((short)-vertices[v * 3 + 2]);
+                mesh.positions.push_back(0);
+            }
+            mesh.indices.assign(indices.begin(), indices.end());
+            corpus.push_back(mesh);
+        }
+
+        return true;
+    }
+
+    // Height field grids with a bit of noise, about the size and shape of the surfaces a HoloLens sees in a room.
+    void CreateSyntheticRoom(std::vector<SpatialMappingCorpusMesh>& corpus)
+    {
+        const int numSurfaces = 48;
+        const int gridSize = 48;
+        std::mt19937 random(1);
+        std::normal_distribution<float> noise(0.0f, 40.0f);
+
+        for (int surface = 0; surface < numSurfaces; surface++)
+        {
+            SpatialMappingCorpusMesh mesh;
+            mesh.header = {};
+            mesh.header.id.Data1 = surface;
+            mesh.header.scale = DirectX::XMFLOAT3(1, 1, 1);
+
+            for (int y = 0; y < gridSize; y++)
+            {
+                for (int x = 0; x < gridSize; x++)
+                {
+                    float height = 2000.0f * sinf(x * 0.1f + surface) * cosf(y * 0.13f) + noise(random);
+                    mesh.positions.push_back((short)(x * 600 - 14000));
+                    mesh.positions.push_back((short)(y * 600 - 14000));
+                    mesh.positions.push_back((short)height);
+                    mesh.positions.push_back(0);
+                }
+            }
+
+            for (int y = 0; y < gridSize - 1; y++)
+            {
+                for (int x = 0; x < gridSize - 1; x++)
+                {
+                    unsigned short i = (unsigned short)(y * gridSize + x);
+                    unsigned short triangles[] = { i, (unsigned short)(i + gridSize), (unsigned short)(i + 1),
+                        (unsigned short)(i + 1), (unsigned short)(i + gridSize), (unsigned short)(i + gridSize + 1) };
+                    mesh.indices.insert(mesh.indices.end(), std::begin(triangles), std::end(triangles));
+                }
+            }
+
+            corpus.push_back(mesh);
+        }
+    }
+}
+
+bool LoadSpatialMappingCorpus(const std::vector<std::wstring>& paths, std::vector<SpatialMappingCorpusMesh>& corpus)
+{
+    for (const std::wstring& path : paths)
+    {
+        if (!LoadSync(path, corpus))
+        {
+            return false;
+        }
+    }
+
+    if (paths.empty())
+    {
+        printf("No sync files given, using a synthetic room.\n");
+        CreateSyntheticRoom(corpus);
+    }
+
+    return true;
+}
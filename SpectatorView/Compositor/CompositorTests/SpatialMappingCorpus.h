@@ -0,0 +1,26 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Spatial mapping meshes for the benchmarks, either loaded from syncs the compositor saved with SAVE_SPATIAL_MAPPING_SYNCS
+// (from HologramCapture\SpatialMapping), or a synthetic room of grid meshes when no files are given.
+
+#pragma once
+#include "CompositorTests.h"
+#include "SpatialMappingEncoder.h"
+
+struct SpatialMappingCorpusMesh
+{
+    SpatialMappingMeshHeader header;
+    // 4 shorts per vertex, as the HoloLens hands them to the encoder.
+    std::vector<short> positions;
+    std::vector<unsigned short> indices;
+
+    int NumVertices() const
+    {
+        return (int)positions.size() / 4;
+    }
+};
+
+// Loads every sync file in paths, or the synthetic room if paths is empty.
+// Returns false if a file could not be read or decoded.
+bool LoadSpatialMappingCorpus(const std::vector<std::wstring>& paths, std::vector<SpatialMappingCorpusMesh>& corpus);
@@ -0,0 +1,355 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#include "CompositorTests.h"
+#include "SpatialMappingEncoder.h"
+
+#include <algorithm>
+#include <climits>
+#include <random>
+
+namespace
+{
+    // A mesh as the HoloLens hands it to the encoder: 4 shorts per vertex and 16 bit triangle indices.
+    struct Mesh
+    {
+        std::vector<short> positions;
+        std::vector<unsigned short> indices;
+
+        int NumVertices() const
+        {
+            return (int)positions.size() / 4;
+        }
+    };
+
+    Mesh CreateMesh(int numVertices, int numIndices, std::mt19937& random)
+    {
+        Mesh mesh;
+        std::uniform_int_distribution<int> position(SHRT_MIN, SHRT_MAX);
+        for (int i = 0; i < numVertices * 4; i++)
+        {
+            mesh.positions.push_back((short)position(random));
+        }
+
+        // Mostly indices near the previous one, like neighboring triangles, with the occasional jump across the mesh.
+        std::uniform_int_distribution<int> step(-8, 8);
+        std::uniform_int_distribution<int> jump(0, numVertices > 0 ? numVertices - 1 : 0);
+        int index = 0;
+        for (int i = 0; i < numIndices && numVertices > 0; i++)
+        {
+            index = (i % 17 == 0) ? jump(random) : index + step(random);
+            index = (std::max)(0, (std::min)(numVertices - 1, index));
+            mesh.indices.push_back((unsigned short)index);
+        }
+
+        return mesh;
+    }
+
+    std::vector<byte> Encode(const Mesh& mesh, bool entropyCode)
+    {
+        SpatialMappingMeshHeader header = {};
+        header.updateTime = 42;
+        header.scale = DirectX::XMFLOAT3(1, 1, 1);
+
+        std::vector<byte> encoded(SpatialMappingEncoder::GetMaxEncodedSize(mesh.NumVertices(), (int)mesh.indices.size()));
+        SpatialMappingScratch scratch;
+        int length = SpatialMappingEncoder::Encode(header,
+            mesh.positions.data(), 4, mesh.NumVertices(),
+            mesh.indices.data(), (int)mesh.indices.size(),
+            entropyCode, encoded.data(), scratch);
+
+        encoded.resize(length);
+        return encoded;
+    }
+
+    // Decodes a mesh the way the compositor does.  Returns false if it was rejected.
+    bool Decode(const byte* encoded, int length, std::vector<float>& vertices, std::vector<short>& indices)
+    {
+        SpatialMappingMeshHeader header;
+        if (!SpatialMappingEncoder::ReadHeader(encoded, length, header))
+        {
+            return false;
+        }
+
+        vertices.assign(header.numVertices * 3, 0.0f);
+        indices.assign(header.numIndices, 0);
+        SpatialMappingScratch scratch;
+        return SpatialMappingEncoder::Decode(header, encoded + sizeof(SpatialMappingMeshHeader), vertices.data(), indices.data(), scratch);
+    }
+
+    bool Matches(const Mesh& mesh, const std::vector<float>& vertices, const std::vector<short>& indices)
+    {
+        if (vertices.size() != (size_t)mesh.NumVertices() * 3 || indices.size() != mesh.indices.size())
+        {
+            return false;
+        }
+
+        for (int i = 0; i < mesh.NumVertices(); i++)
+        {
+            // w is dropped, and z is flipped for Unity.
+            if (vertices[i * 3] != (float)mesh.positions[i * 4] ||
+                vertices[i * 3 + 1] != (float)mesh.positions[i * 4 + 1] ||
+                vertices[i * 3 + 2] != -(float)mesh.positions[i * 4 + 2])
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            if ((unsigned short)indices[i] != mesh.indices[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool RoundTrip()
+    {
+        bool passed = true;
+        std::mt19937 random(1);
+
+        // Every vertex count around the SIMD block sizes, plus a large mesh and the largest one 16 bit indices can address.
+        std::vector<int> vertexCounts;
+        for (int i = 0; i <= 13; i++)
+        {
+            vertexCounts.push_back(i);
+        }
+        vertexCounts.push_back(4099);
+        vertexCounts.push_back(SPATIAL_MAPPING_MAX_VERTICES);
+
+        for (int numVertices : vertexCounts)
+        {
+            Mesh mesh = CreateMesh(numVertices, numVertices * 6, random);
+            for (bool entropyCode : { false, true })
+            {
+                std::vector<byte> encoded = Encode(mesh, entropyCode);
+                std::vector<float> vertices;
+                std::vector<short> indices;
+                CHECK(Decode(encoded.data(), (int)encoded.size(), vertices, indices));
+                CHECK(Matches(mesh, vertices, indices));
+            }
+        }
+
+        // Extremes of the index deltas.
+        Mesh mesh = CreateMesh(SPATIAL_MAPPING_MAX_VERTICES, 0, random);
+        mesh.indices = { 0, 65535, 0, 65535, 65535, 1, 65534, 2 };
+        std::vector<float> vertices;
+        std::vector<short> indices;
+        std::vector<byte> encoded = Encode(mesh, false);
+        CHECK(Decode(encoded.data(), (int)encoded.size(), vertices, indices));
+        CHECK(Matches(mesh, vertices, indices));
+
+        return passed;
+    }
+
+    // Every prefix of a mesh is rejected, whether or not the entropy stage was used.
+    bool Truncated()
+    {
+        bool passed = true;
+        std::mt19937 random(2);
+        Mesh mesh = CreateMesh(300, 1800, random);
+
+        for (bool entropyCode : { false, true })
+        {
+            std::vector<byte> encoded = Encode(mesh, entropyCode);
+            for (size_t length = 0; length < encoded.size(); length++)
+            {
+                // Copy the prefix, so reading past it would read past the allocation.
+                std::vector<byte> truncated(encoded.begin(), encoded.begin() + length);
+                std::vector<float> vertices;
+                std::vector<short> indices;
+                CHECK(!Decode(truncated.data(), (int)truncated.size(), vertices, indices));
+            }
+        }
+
+        // A header that claims a shorter payload than the counts need, as if the sender cut the mesh short.
+        std::vector<byte> encoded = Encode(mesh, false);
+        SpatialMappingMeshHeader header;
+        memcpy(&header, encoded.data(), sizeof(header));
+        header.payloadByteLength -= 10;
+        header.decodedByteLength -= 10;
+        memcpy(encoded.data(), &header, sizeof(header));
+
+        std::vector<float> vertices;
+        std::vector<short> indices;
+        CHECK(!Decode(encoded.data(), (int)encoded.size() - 10, vertices, indices));
+
+        return passed;
+    }
+
+    // Headers with inconsistent counts and lengths are rejected before anything is sized from them.
+    bool MalformedHeaders()
+    {
+        bool passed = true;
+        std::mt19937 random(3);
+        Mesh mesh = CreateMesh(100, 600, random);
+        std::vector<byte> encoded = Encode(mesh, false);
+
+        SpatialMappingMeshHeader valid;
+        memcpy(&valid, encoded.data(), sizeof(valid));
+        CHECK(SpatialMappingEncoder::IsValid(valid, valid.payloadByteLength));
+
+        auto rejected = [&](void(*corrupt)(SpatialMappingMeshHeader& header))
+        {
+            SpatialMappingMeshHeader header = valid;
+            corrupt(header);
+
+            std::vector<byte> corrupted = encoded;
+            memcpy(corrupted.data(), &header, sizeof(header));
+
+            std::vector<float> vertices;
+            std::vector<short> indices;
+            return !Decode(corrupted.data(), (int)corrupted.size(), vertices, indices);
+        };
+
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.payloadByteLength = -1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.payloadByteLength += 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numVertices = -1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numIndices = -1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.indexByteLength = -1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.decodedByteLength = -1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.flags = 0x80; }));
+
+        // numVertices * 3 * sizeof(short) would overflow an int, and the arrays sized from it would be far too small.
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numVertices = INT_MAX / 3; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numVertices = INT_MIN / 2 + 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numVertices = SPATIAL_MAPPING_MAX_VERTICES + 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numIndices = SPATIAL_MAPPING_MAX_INDICES + 1; }));
+
+        // Counts that do not match the lengths: the positions would run into the indices, or the indices past the payload.
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numVertices += 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numIndices += 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.indexByteLength += 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.indexByteLength -= 1; h.decodedByteLength -= 1; h.payloadByteLength -= 1; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.numIndices = h.indexByteLength + 1; }));
+
+        // Without the entropy stage, the decoded payload is the payload, so a larger decoded length would be read past the payload.
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.decodedByteLength += 100; h.indexByteLength += 100; }));
+        CHECK(rejected([](SpatialMappingMeshHeader& h) { h.payloadByteLength -= 1; }));
+
+        // Indices that reference vertices the mesh does not have.
+        Mesh outOfRange = mesh;
+        outOfRange.indices[10] = (unsigned short)mesh.NumVertices();
+        std::vector<byte> outOfRangeEncoded = Encode(outOfRange, false);
+        std::vector<float> vertices;
+        std::vector<short> indices;
+        CHECK(!Decode(outOfRangeEncoded.data(), (int)outOfRangeEncoded.size(), vertices, indices));
+
+        return passed;
+    }
+
+    // A transform-only record keeps the id, update time and transform, carries no payload, and cannot be mistaken for a mesh.
+    bool TransformOnly()
+    {
+        bool passed = true;
+
+        SpatialMappingMeshHeader moved = {};
+        moved.id.Data1 = 7;
+        moved.updateTime = 42;
+        moved.translation = DirectX::XMFLOAT3(1, 2, 3);
+        moved.rotation = DirectX::XMFLOAT4(0, 0, 0, 1);
+        moved.scale = DirectX::XMFLOAT3(2, 2, 2);
+        // Left over from a mesh, and cleared by EncodeTransform.
+        moved.numVertices = 3;
+        moved.payloadByteLength = 100;
+
+        std::vector<byte> encoded(sizeof(SpatialMappingMeshHeader));
+        CHECK(SpatialMappingEncoder::EncodeTransform(moved, encoded.data()) == (int)sizeof(SpatialMappingMeshHeader));
+
+        SpatialMappingMeshHeader header;
+        CHECK(SpatialMappingEncoder::ReadHeader(encoded.data(), (int)encoded.size(), header));
+        CHECK(SpatialMappingEncoder::IsTransformOnly(header));
+        CHECK(header.id == moved.id && header.updateTime == 42);
+        CHECK(header.translation.z == 3 && header.rotation.w == 1 && header.scale.x == 2);
+        CHECK(header.numVertices == 0 && header.numIndices == 0 && header.payloadByteLength == 0);
+
+        // With a payload, or combined with another flag, it is malformed.
+        SpatialMappingMeshHeader withVertices = header;
+        withVertices.numVertices = 1;
+        withVertices.decodedByteLength = 3 * sizeof(short);
+        withVertices.payloadByteLength = withVertices.decodedByteLength;
+        CHECK(!SpatialMappingEncoder::IsValid(withVertices, withVertices.payloadByteLength));
+
+        SpatialMappingMeshHeader entropyCoded = header;
+        entropyCoded.flags |= SPATIAL_MAPPING_FLAG_ENTROPY_CODED;
+        CHECK(!SpatialMappingEncoder::IsValid(entropyCoded, 0));
+
+        // And a mesh is not a transform-only record.
+        std::mt19937 random(5);
+        std::vector<byte> mesh = Encode(CreateMesh(16, 48, random), false);
+        SpatialMappingMeshHeader meshHeader;
+        CHECK(SpatialMappingEncoder::ReadHeader(mesh.data(), (int)mesh.size(), meshHeader));
+        CHECK(!SpatialMappingEncoder::IsTransformOnly(meshHeader));
+        meshHeader.flags |= SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY;
+        CHECK(!SpatialMappingEncoder::IsValid(meshHeader, meshHeader.payloadByteLength));
+
+        return passed;
+    }
+
+    // Random corruption of a mesh never decodes into indices outside the mesh.
+    // Out of bounds reads are caught by running this under the debug heap or Application Verifier.
+    bool RandomCorruption()
+    {
+        bool passed = true;
+        std::mt19937 random(4);
+        Mesh mesh = CreateMesh(64, 384, random);
+
+        for (bool entropyCode : { false, true })
+        {
+            std::vector<byte> encoded = Encode(mesh, entropyCode);
+            std::uniform_int_distribution<size_t> offset(0, encoded.size() - 1);
+            std::uniform_int_distribution<int> value(0, 255);
+
+            for (int i = 0; i < 20000; i++)
+            {
+                std::vector<byte> corrupted = encoded;
+                for (int j = 0; j < 1 + i % 4; j++)
+                {
+                    corrupted[offset(random)] = (byte)value(random);
+                }
+
+                std::vector<float> vertices;
+                std::vector<short> indices;
+                if (Decode(corrupted.data(), (int)corrupted.size(), vertices, indices))
+                {
+                    int numVertices = (int)vertices.size() / 3;
+                    for (short index : indices)
+                    {
+                        CHECK((unsigned short)index < numVertices);
+                    }
+                }
+            }
+        }
+
+        return passed;
+    }
+}
+
+bool SpatialMappingEncoderTests()
+{
+    bool passed = true;
+
+    // Run everything on the scalar paths, and again on the SSE4.1 paths if this CPU has them.
+    bool useSSE41 = SpatialMappingEncoder::UseSSE41();
+    for (bool sse41 : { false, true })
+    {
+        if (sse41 && !SpatialMappingEncoder::IsSSE41Supported())
+        {
+            printf("    SSE4.1 is not supported, only the scalar paths were tested.\n");
+            continue;
+        }
+
+        SpatialMappingEncoder::UseSSE41() = sse41;
+        CHECK(RoundTrip());
+        CHECK(Truncated());
+        CHECK(MalformedHeaders());
+        CHECK(TransformOnly());
+        CHECK(RandomCorruption());
+    }
+    SpatialMappingEncoder::UseSSE41() = useSSE41;
+
+    return passed;
+}
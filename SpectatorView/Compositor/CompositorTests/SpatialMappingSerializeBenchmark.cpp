@@ -0,0 +1,163 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Serializes a full room of spatial mapping meshes the way RealtimeSurfaceMeshRenderer::SerializeMeshes does,
+// and reports the time and heap allocations per room for:
+//   per mesh     the original path: a new byte[] per mesh with float vertices converted one at a time,
+//                collected in vectors and copied again into one combined allocation.
+//   single pass  sizes every mesh with GetMaxEncodedSize, then encodes each one straight into a send buffer that is reused across syncs.
+//   CompositorTests benchmark serialize [sync files]
+// The corpus is the same as the spatialmapping benchmark's.
+
+#include "SpatialMappingCorpus.h"
+
+namespace
+{
+    // SurfaceMesh::Serialize before the encoded format: counts, transform, float vertices, raw indices.
+    byte* SerializeMeshPerMesh(const SpatialMappingCorpusMesh& mesh, int& length)
+    {
+        int transformLength = 10 * sizeof(float);
+        int verticesLength = mesh.NumVertices() * 3 * sizeof(float) + transformLength;
+        int indicesLength = (int)mesh.indices.size() * sizeof(short);
+
+        length = (2 * sizeof(int)) + verticesLength + indicesLength;
+        byte* buffer = new byte[length];
+
+        int startIndex = 0;
+        memcpy(&buffer[startIndex], &verticesLength, sizeof(int));
+        startIndex += sizeof(int);
+
+        memcpy(&buffer[startIndex], &indicesLength, sizeof(int));
+        startIndex += sizeof(int);
+
+        memcpy(&buffer[startIndex], &mesh.header.translation, sizeof(DirectX::XMFLOAT3));
+        startIndex += sizeof(DirectX::XMFLOAT3);
+        memcpy(&buffer[startIndex], &mesh.header.rotation, sizeof(DirectX::XMFLOAT4));
+        startIndex += sizeof(DirectX::XMFLOAT4);
+        memcpy(&buffer[startIndex], &mesh.header.scale, sizeof(DirectX::XMFLOAT3));
+        startIndex += sizeof(DirectX::XMFLOAT3);
+
+        for (int i = 0; i < mesh.NumVertices(); i++)
+        {
+            int vertexStartIndex = i * 4;
+            DirectX::XMFLOAT3 vertex(
+                (float)mesh.positions[vertexStartIndex],
+                (float)mesh.positions[vertexStartIndex + 1],
+                (float)mesh.positions[vertexStartIndex + 2]);
+
+            memcpy(&buffer[startIndex], &vertex, sizeof(DirectX::XMFLOAT3));
+            startIndex += sizeof(DirectX::XMFLOAT3);
+        }
+
+        memcpy(&buffer[startIndex], mesh.indices.data(), indicesLength);
+        return buffer;
+    }
+
+    // RealtimeSurfaceMeshRenderer::SerializeMeshes before the single pass serializer.
+    byte* SerializeRoomPerMesh(const std::vector<SpatialMappingCorpusMesh>& corpus, int& length)
+    {
+        length = 0;
+        std::vector<byte*> meshBytes;
+        std::vector<int> meshLengths;
+
+        for (const SpatialMappingCorpusMesh& mesh : corpus)
+        {
+            int meshLength;
+            byte* bytes = SerializeMeshPerMesh(mesh, meshLength);
+
+            length += meshLength;
+            meshBytes.push_back(bytes);
+            meshLengths.push_back(meshLength);
+        }
+
+        byte* allMeshBytes = new byte[length];
+
+        int dst = 0;
+        for (size_t i = 0; i < meshBytes.size(); i++)
+        {
+            memcpy(&allMeshBytes[dst], meshBytes[i], meshLengths[i]);
+            delete[] meshBytes[i];
+            dst += meshLengths[i];
+        }
+
+        return allMeshBytes;
+    }
+
+    // RealtimeSurfaceMeshRenderer::SerializeMeshes: size every mesh, grow the reused buffer if needed, then encode in place.
+    int SerializeRoomSinglePass(const std::vector<SpatialMappingCorpusMesh>& corpus, bool entropyCode,
+        std::vector<byte>& buffer, SpatialMappingScratch& scratch)
+    {
+        int maxLength = sizeof(SpatialMappingSyncHeader);
+        for (const SpatialMappingCorpusMesh& mesh : corpus)
+        {
+            maxLength += SpatialMappingEncoder::GetMaxEncodedSize(mesh.NumVertices(), (int)mesh.indices.size());
+        }
+
+        if (buffer.size() < (size_t)maxLength)
+        {
+            buffer.resize(maxLength);
+        }
+
+        SpatialMappingSyncHeader syncHeader;
+        syncHeader.numMeshes = 0;
+        syncHeader.numRemovedSurfaces = 0;
+
+        int dst = sizeof(SpatialMappingSyncHeader);
+        for (const SpatialMappingCorpusMesh& mesh : corpus)
+        {
+            dst += SpatialMappingEncoder::Encode(mesh.header,
+                mesh.positions.data(), 4, mesh.NumVertices(),
+                mesh.indices.data(), (int)mesh.indices.size(),
+                entropyCode, &buffer[dst], scratch);
+            syncHeader.numMeshes++;
+        }
+
+        memcpy(buffer.data(), &syncHeader, sizeof(SpatialMappingSyncHeader));
+        return dst;
+    }
+
+    // Times serialize, and counts the allocations of one steady state call (after the first, which may grow reused buffers).
+    template<typename Serialize>
+    void Report(const char* name, Serialize serialize)
+    {
+        int length = serialize();
+
+        long long allocationsBefore = GetAllocationCount();
+        serialize();
+        long long allocations = GetAllocationCount() - allocationsBefore;
+
+        double ms = FastestMS([&] { serialize(); });
+        printf("%-22s %12i %12lld %10.2f\n", name, length, allocations, ms);
+    }
+}
+
+bool SpatialMappingSerializeBenchmark(const std::vector<std::wstring>& args)
+{
+    std::vector<SpatialMappingCorpusMesh> corpus;
+    if (!LoadSpatialMappingCorpus(args, corpus))
+    {
+        return false;
+    }
+
+    printf("%i meshes per room.\n\n", (int)corpus.size());
+    printf("%-22s %12s %12s %10s\n", "serializer", "bytes", "allocations", "ms/room");
+
+    Report("per mesh", [&]
+    {
+        int length;
+        delete[] SerializeRoomPerMesh(corpus, length);
+        return length;
+    });
+
+    std::vector<byte> buffer;
+    SpatialMappingScratch scratch;
+    for (bool entropyCode : { false, true })
+    {
+        Report(entropyCode ? "single pass, entropy" : "single pass", [&]
+        {
+            return SerializeRoomSinglePass(corpus, entropyCode, buffer, scratch);
+        });
+    }
+
+    return true;
+}
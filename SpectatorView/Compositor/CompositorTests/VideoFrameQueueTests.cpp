@@ -0,0 +1,320 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Runs VideoFrameQueue the way VideoEncoder records renditions, against mock encoders with a fixed pool of frames
+// and a sink writer that keeps what was written.  The recording's encoder pops each frame, queues a scaled copy of it
+// for every rendition and then writes it, while each rendition's encoder writes its own queue.
+// Every frame a rendition writes must have the sample time and duration its recording wrote the same frame with,
+// whichever frames the recording or the rendition dropped.
+
+#include "CompositorTests.h"
+#include "VideoFrameQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    // Same sizes as VideoEncoder's.
+    const int queueCapacity = 16;
+    const int dropDepth = 5;
+    const int poolSize = 10;
+    const LONGLONG frameDuration = 333333;
+
+    // Stands in for VideoEncoder::FrameBuffer, index is the captured frame it holds, or was scaled from.
+    struct MockFrame
+    {
+        LONGLONG sampleTime = 0;
+        LONGLONG duration = 0;
+        int index = -1;
+    };
+
+    struct WrittenFrame
+    {
+        int index;
+        LONGLONG sampleTime;
+        LONGLONG duration;
+    };
+
+    class MockEncoder
+    {
+    public:
+        MockEncoder() : frames(poolSize)
+        {
+            for (MockFrame& frame : frames)
+            {
+                freeFrames.push_back(&frame);
+            }
+        }
+
+        // Like VideoEncoder::GetVideoFrameBuffer, a frame is dropped when every frame in the pool is in use.
+        MockFrame* GetFrame()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (freeFrames.empty())
+            {
+                numDropped++;
+                return nullptr;
+            }
+
+            MockFrame* frame = freeFrames.back();
+            freeFrames.pop_back();
+            return frame;
+        }
+
+        void ReleaseFrame(MockFrame* frame)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            freeFrames.push_back(frame);
+        }
+
+        // Producer.  Like VideoEncoder::QueueVideoFrame.
+        void QueueFrame(int index)
+        {
+            MockFrame* frame = GetFrame();
+            if (frame != nullptr)
+            {
+                frame->index = index;
+                CountPush(queue.Push(frame, frameDuration));
+            }
+        }
+
+        // Consumer.  Like VideoEncoder::EncodeFrames and WriteFrame.
+        void EncodeQueued()
+        {
+            MockFrame* frame = nullptr;
+            while (queue.Pop(frame, [this](MockFrame* dropped) { numDropped++; ReleaseFrame(dropped); }))
+            {
+                for (MockEncoder* rendition : renditions)
+                {
+                    MockFrame* scaled = rendition->GetFrame();
+                    if (scaled != nullptr)
+                    {
+                        scaled->index = frame->index;
+                        CountPush(rendition->queue.Push(scaled, *frame));
+                    }
+                }
+
+                written.push_back({ frame->index, frame->sampleTime, frame->duration });
+                ReleaseFrame(frame);
+            }
+        }
+
+        std::vector<MockEncoder*> renditions;
+        // Only used by the consumer until it has stopped.
+        std::vector<WrittenFrame> written;
+        std::atomic<int> numDropped{ 0 };
+        // VideoEncoder assumes a push cannot fail, since the queue can hold every frame in the pool.
+        std::atomic<int> numPushFailures{ 0 };
+
+    private:
+        void CountPush(bool queued)
+        {
+            numPushFailures += queued ? 0 : 1;
+        }
+
+        VideoFrameQueue<MockFrame, queueCapacity, dropDepth> queue;
+        std::vector<MockFrame> frames;
+        std::vector<MockFrame*> freeFrames;
+        std::mutex lock;
+    };
+
+    // Every frame the rendition wrote was written by the recording with the same times, in the same order.
+    bool IsAligned(const MockEncoder& recording, const MockEncoder& rendition)
+    {
+        bool passed = true;
+
+        std::unordered_map<int, const WrittenFrame*> recorded;
+        for (size_t i = 0; i < recording.written.size(); i++)
+        {
+            const WrittenFrame& frame = recording.written[i];
+            recorded[frame.index] = &frame;
+            CHECK(frame.duration == frameDuration);
+            // Frames are timed by how many were queued, so dropping one never moves the frames after it.
+            CHECK(i == 0 || frame.sampleTime > recording.written[i - 1].sampleTime);
+            CHECK(frame.sampleTime % frameDuration == 0);
+        }
+
+        int numMismatched = 0;
+        int lastIndex = -1;
+        for (const WrittenFrame& frame : rendition.written)
+        {
+            auto found = recorded.find(frame.index);
+            bool matches = found != recorded.end() && frame.index > lastIndex &&
+                found->second->sampleTime == frame.sampleTime && found->second->duration == frame.duration;
+            numMismatched += matches ? 0 : 1;
+            lastIndex = frame.index;
+        }
+        CHECK(numMismatched == 0);
+        CHECK(recording.numPushFailures == 0);
+        CHECK(rendition.numPushFailures == 0);
+
+        return passed;
+    }
+
+    bool InStep()
+    {
+        bool passed = true;
+
+        MockEncoder recording, small, smaller;
+        recording.renditions = { &small, &smaller };
+
+        for (int i = 0; i < 100; i++)
+        {
+            recording.QueueFrame(i);
+            recording.EncodeQueued();
+            small.EncodeQueued();
+            smaller.EncodeQueued();
+        }
+
+        CHECK(recording.numDropped == 0 && small.numDropped == 0 && smaller.numDropped == 0);
+        CHECK(recording.written.size() == 100);
+        CHECK(recording.written.back().sampleTime == 99 * frameDuration);
+        CHECK(small.written.size() == 100 && smaller.written.size() == 100);
+        CHECK(IsAligned(recording, small));
+        CHECK(IsAligned(recording, smaller));
+        return passed;
+    }
+
+    // The recording's encoder falls behind, so it drops the oldest frames.  The renditions never see them.
+    bool RecordingDropsOldest()
+    {
+        bool passed = true;
+
+        MockEncoder recording, small;
+        recording.renditions = { &small };
+
+        int index = 0;
+        for (int burst = 0; burst < 20; burst++)
+        {
+            for (int i = 0; i < dropDepth + 3; i++)
+            {
+                recording.QueueFrame(index++);
+            }
+            recording.EncodeQueued();
+            small.EncodeQueued();
+        }
+
+        // Each burst drops the 3 oldest frames and writes the newest dropDepth.
+        CHECK(recording.numDropped == 20 * 3);
+        CHECK(recording.written.size() == 20 * dropDepth);
+        CHECK(recording.written.front().index == 3);
+        CHECK(recording.written.front().sampleTime == 3 * frameDuration);
+        CHECK(recording.written.back().index == index - 1);
+        CHECK(recording.written.back().sampleTime == (index - 1) * frameDuration);
+        CHECK(small.numDropped == 0);
+        CHECK(small.written.size() == recording.written.size());
+        CHECK(IsAligned(recording, small));
+        return passed;
+    }
+
+    // One rendition's encoder falls behind and drops frames of its own, the other renditions and the recording are unaffected.
+    bool RenditionDropsOldest()
+    {
+        bool passed = true;
+
+        MockEncoder recording, slow, fast;
+        recording.renditions = { &slow, &fast };
+
+        for (int i = 0; i < 200; i++)
+        {
+            recording.QueueFrame(i);
+            recording.EncodeQueued();
+            fast.EncodeQueued();
+            if (i % 8 == 7)
+            {
+                slow.EncodeQueued();
+            }
+        }
+        slow.EncodeQueued();
+
+        CHECK(recording.numDropped == 0 && fast.numDropped == 0);
+        CHECK(slow.numDropped > 0);
+        CHECK(slow.written.size() + slow.numDropped == recording.written.size());
+        // Dropping the oldest frames leaves the newest, so the slow rendition still ends on the recording's last frame.
+        CHECK(slow.written.back().sampleTime == recording.written.back().sampleTime);
+        CHECK(IsAligned(recording, slow));
+        CHECK(IsAligned(recording, fast));
+        return passed;
+    }
+
+    // The render thread queues frames while the recording's and renditions' encoder threads write them at their own pace.
+    bool EncoderThreads()
+    {
+        bool passed = true;
+
+        const int numFrames = 600;
+        MockEncoder recording, small, slow;
+        recording.renditions = { &small, &slow };
+
+        std::atomic<bool> rendering{ true };
+        std::atomic<bool> recordingStopped{ false };
+
+        std::thread recordingThread([&]
+        {
+            while (rendering)
+            {
+                recording.EncodeQueued();
+                std::this_thread::yield();
+            }
+            recording.EncodeQueued();
+        });
+
+        auto renditionThread = [&](MockEncoder& rendition, bool isSlow)
+        {
+            return std::thread([&rendition, &recordingStopped, isSlow]
+            {
+                while (!recordingStopped)
+                {
+                    rendition.EncodeQueued();
+                    if (isSlow)
+                    {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                    }
+                    std::this_thread::yield();
+                }
+                rendition.EncodeQueued();
+            });
+        };
+        std::thread smallThread = renditionThread(small, false);
+        std::thread slowThread = renditionThread(slow, true);
+
+        for (int i = 0; i < numFrames; i++)
+        {
+            recording.QueueFrame(i);
+            if (i % 16 == 15)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        rendering = false;
+        recordingThread.join();
+        recordingStopped = true;
+        smallThread.join();
+        slowThread.join();
+
+        CHECK(recording.written.size() + recording.numDropped == numFrames);
+        CHECK(small.written.size() + small.numDropped == recording.written.size());
+        CHECK(slow.written.size() + slow.numDropped == recording.written.size());
+        CHECK(IsAligned(recording, small));
+        CHECK(IsAligned(recording, slow));
+
+        printf("    %i frames queued, recording dropped %i, renditions dropped %i and %i\n",
+            numFrames, recording.numDropped.load(), small.numDropped.load(), slow.numDropped.load());
+        return passed;
+    }
+}
+
+bool VideoFrameQueueTests()
+{
+    bool passed = true;
+    CHECK(InStep());
+    CHECK(RecordingDropsOldest());
+    CHECK(RenditionDropsOldest());
+    CHECK(EncoderThreads());
+    return passed;
+}
@@ -0,0 +1,101 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Unit tests and benchmarks for the compositor's CPU code, from a command prompt:
+//   CompositorTests                                    runs every test, the exit code is the number of tests that failed
+//   CompositorTests <test>                             runs one test
+//   CompositorTests benchmark <benchmark> [arguments]  runs a benchmark, see each benchmark's file for its arguments
+
+#include "CompositorTests.h"
+
+namespace
+{
+    struct Test
+    {
+        const wchar_t* name;
+        bool(*run)();
+    };
+
+    const Test tests[] =
+    {
+        { L"SpatialMappingEncoder", SpatialMappingEncoderTests },
+        { L"PoseDatagram", PoseDatagramTests },
+        { L"SPSCQueue", SPSCQueueTests },
+        { L"ColorConversion", ColorConversionTests },
+        { L"CapturedFrameRing", CapturedFrameRingTests },
+        { L"AudioRing", AudioRingTests },
+        { L"ReplayBuffer", ReplayBufferTests },
+        { L"VideoFrameQueue", VideoFrameQueueTests },
+    };
+
+    struct Benchmark
+    {
+        const wchar_t* name;
+        bool(*run)(const std::vector<std::wstring>& args);
+    };
+
+    const Benchmark benchmarks[] =
+    {
+        { L"spatialmapping", SpatialMappingBenchmark },
+        { L"serialize", SpatialMappingSerializeBenchmark },
+        { L"posereplay", PoseReplayBenchmark },
+        { L"colorconversion", ColorConversionBenchmark },
+    };
+
+    int Usage()
+    {
+        printf("Usage: CompositorTests [test]\n       CompositorTests benchmark <benchmark> [arguments]\n\nTests:\n");
+        for (const Test& test : tests)
+        {
+            printf("  %ls\n", test.name);
+        }
+
+        printf("\nBenchmarks:\n");
+        for (const Benchmark& benchmark : benchmarks)
+        {
+            printf("  %ls\n", benchmark.name);
+        }
+        return -1;
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    if (argc >= 2 && _wcsicmp(argv[1], L"benchmark") == 0)
+    {
+        for (const Benchmark& benchmark : benchmarks)
+        {
+            if (argc >= 3 && _wcsicmp(argv[2], benchmark.name) == 0)
+            {
+                return benchmark.run(std::vector<std::wstring>(argv + 3, argv + argc)) ? 0 : 1;
+            }
+        }
+        return Usage();
+    }
+
+    int numRun = 0;
+    int numFailed = 0;
+    for (const Test& test : tests)
+    {
+        if (argc >= 2 && _wcsicmp(argv[1], test.name) != 0)
+        {
+            continue;
+        }
+
+        printf("%ls\n", test.name);
+        Stopwatch stopwatch;
+        bool passed = test.run();
+        printf("  %s (%.0f ms)\n", passed ? "passed" : "FAILED", stopwatch.ElapsedMS());
+
+        numRun++;
+        numFailed += passed ? 0 : 1;
+    }
+
+    if (numRun == 0)
+    {
+        return Usage();
+    }
+
+    printf("\n%i of %i tests passed.\n", numRun - numFailed, numRun);
+    return numFailed;
+}
@@ -12,8 +12,12 @@
 #define USE_ELGATO              FALSE
 //TODO: Set this to true if using OpenCV to get frames from a camera or capture card.
 #define USE_OPENCV              FALSE
+//TODO: Set this to true to replay a capture file instead of capturing from hardware (see CaptureFileFrameProvider.h).
+#define USE_CAPTURE_FILE        FALSE
+//TODO: Set this to true to composite a generated test pattern instead of capturing from hardware (see SyntheticFrameProvider.h).
+#define USE_SYNTHETIC_FRAMES    FALSE
 
-static_assert((USE_ELGATO + USE_DECKLINK + USE_DECKLINK_SHUTTLE + USE_OPENCV == 1),
+static_assert((USE_ELGATO + USE_DECKLINK + USE_DECKLINK_SHUTTLE + USE_OPENCV + USE_CAPTURE_FILE + USE_SYNTHETIC_FRAMES == 1),
     "Exactly 1 FrameProvider must be set");
 
 // Frame Dimensions and buffer lengths
@@ -71,11 +75,40 @@ static_assert((USE_ELGATO + USE_DECKLINK + USE_DECKLINK_SHUTTLE + USE_OPENCV ==
 
 #define AUDIO_BUFSIZE (AUDIO_CHANNEL_SIZE * AUDIO_CHANNELS)
 
-// Polling rate for engine audio.
-// This is used to replace periods of no audio with empty audio (eg: engine has stopped, listeners have been disabled)
-#define AUDIO_POLLING_RATE_HNS ((LONGLONG)((((float)AUDIO_SAMPLE_RATE * (16.0f /*bits per sample*/ / 8.0f /*bits per byte*/)) / (float)AUDIO_BUFSIZE) * MS2HNS))
+// Engine audio is placed on a sample accurate timeline by when it arrives.
+// Audio that arrives this much later than expected has the gap filled with silence (eg: engine has stopped, listeners have been disabled),
+// audio that arrives this much earlier than expected is trimmed.  Smaller differences are treated as jitter.
+#define AUDIO_SPLICE_THRESHOLD_MS 100
+// Engine audio waiting to be encoded, in sample frames.  This must be a power of 2.
+#define AUDIO_RING_FRAMES 16384
 
 
 #define VIDEO_FPS 30
 
-#define MAX_NUM_CACHED_BUFFERS 20
\ No newline at end of file
+//TODO: Smaller copies of every recording, scaled from the same composite and saved alongside it as N_Video_<height>p.mp4.
+// Each is { width, height, bit rate }, with an even width and height no larger than the frame.  Every rendition costs an encoder
+// thread and a downscale of each frame, so leave this empty to record only the full size video.  For example:
+// #define VIDEO_RENDITIONS { { 1280, 720, 10 * 1000 * 1000 }, { 640, 360, 2 * 1000 * 1000 } }
+#define VIDEO_RENDITIONS { }
+
+#define MAX_NUM_CACHED_BUFFERS 20
+
+// Spatial Mapping
+//TODO: Set this to false to skip the entropy coding stage on spatial mapping meshes (trades bandwidth for HoloLens CPU).
+#define SPATIAL_MAPPING_ENTROPY_CODING TRUE
+//TODO: Set this to true to save every spatial mapping sync the compositor receives to the SpatialMapping folder in HologramCapture,
+// as a corpus for the spatial mapping benchmark in CompositorTests.
+#define SAVE_SPATIAL_MAPPING_SYNCS FALSE
+
+// Poses
+//TODO: Number of historical poses sampled per send and the spacing between them.
+// Poses are sent every POSE_SAMPLES_PER_SEND * POSE_SAMPLE_INTERVAL_MS, each send covering the time since the last one,
+// so the pose cache gets an evenly spaced timeline from fewer packets.
+// Set POSE_SAMPLES_PER_SEND to 1 and POSE_SAMPLE_INTERVAL_MS to 0 to send a single pose every frame.
+// These must match between SpectatorViewPoseProvider and UnityCompositorInterface.
+#define POSE_SAMPLES_PER_SEND   4
+#define POSE_SAMPLE_INTERVAL_MS 8
+//TODO: Set this to false to receive poses on the TCP stream instead of as datagrams (eg: if a firewall blocks DEFAULT_POSE_PORT).
+#define USE_DATAGRAM_POSES TRUE
+// How often pose datagram statistics are logged.
+#define POSE_DATAGRAM_STATS_INTERVAL_SECONDS    5
@@ -31,7 +31,8 @@ public:
         return srv;
     }
 
-    static void UpdateSRV(ID3D11Device* device, ID3D11ShaderResourceView* srv, const byte* bytes, int stride)
+    // numRows limits the update to the first rows of the texture, for sources smaller than the texture.
+    static void UpdateSRV(ID3D11Device* device, ID3D11ShaderResourceView* srv, const byte* bytes, int stride, int numRows = -1)
     {
         ID3D11Texture2D* tex = NULL;
         srv->GetResource((ID3D11Resource**)(&tex));
@@ -49,6 +50,20 @@ public:
             return;
         }
 
+        if (numRows >= 0)
+        {
+            D3D11_TEXTURE2D_DESC desc;
+            tex->GetDesc(&desc);
+
+            D3D11_BOX box = { 0, 0, 0, desc.Width, (UINT)numRows, 1 };
+            if ((UINT)numRows < desc.Height)
+            {
+                ctx->UpdateSubresource(tex, 0, &box, bytes, stride, 0);
+                ctx->Release();
+                return;
+            }
+        }
+
         ctx->UpdateSubresource(tex, 0, NULL, bytes, stride, 0);
         ctx->Release();
     }
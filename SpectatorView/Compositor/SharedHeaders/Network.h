@@ -20,6 +20,12 @@
 // This must match between SpectatorViewPoseProvider and UnityCompositorInterface.
 #define DEFAULT_PORT 9481
 
+// Port the compositor listens on for pose datagrams.
+#define DEFAULT_POSE_PORT 9482
+
+// Datagrams are not segmented, so this only needs to cover the largest datagram we send.
+#define DATAGRAM_BUFLEN 512
+
 class WSASession
 {
 public:
@@ -41,10 +47,9 @@ private:
     WSADATA wsaData;
 };
 
-//TODO: base class and UDP class.
-class TCPSocket
+class SocketBase
 {
-private:
+protected:
     // See here for explanation of error codes:
     // https://msdn.microsoft.com/en-us/library/windows/desktop/ms740668(v=vs.85).aspx
     void PrintSocketError(const wchar_t* function)
@@ -54,7 +59,10 @@ private:
         OutputDebugStringW(std::to_wstring(WSAGetLastError()).c_str());
         OutputDebugStringW(L"\n");
     }
+};
 
+class TCPSocket : public SocketBase
+{
 public:
     TCPSocket()
     {
@@ -250,6 +258,24 @@ public:
         return true;
     }
 
+    // Get the address of the connected peer.
+    bool GetPeerAddress(sockaddr_storage& address, int& addressLength)
+    {
+        if (connectSocket == INVALID_SOCKET)
+        {
+            return false;
+        }
+
+        addressLength = sizeof(sockaddr_storage);
+        if (getpeername(connectSocket, (sockaddr*)&address, &addressLength) == SOCKET_ERROR)
+        {
+            PrintSocketError(L"GetPeerName");
+            return false;
+        }
+
+        return true;
+    }
+
 private:
     // Socket to establish connection.
     SOCKET listenSocket;
@@ -259,3 +285,145 @@ private:
 
     char recvbuf[DEFAULT_BUFLEN];
 };
+
+// Connectionless socket for data where a late packet is worthless, like poses.
+// Datagrams may be dropped, duplicated or reordered, so callers must tolerate all three.
+class UDPSocket : public SocketBase
+{
+public:
+    UDPSocket()
+    {
+    }
+
+    ~UDPSocket()
+    {
+        Close();
+    }
+
+    // Receive datagrams sent to port on any local address.
+    bool Bind(int port)
+    {
+        Close();
+
+        udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (udpSocket == INVALID_SOCKET)
+        {
+            PrintSocketError(L"Create UDP Socket");
+            return false;
+        }
+
+        sockaddr_in address;
+        ZeroMemory(&address, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((u_short)port);
+
+        if (bind(udpSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR)
+        {
+            PrintSocketError(L"UDP Bind");
+            Close();
+            return false;
+        }
+
+        return true;
+    }
+
+    // Send future datagrams to port on the host at address.
+    bool SetDestination(const sockaddr_storage& address, int addressLength, int port)
+    {
+        if ((address.ss_family != AF_INET && address.ss_family != AF_INET6)
+            || addressLength > (int)sizeof(sockaddr_storage))
+        {
+            return false;
+        }
+
+        if (udpSocket == INVALID_SOCKET || destination.ss_family != address.ss_family)
+        {
+            Close();
+
+            udpSocket = socket(address.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+            if (udpSocket == INVALID_SOCKET)
+            {
+                PrintSocketError(L"Create UDP Socket");
+                return false;
+            }
+        }
+
+        memcpy(&destination, &address, addressLength);
+        destinationLength = addressLength;
+
+        if (address.ss_family == AF_INET)
+        {
+            ((sockaddr_in*)&destination)->sin_port = htons((u_short)port);
+        }
+        else
+        {
+            ((sockaddr_in6*)&destination)->sin6_port = htons((u_short)port);
+        }
+
+        return true;
+    }
+
+    bool SendData(const byte* bytes, int len)
+    {
+        if (udpSocket == INVALID_SOCKET || destinationLength == 0)
+        {
+            return false;
+        }
+
+        if (len > DATAGRAM_BUFLEN)
+        {
+            OutputDebugString(L"Error, datagram is too large.");
+            return false;
+        }
+
+        int iResult = sendto(udpSocket, (const char*)bytes, len, 0, (const sockaddr*)&destination, destinationLength);
+        if (iResult == SOCKET_ERROR)
+        {
+            PrintSocketError(L"SendTo");
+            return false;
+        }
+
+        return true;
+    }
+
+    // Blocks until a datagram arrives.
+    // Returns the number of bytes received, or -1 if the socket has failed.
+    int ReceiveData(byte* bytes, int capacity)
+    {
+        if (udpSocket == INVALID_SOCKET)
+        {
+            return -1;
+        }
+
+        int iResult = recvfrom(udpSocket, (char*)bytes, capacity, 0, NULL, NULL);
+        if (iResult == SOCKET_ERROR)
+        {
+            // A datagram larger than our buffer is not one of ours, so skip it.
+            if (WSAGetLastError() == WSAEMSGSIZE)
+            {
+                return 0;
+            }
+
+            PrintSocketError(L"RecvFrom");
+            return -1;
+        }
+
+        return iResult;
+    }
+
+    void Close()
+    {
+        if (udpSocket != INVALID_SOCKET)
+        {
+            closesocket(udpSocket);
+            udpSocket = INVALID_SOCKET;
+        }
+    }
+
+private:
+    SOCKET udpSocket = INVALID_SOCKET;
+
+    sockaddr_storage destination = {};
+    int destinationLength = 0;
+};
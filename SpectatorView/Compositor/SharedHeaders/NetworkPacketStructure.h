@@ -4,6 +4,7 @@
 #pragma once
 #include <windows.h>
 #include "Network.h"
+#include "CompositorConstants.h"
 
 #define IP_LENGTH 15
 #define ANCHOR_NAME_LENGTH 36
@@ -12,6 +13,7 @@ enum PacketType
 {
     Pose = 0,
     SpatialMapping = 1,
+    PoseBatch = 2,
 };
 
 struct SVPose
@@ -34,6 +36,27 @@ static_assert(sizeof(SVPose) <= DEFAULT_BUFLEN,
     "SVPose cannot exceed network buffer size limit.");
 
 
+// Number of poses in every pose datagram.
+// Each datagram carries the newest batch of samples and repeats the batch before it, so a lost datagram is covered by the next one.
+#define POSE_DATAGRAM_REDUNDANCY (2 * POSE_SAMPLES_PER_SEND)
+
+struct PoseDatagram
+{
+    int header = (int)PacketType::PoseBatch;
+
+    // Sequence number of poses[0].  poses[i] has sequence number (sequence - i).
+    unsigned int sequence;
+    int numPoses;
+    // Number of poses sampled for this datagram, the rest are repeated from the previous one.
+    int numNewPoses;
+
+    // Newest first.  Each pose's sentTime is the QPC time it was sampled at.
+    SVPose poses[POSE_DATAGRAM_REDUNDANCY];
+};
+static_assert(sizeof(PoseDatagram) <= DATAGRAM_BUFLEN,
+    "PoseDatagram cannot exceed datagram buffer size limit.");
+
+
 struct SpatialMappingPacket
 {
     int header = (int)PacketType::SpatialMapping;
@@ -68,6 +91,33 @@ struct ClientToServerPacket
 
     // Set to true to get spatial mapping information from SV HoloLens
     bool requestSpatialMapping;
+
+    // Set to true if the compositor is listening for PoseDatagrams on DEFAULT_POSE_PORT.
+    // Poses are then sent as datagrams instead of on the TCP stream, so they are never stuck behind spatial mapping data.
+    bool useDatagramPoses;
+
+    // Number of surfaces the compositor already holds.
+    // When requesting spatial mapping, this many SurfaceVersions follow in SurfaceVersionPackets
+    // so only added or updated surfaces are sent back.
+    int numKnownSurfaces;
 };
 static_assert(sizeof(ClientToServerPacket) <= DEFAULT_BUFLEN,
-    "ClientToServerPacket cannot exceed network buffer size limit.");
\ No newline at end of file
+    "ClientToServerPacket cannot exceed network buffer size limit.");
+
+
+struct SurfaceVersion
+{
+    GUID id;
+    // SpatialSurfaceInfo UpdateTime of the mesh the compositor holds.
+    LONGLONG updateTime;
+};
+
+#define SURFACE_VERSIONS_PER_PACKET 3
+
+struct SurfaceVersionPacket
+{
+    int numSurfaces;
+    SurfaceVersion surfaces[SURFACE_VERSIONS_PER_PACKET];
+};
+static_assert(sizeof(SurfaceVersionPacket) <= DEFAULT_BUFLEN,
+    "SurfaceVersionPacket cannot exceed network buffer size limit.");
\ No newline at end of file
@@ -0,0 +1,467 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+// Compact wire format for spatial mapping meshes.
+// A sync is a SpatialMappingSyncHeader, followed by the GUIDs of surfaces the compositor should remove,
+// followed by the added or updated meshes.
+// Each mesh is a SpatialMappingMeshHeader followed by a payload of:
+//  - numVertices * 3 int16 positions (HoloLens R16G16B16A16IntNormalized with w dropped).
+//    The per-mesh VertexPositionScale is folded into the header's scale, so positions are never expanded to float on the wire.
+//  - numIndices zigzag-coded deltas between consecutive triangle indices, stored as little-endian base 128 varints.
+// The payload can optionally be run through an XPRESS Huffman entropy stage.
+// A mesh the compositor already has, but whose transform changed, is sent as a header with SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY and no payload.
+
+#pragma once
+#include <Windows.h>
+#include <compressapi.h>
+#include <DirectXMath.h>
+#include <vector>
+
+// The SSE4.1 paths are compiled in on x86 and x64, and only run when the CPU supports them (see UseSSE41).
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <smmintrin.h>
+#define SPATIAL_MAPPING_USE_SSE 1
+#else
+#define SPATIAL_MAPPING_USE_SSE 0
+#endif
+
+#pragma comment(lib, "Cabinet") // for CreateCompressor/CreateDecompressor
+
+#define SPATIAL_MAPPING_FLAG_ENTROPY_CODED  0x1
+#define SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY 0x2
+
+// Maximum bytes a 16 bit zigzag delta can take as a varint.
+#define SPATIAL_MAPPING_MAX_VARINT_BYTES    3
+
+// 16 bit triangle indices cannot address more vertices than this.
+#define SPATIAL_MAPPING_MAX_VERTICES        65536
+// Far more indices than a surface mesh over SPATIAL_MAPPING_MAX_VERTICES vertices has,
+// and small enough that no byte length computed from a mesh's counts overflows an int.
+#define SPATIAL_MAPPING_MAX_INDICES         (1 << 20)
+
+#pragma pack(push, 1)
+struct SpatialMappingSyncHeader
+{
+    int numMeshes;
+    int numRemovedSurfaces;
+};
+
+struct SpatialMappingMeshHeader
+{
+    // Surface this mesh belongs to and the SpatialSurfaceInfo UpdateTime it was computed at.
+    GUID id;
+    LONGLONG updateTime;
+
+    // Number of bytes following this header that belong to this mesh.
+    int payloadByteLength;
+    // Number of payload bytes after the entropy stage has been undone.
+    int decodedByteLength;
+    // Number of bytes in the decoded payload used by the index stream.
+    int indexByteLength;
+
+    int numVertices;
+    int numIndices;
+    int flags;
+
+    // Mesh transform in Unity space.
+    DirectX::XMFLOAT3 translation;
+    DirectX::XMFLOAT4 rotation;
+    DirectX::XMFLOAT3 scale;
+};
+#pragma pack(pop)
+
+// State the encoder reuses from one mesh to the next: the entropy stage's buffer, and its compressor and decompressor,
+// which are created the first time a mesh needs them and closed when this is destroyed.
+// Keep one for a whole sync (or longer) instead of one per mesh.  Not thread safe, use one per thread.
+class SpatialMappingScratch
+{
+public:
+    SpatialMappingScratch() = default;
+    SpatialMappingScratch(const SpatialMappingScratch&) = delete;
+    SpatialMappingScratch& operator=(const SpatialMappingScratch&) = delete;
+
+    ~SpatialMappingScratch()
+    {
+        if (compressor != NULL)
+        {
+            CloseCompressor(compressor);
+        }
+
+        if (decompressor != NULL)
+        {
+            CloseDecompressor(decompressor);
+        }
+    }
+
+private:
+    friend class SpatialMappingEncoder;
+
+    std::vector<byte> buffer;
+    COMPRESSOR_HANDLE compressor = NULL;
+    DECOMPRESSOR_HANDLE decompressor = NULL;
+};
+
+class SpatialMappingEncoder
+{
+public:
+    static bool IsSSE41Supported()
+    {
+#if SPATIAL_MAPPING_USE_SSE
+        int info[4];
+        __cpuid(info, 1);
+        // SSE4.1 CPUs also have the SSSE3 shuffle used to pack positions.
+        return (info[2] & (1 << 19)) != 0;
+#else
+        return false;
+#endif
+    }
+
+    // Whether the SSE4.1 paths are used.  Starts out as IsSSE41Supported, tests clear it to check the scalar paths.
+    static bool& UseSSE41()
+    {
+        static bool useSSE41 = IsSSE41Supported();
+        return useSSE41;
+    }
+
+    // Whether a mesh of this size can be encoded.  Larger meshes are rejected by the decoder.
+    static bool CanEncode(int numVertices, int numIndices)
+    {
+        return numVertices >= 0 && numVertices <= SPATIAL_MAPPING_MAX_VERTICES
+            && numIndices >= 0 && numIndices <= SPATIAL_MAPPING_MAX_INDICES;
+    }
+
+    // Upper bound on the bytes Encode will write for a mesh of this size.
+    static int GetMaxEncodedSize(int numVertices, int numIndices)
+    {
+        return sizeof(SpatialMappingMeshHeader)
+            + GetPositionByteLength(numVertices)
+            + numIndices * SPATIAL_MAPPING_MAX_VARINT_BYTES;
+    }
+
+    // Size the same mesh took in the original float vertex / raw index format.
+    static int GetUnencodedSize(int numVertices, int numIndices)
+    {
+        return (2 * sizeof(int)) + (10 * sizeof(float))
+            + numVertices * 3 * sizeof(float)
+            + numIndices * sizeof(short);
+    }
+
+    // Encode a mesh into dst, which must hold at least GetMaxEncodedSize bytes.  The mesh size must pass CanEncode.
+    // The id, update time and transform are taken from header, the remaining fields are filled in here.
+    // positionStride is the distance between vertices in shorts.
+    // scratch is only used by the entropy stage, reuse it across meshes to avoid allocating.
+    // Returns the number of bytes written.
+    static int Encode(
+        SpatialMappingMeshHeader header,
+        const short* positions, int positionStride, int numVertices,
+        const unsigned short* indices, int numIndices,
+        bool entropyCode,
+        byte* dst,
+        SpatialMappingScratch& scratch)
+    {
+        header.numVertices = numVertices;
+        header.numIndices = numIndices;
+        header.flags = 0;
+
+        byte* payload = dst + sizeof(SpatialMappingMeshHeader);
+        int vertexByteLength = WritePositions(positions, positionStride, numVertices, payload);
+        header.indexByteLength = WriteIndices(indices, numIndices, payload + vertexByteLength);
+        header.decodedByteLength = vertexByteLength + header.indexByteLength;
+        header.payloadByteLength = header.decodedByteLength;
+
+        if (entropyCode)
+        {
+            if (scratch.buffer.size() < (size_t)header.decodedByteLength)
+            {
+                scratch.buffer.resize(header.decodedByteLength);
+            }
+
+            int compressedLength = Compress(scratch, payload, header.decodedByteLength, header.decodedByteLength);
+
+            // Only keep the entropy stage if it actually made the payload smaller.
+            if (compressedLength > 0 && compressedLength < header.decodedByteLength)
+            {
+                memcpy(payload, scratch.buffer.data(), compressedLength);
+                header.payloadByteLength = compressedLength;
+                header.flags |= SPATIAL_MAPPING_FLAG_ENTROPY_CODED;
+            }
+        }
+
+        memcpy(dst, &header, sizeof(SpatialMappingMeshHeader));
+        return sizeof(SpatialMappingMeshHeader) + header.payloadByteLength;
+    }
+
+    // Write a record that only moves a mesh the compositor already has to header's transform.  dst must hold a SpatialMappingMeshHeader.
+    // Returns the number of bytes written.
+    static int EncodeTransform(SpatialMappingMeshHeader header, byte* dst)
+    {
+        header.payloadByteLength = 0;
+        header.decodedByteLength = 0;
+        header.indexByteLength = 0;
+        header.numVertices = 0;
+        header.numIndices = 0;
+        header.flags = SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY;
+
+        memcpy(dst, &header, sizeof(SpatialMappingMeshHeader));
+        return sizeof(SpatialMappingMeshHeader);
+    }
+
+    static bool IsTransformOnly(const SpatialMappingMeshHeader& header)
+    {
+        return (header.flags & SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY) != 0;
+    }
+
+    // Read a mesh header from src.  Returns false if there are not enough bytes for the header and its payload,
+    // or if the header's counts and lengths are inconsistent (see IsValid).
+    static bool ReadHeader(const byte* src, int length, SpatialMappingMeshHeader& header)
+    {
+        if (length < (int)sizeof(SpatialMappingMeshHeader))
+        {
+            return false;
+        }
+
+        memcpy(&header, src, sizeof(SpatialMappingMeshHeader));
+        return IsValid(header, length - (int)sizeof(SpatialMappingMeshHeader));
+    }
+
+    // Whether a header received over the network describes a mesh Decode can safely read from a payload of availableByteLength bytes:
+    // the payload fits, the counts are within what can be encoded, and the decoded lengths match the counts.
+    // Every length is checked before it is used to size or read anything, so a truncated or malformed sync cannot read past its payload.
+    static bool IsValid(const SpatialMappingMeshHeader& header, int availableByteLength)
+    {
+        if (header.payloadByteLength < 0 || header.payloadByteLength > availableByteLength)
+        {
+            return false;
+        }
+
+        if (!CanEncode(header.numVertices, header.numIndices) || (header.flags & ~(SPATIAL_MAPPING_FLAG_ENTROPY_CODED | SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY)) != 0)
+        {
+            return false;
+        }
+
+        // A transform-only record carries nothing but the header.
+        if (IsTransformOnly(header))
+        {
+            return header.flags == SPATIAL_MAPPING_FLAG_TRANSFORM_ONLY && header.numVertices == 0 && header.numIndices == 0
+                && header.payloadByteLength == 0 && header.decodedByteLength == 0 && header.indexByteLength == 0;
+        }
+
+        // Every index takes at least 1 and at most SPATIAL_MAPPING_MAX_VARINT_BYTES bytes.
+        if (header.indexByteLength < header.numIndices || header.indexByteLength > header.numIndices * SPATIAL_MAPPING_MAX_VARINT_BYTES)
+        {
+            return false;
+        }
+
+        if (header.decodedByteLength != GetPositionByteLength(header.numVertices) + header.indexByteLength)
+        {
+            return false;
+        }
+
+        // Without the entropy stage, the payload is the decoded payload.
+        return (header.flags & SPATIAL_MAPPING_FLAG_ENTROPY_CODED) != 0
+            || header.payloadByteLength == header.decodedByteLength;
+    }
+
+    // Decode a mesh payload of header.payloadByteLength bytes directly into Unity's vertex and index arrays.
+    // vertices must hold numVertices * 3 floats and indices must hold numIndices shorts.
+    // Vertex z is negated to convert to Unity's coordinate system.
+    static bool Decode(const SpatialMappingMeshHeader& header, const byte* payload, float* vertices, short* indices, SpatialMappingScratch& scratch)
+    {
+        if (!IsValid(header, header.payloadByteLength))
+        {
+            return false;
+        }
+
+        const byte* decoded = payload;
+        if ((header.flags & SPATIAL_MAPPING_FLAG_ENTROPY_CODED) != 0)
+        {
+            if (scratch.buffer.size() < (size_t)header.decodedByteLength)
+            {
+                scratch.buffer.resize(header.decodedByteLength);
+            }
+
+            if (!Decompress(scratch, payload, header.payloadByteLength, header.decodedByteLength))
+            {
+                return false;
+            }
+            decoded = scratch.buffer.data();
+        }
+
+        int vertexByteLength = GetPositionByteLength(header.numVertices);
+        ReadPositions(decoded, header.numVertices, vertices);
+        return ReadIndices(decoded + vertexByteLength, header.indexByteLength, header.numIndices, header.numVertices, indices);
+    }
+
+private:
+    static int GetPositionByteLength(int numVertices)
+    {
+        return numVertices * 3 * sizeof(short);
+    }
+
+    static int WritePositions(const short* positions, int positionStride, int numVertices, byte* dst)
+    {
+        short* out = reinterpret_cast<short*>(dst);
+        int i = 0;
+
+#if SPATIAL_MAPPING_USE_SSE
+        if (positionStride == 4 && UseSSE41())
+        {
+            // Drop w from 4 vertices at a time.
+            const __m128i dropW = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+
+            // Each 16 byte store only advances 12 bytes, so always leave at least one vertex
+            // for the scalar loop to keep the overlapping tail write inside this mesh's payload.
+            for (; numVertices - i > 4; i += 4)
+            {
+                __m128i v01 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&positions[i * 4]));
+                __m128i v23 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&positions[i * 4 + 8]));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(v01, dropW));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 6), _mm_shuffle_epi8(v23, dropW));
+                out += 12;
+            }
+        }
+#endif
+
+        // Meshes are packed back to back in a sync, so the payload is not necessarily 2 byte aligned.
+        for (; i < numVertices; i++)
+        {
+            memcpy(out, &positions[i * positionStride], 3 * sizeof(short));
+            out += 3;
+        }
+
+        return GetPositionByteLength(numVertices);
+    }
+
+    static void ReadPositions(const byte* src, int numVertices, float* vertices)
+    {
+        const short* in = reinterpret_cast<const short*>(src);
+        int i = 0;
+
+#if SPATIAL_MAPPING_USE_SSE
+        if (UseSSE41())
+        {
+            // Convert 4 vertices (12 shorts) at a time, flipping the sign of every third float.
+            const __m128 flipZ0 = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0x80000000, 0));
+            const __m128 flipZ1 = _mm_castsi128_ps(_mm_setr_epi32(0, 0x80000000, 0, 0));
+            const __m128 flipZ2 = _mm_castsi128_ps(_mm_setr_epi32(0x80000000, 0, 0, 0x80000000));
+
+            for (; numVertices - i >= 4; i += 4)
+            {
+                __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                __m128i s1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 8));
+
+                __m128 f0 = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(s0));
+                __m128 f1 = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(_mm_srli_si128(s0, 8)));
+                __m128 f2 = _mm_cvtepi32_ps(_mm_cvtepi16_epi32(s1));
+
+                _mm_storeu_ps(vertices, _mm_xor_ps(f0, flipZ0));
+                _mm_storeu_ps(vertices + 4, _mm_xor_ps(f1, flipZ1));
+                _mm_storeu_ps(vertices + 8, _mm_xor_ps(f2, flipZ2));
+
+                in += 12;
+                vertices += 12;
+            }
+        }
+#endif
+
+        for (; i < numVertices; i++)
+        {
+            short vertex[3];
+            memcpy(vertex, in, sizeof(vertex));
+            vertices[0] = (float)vertex[0];
+            vertices[1] = (float)vertex[1];
+            vertices[2] = -(float)vertex[2];
+
+            in += 3;
+            vertices += 3;
+        }
+    }
+
+    // Triangle indices from neighboring triangles are close together, so most deltas fit in a single byte.
+    static int WriteIndices(const unsigned short* indices, int numIndices, byte* dst)
+    {
+        byte* out = dst;
+        int previous = 0;
+        for (int i = 0; i < numIndices; i++)
+        {
+            int delta = (int)indices[i] - previous;
+            previous = (int)indices[i];
+
+            unsigned int zigzag = ((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31);
+            while (zigzag >= 0x80)
+            {
+                *out++ = (byte)(zigzag | 0x80);
+                zigzag >>= 7;
+            }
+            *out++ = (byte)zigzag;
+        }
+
+        return (int)(out - dst);
+    }
+
+    // Fails if the indices do not exactly fill length bytes, or reference a vertex the mesh does not have.
+    static bool ReadIndices(const byte* src, int length, int numIndices, int numVertices, short* indices)
+    {
+        const byte* in = src;
+        const byte* end = src + length;
+        int previous = 0;
+        for (int i = 0; i < numIndices; i++)
+        {
+            unsigned int zigzag = 0;
+            int shift = 0;
+            do
+            {
+                if (in >= end || shift > 7 * (SPATIAL_MAPPING_MAX_VARINT_BYTES - 1))
+                {
+                    return false;
+                }
+
+                zigzag |= (unsigned int)(*in & 0x7F) << shift;
+                shift += 7;
+            } while ((*in++ & 0x80) != 0);
+
+            int delta = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+            previous += delta;
+            if (previous < 0 || previous >= numVertices)
+            {
+                return false;
+            }
+
+            indices[i] = (short)previous;
+        }
+
+        return in == end;
+    }
+
+    // Compresses src into scratch.buffer, which must hold at least capacity bytes.
+    static int Compress(SpatialMappingScratch& scratch, const byte* src, int length, int capacity)
+    {
+        if (scratch.compressor == NULL && !CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &scratch.compressor))
+        {
+            scratch.compressor = NULL;
+            return 0;
+        }
+
+        SIZE_T compressedLength = 0;
+        BOOL success = ::Compress(scratch.compressor, src, length, scratch.buffer.data(), capacity, &compressedLength);
+
+        return success ? (int)compressedLength : 0;
+    }
+
+    // Decompresses src into scratch.buffer, which must hold at least decodedLength bytes.
+    static bool Decompress(SpatialMappingScratch& scratch, const byte* src, int length, int decodedLength)
+    {
+        if (scratch.decompressor == NULL && !CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &scratch.decompressor))
+        {
+            scratch.decompressor = NULL;
+            return false;
+        }
+
+        SIZE_T decompressedLength = 0;
+        BOOL success = ::Decompress(scratch.decompressor, src, length, scratch.buffer.data(), decodedLength, &decompressedLength);
+
+        return success && decompressedLength == (SIZE_T)decodedLength;
+    }
+};
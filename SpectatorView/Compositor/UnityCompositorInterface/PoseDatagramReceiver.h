@@ -0,0 +1,280 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License. See LICENSE in the project root for license information.
+
+#pragma once
+#include "NetworkPacketStructure.h"
+#include "CompositorConstants.h"
+
+#include <bitset>
+#include <climits>
+#include <string>
+
+// Number of sequence numbers behind the newest pose that can still be accepted.
+#define POSE_SEQUENCE_WINDOW 64
+
+// A jump back further than this means the HoloLens app restarted its sequence.
+#define POSE_SEQUENCE_RESTART_THRESHOLD 1024
+
+// Loss and latency since the last LogStatistics, latencies in ms.
+struct PoseDatagramStatistics
+{
+    int numDatagrams;
+    int numDuplicateDatagrams;
+    int numRecoveredPoses;
+    int numLostPoses;
+    int numLatePoses;
+
+    // Clocks are not shared with the HoloLens, so latency is relative to the fastest pose seen.
+    // This is the time poses spent queued on top of the best case network delay.
+    double averageAddedLatency;
+    double maxAddedLatency;
+    // Longest time between two newest poses arriving.
+    double maxArrivalGap;
+};
+
+// Filters PoseDatagrams down to the poses that have not been delivered yet and tracks loss and latency.
+// Every datagram repeats the previous batch of poses, so a pose is only lost if two datagrams in a row are.
+class PoseDatagramReceiver
+{
+public:
+    PoseDatagramReceiver()
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        freq = frequency.QuadPart;
+
+        Reset();
+    }
+
+    void Reset()
+    {
+        hasSequence = false;
+        newestSequence = 0;
+        seenSequences = 0;
+
+        ResetStatistics();
+        minLatency = LLONG_MAX;
+        lastNewestArrivalTime = 0;
+    }
+
+    // Copy the poses in datagram that have not been seen before into poses, oldest first.
+    // poses must hold POSE_DATAGRAM_REDUNDANCY poses.  Returns the number of poses copied.
+    int Process(const PoseDatagram& datagram, SVPose* poses)
+    {
+        LONGLONG arrivalTime = GetTime();
+        numDatagrams++;
+
+        int numPoses = datagram.numPoses;
+        if (numPoses > POSE_DATAGRAM_REDUNDANCY)
+        {
+            numPoses = POSE_DATAGRAM_REDUNDANCY;
+        }
+
+        int numAccepted = 0;
+        for (int i = numPoses - 1; i >= 0; i--)
+        {
+            unsigned int sequence = datagram.sequence - (unsigned int)i;
+
+            bool newest = false;
+            if (!Accept(sequence, newest))
+            {
+                continue;
+            }
+
+            poses[numAccepted++] = datagram.poses[i];
+
+            if (i >= datagram.numNewPoses)
+            {
+                numRecoveredPoses++;
+            }
+
+            if (newest)
+            {
+                RecordArrival(datagram.poses[i], arrivalTime);
+            }
+        }
+
+        if (numAccepted == 0)
+        {
+            numDuplicateDatagrams++;
+        }
+
+        return numAccepted;
+    }
+
+    PoseDatagramStatistics GetStatistics()
+    {
+        PoseDatagramStatistics statistics;
+        statistics.numDatagrams = numDatagrams;
+        statistics.numDuplicateDatagrams = numDuplicateDatagrams;
+        statistics.numRecoveredPoses = numRecoveredPoses;
+        statistics.numLostPoses = numLostPoses;
+        statistics.numLatePoses = numLatePoses;
+        statistics.averageAddedLatency = numLatencySamples > 0 ? HNSToMS(totalLatency / numLatencySamples - minLatency) : 0;
+        statistics.maxAddedLatency = numLatencySamples > 0 ? HNSToMS(maxLatency - minLatency) : 0;
+        statistics.maxArrivalGap = HNSToMS(maxArrivalGap);
+        return statistics;
+    }
+
+    // Log loss and latency since the last call, then start counting again.
+    void LogStatistics()
+    {
+        PoseDatagramStatistics statistics = GetStatistics();
+
+        OutputDebugString(L"Pose datagrams received: ");
+        OutputDebugString(std::to_wstring(statistics.numDatagrams).c_str());
+        OutputDebugString(L", duplicates discarded: ");
+        OutputDebugString(std::to_wstring(statistics.numDuplicateDatagrams).c_str());
+        OutputDebugString(L", poses recovered from redundancy: ");
+        OutputDebugString(std::to_wstring(statistics.numRecoveredPoses).c_str());
+        OutputDebugString(L", poses lost: ");
+        OutputDebugString(std::to_wstring(statistics.numLostPoses).c_str());
+        OutputDebugString(L", arrived too late: ");
+        OutputDebugString(std::to_wstring(statistics.numLatePoses).c_str());
+
+        if (numLatencySamples > 0)
+        {
+            OutputDebugString(L", added latency avg: ");
+            OutputDebugString(std::to_wstring(statistics.averageAddedLatency).c_str());
+            OutputDebugString(L" ms, max: ");
+            OutputDebugString(std::to_wstring(statistics.maxAddedLatency).c_str());
+            OutputDebugString(L" ms");
+        }
+
+        OutputDebugString(L", longest gap between poses: ");
+        OutputDebugString(std::to_wstring(statistics.maxArrivalGap).c_str());
+        OutputDebugString(L" ms\n");
+
+        ResetStatistics();
+    }
+
+private:
+    LONGLONG freq;
+
+    bool hasSequence;
+    unsigned int newestSequence;
+    // Bit n is set if (newestSequence - n) has been delivered.
+    unsigned long long seenSequences;
+
+    // Statistics
+    int numDatagrams;
+    int numDuplicateDatagrams;
+    int numRecoveredPoses;
+    int numLostPoses;
+    int numLatePoses;
+
+    int numLatencySamples;
+    LONGLONG totalLatency;
+    LONGLONG maxLatency;
+    // Kept across intervals since it is our estimate of the clock offset.
+    LONGLONG minLatency;
+
+    LONGLONG lastNewestArrivalTime;
+    LONGLONG maxArrivalGap;
+
+    void ResetStatistics()
+    {
+        numDatagrams = 0;
+        numDuplicateDatagrams = 0;
+        numRecoveredPoses = 0;
+        numLostPoses = 0;
+        numLatePoses = 0;
+
+        numLatencySamples = 0;
+        totalLatency = 0;
+        maxLatency = 0;
+
+        maxArrivalGap = 0;
+    }
+
+    // Returns true if sequence has not been delivered yet.
+    // newest is set if sequence is now the newest sequence number seen.
+    bool Accept(unsigned int sequence, bool& newest)
+    {
+        newest = false;
+        int delta = (int)(sequence - newestSequence);
+
+        if (!hasSequence || delta < -POSE_SEQUENCE_RESTART_THRESHOLD)
+        {
+            // Treat everything before the first pose as seen so it is not counted as lost.
+            // The HoloLens clock may have changed too, so start a new offset estimate.
+            hasSequence = true;
+            minLatency = LLONG_MAX;
+            newestSequence = sequence;
+            seenSequences = ~0ULL;
+            newest = true;
+            return true;
+        }
+
+        if (delta > 0)
+        {
+            // Any sequence that slides out of the window without being seen is lost.
+            if (delta >= POSE_SEQUENCE_WINDOW)
+            {
+                numLostPoses += (POSE_SEQUENCE_WINDOW - (int)std::bitset<64>(seenSequences).count()) + (delta - POSE_SEQUENCE_WINDOW);
+                seenSequences = 0;
+            }
+            else
+            {
+                unsigned long long dropped = seenSequences >> (POSE_SEQUENCE_WINDOW - delta);
+                numLostPoses += delta - (int)std::bitset<64>(dropped).count();
+                seenSequences <<= delta;
+            }
+
+            seenSequences |= 1;
+            newestSequence = sequence;
+            newest = true;
+            return true;
+        }
+
+        int age = -delta;
+        if (age >= POSE_SEQUENCE_WINDOW)
+        {
+            numLatePoses++;
+            return false;
+        }
+
+        unsigned long long bit = 1ULL << age;
+        if ((seenSequences & bit) != 0)
+        {
+            return false;
+        }
+
+        seenSequences |= bit;
+        return true;
+    }
+
+    void RecordArrival(const SVPose& pose, LONGLONG arrivalTime)
+    {
+        LONGLONG latency = arrivalTime - pose.sentTime;
+        if (latency < minLatency)
+        {
+            minLatency = latency;
+        }
+        if (latency > maxLatency || numLatencySamples == 0)
+        {
+            maxLatency = latency;
+        }
+        totalLatency += latency;
+        numLatencySamples++;
+
+        if (lastNewestArrivalTime != 0 && arrivalTime - lastNewestArrivalTime > maxArrivalGap)
+        {
+            maxArrivalGap = arrivalTime - lastNewestArrivalTime;
+        }
+        lastNewestArrivalTime = arrivalTime;
+    }
+
+    // Current QPC time in the same units as SVPose::sentTime.
+    LONGLONG GetTime()
+    {
+        LARGE_INTEGER qpc;
+        QueryPerformanceCounter(&qpc);
+        return (qpc.QuadPart * S2HNS) / freq;
+    }
+
+    double HNSToMS(LONGLONG hns)
+    {
+        return (double)hns / (double)MS2HNS;
+    }
+};
@@ -130,48 +130,139 @@ void RealtimeSurfaceMeshRenderer::ClearSurfaces()
     m_meshCollection.clear();
 }
 
-byte* RealtimeSurfaceMeshRenderer::SerializeMeshes(int& length, Windows::Perception::Spatial::SpatialCoordinateSystem^ cs)
+const byte* RealtimeSurfaceMeshRenderer::SerializeMeshes(int& length, Windows::Perception::Spatial::SpatialCoordinateSystem^ cs, const std::vector<SurfaceVersion>& knownSurfaces)
 {
     std::lock_guard<std::mutex> guard(m_meshCollectionLock);
     length = 0;
 
-    std::vector<byte*> meshBytes;
-    std::vector<int> meshLengths;
+    LARGE_INTEGER freq, start, end;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+
+    // Surfaces the compositor holds that are gone or no longer observed.
+    m_removedSurfaces.clear();
+    for (auto const& known : knownSurfaces)
+    {
+        auto meshIter = m_meshCollection.find(Platform::Guid(known.id));
+        if (meshIter == m_meshCollection.end() || !meshIter->second.GetIsActive())
+        {
+            m_removedSurfaces.push_back(known.id);
+        }
+    }
+
+    // Sort the compositor's surfaces by id, so each mesh below finds its known version with a binary search.
+    m_knownSurfaces.assign(knownSurfaces.begin(), knownSurfaces.end());
+    std::sort(m_knownSurfaces.begin(), m_knownSurfaces.end(), [](const SurfaceVersion& a, const SurfaceVersion& b)
+    {
+        return memcmp(&a.id, &b.id, sizeof(GUID)) < 0;
+    });
+
+    // First pass: find the meshes to send and size the buffer for all of them.
+    m_meshesToSerialize.clear();
+    m_meshesToMove.clear();
+    int removedLength = (int)m_removedSurfaces.size() * sizeof(GUID);
+    int maxLength = sizeof(SpatialMappingSyncHeader) + removedLength;
+    int numUnchangedMeshes = 0;
 
     for (auto& pair : m_meshCollection)
     {
-        Platform::Guid id = pair.first;
+        GUID id = pair.first;
         SurfaceMesh& surfaceMesh = pair.second;
 
-        int meshLength;
-        byte* bytes = surfaceMesh.Serialize(meshLength, cs);
-
-        if (bytes != nullptr && meshLength > 0)
+        // Meshes the compositor already has at this version are only sent again as a transform, and only if it moved.
+        // The transform is relative to cs, so it changes without the mesh updating, eg: when the tracker re-localizes
+        // or the caller switches between the anchor and the reference frame.
+        auto knownIter = std::lower_bound(m_knownSurfaces.begin(), m_knownSurfaces.end(), id, [](const SurfaceVersion& known, const GUID& id)
         {
-            length += meshLength;
+            return memcmp(&known.id, &id, sizeof(GUID)) < 0;
+        });
+        if (knownIter != m_knownSurfaces.end() && knownIter->id == id && knownIter->updateTime == surfaceMesh.GetSurfaceUpdateTime())
+        {
+            if (surfaceMesh.HasTransformChanged(cs))
+            {
+                maxLength += sizeof(SpatialMappingMeshHeader);
+                m_meshesToMove.push_back(&surfaceMesh);
+            }
+            else
+            {
+                numUnchangedMeshes++;
+            }
+            continue;
+        }
 
-            meshBytes.push_back(bytes);
-            meshLengths.push_back(meshLength);
+        int meshLength = surfaceMesh.GetMaxSerializedSize();
+        if (meshLength > 0)
+        {
+            maxLength += meshLength;
+            m_meshesToSerialize.push_back(&surfaceMesh);
         }
     }
 
-    if (length == 0)
+    // The send buffer is reused across requests and only grows.
+    if (m_serializeBuffer.size() < (size_t)maxLength)
     {
-        return nullptr;
+        OutputDebugString(L"Growing spatial mapping buffer to ");
+        OutputDebugString(std::to_wstring(maxLength).c_str());
+        OutputDebugString(L" bytes.\n");
+
+        m_serializeBuffer.resize(maxLength);
     }
 
-    byte* allMeshBytes = new byte[length];
+    // Second pass: encode every mesh directly into the send buffer.
+    byte* buffer = m_serializeBuffer.data();
+    int dst = sizeof(SpatialMappingSyncHeader);
 
-    int dst = 0;
-    for (unsigned int i = 0; i < meshBytes.size(); i++)
+    if (removedLength > 0)
     {
-        int size = meshLengths[i];
-        memcpy(&allMeshBytes[dst], meshBytes[i], size);
-        delete[] meshBytes[i];
-        dst += size;
+        memcpy(&buffer[dst], m_removedSurfaces.data(), removedLength);
+        dst += removedLength;
+    }
+
+    SpatialMappingSyncHeader syncHeader;
+    syncHeader.numMeshes = 0;
+    syncHeader.numRemovedSurfaces = (int)m_removedSurfaces.size();
+
+    for (SurfaceMesh* surfaceMesh : m_meshesToSerialize)
+    {
+        int meshLength = surfaceMesh->Serialize(&buffer[dst], maxLength - dst, cs, m_encodeScratch);
+        if (meshLength > 0)
+        {
+            dst += meshLength;
+            syncHeader.numMeshes++;
+        }
+    }
+
+    int numMovedMeshes = 0;
+    for (SurfaceMesh* surfaceMesh : m_meshesToMove)
+    {
+        int meshLength = surfaceMesh->SerializeTransform(&buffer[dst], maxLength - dst, cs);
+        if (meshLength > 0)
+        {
+            dst += meshLength;
+            syncHeader.numMeshes++;
+            numMovedMeshes++;
+        }
     }
 
-    return allMeshBytes;
+    // Always send the sync header, even when nothing changed, so the compositor knows the refresh finished.
+    memcpy(&buffer[0], &syncHeader, sizeof(SpatialMappingSyncHeader));
+    length = dst;
+
+    QueryPerformanceCounter(&end);
+
+    OutputDebugString(L"Spatial mapping sync: ");
+    OutputDebugString(std::to_wstring(syncHeader.numMeshes - numMovedMeshes).c_str());
+    OutputDebugString(L" added or updated, ");
+    OutputDebugString(std::to_wstring(numMovedMeshes).c_str());
+    OutputDebugString(L" moved, ");
+    OutputDebugString(std::to_wstring(syncHeader.numRemovedSurfaces).c_str());
+    OutputDebugString(L" removed, ");
+    OutputDebugString(std::to_wstring(numUnchangedMeshes).c_str());
+    OutputDebugString(L" unchanged, serialized in ");
+    OutputDebugString(std::to_wstring((double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)freq.QuadPart).c_str());
+    OutputDebugString(L" ms.\n");
+
+    return buffer;
 }
 
 void RealtimeSurfaceMeshRenderer::HideInactiveMeshes(IMapView<Guid, SpatialSurfaceInfo^>^ const& surfaceCollection)
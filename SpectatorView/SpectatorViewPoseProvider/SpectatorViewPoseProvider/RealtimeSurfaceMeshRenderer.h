@@ -15,7 +15,10 @@
 #include "Common\StepTimer.h"
 #include "SurfaceMesh.h"
 #include "Content\ShaderStructures.h"
+#include "NetworkPacketStructure.h"
+#include "SpatialMappingEncoder.h"
 
+#include <algorithm>
 #include <memory>
 #include <map>
 #include <ppltasks.h>
@@ -37,7 +40,9 @@ public:
     void UpdateSurface(Platform::Guid id, Windows::Perception::Spatial::Surfaces::SpatialSurfaceInfo^ newSurface);
     void RemoveSurface(Platform::Guid id);
     void ClearSurfaces();
-    byte* SerializeMeshes(int& length, Windows::Perception::Spatial::SpatialCoordinateSystem^ cs);
+    // Serialize meshes that are new or newer than the compositor's copy, the transforms of its other meshes that moved, plus the surfaces it should remove.
+    // The returned buffer is owned by the renderer and stays valid until the next call.
+    const byte* SerializeMeshes(int& length, Windows::Perception::Spatial::SpatialCoordinateSystem^ cs, const std::vector<SurfaceVersion>& knownSurfaces);
 
     Windows::Foundation::DateTime GetLastUpdateTime(Platform::Guid id);
 
@@ -64,6 +69,14 @@ private:
     // A way to lock map access.
     std::mutex                                      m_meshCollectionLock;
 
+    // Reused across SerializeMeshes calls so a sync does not allocate once the buffers have grown.
+    std::vector<byte>                               m_serializeBuffer;
+    SpatialMappingScratch                           m_encodeScratch;
+    std::vector<SurfaceMesh*>                       m_meshesToSerialize;
+    std::vector<SurfaceMesh*>                       m_meshesToMove;
+    std::vector<GUID>                               m_removedSurfaces;
+    std::vector<SurfaceVersion>                     m_knownSurfaces;
+
     // Total number of surface meshes.
     unsigned int                                    m_surfaceMeshCount;
 
@@ -66,7 +66,7 @@ void SpatialMappingManager::StartSurfaceObserver()
     isSpatialMappingActive = true;
 }
 
-byte* SpatialMappingManager::GetMeshData(int& length, SpatialCoordinateSystem^ cs)
+const byte* SpatialMappingManager::GetMeshData(int& length, SpatialCoordinateSystem^ cs, const std::vector<SurfaceVersion>& knownSurfaces)
 {
     std::lock_guard<std::mutex> lock(m_resetMutex);
     if (m_meshRenderer == nullptr)
@@ -74,7 +74,7 @@ byte* SpatialMappingManager::GetMeshData(int& length, SpatialCoordinateSystem^ c
         return nullptr;
     }
 
-    return m_meshRenderer->SerializeMeshes(length, cs);
+    return m_meshRenderer->SerializeMeshes(length, cs, knownSurfaces);
 }
 
 void SpatialMappingManager::OnSurfacesChanged(
@@ -68,7 +68,7 @@ public:
     void CreateDeviceDependentResources();
     void ReleaseDeviceDependentResources();
 
-    byte* GetMeshData(int& length, SpatialCoordinateSystem^ cs);
+    const byte* GetMeshData(int& length, SpatialCoordinateSystem^ cs, const std::vector<SurfaceVersion>& knownSurfaces);
 
     void StartSurfaceObserver();
 };
@@ -152,17 +152,19 @@ void SpectatorViewPoseProviderMain::ConnectToAnchorOwner()
 void SpectatorViewPoseProviderMain::SendSpatialMappingData()
 {
     // Get spatial mapping data relative to coordinate system.
-    int length;
-    byte* bytes = nullptr;
+    // Only surfaces the compositor does not already have at their latest version are sent.
+    int length = 0;
+    const byte* bytes = nullptr;
+    std::vector<SurfaceVersion> knownSurfaces = SVSocket.GetKnownSurfaces();
     SpatialCoordinateSystem^ anchorCoordSystem = anchorImporter.GetSharedAnchorCoordinateSystem();
     if (anchorCoordSystem != nullptr &&
         anchorCoordSystem->TryGetTransformTo(m_referenceFrame->CoordinateSystem) != nullptr)
     {
-        bytes = m_spatialMappingManager.GetMeshData(length, anchorCoordSystem);
+        bytes = m_spatialMappingManager.GetMeshData(length, anchorCoordSystem, knownSurfaces);
     }
     else
     {
-        bytes = m_spatialMappingManager.GetMeshData(length, m_referenceFrame->CoordinateSystem);
+        bytes = m_spatialMappingManager.GetMeshData(length, m_referenceFrame->CoordinateSystem, knownSurfaces);
     }
 
     if (length == 0 || bytes == nullptr)
@@ -176,7 +178,6 @@ void SpectatorViewPoseProviderMain::SendSpatialMappingData()
 
     // Send serialized data to compositor.
     SVSocket.SendSpatialMapping(bytes, length);
-    delete[] bytes;
 }
 
 // Updates the application state once per frame.
@@ -13,6 +13,10 @@ SpectatorViewSocket::SpectatorViewSocket()
     QueryPerformanceFrequency(&frequency);
     freq = frequency.QuadPart;
 
+    poseDatagram.sequence = 0;
+    poseDatagram.numPoses = 0;
+    poseDatagram.numNewPoses = 0;
+
     create_task([&]
     {
         // Loop to accept future connections.
@@ -24,6 +28,8 @@ SpectatorViewSocket::SpectatorViewSocket()
             tcp.ServerEstablishConnection();
             OutputDebugString(L"Connection Created!\n");
 
+            // Send poses on the TCP stream until this compositor asks for datagrams.
+            sendDatagramPoses = false;
             connectionEstablished = true;
         }
     });
@@ -74,8 +80,16 @@ bool SpectatorViewSocket::Listen()
                     ConnectToAnchorOwner = true;
                 }
 
+                SetDatagramPoses(packet.useDatagramPoses);
+
                 if (packet.requestSpatialMapping)
                 {
+                    if (!ReceiveKnownSurfaces(packet.numKnownSurfaces))
+                    {
+                        connectionEstablished = false;
+                        return false;
+                    }
+
                     OutputDebugString(L"Sending Spatial Mapping Information.\n");
                     SendSpatialMappingData = true;
                 }
@@ -93,14 +107,58 @@ bool SpectatorViewSocket::Listen()
     return false;
 }
 
-void SpectatorViewSocket::GetPose(SpatialCoordinateSystem^ cs, int nsPast)
+bool SpectatorViewSocket::ReceiveKnownSurfaces(int numKnownSurfaces)
+{
+    std::vector<SurfaceVersion> surfaces;
+    surfaces.reserve(max(numKnownSurfaces, 0));
+
+    while ((int)surfaces.size() < numKnownSurfaces)
+    {
+        int recvLen = sizeof(SurfaceVersionPacket);
+        if (!tcp.ReceiveData(recvbuf, recvLen))
+        {
+            return false;
+        }
+
+        memcpy(&surfaceVersionPacket, recvbuf, recvLen);
+        if (surfaceVersionPacket.numSurfaces <= 0)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < surfaceVersionPacket.numSurfaces && i < SURFACE_VERSIONS_PER_PACKET; i++)
+        {
+            surfaces.push_back(surfaceVersionPacket.surfaces[i]);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(knownSurfacesLock);
+    knownSurfaces = surfaces;
+    return true;
+}
+
+std::vector<SurfaceVersion> SpectatorViewSocket::GetKnownSurfaces()
+{
+    std::lock_guard<std::mutex> lock(knownSurfacesLock);
+    return knownSurfaces;
+}
+
+LONGLONG SpectatorViewSocket::GetTime()
+{
+    LARGE_INTEGER qpc;
+    QueryPerformanceCounter(&qpc);
+
+    return (qpc.QuadPart * S2HNS) / freq;
+}
+
+bool SpectatorViewSocket::GetPose(SpatialCoordinateSystem^ cs, int nsPast)
 {
     try
     {
         // Cannot find position if we do not have a coordinate system.
         if (cs == nullptr)
         {
-            return;
+            return false;
         }
 
         // Find the locator if we have not cached one.
@@ -110,12 +168,13 @@ void SpectatorViewSocket::GetPose(SpatialCoordinateSystem^ cs, int nsPast)
 
             if (locator == nullptr)
             {
-                return;
+                return false;
             }
         }
 
         // Create a perception timestamp at our offset time.
         calendar->SetToNow();
+        LONGLONG now = GetTime();
         if (nsPast > 0)
         {
             nsPast *= -1;
@@ -131,20 +190,18 @@ void SpectatorViewSocket::GetPose(SpatialCoordinateSystem^ cs, int nsPast)
         PerceptionTimestamp^ perceptionTimestamp = PerceptionTimestampHelper::FromHistoricalTargetTime(calendar->GetDateTime());
         if (perceptionTimestamp == nullptr)
         {
-            return;
+            return false;
         }
 
         SpatialLocation^ headPose = nullptr;
         headPose = locator->TryLocateAtTimestamp(perceptionTimestamp, cs);
         if (headPose == nullptr)
         {
-            return;
+            return false;
         }
 
-        LARGE_INTEGER qpc;
-        QueryPerformanceCounter(&qpc);
-
-        currentPose.sentTime = (qpc.QuadPart * S2HNS) / freq;
+        // Stamp the pose with the time it was located at, so the compositor can place historical poses on its timeline.
+        currentPose.sentTime = now + (nsPast / HNS2NS);
 
         // Convert position and rotation to Unity space.
         Windows::Foundation::Numerics::quaternion rot = headPose->Orientation;
@@ -157,8 +214,69 @@ void SpectatorViewSocket::GetPose(SpatialCoordinateSystem^ cs, int nsPast)
         currentPose.posX = pos.x;
         currentPose.posY = pos.y;
         currentPose.posZ = -pos.z;
+
+        return true;
     }
     catch (...) { }
+
+    return false;
+}
+
+void SpectatorViewSocket::SetDatagramPoses(bool useDatagramPoses)
+{
+    if (useDatagramPoses == sendDatagramPoses)
+    {
+        return;
+    }
+
+    if (useDatagramPoses)
+    {
+        // The compositor listens for datagrams on the same host it connected to us from.
+        sockaddr_storage address;
+        int addressLength;
+        if (!tcp.GetPeerAddress(address, addressLength)
+            || !udp.SetDestination(address, addressLength, DEFAULT_POSE_PORT))
+        {
+            OutputDebugString(L"Could not find compositor for pose datagrams, sending poses over TCP.\n");
+            return;
+        }
+
+        OutputDebugString(L"Sending poses as datagrams.\n");
+    }
+    else
+    {
+        OutputDebugString(L"Sending poses over TCP.\n");
+    }
+
+    sendDatagramPoses = useDatagramPoses;
+}
+
+void SpectatorViewSocket::SendPoseDatagram(const SVPose* poses, int numPoses)
+{
+    // Shift the previous batch back so every datagram also carries the poses a lost datagram would have.
+    int numRepeated = poseDatagram.numPoses;
+    if (numRepeated > POSE_DATAGRAM_REDUNDANCY - numPoses)
+    {
+        numRepeated = POSE_DATAGRAM_REDUNDANCY - numPoses;
+    }
+
+    memmove(&poseDatagram.poses[numPoses], &poseDatagram.poses[0], numRepeated * sizeof(SVPose));
+
+    // Datagram poses are newest first.
+    for (int i = 0; i < numPoses; i++)
+    {
+        poseDatagram.poses[i] = poses[numPoses - 1 - i];
+    }
+
+    poseDatagram.sequence += numPoses;
+    poseDatagram.numPoses = numRepeated + numPoses;
+    poseDatagram.numNewPoses = numPoses;
+
+    if (!udp.SendData((byte*)&poseDatagram, sizeof(poseDatagram)))
+    {
+        OutputDebugString(L"Pose datagram failed, sending poses over TCP.\n");
+        sendDatagramPoses = false;
+    }
 }
 
 void SpectatorViewSocket::SendPose(SpatialCoordinateSystem^ cs)
@@ -167,17 +285,60 @@ void SpectatorViewSocket::SendPose(SpatialCoordinateSystem^ cs)
     {
         if (connectionEstablished)
         {
-            GetPose(cs, 0);
-            if (!tcp.SendData((byte*)&currentPose, sizeof(currentPose)))
+            LONGLONG now = GetTime();
+            LONGLONG elapsed = now - lastSampleTime;
+
+            const LONGLONG sampleInterval = POSE_SAMPLE_INTERVAL_MS * MS2HNS;
+            if (elapsed < POSE_SAMPLES_PER_SEND * sampleInterval)
             {
-                connectionEstablished = false;
+                return;
+            }
+
+            // Spread this batch evenly back to the newest pose we already sent, so the compositor's timeline has no holes.
+            // After a stall (or for the first send), only cover the usual send period.
+            LONGLONG spacing = elapsed / POSE_SAMPLES_PER_SEND;
+            if (lastSampleTime == 0 || spacing > 2 * sampleInterval)
+            {
+                spacing = sampleInterval;
+            }
+
+            // Sample oldest first, ending at the current pose.
+            int numPoses = 0;
+            for (int i = POSE_SAMPLES_PER_SEND - 1; i >= 0; i--)
+            {
+                if (GetPose(cs, (int)(i * spacing * HNS2NS)))
+                {
+                    sampledPoses[numPoses++] = currentPose;
+                }
+            }
+
+            lastSampleTime = now;
+            if (numPoses == 0)
+            {
+                return;
+            }
+
+            if (sendDatagramPoses)
+            {
+                SendPoseDatagram(sampledPoses, numPoses);
+                return;
+            }
+
+            // Poses do not fit in a single TCP packet, so send them one at a time.
+            for (int i = 0; i < numPoses; i++)
+            {
+                if (!tcp.SendData((byte*)&sampledPoses[i], sizeof(SVPose)))
+                {
+                    connectionEstablished = false;
+                    break;
+                }
             }
         }
     }
     catch (...) { }
 }
 
-void SpectatorViewSocket::SendSpatialMapping(byte* bytes, int length)
+void SpectatorViewSocket::SendSpatialMapping(const byte* bytes, int length)
 {
     // Segment bytes into packet sized chunks.
     SpatialMappingPacket packet;
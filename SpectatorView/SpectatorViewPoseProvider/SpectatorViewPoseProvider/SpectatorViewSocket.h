@@ -22,10 +22,13 @@ public:
     SpectatorViewSocket();
     ~SpectatorViewSocket();
 
-    void SendSpatialMapping(byte* bytes, int length);
+    void SendSpatialMapping(const byte* bytes, int length);
     void SendPose(SpatialCoordinateSystem^ cs);
     bool Listen();
 
+    // Surfaces the compositor reported holding with its last spatial mapping request.
+    std::vector<SurfaceVersion> GetKnownSurfaces();
+
     std::string anchorOwnerIP;
     std::string anchorName;
     int anchorPort;
@@ -36,6 +39,16 @@ private:
     WSASession session;
     TCPSocket tcp;
 
+    // Poses are sent as datagrams when the compositor asks for them, so they are not stuck behind spatial mapping data.
+    UDPSocket udp;
+    bool sendDatagramPoses = false;
+    PoseDatagram poseDatagram;
+
+    // Poses sampled for the current send, oldest first.
+    SVPose sampledPoses[POSE_SAMPLES_PER_SEND];
+    // Time of the newest pose we sent, in the same units as SVPose::sentTime.
+    LONGLONG lastSampleTime = 0;
+
     Windows::Globalization::Calendar^ calendar = nullptr;
     SpatialLocator^ locator;
     
@@ -47,8 +60,20 @@ private:
 
     byte* recvbuf = new byte[DEFAULT_BUFLEN];
     ClientToServerPacket packet;
+    SurfaceVersionPacket surfaceVersionPacket;
+
+    std::vector<SurfaceVersion> knownSurfaces;
+    std::mutex knownSurfacesLock;
+
+    bool ReceiveKnownSurfaces(int numKnownSurfaces);
+    void SetDatagramPoses(bool useDatagramPoses);
+    void SendPoseDatagram(const SVPose* poses, int numPoses);
+
+    // Find the pose nsPast nanoseconds ago and store it in currentPose, stamped with the time it was sampled at.
+    // Returns false if the pose could not be found.
+    bool GetPose(SpatialCoordinateSystem^ cs, int nsPast);
 
-    // Get time from compositor peer, find past pose, send pose back to peer.
-    void GetPose(SpatialCoordinateSystem^ cs, int nsPast);
+    // Current QPC time in the same units as SVPose::sentTime.
+    LONGLONG GetTime();
 };
 
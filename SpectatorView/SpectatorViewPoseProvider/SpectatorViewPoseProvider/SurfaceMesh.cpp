@@ -17,6 +17,8 @@
 #include "Common\StepTimer.h"
 #include "GetDataFromIBuffer.h"
 #include "SurfaceMesh.h"
+#include "SpatialMappingEncoder.h"
+#include "CompositorConstants.h"
 
 using namespace DirectX;
 using namespace Windows::Perception::Spatial;
@@ -347,49 +349,121 @@ void SurfaceMesh::ReleaseVertexResources()
     m_triangleIndices.Reset();
 }
 
-byte* SurfaceMesh::Serialize(int& length, Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem)
+bool SurfaceMesh::CanSerialize() const
 {
-    if (!m_constantBufferCreated || !m_loadingComplete)
+    if (m_surfaceMesh == nullptr || !m_constantBufferCreated || !m_loadingComplete)
     {
         // Resources are still being initialized.
-        return nullptr;
+        return false;
     }
 
     if (!m_isActive)
     {
         // Mesh is not active this frame, and should not be drawn.
-        return nullptr;
+        return false;
+    }
+
+    return m_surfaceMesh->VertexPositions->ElementCount > 0
+        && m_surfaceMesh->TriangleIndices->ElementCount > 0
+        && SpatialMappingEncoder::CanEncode(m_surfaceMesh->VertexPositions->ElementCount, m_surfaceMesh->TriangleIndices->ElementCount);
+}
+
+int SurfaceMesh::GetMaxSerializedSize() const
+{
+    if (!CanSerialize())
+    {
+        return 0;
+    }
+
+    return SpatialMappingEncoder::GetMaxEncodedSize(
+        m_surfaceMesh->VertexPositions->ElementCount,
+        m_surfaceMesh->TriangleIndices->ElementCount);
+}
+
+int SurfaceMesh::Serialize(byte* dst, int capacity, Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem, SpatialMappingScratch& scratch)
+{
+    if (!CanSerialize())
+    {
+        return 0;
     }
 
-    // Add transform information to beginning of vertex list.
-    int transformLength = 10 * sizeof(float);
-    int verticesLength = m_surfaceMesh->VertexPositions->ElementCount * 3 * sizeof(float) + transformLength;
-    if (verticesLength == 0)
+    int numVertices = m_surfaceMesh->VertexPositions->ElementCount;
+    int numIndices = m_surfaceMesh->TriangleIndices->ElementCount;
+    if (SpatialMappingEncoder::GetMaxEncodedSize(numVertices, numIndices) > capacity)
     {
-        return nullptr;
+        // The mesh changed after the buffer was sized.
+        return 0;
     }
+
     short* vertexPositions = GetDataFromIBuffer<short>(m_surfaceMesh->VertexPositions->Data);
+    unsigned short* vertexIndices = GetDataFromIBuffer<unsigned short>(m_surfaceMesh->TriangleIndices->Data);
+    if (vertexPositions == nullptr || vertexIndices == nullptr)
+    {
+        return 0;
+    }
 
-    int indicesLength = m_surfaceMesh->TriangleIndices->Data->Length;
-    if (indicesLength == 0)
+    SpatialMappingMeshHeader header = GetSerializedHeader(baseCoordinateSystem);
+    RememberSentTransform(header);
+
+    // Positions stay as int16 on the wire, VertexPositionScale is carried in the mesh scale.
+    return SpatialMappingEncoder::Encode(
+        header,
+        vertexPositions, m_surfaceMesh->VertexPositions->Stride / sizeof(short), numVertices,
+        vertexIndices, numIndices,
+        SPATIAL_MAPPING_ENTROPY_CODING == TRUE,
+        dst,
+        scratch);
+}
+
+int SurfaceMesh::SerializeTransform(byte* dst, int capacity, SpatialCoordinateSystem^ baseCoordinateSystem)
+{
+    if (!CanSerialize() || capacity < (int)sizeof(SpatialMappingMeshHeader))
     {
-        return nullptr;
+        return 0;
     }
-    short* vertexIndices = GetDataFromIBuffer<short>(m_surfaceMesh->TriangleIndices->Data);
 
-    length = (2 * sizeof(int)) + verticesLength + indicesLength;
-    byte* buffer = new byte[length];
-    
-    // First serialize number of vertices and indices.
-    int startIndex = 0;
-    memcpy(&buffer[startIndex], &verticesLength, sizeof(int));
-    startIndex += sizeof(int);
+    SpatialMappingMeshHeader header = GetSerializedHeader(baseCoordinateSystem);
+    RememberSentTransform(header);
 
-    memcpy(&buffer[startIndex], &indicesLength, sizeof(int));
-    startIndex += sizeof(int);
+    return SpatialMappingEncoder::EncodeTransform(header, dst);
+}
 
-    // Then serialize byte arrays for vertices and indices.
+bool SurfaceMesh::HasTransformChanged(SpatialCoordinateSystem^ baseCoordinateSystem) const
+{
+    if (!CanSerialize())
+    {
+        return false;
+    }
+
+    if (!m_hasSentTransform)
+    {
+        // The compositor's copy was sent before this mesh was created, eg: by an earlier run of the app.
+        return true;
+    }
 
+    // Tracking refines the transform a little on most frames, so only count moves of more than about 1 mm or 0.01 degrees.
+    // q and -q are the same rotation.
+    SpatialMappingMeshHeader header = GetSerializedHeader(baseCoordinateSystem);
+    XMVECTOR rotation = XMLoadFloat4(&header.rotation);
+    XMVECTOR sentRotation = XMLoadFloat4(&m_sentRotation);
+    XMVECTOR sentScale = XMLoadFloat3(&m_sentScale);
+    bool samePosition = XMVector3NearEqual(XMLoadFloat3(&header.translation), XMLoadFloat3(&m_sentTranslation), XMVectorReplicate(0.001f));
+    bool sameRotation = XMVector4NearEqual(rotation, sentRotation, XMVectorReplicate(0.0001f))
+        || XMVector4NearEqual(XMVectorNegate(rotation), sentRotation, XMVectorReplicate(0.0001f));
+    bool sameScale = XMVector3NearEqual(XMLoadFloat3(&header.scale), sentScale, XMVectorScale(XMVectorAbs(sentScale), 0.0001f));
+    return !(samePosition && sameRotation && sameScale);
+}
+
+void SurfaceMesh::RememberSentTransform(const SpatialMappingMeshHeader& header)
+{
+    m_hasSentTransform = true;
+    m_sentTranslation = header.translation;
+    m_sentRotation = header.rotation;
+    m_sentScale = header.scale;
+}
+
+SpatialMappingMeshHeader SurfaceMesh::GetSerializedHeader(SpatialCoordinateSystem^ baseCoordinateSystem) const
+{
     XMFLOAT3 meshTranslation = XMFLOAT3(0, 0, 0);
     XMFLOAT4 meshRotation = XMFLOAT4(0, 0, 0, 1);
     XMFLOAT3 meshScale = XMFLOAT3(1, 1, 1);
@@ -424,40 +498,23 @@ byte* SurfaceMesh::Serialize(int& length, Windows::Perception::Spatial::SpatialC
         meshTranslation.z = -1 * meshTranslation.z;
     }
 
-    // Add transform information to vertex list
-    // Position
-    memcpy(&buffer[startIndex], &meshTranslation, sizeof(XMFLOAT3));
-    startIndex += sizeof(XMFLOAT3);
-
-    // Rotation
-    memcpy(&buffer[startIndex], &meshRotation, sizeof(XMFLOAT4));
-    startIndex += sizeof(XMFLOAT4);
-
-    // Scale
-    memcpy(&buffer[startIndex], &meshScale, sizeof(XMFLOAT3));
-    startIndex += sizeof(XMFLOAT3);
+    SpatialMappingMeshHeader header = {};
+    header.id = m_surfaceMesh->SurfaceInfo->Id;
+    header.updateTime = GetSurfaceUpdateTime();
+    header.translation = meshTranslation;
+    header.rotation = meshRotation;
+    header.scale = meshScale;
+    return header;
+}
 
-    // Vertices
-    int numVertices = m_surfaceMesh->VertexPositions->ElementCount;
-    for (int i = 0; i < numVertices; i++)
+LONGLONG SurfaceMesh::GetSurfaceUpdateTime() const
+{
+    if (m_surfaceMesh == nullptr)
     {
-        // Ignoring w component.
-        int vertexStartIndex = i * 4;
-
-        XMFLOAT3 vertex = XMFLOAT3(
-            (float)vertexPositions[vertexStartIndex],
-            (float)vertexPositions[vertexStartIndex + 1],
-            (float)vertexPositions[vertexStartIndex + 2]
-        );
-
-        memcpy(&buffer[startIndex], &vertex, sizeof(XMFLOAT3));
-        startIndex += sizeof(XMFLOAT3);
+        return 0;
     }
 
-    // Indices
-    memcpy(&buffer[startIndex], vertexIndices, indicesLength);
-
-    return buffer;
+    return m_surfaceMesh->SurfaceInfo->UpdateTime.UniversalTime;
 }
 
 void SurfaceMesh::SwapVertexBuffers()
@@ -16,6 +16,9 @@
 
 using namespace SpectatorViewPoseProvider;
 
+class SpatialMappingScratch;
+struct SpatialMappingMeshHeader;
+
 struct SurfaceMeshProperties
 {
     unsigned int vertexStride = 0;
@@ -53,9 +56,35 @@ public:
     void SetIsActive(const bool& isActive) { m_isActive = isActive; }
     void SetColorFadeTimer(const float& duration) { m_colorFadeTimeout = duration; m_colorFadeTimer = 0.f; }
 
-    byte* Serialize(int& length, Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem);
+    // Upper bound on the bytes Serialize will write, or 0 if the mesh cannot be serialized right now.
+    int GetMaxSerializedSize() const;
+
+    // Encode this mesh into dst.  Returns the number of bytes written, or 0 if nothing was written.
+    int Serialize(
+        byte* dst,
+        int capacity,
+        Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem,
+        SpatialMappingScratch& scratch);
+
+    // Update time of the surface mesh that Serialize will send, or 0 if there is no mesh yet.
+    LONGLONG GetSurfaceUpdateTime() const;
+
+    // Whether the mesh's transform relative to baseCoordinateSystem moved since Serialize or SerializeTransform last sent it,
+    // eg: after the tracker re-localized, or when the base coordinate system changed.
+    bool HasTransformChanged(Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem) const;
+
+    // Encode a record that only moves the compositor's copy of this mesh, see SpatialMappingEncoder::EncodeTransform.
+    // Returns the number of bytes written, or 0 if nothing was written.
+    int SerializeTransform(
+        byte* dst,
+        int capacity,
+        Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem);
 
 private:
+    bool CanSerialize() const;
+    // The mesh's id, update time and transform in Unity space relative to baseCoordinateSystem.
+    SpatialMappingMeshHeader GetSerializedHeader(Windows::Perception::Spatial::SpatialCoordinateSystem^ baseCoordinateSystem) const;
+    void RememberSentTransform(const SpatialMappingMeshHeader& header);
     void SwapVertexBuffers();
     void CreateDirectXBuffer(
         ID3D11Device* device,
@@ -76,6 +105,12 @@ private:
 
     Windows::Foundation::DateTime m_lastUpdateTime;
 
+    // Transform of the last mesh or transform-only record sent to the compositor.
+    bool              m_hasSentTransform = false;
+    DirectX::XMFLOAT3 m_sentTranslation;
+    DirectX::XMFLOAT4 m_sentRotation;
+    DirectX::XMFLOAT3 m_sentScale;
+
     SurfaceMeshProperties m_meshProperties;
     SurfaceMeshProperties m_updatedMeshProperties;
 
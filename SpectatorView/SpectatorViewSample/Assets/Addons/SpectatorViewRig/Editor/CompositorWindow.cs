@@ -30,6 +30,12 @@ namespace SpectatorView
         [DllImport("UnityCompositorInterface")]
         private static extern int TakePicture();
 
+        [UnmanagedFunctionPointer(CallingConvention.StdCall)]
+        private delegate void PictureSavedCallback([MarshalAs(UnmanagedType.LPWStr)] string path, [MarshalAs(UnmanagedType.I1)] bool succeeded);
+
+        [DllImport("UnityCompositorInterface")]
+        private static extern void SetPictureSavedCallback(PictureSavedCallback callback);
+
         [DllImport("UnityCompositorInterface")]
         private static extern bool IsRecording();
 
@@ -39,12 +45,27 @@ namespace SpectatorView
         [DllImport("UnityCompositorInterface")]
         private static extern void StopRecording();
 
+        [DllImport("UnityCompositorInterface")]
+        private static extern bool StartReplay(int seconds, int memoryMB);
+
+        [DllImport("UnityCompositorInterface")]
+        private static extern void StopReplay();
+
+        [DllImport("UnityCompositorInterface")]
+        private static extern bool IsReplayEnabled();
+
+        [DllImport("UnityCompositorInterface")]
+        private static extern bool SaveReplay();
+
         [DllImport("UnityCompositorInterface")]
         private static extern bool RequestSpatialMapping();
         #endregion
 
         private static CompositorWindow window = null;
 
+        // Kept alive for as long as the plugin can call it.
+        private static PictureSavedCallback pictureSavedCallback = OnPictureSaved;
+
         static float aspect;
         static float padding = 10;
         static float frameWidth = 100;
@@ -59,12 +80,26 @@ namespace SpectatorView
         private void OnEnable()
         {
             aspect = (float)GetFrameWidth() / (float)GetFrameHeight();
+            SetPictureSavedCallback(pictureSavedCallback);
             if (SpectatorViewManager.Instance != null)
             {
                 SpectatorViewManager.Instance.frameProviderInitialized = false;
             }
         }
 
+        // Called on a picture encoder thread, so only thread safe Unity APIs can be used here.
+        private static void OnPictureSaved(string path, bool succeeded)
+        {
+            if (succeeded)
+            {
+                UnityEngine.Debug.Log("Saved picture: " + path);
+            }
+            else
+            {
+                UnityEngine.Debug.LogError("Could not save picture: " + path);
+            }
+        }
+
         private void OnDestroy()
         {
             if (SpectatorView.SpectatorViewManager.Instance != null)
@@ -252,6 +287,31 @@ namespace SpectatorView
                 }
             }
 
+            EditorGUILayout.BeginVertical("Box");
+            {
+                if (!IsReplayEnabled())
+                {
+                    // Zero uses the plugin's default length and memory budget.
+                    if (GUILayout.Button("Start Instant Replay"))
+                    {
+                        StartReplay(0, 0);
+                    }
+                }
+                else
+                {
+                    if (GUILayout.Button("Save Replay"))
+                    {
+                        SaveReplay();
+                    }
+
+                    if (GUILayout.Button("Stop Instant Replay"))
+                    {
+                        StopReplay();
+                    }
+                }
+            }
+            EditorGUILayout.EndVertical();
+
             if (GUILayout.Button("Take Picture"))
             {
                 TakePicture();
@@ -18,7 +18,8 @@ namespace SpectatorView
         private static extern bool GetSpatialMappingDataBufferLengths(int index, out int numVertices, out int numIndices);
 
         [DllImport("UnityCompositorInterface")]
-        private static extern bool GetSpatialMappingData(int index, out Vector3 translation, out Quaternion rotation, out Vector3 scale, out IntPtr vertices, out IntPtr indices);
+        private static extern bool GetSpatialMappingData(int index, out Vector3 translation, out Quaternion rotation, out Vector3 scale,
+            [Out] float[] vertices, int maxVertices, [Out] short[] indices, int maxIndices, out int numVertices, out int numIndices);
 
         [DllImport("UnityCompositorInterface")]
         private static extern void ResetPoseCache();
@@ -57,30 +58,8 @@ namespace SpectatorView
                 }
                 spatialMappingMeshes.Clear();
 
-                // Find largest sizes for index and vertex buffers.
-                int largestNumVertices = int.MinValue;
-                int largestNumIndices = int.MinValue;
                 int numVertices;
                 int numIndices;
-                for (int i = 0; i < numSpatialMappingMeshes; i++)
-                {
-                    if (GetSpatialMappingDataBufferLengths(i, out numVertices, out numIndices))
-                    {
-                        if (numVertices > largestNumVertices)
-                        {
-                            largestNumVertices = numVertices;
-                        }
-
-                        if (numIndices > largestNumIndices)
-                        {
-                            largestNumIndices = numIndices;
-                        }
-                    }
-                }
-
-                IntPtr nativeVertices = Marshal.AllocHGlobal(largestNumVertices * 3 * sizeof(float));
-                IntPtr nativeIndices = Marshal.AllocHGlobal(largestNumIndices * sizeof(short));
-
                 for (int i = 0; i < numSpatialMappingMeshes; i++)
                 {
                     if (GetSpatialMappingDataBufferLengths(i, out numVertices, out numIndices))
@@ -96,17 +75,17 @@ namespace SpectatorView
                         Vector3 meshTrans;
                         Quaternion meshRot;
                         Vector3 meshScale;
-                        if (GetSpatialMappingData(i, out meshTrans, out meshRot, out meshScale, out nativeVertices, out nativeIndices))
+                        // The DLL copies the mesh into these arrays while it holds its lock, and sets numVertices and numIndices to what it copied.
+                        // It fails if the mesh was updated since GetSpatialMappingDataBufferLengths and no longer fits.
+                        if (GetSpatialMappingData(i, out meshTrans, out meshRot, out meshScale,
+                            vertexElements, vertexElements.Length / 3, indices, indices.Length, out numVertices, out numIndices))
                         {
                             TransformValidation.ValidateVector(ref meshTrans);
                             TransformValidation.ValidateVector(ref meshScale);
                             meshRot = TransformValidation.GetNormalizedQuaternion(meshRot);
 
-                            Marshal.Copy(nativeVertices, vertexElements, 0, numVertices * 3);
-                            Marshal.Copy(nativeIndices, indices, 0, numIndices);
-
                             List<Vector3> vertices = new List<Vector3>();
-                            for (int v = 0; v < vertexElements.Length; v += 3)
+                            for (int v = 0; v < numVertices * 3; v += 3)
                             {
                                 Vector3 vertex = new Vector3(
                                     vertexElements[v],
@@ -160,10 +139,6 @@ namespace SpectatorView
                     }
                 }
 
-                //TODO: We should be freeing the memory we allocated for the index and vertex buffers, but this was deadlocking.
-                //Marshal.FreeHGlobal(nativeVertices);
-                //Marshal.FreeHGlobal(nativeIndices);
-
                 // When receiving spatial mapping data, some amount of time will pass without receiving any pose data.
                 // To ensure our poses remain synced, force a reset of our pose cache.
                 ResetPoseCache();